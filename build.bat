@@ -26,15 +26,26 @@ if not defined VULKAN_SDK (
 echo --- Compiling Vulkan Demo ---
 
 REM Compile the C code, including the Vulkan SDK headers and linking the Vulkan library.
+REM Every step is checked, so a failed compile is never reported as a success.
 cl.exe main.c /I"%VULKAN_SDK%\Include" /link /LIBPATH:"%VULKAN_SDK%\Lib" vulkan-1.lib /OUT:render.exe
+if %errorlevel% neq 0 goto :failed
+REM setargv.obj expands the spv\*.spv wildcard, which cmd leaves to the program.
+cl.exe /O2 spvbundle.c /link setargv.obj /OUT:spvbundle.exe
+if %errorlevel% neq 0 goto :failed
 
-if %errorlevel% neq 0 (
-    echo.
-    echo --- Build FAILED ---
-) else (
-    echo.
-    echo --- Build SUCCEEDED ---
-    echo Run 'render.exe' to generate 'render.ppm'.
-)
+REM Pack every module into one mapped file for --bundle (see spirv_bundle.h).
+REM This script compiles no shaders; build them with build.ps1 first.
+spvbundle.exe spv\shaders.spvb spv\*.spv
+if %errorlevel% neq 0 goto :failed
+
+echo.
+echo --- Build SUCCEEDED ---
+echo Run 'render.exe' to generate 'render.ppm'.
+goto :eof
+
+:failed
+echo.
+echo --- Build FAILED ---
+exit /b 1
 
 :eof
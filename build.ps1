@@ -14,6 +14,7 @@ Write-Host "Compiling shaders..."
 
 # Run glslc for vertex shader
 & "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shader.vert -o spv/shader.vert.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" shaderGrid.vert -o spv/shaderGrid.vert.spv
 if ($LASTEXITCODE -ne 0) {
     Write-Error "Vertex shader compilation failed."
     exit 1
@@ -25,10 +26,51 @@ if ($LASTEXITCODE -ne 0) {
 & "$env:VULKAN_SDK\bin\glslc.exe" shaderSubgroupGray.frag -o spv/shaderSubgroupGray.frag.spv
 & "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderSubgroupShuffleGray.frag -o spv/shaderSubgroupShuffleGray.frag.spv
 & "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderShuffle.frag -o spv/shaderShuffle.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderShufflePacked.frag -o spv/shaderShufflePacked.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderShuffleHalf.frag -o spv/shaderShuffleHalf.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderShuffleFloat16.frag -o spv/shaderShuffleFloat16.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderSubgroupShuffleGray8.frag -o spv/shaderSubgroupShuffleGray8.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderShufflePattern.frag -o spv/shaderShufflePattern.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderVersus.frag -o spv/shaderVersus.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DLANE_STATS shaderVersus.frag -o spv/shaderVersusStats.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DQUAD_OPS shaderQuad.frag -o spv/shaderQuad.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderQuad.frag -o spv/shaderQuadShuffle.frag.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderLaneStats.frag -o spv/shaderLaneStats.frag.spv
 if ($LASTEXITCODE -ne 0) {
     Write-Error "Fragment shader compilation failed."
     exit 1
 }
+
+# Run glslc for compute shaders (invocationMapping.glsl is pulled in via #include)
+& "$env:VULKAN_SDK\bin\glslc.exe" shaderCompute.comp -o spv/shaderCompute.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeSubgroup.comp -o spv/shaderComputeSubgroup.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeSubgroupShuffle.comp -o spv/shaderComputeSubgroupShuffle.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeStencilShuffle.comp -o spv/shaderComputeStencilShuffle.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeBatch.comp -o spv/shaderComputeBatch.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderImageHash.comp -o spv/shaderImageHash.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" shaderComputePost.comp -o spv/shaderComputePost.comp.spv
+foreach ($bits in 8, 16, 32) {
+    & "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DPRECISION=$bits shaderComputeStencilPrecision.comp -o spv/shaderComputeStencilPrecision$bits.comp.spv
+}
+foreach ($bits in 8, 16, 32, 64) {
+    & "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DPAYLOAD_BITS=$bits shaderComputeShufflePayload.comp -o spv/shaderComputeShufflePayload$bits.comp.spv
+}
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeVersus.comp -o spv/shaderComputeVersus.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DLANE_STATS shaderComputeVersus.comp -o spv/shaderComputeVersusStats.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DOUTPUT_BUFFER shaderComputeStore.comp -o spv/shaderComputeStoreBuffer.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DOUTPUT_TEXEL_BUFFER shaderComputeStore.comp -o spv/shaderComputeStoreTexelBuffer.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DQUAD_OPS shaderComputeQuad.comp -o spv/shaderComputeQuad.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeQuad.comp -o spv/shaderComputeQuadShuffle.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeWorkQueue.comp -o spv/shaderComputeWorkQueue.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 -DPERSISTENT shaderComputeWorkQueue.comp -o spv/shaderComputeWorkQueuePersistent.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeShufflePattern.comp -o spv/shaderComputeShufflePattern.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" --target-spv=spv1.3 shaderComputeClassify.comp -o spv/shaderComputeClassify.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" shaderComputeSparse.comp -o spv/shaderComputeSparse.comp.spv
+& "$env:VULKAN_SDK\bin\glslc.exe" -DTILE_LIST shaderComputeSparse.comp -o spv/shaderComputeSparseList.comp.spv
+if ($LASTEXITCODE -ne 0) {
+    Write-Error "Compute shader compilation failed."
+    exit 1
+}
 Write-Host "Shaders compiled successfully."
 
 # Check if cl.exe is available
@@ -50,6 +92,8 @@ Write-Host "--- Compiling Vulkan Demo ---"
 # Compile the C code, including the Vulkan SDK headers and linking the Vulkan library
 cl.exe main.c /I"$env:VULKAN_SDK\Include" /link /LIBPATH:"$env:VULKAN_SDK\Lib" vulkan-1.lib /OUT:render.exe
 cl.exe compute.c /I"$env:VULKAN_SDK\Include" /link /LIBPATH:"$env:VULKAN_SDK\Lib" vulkan-1.lib /OUT:compute.exe
+cl.exe /O2 /arch:AVX2 cpuref.c /link /OUT:cpuref.exe
+cl.exe /O2 spvbundle.c /link /OUT:spvbundle.exe
 
 if ($LASTEXITCODE -ne 0) {
     Write-Host ""
@@ -60,3 +104,10 @@ if ($LASTEXITCODE -ne 0) {
     Write-Host "--- Build SUCCEEDED ---"
     Write-Host "Run 'render.exe' to generate 'render.ppm'."
 }
+
+# Pack every module into one mapped file for --bundle (see spirv_bundle.h).
+.\spvbundle.exe spv/shaders.spvb (Get-ChildItem spv/*.spv | ForEach-Object { "spv/" + $_.Name })
+if ($LASTEXITCODE -ne 0) {
+    Write-Error "Shader bundle failed."
+    exit 1
+}
@@ -5,23 +5,70 @@
 # Ensure the Vulkan SDK is sourced, which provides glslc.
 # For example: source /path/to/your/vulkansdk/1.x.x.x/setup-env.sh
 
-# echo "Compiling shaders..."
-# glslc shader.vert -o vert.spv
-# glslc shader.frag -o frag.spv
-# glslc shaderShuffle.frag -o frag.spv
+# Stop at the first failing compiler, so a stale module is never bundled.
+set -e
 
-# if [ $? -ne 0 ]; then
-#     echo "Shader compilation failed."
-#     exit 1
-# fi
+echo "Compiling shaders..."
+mkdir -p spv
+
+# Vertex shaders
+glslc --target-spv=spv1.3 shader.vert -o spv/shader.vert.spv
+glslc shaderGrid.vert -o spv/shaderGrid.vert.spv
+
+# Fragment shaders
+glslc shader.frag -o spv/shader.frag.spv
+glslc shaderSubgroup.frag -o spv/shaderSubgroup.frag.spv
+glslc shaderSubgroupGray.frag -o spv/shaderSubgroupGray.frag.spv
+glslc --target-spv=spv1.3 shaderSubgroupShuffleGray.frag -o spv/shaderSubgroupShuffleGray.frag.spv
+glslc --target-spv=spv1.3 shaderShuffle.frag -o spv/shaderShuffle.frag.spv
+glslc --target-spv=spv1.3 shaderShufflePacked.frag -o spv/shaderShufflePacked.frag.spv
+glslc --target-spv=spv1.3 shaderShuffleHalf.frag -o spv/shaderShuffleHalf.frag.spv
+glslc --target-spv=spv1.3 shaderShuffleFloat16.frag -o spv/shaderShuffleFloat16.frag.spv
+glslc --target-spv=spv1.3 shaderSubgroupShuffleGray8.frag -o spv/shaderSubgroupShuffleGray8.frag.spv
+glslc --target-spv=spv1.3 shaderShufflePattern.frag -o spv/shaderShufflePattern.frag.spv
+glslc --target-spv=spv1.3 shaderVersus.frag -o spv/shaderVersus.frag.spv
+glslc --target-spv=spv1.3 -DLANE_STATS shaderVersus.frag -o spv/shaderVersusStats.frag.spv
+glslc --target-spv=spv1.3 -DQUAD_OPS shaderQuad.frag -o spv/shaderQuad.frag.spv
+glslc --target-spv=spv1.3 shaderQuad.frag -o spv/shaderQuadShuffle.frag.spv
+glslc --target-spv=spv1.3 shaderLaneStats.frag -o spv/shaderLaneStats.frag.spv
+
+# Compute shaders (invocationMapping.glsl is pulled in via #include)
+glslc shaderCompute.comp -o spv/shaderCompute.comp.spv
+glslc --target-spv=spv1.3 shaderComputeSubgroup.comp -o spv/shaderComputeSubgroup.comp.spv
+glslc --target-spv=spv1.3 shaderComputeSubgroupShuffle.comp -o spv/shaderComputeSubgroupShuffle.comp.spv
+glslc --target-spv=spv1.3 shaderComputeStencilShuffle.comp -o spv/shaderComputeStencilShuffle.comp.spv
+glslc --target-spv=spv1.3 shaderComputeBatch.comp -o spv/shaderComputeBatch.comp.spv
+glslc --target-spv=spv1.3 shaderImageHash.comp -o spv/shaderImageHash.comp.spv
+glslc shaderComputePost.comp -o spv/shaderComputePost.comp.spv
+for bits in 8 16 32; do
+    glslc --target-spv=spv1.3 -DPRECISION=$bits shaderComputeStencilPrecision.comp -o spv/shaderComputeStencilPrecision$bits.comp.spv
+done
+for bits in 8 16 32 64; do
+    glslc --target-spv=spv1.3 -DPAYLOAD_BITS=$bits shaderComputeShufflePayload.comp -o spv/shaderComputeShufflePayload$bits.comp.spv
+done
+glslc --target-spv=spv1.3 shaderComputeVersus.comp -o spv/shaderComputeVersus.comp.spv
+glslc --target-spv=spv1.3 -DLANE_STATS shaderComputeVersus.comp -o spv/shaderComputeVersusStats.comp.spv
+glslc --target-spv=spv1.3 -DOUTPUT_BUFFER shaderComputeStore.comp -o spv/shaderComputeStoreBuffer.comp.spv
+glslc --target-spv=spv1.3 -DOUTPUT_TEXEL_BUFFER shaderComputeStore.comp -o spv/shaderComputeStoreTexelBuffer.comp.spv
+glslc --target-spv=spv1.3 -DQUAD_OPS shaderComputeQuad.comp -o spv/shaderComputeQuad.comp.spv
+glslc --target-spv=spv1.3 shaderComputeQuad.comp -o spv/shaderComputeQuadShuffle.comp.spv
+glslc --target-spv=spv1.3 shaderComputeWorkQueue.comp -o spv/shaderComputeWorkQueue.comp.spv
+glslc --target-spv=spv1.3 -DPERSISTENT shaderComputeWorkQueue.comp -o spv/shaderComputeWorkQueuePersistent.comp.spv
+glslc --target-spv=spv1.3 shaderComputeShufflePattern.comp -o spv/shaderComputeShufflePattern.comp.spv
+glslc --target-spv=spv1.3 shaderComputeClassify.comp -o spv/shaderComputeClassify.comp.spv
+glslc shaderComputeSparse.comp -o spv/shaderComputeSparse.comp.spv
+glslc -DTILE_LIST shaderComputeSparse.comp -o spv/shaderComputeSparseList.comp.spv
 
 echo "Compiling C code..."
-gcc -I1.4.321.1/x86_64/include/ -ggdb main.c -o render -lvulkan -ldl
+gcc -I1.4.321.1/x86_64/include/ -ggdb main.c -o render -lvulkan -ldl -lpthread
+# -ffp-contract=off keeps the CPU reference kernels (cpu_kernels.h) from
+# fusing multiply-adds, so their output does not depend on the target ISA.
+gcc -I1.4.321.1/x86_64/include/ -ggdb -O2 -march=native -ffp-contract=off compute.c -o compute -ldl -lpthread -lm
+gcc -O2 -march=native -ffp-contract=off cpuref.c -o cpuref -lpthread -lm
+gcc -O2 spvbundle.c -o spvbundle
 
-if [ $? -ne 0 ]; then
-    echo "C code compilation failed."
-    exit 1
-fi
+# Pack every module into one mapped file for --bundle (see spirv_bundle.h).
+./spvbundle spv/shaders.spvb spv/*.spv
 
 echo ""
 echo "Compilation successful!"
@@ -2,7 +2,9 @@
 #include <vulkan/vulkan.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <string.h>
 
 #ifdef __linux__
 #include <dlfcn.h>
@@ -11,87 +13,4029 @@
 #include <windows.h>
 #endif
 
-// Define the dimensions of the image we want to generate.
+// Define the default dimensions of the image we want to generate.
 #define IMAGE_WIDTH 256
 #define IMAGE_HEIGHT 256
 
+// The compute kernels all use a 16x16 workgroup.
+#define WORKGROUP_DIM 16
+
 #define EXPORTED_VULKAN_FUNCTION( name ) PFN_##name name;
 #define GLOBAL_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
 #define INSTANCE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
+#define OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
 #define DEVICE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
+#define OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
+
+#include "vulkan_functions.h"
+#include "timing.h"
+#include "host_alloc.h"
+#include "memory_budget.h"
+#include "frame_stream.h"
+#include "frame_params.h"
+#include "image_hash.h"
+#include "submit_graph.h"
+#include "device_select.h"
+#include "cpu_kernels.h"
+#include "parallel_record.h"
+#include "graphics_pass.h"
+#include "shuffle_variants.h"
+#include "spirv_bundle.h"
+#include "gpu_counters.h"
+
+// Simple error handling macro.
+#define VK_CHECK(result)                                                 \
+    if (result != VK_SUCCESS) {                                          \
+        fprintf(stderr, "Vulkan error in %s at line %d: %d\n", __FILE__, \
+                __LINE__, result);                                       \
+        exit(EXIT_FAILURE);                                              \
+    }
+
+// Invocation-to-pixel mappings understood by invocationMapping.glsl.
+enum {
+    MAPPING_LINEAR = 0,
+    MAPPING_MORTON = 1,
+    MAPPING_TILED = 2,
+    MAPPING_COUNT
+};
+const char* mappingNames[MAPPING_COUNT] = { "linear", "morton", "tiled" };
+
+// Specialization constants consumed by invocationMapping.glsl (constant_id 0..2).
+typedef struct {
+    uint32_t mapping;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+} MappingSpecialization;
+
+// Command line options.
+typedef struct {
+    const char* shaderPath;
+    const char* bundlePath; // Modules from one mapped file (see spirv_bundle.h).
+    const char* outputPath;
+    uint32_t width;
+    uint32_t height;
+    MappingSpecialization mapping;
+    int dispatch1D;
+    uint32_t benchIterations;
+    uint32_t shuffleBenchIterations;
+    uint32_t precisionBenchIterations;
+    uint32_t pushBenchFrames;
+    uint32_t batchLayers;
+    // Readback-free verification (see image_hash.h).
+    int hashOutput;
+    const char* expectedHash;
+    int cpuCheck; // Compare against the CPU reference (see cpu_kernels.h).
+    uint32_t graphJobs;
+    uint32_t recordRounds;
+    uint32_t shufflePattern;
+    // Driver host allocations (see host_alloc.h).
+    HostAllocMode hostAlloc;
+    int hostAllocReport;
+    uint32_t allocBenchFrames;
+    const char* memoryLogPath; // Device memory timeline (see memory_budget.h).
+    uint32_t versusIterations; // Fragment vs compute head-to-head (see graphics_pass.h).
+    uint32_t layoutBenchIterations;
+    uint32_t quadBenchIterations;
+    uint32_t packedBenchIterations; // Packed fragment shuffles (see notes.md).
+    uint32_t queueBenchIterations; // Persistent workgroups vs the plain grid.
+    uint32_t patternSweepIterations; // Specialized shuffle patterns (see shuffle_variants.h).
+    uint32_t indirectBenchIterations; // GPU-sized dispatch over active tiles vs the whole image.
+    uint32_t asyncBenchIterations; // Fragment renders and compute kernels on two queues at once.
+    uint32_t statsIterations; // Pipeline statistics and performance counters (see gpu_counters.h).
+    // Device override and capability report (see device_select.h).
+    const char* deviceSelector;
+    const char* reportPath;
+    // Frame streaming (see frame_stream.h).
+    const char* streamPath;
+    FrameStreamFormat streamFormat;
+    uint32_t frames;
+    uint32_t fps;
+    uint32_t streamQueue;
+    int streamDrop;
+} ComputeOptions;
+
+// Handles shared by the recording, submission and benchmark helpers.
+typedef struct {
+    VkPhysicalDevice physicalDevice;
+    VkDevice device;
+    VkQueue queue;
+    uint32_t queueFamilyIndex;
+    // Second queue for --async-bench; `queue` itself when there is none.
+    VkQueue asyncQueue;
+    uint32_t asyncQueueFamilyIndex;
+    float timestampPeriod;
+    uint32_t timestampValidBits;
+    VkCommandPool commandPool;
+    VkCommandBuffer commandBuffer;
+    VkFence fence;
+    VkPipelineLayout pipelineLayout;
+    VkDescriptorSet descriptorSet;
+    VkImage image;
+    VkImageView imageView;
+    VkBuffer stagingBuffer;
+    VkDeviceMemory stagingBufferMemory;
+    uint32_t width;
+    uint32_t height;
+    uint32_t layers; // Array layers in `image`, one dispatch slice each.
+    int dispatch1D;
+    uint32_t subgroupSize; // Reported by the device, used by the CPU reference.
+    // Pinning the subgroup size (Vulkan 1.3 or VK_EXT_subgroup_size_control);
+    // both flags are 0 when the features were not enabled.
+    VkBool32 subgroupSizeControl;
+    VkBool32 computeFullSubgroups;
+    VkPhysicalDeviceSubgroupSizeControlProperties sizeControl;
+    VkShaderStageFlags subgroupStages;
+    VkSubgroupFeatureFlags subgroupOperations;
+    VkBool32 quadOperationsInAllStages;
+    // Push constant source, see frame_params.h.
+    uint32_t shufflePattern;
+    float frameRate;
+    // When set, the recorded commands hash the image instead of copying it out.
+    const ImageHasher* hasher;
+    // When set, recordComputeCommands() brackets dispatch i with query i.
+    const GpuCounters* counters;
+    // Optional device features that were enabled at device creation.
+    VkBool32 shaderInt8;
+    VkBool32 shaderInt16;
+    VkBool32 shaderInt64;
+    VkBool32 shaderFloat16;
+    VkBool32 subgroupExtendedTypes;
+    VkBool32 storageBuffer16BitAccess;
+    VkBool32 storageBuffer8BitAccess;
+    VkBool32 timelineSemaphore;
+    VkBool32 fragmentStoresAndAtomics;
+    VkBool32 pipelineStatisticsQuery;
+    VkBool32 performanceQuery; // VK_KHR_performance_query counter pools.
+} ComputeContext;
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --device <sel>         device index, name substring or UUID (default: best score, or $%s)\n"
+            "  --report <file|->      write a JSON capability report of every device\n"
+            "  --shader <file.spv>    compute shader (default spv/shaderComputeSubgroupShuffle.comp.spv)\n"
+            "  --bundle <file.spvb>   take shaders from a bundle (spvbundle) by file name, with a pipeline cache\n"
+            "  --output <file.ppm>    output image (default output.ppm)\n"
+            "  --size <W>x<H>         image size, multiples of %d (default %dx%d)\n"
+            "  --mapping <name>       invocation mapping: linear, morton, tiled (default linear)\n"
+            "  --tile <N>x<M>         sub-tile shape for the tiled mapping (default 8x4)\n"
+            "  --dispatch <1d|2d>     dispatch shape (default 2d)\n"
+            "  --bench <iterations>   time every mapping with the stencil kernel\n"
+            "  --shuffle-bench <iterations>  time 8/16/32/64-bit subgroupShuffle payloads\n"
+            "  --precision-bench <iterations>  time the fp32/fp16/int8 stencil variants\n"
+            "  --pattern <name>       shuffle pattern push constant: reverse, rotate, xor (default reverse)\n"
+            "  --push-bench <frames>  per-frame CPU cost of push-constant frames\n"
+            "  --batch <layers>       render <layers> images in one dispatch vs one per submit\n"
+            "  --hash                 hash the output on the GPU, check it against a full readback\n"
+            "  --verify <hex>         hash the output on the GPU and compare (no image readback)\n"
+            "  --cpu-check            compare the output with the CPU subgroup emulator, time both\n"
+            "  --graph <jobs>         render/post/hash/copy as a timeline-semaphore graph vs waits per stage\n"
+            "  --record-bench <rounds>  record one dispatch per workgroup row per round on 1..N threads\n"
+            "  --host-alloc <mode>    driver host allocations: system, tracking, arena (default system)\n"
+            "  --alloc-bench <frames> compare the host allocators on pipeline creation and per-frame recording\n"
+            "  --memory-log <file|->  write the device memory timeline as CSV and print per-heap peaks\n"
+            "  --versus <iterations>  same image from a fragment shader and a compute kernel, cost and lane occupancy\n"
+            "  --layout-bench <iterations>  output to an optimal image + copy, linear image, buffer or texel buffer\n"
+            "  --quad-bench <iterations>  2x2 filter with subgroup quad operations vs shuffles, fragment and compute\n"
+            "  --packed-bench <iterations>  fragment shuffles of packed, half and 8-bit colors vs the vec4 shuffles\n"
+            "  --queue-bench <iterations>  persistent workgroups on an atomic tile queue vs the plain grid\n"
+            "  --pattern-sweep <iterations>  every specialization-constant shuffle pattern from one .spv\n"
+            "  --indirect-bench <iterations>  classify tiles and vkCmdDispatchIndirect over the active ones vs the whole image\n"
+            "  --async-bench <iterations>  fragment renders and compute kernels on separate queues, concurrent vs back-to-back\n"
+            "  --stats <iterations>  pipeline statistics and performance counters per dispatch of the kernel\n"
+            "  --stream <path|->      stream frames to a file, FIFO or stdout instead of --output\n"
+            "  --stream-format <fmt>  y4m (I420) or rgba (default y4m)\n"
+            "  --frames <N>           number of frames to stream (default 1)\n"
+            "  --fps <N>              frame rate written to the Y4M header (default 60)\n"
+            "  --stream-queue <N>     frames buffered ahead of the writer (default 4)\n"
+            "  --stream-drop          drop frames instead of blocking when the queue is full\n",
+            program, DEVICE_SELECT_ENV, WORKGROUP_DIM, IMAGE_WIDTH, IMAGE_HEIGHT);
+}
+
+// Parses "<a>x<b>" into two non-zero integers.
+int parseDimensions(const char* text, uint32_t* a, uint32_t* b) {
+    return sscanf(text, "%ux%u", a, b) == 2 && *a > 0 && *b > 0;
+}
+
+// Fills `options` from argv. Returns 0 on invalid input.
+int parseOptions(int argc, char** argv, ComputeOptions* options) {
+    *options = (ComputeOptions){
+        .shaderPath = "spv/shaderComputeSubgroupShuffle.comp.spv",
+        .outputPath = "output.ppm",
+        .width = IMAGE_WIDTH,
+        .height = IMAGE_HEIGHT,
+        .mapping = { MAPPING_LINEAR, 8, 4 },
+        .streamFormat = FRAME_STREAM_Y4M,
+        .frames = 1,
+        .fps = 60,
+        .streamQueue = 4,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            return 0;
+        }
+        if (strcmp(arg, "--stream-drop") == 0) {
+            options->streamDrop = 1;
+            continue;
+        }
+        if (strcmp(arg, "--hash") == 0) {
+            options->hashOutput = 1;
+            continue;
+        }
+        if (strcmp(arg, "--cpu-check") == 0) {
+            options->cpuCheck = 1;
+            continue;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 0;
+        }
+        i++;
+
+        if (strcmp(arg, "--device") == 0) {
+            options->deviceSelector = value;
+        } else if (strcmp(arg, "--report") == 0) {
+            options->reportPath = value;
+        } else if (strcmp(arg, "--shader") == 0) {
+            options->shaderPath = value;
+        } else if (strcmp(arg, "--bundle") == 0) {
+            options->bundlePath = value;
+        } else if (strcmp(arg, "--output") == 0) {
+            options->outputPath = value;
+        } else if (strcmp(arg, "--size") == 0) {
+            if (!parseDimensions(value, &options->width, &options->height) ||
+                options->width % WORKGROUP_DIM != 0 || options->height % WORKGROUP_DIM != 0) {
+                fprintf(stderr, "Invalid --size %s (must be multiples of %d)\n", value, WORKGROUP_DIM);
+                return 0;
+            }
+        } else if (strcmp(arg, "--mapping") == 0) {
+            uint32_t m = 0;
+            while (m < MAPPING_COUNT && strcmp(value, mappingNames[m]) != 0) m++;
+            if (m == MAPPING_COUNT) {
+                fprintf(stderr, "Unknown mapping: %s\n", value);
+                return 0;
+            }
+            options->mapping.mapping = m;
+        } else if (strcmp(arg, "--tile") == 0) {
+            uint32_t tw, th;
+            if (!parseDimensions(value, &tw, &th) || WORKGROUP_DIM % tw != 0 || WORKGROUP_DIM % th != 0) {
+                fprintf(stderr, "Invalid --tile %s (both sides must divide %d)\n", value, WORKGROUP_DIM);
+                return 0;
+            }
+            options->mapping.tileWidth = tw;
+            options->mapping.tileHeight = th;
+        } else if (strcmp(arg, "--dispatch") == 0) {
+            if (strcmp(value, "1d") != 0 && strcmp(value, "2d") != 0) {
+                fprintf(stderr, "Invalid --dispatch %s\n", value);
+                return 0;
+            }
+            options->dispatch1D = strcmp(value, "1d") == 0;
+        } else if (strcmp(arg, "--bench") == 0) {
+            options->benchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--shuffle-bench") == 0) {
+            options->shuffleBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--precision-bench") == 0) {
+            options->precisionBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--pattern") == 0) {
+            options->shufflePattern = parseShufflePattern(value);
+            if (options->shufflePattern == SHUFFLE_PATTERN_COUNT) {
+                fprintf(stderr, "Unknown pattern: %s\n", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--push-bench") == 0) {
+            options->pushBenchFrames = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--batch") == 0) {
+            options->batchLayers = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--graph") == 0) {
+            options->graphJobs = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--record-bench") == 0) {
+            options->recordRounds = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--host-alloc") == 0) {
+            options->hostAlloc = parseHostAllocMode(value);
+            if (options->hostAlloc == HOST_ALLOC_MODE_COUNT) {
+                fprintf(stderr, "Unknown host allocator: %s\n", value);
+                return 0;
+            }
+            options->hostAllocReport = 1;
+        } else if (strcmp(arg, "--alloc-bench") == 0) {
+            options->allocBenchFrames = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--memory-log") == 0) {
+            options->memoryLogPath = value;
+        } else if (strcmp(arg, "--versus") == 0) {
+            options->versusIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--layout-bench") == 0) {
+            options->layoutBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--quad-bench") == 0) {
+            options->quadBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--packed-bench") == 0) {
+            options->packedBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--queue-bench") == 0) {
+            options->queueBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--pattern-sweep") == 0) {
+            options->patternSweepIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--indirect-bench") == 0) {
+            options->indirectBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--async-bench") == 0) {
+            options->asyncBenchIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--stats") == 0) {
+            options->statsIterations = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--verify") == 0) {
+            uint32_t words[IMAGE_HASH_WORDS];
+            if (!imageHashFromHex(value, words)) {
+                fprintf(stderr, "Invalid --verify %s (expected %d hex digits)\n", value, IMAGE_HASH_HEX_LENGTH);
+                return 0;
+            }
+            options->expectedHash = value;
+        } else if (strcmp(arg, "--stream") == 0) {
+            options->streamPath = value;
+        } else if (strcmp(arg, "--stream-format") == 0) {
+            if (strcmp(value, "y4m") != 0 && strcmp(value, "rgba") != 0) {
+                fprintf(stderr, "Invalid --stream-format %s\n", value);
+                return 0;
+            }
+            options->streamFormat = strcmp(value, "y4m") == 0 ? FRAME_STREAM_Y4M : FRAME_STREAM_RGBA;
+        } else if (strcmp(arg, "--frames") == 0) {
+            options->frames = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--fps") == 0) {
+            options->fps = (uint32_t)strtoul(value, NULL, 10);
+            if (options->fps == 0) {
+                fprintf(stderr, "Invalid --fps %s\n", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--stream-queue") == 0) {
+            options->streamQueue = (uint32_t)strtoul(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Function to find a suitable memory type index.
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+
+    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+            return i;
+        }
+    }
+    fprintf(stderr, "Failed to find suitable memory type!\n");
+    exit(EXIT_FAILURE);
+}
+
+// Function to read a binary file (like our SPIR-V shader).
+char* readFile(const char* filename, size_t* pSize) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file: %s\n", filename);
+        exit(EXIT_FAILURE);
+    }
+
+    fseek(file, 0, SEEK_END);
+    *pSize = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    char* buffer = (char*)malloc(*pSize);
+    if (!buffer) {
+        fprintf(stderr, "Failed to allocate memory for file content.\n");
+        fclose(file);
+        exit(EXIT_FAILURE);
+    }
+
+    fread(buffer, 1, *pSize, file);
+    fclose(file);
+    return buffer;
+}
+
+// Function to save the image buffer to a .ppm file.
+void saveImage(const char* filename, const void* buffer, uint32_t width, uint32_t height) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", filename);
+        return;
+    }
+
+    // Write PPM header (P6 format for binary color).
+    fprintf(file, "P6\n%d %d\n255\n", width, height);
+
+    // The shader outputs RGBA, but PPM P6 is RGB. We need to convert.
+    const uint8_t* pixelData = (const uint8_t*)buffer;
+    for (uint32_t i = 0; i < width * height; ++i) {
+        fwrite(pixelData, 3, 1, file); // Write R, G, B
+        pixelData += 4;                 // Skip Alpha
+    }
+
+    fclose(file);
+    printf("Image saved to %s\n", filename);
+}
+
+// With --bundle, shader modules come from this mapping, looked up by file
+// name, and pipelines go through a cache named after the bundle's hash.
+SpirvBundle shaderBundle;
+VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+
+// Creates a VkShaderModule from the bundle, or from a SPIR-V file on disk
+// when there is no bundle or it lacks `path`.
+VkShaderModule loadShaderModule(VkDevice device, const char* path) {
+    if (shaderBundle.data != NULL) {
+        VkShaderModule bundledModule = spirvBundleCreateModule(device, &shaderBundle, path);
+        if (bundledModule != VK_NULL_HANDLE) {
+            return bundledModule;
+        }
+    }
+    size_t shaderCodeSize;
+    char* shaderCode = readFile(path, &shaderCodeSize);
+    VkShaderModuleCreateInfo shaderModuleCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
+        .codeSize = shaderCodeSize,
+        .pCode = (const uint32_t*)shaderCode,
+    };
+    VkShaderModule shaderModule;
+    VK_CHECK(vkCreateShaderModule(device, &shaderModuleCreateInfo, hostCallbacks, &shaderModule));
+    free(shaderCode);
+    return shaderModule;
+}
+
+// Creates a compute pipeline from `shaderModule` with optional specialization
+// constants. A nonzero `requiredSubgroupSize` pins the subgroup size and
+// requires full subgroups (subgroupSizeControl and computeFullSubgroups).
+VkPipeline createComputePipelineWithSubgroupSize(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                                                 const VkSpecializationInfo* specializationInfo, VkPipelineCreateFlags flags,
+                                                 uint32_t requiredSubgroupSize) {
+    VkPipelineShaderStageRequiredSubgroupSizeCreateInfo requiredSize = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_REQUIRED_SUBGROUP_SIZE_CREATE_INFO,
+        .requiredSubgroupSize = requiredSubgroupSize,
+    };
+    VkComputePipelineCreateInfo pipelineCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+        .flags = flags,
+        .stage = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
+            .pNext = requiredSubgroupSize != 0 ? &requiredSize : NULL,
+            .flags = requiredSubgroupSize != 0 ? VK_PIPELINE_SHADER_STAGE_CREATE_REQUIRE_FULL_SUBGROUPS_BIT : 0,
+            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
+            .module = shaderModule,
+            .pName = "main",
+            .pSpecializationInfo = specializationInfo,
+        },
+        .layout = pipelineLayout,
+    };
+    VkPipeline pipeline;
+    VK_CHECK(vkCreateComputePipelines(device, pipelineCache, 1, &pipelineCreateInfo, hostCallbacks, &pipeline));
+    return pipeline;
+}
+
+VkPipeline createComputePipelineWithFlags(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                                          const VkSpecializationInfo* specializationInfo, VkPipelineCreateFlags flags) {
+    return createComputePipelineWithSubgroupSize(device, pipelineLayout, shaderModule, specializationInfo, flags, 0);
+}
+
+VkPipeline createComputePipelineSpecialized(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                                            const VkSpecializationInfo* specializationInfo) {
+    return createComputePipelineWithFlags(device, pipelineLayout, shaderModule, specializationInfo, 0);
+}
+
+// Creates a compute pipeline with the invocation mapping baked in through
+// specialization constants. Shaders that don't declare the constants ignore them.
+// `requiredSubgroupSize` is passed on to createComputePipelineWithSubgroupSize().
+VkPipeline createMappedComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                                       const MappingSpecialization* mapping, VkPipelineCreateFlags flags,
+                                       uint32_t requiredSubgroupSize) {
+    VkSpecializationMapEntry mapEntries[] = {
+        { 0, offsetof(MappingSpecialization, mapping), sizeof(uint32_t) },
+        { 1, offsetof(MappingSpecialization, tileWidth), sizeof(uint32_t) },
+        { 2, offsetof(MappingSpecialization, tileHeight), sizeof(uint32_t) },
+    };
+    VkSpecializationInfo specializationInfo = {
+        .mapEntryCount = 3,
+        .pMapEntries = mapEntries,
+        .dataSize = sizeof(MappingSpecialization),
+        .pData = mapping,
+    };
+    return createComputePipelineWithSubgroupSize(device, pipelineLayout, shaderModule, &specializationInfo, flags,
+                                                 requiredSubgroupSize);
+}
+
+VkPipeline createComputePipeline(VkDevice device, VkPipelineLayout pipelineLayout, VkShaderModule shaderModule,
+                                 const MappingSpecialization* mapping) {
+    return createMappedComputePipeline(device, pipelineLayout, shaderModule, mapping, 0, 0);
+}
+
+// Dispatches one 16x16 workgroup per image tile, either as a 2D grid or as a
+// flat 1D row of workgroups (the shaders recover the tile from the flat index).
+void recordDispatch(VkCommandBuffer commandBuffer, uint32_t width, uint32_t height, uint32_t layers, int dispatch1D) {
+    uint32_t groupsX = width / WORKGROUP_DIM;
+    uint32_t groupsY = height / WORKGROUP_DIM;
+    if (dispatch1D) {
+        vkCmdDispatch(commandBuffer, groupsX * groupsY, 1, layers);
+    } else {
+        vkCmdDispatch(commandBuffer, groupsX, groupsY, layers);
+    }
+}
+
+// Records `iterations` dispatches of `pipeline` into the storage image followed
+// by a copy into the staging buffer. Dispatch i renders frame `firstFrame + i`,
+// selected only through push constants. When `queryPool` is given, timestamps
+// 0 and 1 bracket the dispatches.
+void recordComputeCommands(const ComputeContext* ctx, VkPipeline pipeline, uint32_t iterations, VkQueryPool queryPool, uint32_t firstFrame) {
+    VkCommandBuffer commandBuffer = ctx->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+    }
+    if (ctx->counters) {
+        gpuCountersReset(ctx->counters, commandBuffer);
+    }
+
+    // Transition image layout to general for shader writing.
+    VkImageMemoryBarrier barrier1 = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = ctx->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, ctx->layers},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier1);
+
+    // Bind pipeline and descriptor sets.
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ctx->pipelineLayout, 0, 1, &ctx->descriptorSet, 0, NULL);
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+
+    // Dispatch the compute shader. Repeated dispatches write the same image,
+    // so each one waits for the previous to finish (write-after-write).
+    VkMemoryBarrier writeBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (i > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &writeBarrier, 0, NULL, 0, NULL);
+        }
+        FrameParams params = frameParamsAt(firstFrame + i, ctx->shufflePattern, ctx->frameRate);
+        vkCmdPushConstants(commandBuffer, ctx->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        if (ctx->counters && i < ctx->counters->queryCount) {
+            gpuCountersBegin(ctx->counters, commandBuffer, i);
+            recordDispatch(commandBuffer, ctx->width, ctx->height, ctx->layers, ctx->dispatch1D);
+            gpuCountersEnd(ctx->counters, commandBuffer, i);
+        } else {
+            recordDispatch(commandBuffer, ctx->width, ctx->height, ctx->layers, ctx->dispatch1D);
+        }
+    }
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+    }
+
+    if (ctx->hasher) {
+        // Hash the image in place; only the hash words reach the host.
+        VkMemoryBarrier hashBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &hashBarrier, 0, NULL, 0, NULL);
+        imageHasherRecord(ctx->hasher, commandBuffer, ctx->width, ctx->height);
+        VK_CHECK(vkEndCommandBuffer(commandBuffer));
+        return;
+    }
+
+    // Transition image layout for transfer source.
+    VkImageMemoryBarrier barrier2 = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = ctx->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, ctx->layers},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier2);
+
+    // Copy image to staging buffer.
+    VkBufferImageCopy region = {
+        .bufferOffset = 0,
+        .bufferRowLength = 0,
+        .bufferImageHeight = 0,
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, ctx->layers},
+        .imageOffset = {0, 0, 0},
+        .imageExtent = {ctx->width, ctx->height, 1},
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, ctx->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ctx->stagingBuffer, 1, &region);
+
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+// Submits the recorded command buffer and blocks until it has finished.
+void submitAndWait(const ComputeContext* ctx, const void* pNext) {
+    VkSubmitInfo submitInfo = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .pNext = pNext,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &ctx->commandBuffer,
+    };
+    VK_CHECK(vkResetFences(ctx->device, 1, &ctx->fence));
+    VK_CHECK(vkQueueSubmit(ctx->queue, 1, &submitInfo, ctx->fence));
+    VK_CHECK(vkWaitForFences(ctx->device, 1, &ctx->fence, VK_TRUE, UINT64_MAX));
+}
+
+// Average of one colour channel of the staging buffer, in [0, 1].
+double averageChannel(const ComputeContext* ctx, uint32_t channel) {
+    void* mappedMemory = NULL;
+    VkDeviceSize size = (VkDeviceSize)ctx->width * ctx->height * 4;
+    VK_CHECK(vkMapMemory(ctx->device, ctx->stagingBufferMemory, 0, size, 0, &mappedMemory));
+    const uint8_t* pixels = (const uint8_t*)mappedMemory;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < (uint64_t)ctx->width * ctx->height; i++) {
+        sum += pixels[i * 4 + channel];
+    }
+    vkUnmapMemory(ctx->device, ctx->stagingBufferMemory);
+    return (double)sum / ((double)ctx->width * ctx->height * 255.0);
+}
+
+// What recordSentinelClear() fills the image with. The kernels it guards all
+// write alpha 1, so an average alpha below 1 means some pixels were never
+// written.
+const VkClearColorValue unwrittenSentinel = { .float32 = { 1.0f, 0.0f, 1.0f, 0.0f } };
+
+// Clears ctx->image to unwrittenSentinel and leaves it in GENERAL for the
+// compute writes that follow. Replaces the UNDEFINED -> GENERAL transition.
+void recordSentinelClear(const ComputeContext* ctx, VkCommandBuffer commandBuffer) {
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = ctx->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, ctx->layers},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+    vkCmdClearColorImage(commandBuffer, ctx->image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &unwrittenSentinel, 1,
+                         &toTransfer.subresourceRange);
+    VkImageMemoryBarrier toGeneral = toTransfer;
+    toGeneral.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    toGeneral.dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    toGeneral.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    toGeneral.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &toGeneral);
+}
+
+// Times `iterations` dispatches of `pipeline` after one warm-up run (so
+// pipeline compilation and first-touch costs aren't measured). Reports GPU
+// time per dispatch from timestamps (0 if unsupported) and host time per
+// dispatch around the submission.
+void measurePipeline(const ComputeContext* ctx, VkPipeline pipeline, uint32_t iterations, double* gpuMs, double* hostMs) {
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(ctx->device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(ctx, NULL);
+
+    recordComputeCommands(ctx, pipeline, iterations, queryPool, 0);
+    double start = getTimeSeconds();
+    submitAndWait(ctx, NULL);
+    *hostMs = (getTimeSeconds() - start) * 1000.0 / iterations;
+
+    *gpuMs = 0.0;
+    if (queryPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        *gpuMs = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6 / iterations;
+        vkDestroyQueryPool(ctx->device, queryPool, hostCallbacks);
+    }
+}
+
+// Renders `kernel` on the CPU emulator at the device's subgroup size into
+// `pixels` (width * height * 4 bytes). Returns 0 if the emulator can't run it.
+int runCpuKernel(const ComputeContext* ctx, CpuKernel kernel, const MappingSpecialization* mapping, uint8_t* pixels) {
+    CpuKernelArgs args = {
+        .width = ctx->width,
+        .height = ctx->height,
+        .subgroupSize = ctx->subgroupSize,
+        .mapping = mapping->mapping,
+        .tileWidth = mapping->tileWidth,
+        .tileHeight = mapping->tileHeight,
+        .params = frameParamsAt(0, ctx->shufflePattern, ctx->frameRate),
+        .rgba = pixels,
+    };
+    return cpuKernelRun(kernel, &args, hardwareThreadCount());
+}
+
+// CPU emulator time per image over `iterations` runs after a warm-up, in
+// milliseconds, on every hardware thread. 0 if the emulator can't run it.
+double measureCpuKernel(const ComputeContext* ctx, CpuKernel kernel, const MappingSpecialization* mapping, uint32_t iterations) {
+    uint8_t* pixels = (uint8_t*)malloc((size_t)ctx->width * ctx->height * 4);
+    double ms = 0.0;
+    if (runCpuKernel(ctx, kernel, mapping, pixels)) {
+        double start = getTimeSeconds();
+        for (uint32_t i = 0; i < iterations; i++) {
+            runCpuKernel(ctx, kernel, mapping, pixels);
+        }
+        ms = (getTimeSeconds() - start) * 1000.0 / iterations;
+    }
+    free(pixels);
+    return ms;
+}
+
+// Runs the stencil kernel under every invocation mapping and reports GPU time
+// per dispatch together with the fraction of stencil neighbours that were
+// fetched by subgroupShuffle instead of being recomputed.
+void benchmarkMappings(const ComputeContext* ctx, const ComputeOptions* options) {
+    if (ctx->timestampValidBits == 0) {
+        fprintf(stderr, "Queue does not support timestamps; reporting host time only.\n");
+    }
+    VkShaderModule stencilModule = loadShaderModule(ctx->device, "spv/shaderComputeStencilShuffle.comp.spv");
+
+    printf("Stencil benchmark: %ux%u, %u iterations, %s dispatch\n",
+           ctx->width, ctx->height, options->benchIterations, ctx->dispatch1D ? "1D" : "2D");
+    printf("%-8s %-6s %14s %14s %12s %14s\n", "mapping", "tile", "gpu ms/disp", "host ms/disp", "shuffle hit", "cpu ms/disp");
+
+    for (uint32_t m = 0; m < MAPPING_COUNT; m++) {
+        MappingSpecialization mapping = options->mapping;
+        mapping.mapping = m;
+        VkPipeline pipeline = createComputePipeline(ctx->device, ctx->pipelineLayout, stencilModule, &mapping);
+
+        double gpuMs, hostMs;
+        measurePipeline(ctx, pipeline, options->benchIterations, &gpuMs, &hostMs);
+
+        char tile[16] = "-";
+        if (m == MAPPING_TILED) {
+            snprintf(tile, sizeof(tile), "%ux%u", mapping.tileWidth, mapping.tileHeight);
+        }
+        printf("%-8s %-6s %14.4f %14.4f %11.1f%%", mappingNames[m], tile, gpuMs, hostMs, averageChannel(ctx, 1) * 100.0);
+
+        // The same kernel on the CPU emulator, as a baseline.
+        double cpuMs = measureCpuKernel(ctx, CPU_KERNEL_STENCIL, &mapping, 3);
+        if (cpuMs > 0.0) {
+            printf(" %14.4f\n", cpuMs);
+        } else {
+            printf(" %14s\n", "-");
+        }
+
+        vkDestroyPipeline(ctx->device, pipeline, hostCallbacks);
+    }
+    vkDestroyShaderModule(ctx->device, stencilModule, hostCallbacks);
+}
+
+// Specialization constants of shaderComputeShufflePayload.comp: the
+// invocation mapping (constant_id 0-2), then constant_id 3 and 4.
+typedef struct {
+    MappingSpecialization mapping;
+    uint32_t shufflesPerRound;
+    uint32_t rounds;
+} PayloadSpecialization;
+
+// Measures subgroupShuffle throughput for 8/16/32/64-bit payloads at 1, 2 and
+// 4 shuffles per round, to show whether packing data into fewer, wider
+// shuffles beats more, narrower ones. Widths the device can't shuffle are skipped.
+void benchmarkShufflePayloads(const ComputeContext* ctx, const ComputeOptions* options) {
+    const uint32_t payloadBits[] = { 8, 16, 32, 64 };
+    const uint32_t shuffleCounts[] = { 1, 2, 4 };
+    const uint32_t rounds = 64;
+    uint32_t iterations = options->shuffleBenchIterations;
+
+    printf("Shuffle payload benchmark: %ux%u, %u rounds, %u iterations, %s mapping, %s dispatch\n", ctx->width, ctx->height,
+           rounds, iterations, mappingNames[options->mapping.mapping], ctx->dispatch1D ? "1d" : "2d");
+    printf("%-5s %-9s %14s %16s %12s\n", "bits", "shuffles", "gpu ms/disp", "Gshuffles/s", "GB/s moved");
+
+    for (uint32_t b = 0; b < sizeof(payloadBits) / sizeof(payloadBits[0]); b++) {
+        uint32_t bits = payloadBits[b];
+        int supported = bits == 32 ||
+                        (ctx->subgroupExtendedTypes &&
+                         ((bits == 8 && ctx->shaderInt8) || (bits == 16 && ctx->shaderInt16) || (bits == 64 && ctx->shaderInt64)));
+        if (!supported) {
+            printf("%-5u skipped (shaderSubgroupExtendedTypes / %u-bit integers not supported)\n", bits, bits);
+            continue;
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), "spv/shaderComputeShufflePayload%u.comp.spv", bits);
+        VkShaderModule module = loadShaderModule(ctx->device, path);
+
+        for (uint32_t s = 0; s < sizeof(shuffleCounts) / sizeof(shuffleCounts[0]); s++) {
+            PayloadSpecialization spec = { options->mapping, shuffleCounts[s], rounds };
+            VkSpecializationMapEntry mapEntries[] = {
+                { 0, offsetof(PayloadSpecialization, mapping.mapping), sizeof(uint32_t) },
+                { 1, offsetof(PayloadSpecialization, mapping.tileWidth), sizeof(uint32_t) },
+                { 2, offsetof(PayloadSpecialization, mapping.tileHeight), sizeof(uint32_t) },
+                { 3, offsetof(PayloadSpecialization, shufflesPerRound), sizeof(uint32_t) },
+                { 4, offsetof(PayloadSpecialization, rounds), sizeof(uint32_t) },
+            };
+            VkSpecializationInfo specializationInfo = {
+                .mapEntryCount = 5,
+                .pMapEntries = mapEntries,
+                .dataSize = sizeof(spec),
+                .pData = &spec,
+            };
+            VkPipeline pipeline = createComputePipelineSpecialized(ctx->device, ctx->pipelineLayout, module, &specializationInfo);
+
+            double gpuMs, hostMs;
+            measurePipeline(ctx, pipeline, iterations, &gpuMs, &hostMs);
+            double seconds = (gpuMs > 0.0 ? gpuMs : hostMs) * 1e-3;
+            double shuffles = (double)ctx->width * ctx->height * rounds * spec.shufflesPerRound;
+            printf("%-5u %-9u %14.4f %16.3f %12.3f\n", bits, spec.shufflesPerRound, gpuMs,
+                   shuffles / seconds * 1e-9, shuffles * (bits / 8) / seconds * 1e-9);
+
+            vkDestroyPipeline(ctx->device, pipeline, hostCallbacks);
+        }
+        vkDestroyShaderModule(ctx->device, module, hostCallbacks);
+    }
+}
+
+// Reduced-precision stencil variants (shaderComputeStencilPrecision.comp).
+typedef struct {
+    uint32_t bits;
+    uint32_t bytesPerPixel;
+    const char* name;
+} PrecisionVariant;
+const PrecisionVariant precisionVariants[] = {
+    { 32, 16, "fp32" },
+    { 16, 8, "fp16" },
+    { 8, 4, "int8" },
+};
+
+// Whether every feature a precision variant needs was enabled on the device.
+int precisionSupported(const ComputeContext* ctx, uint32_t bits) {
+    if (bits == 16) {
+        return ctx->shaderFloat16 && ctx->storageBuffer16BitAccess && ctx->subgroupExtendedTypes;
+    }
+    if (bits == 8) {
+        return ctx->shaderInt8 && ctx->storageBuffer8BitAccess && ctx->subgroupExtendedTypes;
+    }
+    return 1;
+}
+
+// Returns the narrowest supported precision that is at least `requested` bits,
+// so a missing feature falls back to the next wider variant and finally fp32.
+uint32_t selectPrecision(const ComputeContext* ctx, uint32_t requested) {
+    if (requested <= 8 && precisionSupported(ctx, 8)) return 8;
+    if (requested <= 16 && precisionSupported(ctx, 16)) return 16;
+    return 32;
+}
+
+// Runs the stencil at 32, 16 and 8 bits, each writing its native texel type
+// to a storage buffer, and reports throughput and bytes written per second.
+void benchmarkPrecisions(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    VkDeviceSize bufferSize = (VkDeviceSize)ctx->width * ctx->height * 16; // Large enough for vec4 texels
+
+    // Output buffer the variants write to.
+    VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = bufferSize,
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer resultBuffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &resultBuffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, resultBuffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    VkDeviceMemory resultBufferMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &resultBufferMemory, "precision results"));
+    VK_CHECK(vkBindBufferMemory(device, resultBuffer, resultBufferMemory, 0));
+
+    // Binding 0 is the storage image (for its size), binding 1 the result buffer.
+    VkDescriptorSetLayoutBinding layoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = layoutBindings,
+    };
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes,
+        .maxSets = 1,
+    };
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkDescriptorSet descriptorSet;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+
+    VkDescriptorImageInfo imageInfo = { .imageView = ctx->imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { .buffer = resultBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &imageInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfo,
+        },
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VkPipelineLayout pipelineLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &pipelineLayout));
+
+    // Same recording helpers, different layout and descriptor set.
+    ComputeContext precisionCtx = *ctx;
+    precisionCtx.pipelineLayout = pipelineLayout;
+    precisionCtx.descriptorSet = descriptorSet;
+
+    printf("Precision benchmark: %ux%u, %u iterations, %s mapping\n",
+           ctx->width, ctx->height, options->precisionBenchIterations, mappingNames[options->mapping.mapping]);
+    printf("%-9s %-6s %14s %12s %10s %12s\n", "requested", "ran", "gpu ms/disp", "Mpixels/s", "bytes/px", "GB/s written");
+
+    for (uint32_t v = 0; v < sizeof(precisionVariants) / sizeof(precisionVariants[0]); v++) {
+        uint32_t bits = selectPrecision(ctx, precisionVariants[v].bits);
+        const PrecisionVariant* variant = &precisionVariants[0];
+        for (uint32_t i = 0; i < sizeof(precisionVariants) / sizeof(precisionVariants[0]); i++) {
+            if (precisionVariants[i].bits == bits) variant = &precisionVariants[i];
+        }
+        if (bits != precisionVariants[v].bits) {
+            printf("%s unsupported on this device, falling back to %s\n", precisionVariants[v].name, variant->name);
+        }
+
+        char path[64];
+        snprintf(path, sizeof(path), "spv/shaderComputeStencilPrecision%u.comp.spv", bits);
+        VkShaderModule module = loadShaderModule(device, path);
+        VkPipeline pipeline = createComputePipeline(device, pipelineLayout, module, &options->mapping);
+
+        double gpuMs, hostMs;
+        measurePipeline(&precisionCtx, pipeline, options->precisionBenchIterations, &gpuMs, &hostMs);
+        double seconds = (gpuMs > 0.0 ? gpuMs : hostMs) * 1e-3;
+        double pixels = (double)ctx->width * ctx->height;
+        printf("%-9s %-6s %14.4f %12.1f %10u %12.3f\n", precisionVariants[v].name, variant->name, gpuMs,
+               pixels / seconds * 1e-6, variant->bytesPerPixel, pixels * variant->bytesPerPixel / seconds * 1e-9);
+
+        vkDestroyPipeline(device, pipeline, hostCallbacks);
+        vkDestroyShaderModule(device, module, hostCallbacks);
+    }
+
+    vkDestroyPipelineLayout(device, pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkDestroyBuffer(device, resultBuffer, hostCallbacks);
+    memoryBudgetFree(device, resultBufferMemory);
+}
+
+// Measures the per-frame CPU cost of rendering distinct frames from a single
+// pipeline, where push constants are the only per-frame input:
+//   batched    all frames in one command buffer, a vkCmdPushConstants before
+//              each dispatch, one submission
+//   per-frame  each frame re-recorded and submitted on its own, as the
+//              streaming path does
+void benchmarkPushConstants(const ComputeContext* ctx, VkPipeline pipeline, uint32_t frames) {
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(ctx->device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    // Warm-up.
+    recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(ctx, NULL);
+
+    double start = getTimeSeconds();
+    recordComputeCommands(ctx, pipeline, frames, queryPool, 0);
+    double batchedRecord = getTimeSeconds() - start;
+    submitAndWait(ctx, NULL);
+    double batchedTotal = getTimeSeconds() - start;
+
+    double gpuMs = 0.0;
+    if (queryPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        gpuMs = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6 / frames;
+        vkDestroyQueryPool(ctx->device, queryPool, hostCallbacks);
+    }
+
+    double perFrameRecord = 0.0;
+    start = getTimeSeconds();
+    for (uint32_t frame = 0; frame < frames; frame++) {
+        double recordStart = getTimeSeconds();
+        recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, frame);
+        perFrameRecord += getTimeSeconds() - recordStart;
+        submitAndWait(ctx, NULL);
+    }
+    double perFrameTotal = getTimeSeconds() - start;
+
+    printf("Push constant benchmark: %ux%u, %u frames, %s pattern, %.4f ms GPU per frame\n",
+           ctx->width, ctx->height, frames, shufflePatternNames[ctx->shufflePattern], gpuMs);
+    printf("%-10s %16s %16s\n", "mode", "record us/frame", "total us/frame");
+    printf("%-10s %16.2f %16.2f\n", "batched", batchedRecord * 1e6 / frames, batchedTotal * 1e6 / frames);
+    printf("%-10s %16.2f %16.2f\n", "per-frame", perFrameRecord * 1e6 / frames, perFrameTotal * 1e6 / frames);
+}
+
+// Renders `options->batchLayers` distinct images two ways and reports images/s:
+//   batched     one arrayLayers = N storage image, one dispatch with z = N
+//               (shaderComputeBatch.comp reads each layer's FrameParams from a
+//               storage buffer), one copy of every layer, one submission
+//   per-submit  the regular pipeline, one image per record + submit + wait
+void benchmarkBatch(const ComputeContext* ctx, VkPipeline singlePipeline, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    uint32_t layers = options->batchLayers;
+
+    // Every layer costs an image layer and a staging slice. Halve the batch
+    // until both fit the memory budget rather than fail the allocation.
+    VkDeviceSize layerBytes = (VkDeviceSize)ctx->width * ctx->height * 4;
+    uint32_t batchTypes[2] = {
+        findMemoryType(ctx->physicalDevice, ~0u, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+        findMemoryType(ctx->physicalDevice, ~0u, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+    };
+    for (;;) {
+        VkDeviceSize batchSizes[2] = { layerBytes * layers, layerBytes * layers };
+        if (memoryBudgetFits(batchTypes, batchSizes, 2)) break;
+        if (layers == 1) {
+            fprintf(stderr, "Batch benchmark skipped: one %ux%u layer does not fit the memory budget.\n", ctx->width, ctx->height);
+            return;
+        }
+        layers /= 2;
+    }
+    if (layers != options->batchLayers) {
+        printf("Batch of %u layers exceeds the memory budget, using %u.\n", options->batchLayers, layers);
+    }
+
+    // Image array, one layer per output image.
+    VkImageCreateInfo imageCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = {ctx->width, ctx->height, 1},
+        .mipLevels = 1,
+        .arrayLayers = layers,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VkImage image;
+    VK_CHECK(vkCreateImage(device, &imageCreateInfo, hostCallbacks, &image));
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    VkDeviceMemory imageMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &imageMemory, "batch image"));
+    VK_CHECK(vkBindImageMemory(device, image, imageMemory, 0));
+
+    VkImageViewCreateInfo imageViewCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
+        .format = imageCreateInfo.format,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, layers},
+    };
+    VkImageView imageView;
+    VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, hostCallbacks, &imageView));
+
+    // Staging buffer for every layer, tightly packed one after another.
+    VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = (VkDeviceSize)ctx->width * ctx->height * 4 * layers,
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer stagingBuffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &stagingBuffer));
+    vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkDeviceMemory stagingBufferMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &stagingBufferMemory, "batch staging"));
+    VK_CHECK(vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0));
+
+    // Per-layer parameters, written once from the host.
+    bufferCreateInfo.size = sizeof(FrameParams) * layers;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+    VkBuffer paramsBuffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &paramsBuffer));
+    vkGetBufferMemoryRequirements(device, paramsBuffer, &memRequirements);
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkDeviceMemory paramsBufferMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &paramsBufferMemory, "batch params"));
+    VK_CHECK(vkBindBufferMemory(device, paramsBuffer, paramsBufferMemory, 0));
+
+    void* mappedParams = NULL;
+    VK_CHECK(vkMapMemory(device, paramsBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedParams));
+    for (uint32_t layer = 0; layer < layers; layer++) {
+        ((FrameParams*)mappedParams)[layer] = frameParamsAt(layer, ctx->shufflePattern, ctx->frameRate);
+    }
+    vkUnmapMemory(device, paramsBufferMemory);
+
+    // Binding 0 is the image array, binding 1 the per-layer parameters.
+    VkDescriptorSetLayoutBinding layoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = layoutBindings,
+    };
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes,
+        .maxSets = 1,
+    };
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkDescriptorSet descriptorSet;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+
+    VkDescriptorImageInfo imageInfo = { .imageView = imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { .buffer = paramsBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &imageInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfo,
+        },
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    // The recording helper always pushes FrameParams; the batch shader ignores them.
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VkPipelineLayout pipelineLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &pipelineLayout));
+
+    VkShaderModule module = loadShaderModule(device, "spv/shaderComputeBatch.comp.spv");
+    VkPipeline batchPipeline = createComputePipeline(device, pipelineLayout, module, &options->mapping);
+
+    // Same recording helpers, with every layer in one dispatch and one copy.
+    ComputeContext batchCtx = *ctx;
+    batchCtx.pipelineLayout = pipelineLayout;
+    batchCtx.descriptorSet = descriptorSet;
+    batchCtx.image = image;
+    batchCtx.imageView = imageView;
+    batchCtx.stagingBuffer = stagingBuffer;
+    batchCtx.stagingBufferMemory = stagingBufferMemory;
+    batchCtx.layers = layers;
+
+    // Warm-up, then time the whole batch including readback.
+    recordComputeCommands(&batchCtx, batchPipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(&batchCtx, NULL);
+    double start = getTimeSeconds();
+    recordComputeCommands(&batchCtx, batchPipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(&batchCtx, NULL);
+    double batchedSeconds = getTimeSeconds() - start;
+
+    recordComputeCommands(ctx, singlePipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(ctx, NULL);
+    start = getTimeSeconds();
+    for (uint32_t layer = 0; layer < layers; layer++) {
+        recordComputeCommands(ctx, singlePipeline, 1, VK_NULL_HANDLE, layer);
+        submitAndWait(ctx, NULL);
+    }
+    double perSubmitSeconds = getTimeSeconds() - start;
+
+    printf("Batch benchmark: %u images of %ux%u, %s pattern\n", layers, ctx->width, ctx->height,
+           shufflePatternNames[ctx->shufflePattern]);
+    printf("%-10s %10s %12s\n", "mode", "total ms", "images/s");
+    printf("%-10s %10.3f %12.1f\n", "batched", batchedSeconds * 1000.0, layers / batchedSeconds);
+    printf("%-10s %10.3f %12.1f\n", "per-submit", perSubmitSeconds * 1000.0, layers / perSubmitSeconds);
+
+    vkDestroyPipeline(device, batchPipeline, hostCallbacks);
+    vkDestroyShaderModule(device, module, hostCallbacks);
+    vkDestroyPipelineLayout(device, pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkDestroyBuffer(device, paramsBuffer, hostCallbacks);
+    memoryBudgetFree(device, paramsBufferMemory);
+    vkDestroyBuffer(device, stagingBuffer, hostCallbacks);
+    memoryBudgetFree(device, stagingBufferMemory);
+    vkDestroyImageView(device, imageView, hostCallbacks);
+    vkDestroyImage(device, image, hostCallbacks);
+    memoryBudgetFree(device, imageMemory);
+}
+
+// Stages of the submission graph benchmark, one command buffer each.
+enum {
+    GRAPH_RENDER,
+    GRAPH_POST,
+    GRAPH_HASH,
+    GRAPH_COPY,
+    GRAPH_STAGE_COUNT
+};
+const char* graphStageNames[GRAPH_STAGE_COUNT] = { "render", "post", "hash", "copy" };
+
+// Records the four stages. Each one brackets its work with timestamps 2i and
+// 2i+1 and carries its own barriers, so the same command buffers are valid
+// whether the stages are chained by semaphores or by host waits. Hash and
+// copy only read the image, which stays in GENERAL.
+void recordGraphStages(const ComputeContext* ctx, VkPipeline pipeline, VkPipeline postPipeline,
+                       const ImageHasher* hasher, VkQueryPool queryPool, VkCommandBuffer* commandBuffers) {
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+    };
+    VkMemoryBarrier readBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_READ_BIT,
+    };
+
+    for (uint32_t stage = 0; stage < GRAPH_STAGE_COUNT; stage++) {
+        VkCommandBuffer commandBuffer = commandBuffers[stage];
+        VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        vkCmdResetQueryPool(commandBuffer, queryPool, stage * 2, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, stage * 2);
+
+        if (stage == GRAPH_RENDER) {
+            VkImageMemoryBarrier toGeneral = {
+                .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+                .srcAccessMask = 0,
+                .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+                .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+                .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = ctx->image,
+                .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+            };
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &toGeneral);
+            FrameParams params = frameParamsAt(0, ctx->shufflePattern, ctx->frameRate);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ctx->pipelineLayout, 0, 1, &ctx->descriptorSet, 0, NULL);
+            vkCmdPushConstants(commandBuffer, ctx->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+            recordDispatch(commandBuffer, ctx->width, ctx->height, 1, ctx->dispatch1D);
+        } else if (stage == GRAPH_POST) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &readBarrier, 0, NULL, 0, NULL);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, postPipeline);
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ctx->pipelineLayout, 0, 1, &ctx->descriptorSet, 0, NULL);
+            vkCmdDispatch(commandBuffer, ctx->width / WORKGROUP_DIM, ctx->height / WORKGROUP_DIM, 1);
+        } else if (stage == GRAPH_HASH) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &readBarrier, 0, NULL, 0, NULL);
+            imageHasherRecord(hasher, commandBuffer, ctx->width, ctx->height);
+        } else {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &readBarrier, 0, NULL, 0, NULL);
+            VkBufferImageCopy region = {
+                .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+                .imageExtent = {ctx->width, ctx->height, 1},
+            };
+            vkCmdCopyImageToBuffer(commandBuffer, ctx->image, VK_IMAGE_LAYOUT_GENERAL, ctx->stagingBuffer, 1, &region);
+        }
+
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, stage * 2 + 1);
+        VK_CHECK(vkEndCommandBuffer(commandBuffer));
+    }
+}
+
+// Busy time and idle gaps of the GPU between the first stage starting and the
+// last one finishing, from the per-stage timestamps, in milliseconds.
+void graphGpuTimes(const ComputeContext* ctx, VkQueryPool queryPool, double* busyMs, double* gapMs) {
+    uint64_t timestamps[GRAPH_STAGE_COUNT * 2];
+    VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, GRAPH_STAGE_COUNT * 2, sizeof(timestamps), timestamps,
+                                   sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+    // Sort the [start, end] intervals by start, then merge overlaps.
+    uint32_t order[GRAPH_STAGE_COUNT];
+    for (uint32_t i = 0; i < GRAPH_STAGE_COUNT; i++) {
+        order[i] = i;
+        for (uint32_t j = i; j > 0 && timestamps[order[j] * 2] < timestamps[order[j - 1] * 2]; j--) {
+            uint32_t swap = order[j];
+            order[j] = order[j - 1];
+            order[j - 1] = swap;
+        }
+    }
+    uint64_t busy = 0, gaps = 0;
+    uint64_t start = timestamps[order[0] * 2], end = timestamps[order[0] * 2 + 1];
+    for (uint32_t i = 1; i < GRAPH_STAGE_COUNT; i++) {
+        uint64_t nextStart = timestamps[order[i] * 2], nextEnd = timestamps[order[i] * 2 + 1];
+        if (nextStart > end) {
+            busy += end - start;
+            gaps += nextStart - end;
+            start = nextStart;
+        }
+        if (nextEnd > end) end = nextEnd;
+    }
+    busy += end - start;
+    *busyMs = (double)busy * ctx->timestampPeriod * 1e-6;
+    *gapMs = (double)gaps * ctx->timestampPeriod * 1e-6;
+}
+
+// Runs `options->graphJobs` render -> post -> {hash, copy} jobs two ways:
+//   waits     one submission per stage, host waits on a fence after each
+//   graph     all stages in one vkQueueSubmit chained by a timeline semaphore,
+//             host waits once on the final value (see submit_graph.h)
+// and reports per-job wall time, host time blocked in waits and GPU busy time
+// and idle gaps between the stages.
+void benchmarkSubmitGraph(const ComputeContext* ctx, VkPipeline pipeline, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    if (!ctx->timelineSemaphore || vkWaitSemaphores == NULL || ctx->timestampValidBits == 0) {
+        printf("Submission graph benchmark skipped: needs timeline semaphores and timestamps.\n");
+        return;
+    }
+    if (!imageHashSupported(ctx->physicalDevice)) {
+        printf("Submission graph benchmark skipped: the hash stage needs subgroup arithmetic.\n");
+        return;
+    }
+
+    VkShaderModule postModule = loadShaderModule(device, "spv/shaderComputePost.comp.spv");
+    VkPipeline postPipeline = createComputePipelineSpecialized(device, ctx->pipelineLayout, postModule, NULL);
+    VkShaderModule hashModule = loadShaderModule(device, "spv/shaderImageHash.comp.spv");
+    ImageHasher hasher;
+    if (!imageHasherCreate(&hasher, device, ctx->physicalDevice, hashModule, ctx->imageView)) {
+        fprintf(stderr, "Failed to create the image hash pipeline!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = GRAPH_STAGE_COUNT * 2,
+    };
+    VkQueryPool queryPool;
+    VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+
+    VkCommandBufferAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+        .commandPool = ctx->commandPool,
+        .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+        .commandBufferCount = GRAPH_STAGE_COUNT,
+    };
+    VkCommandBuffer commandBuffers[GRAPH_STAGE_COUNT];
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocInfo, commandBuffers));
+    recordGraphStages(ctx, pipeline, postPipeline, &hasher, queryPool, commandBuffers);
+
+    SubmitGraph graph;
+    if (!submitGraphInit(&graph, device, ctx->queue)) {
+        fprintf(stderr, "Failed to create the timeline semaphore!\n");
+        exit(EXIT_FAILURE);
+    }
+    // The hash node is a compute dispatch, so its wait has to cover the compute
+    // stage; the copy node only needs the transfer stage. Once the graph is
+    // full every later add fails too, so checking the last add covers them all.
+    uint32_t render = submitGraphAddNode(&graph, graphStageNames[GRAPH_RENDER], commandBuffers[GRAPH_RENDER], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, 0);
+    uint32_t post = submitGraphAddNode(&graph, graphStageNames[GRAPH_POST], commandBuffers[GRAPH_POST], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1u << render);
+    submitGraphAddNode(&graph, graphStageNames[GRAPH_HASH], commandBuffers[GRAPH_HASH], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 1u << post);
+    if (submitGraphAddNode(&graph, graphStageNames[GRAPH_COPY], commandBuffers[GRAPH_COPY], VK_PIPELINE_STAGE_TRANSFER_BIT, 1u << post) == UINT32_MAX) {
+        fprintf(stderr, "Submission graph is full!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    printf("Submission graph benchmark: %ux%u, %u jobs of render -> post -> {hash, copy}\n",
+           ctx->width, ctx->height, options->graphJobs);
+    printf("%-6s %14s %16s %14s %14s\n", "mode", "wall ms/job", "host wait ms/job", "gpu busy ms", "gpu gaps ms");
+
+    for (int useGraph = 0; useGraph <= 1; useGraph++) {
+        double hostWait = 0.0, busyTotal = 0.0, gapTotal = 0.0;
+        graph.hostWaitSeconds = 0.0;
+        double start = getTimeSeconds();
+        for (uint32_t job = 0; job < options->graphJobs; job++) {
+            if (useGraph) {
+                VK_CHECK(submitGraphSubmit(&graph));
+                VK_CHECK(submitGraphWait(&graph));
+            } else {
+                for (uint32_t stage = 0; stage < GRAPH_STAGE_COUNT; stage++) {
+                    VkSubmitInfo submitInfo = {
+                        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+                        .commandBufferCount = 1,
+                        .pCommandBuffers = &commandBuffers[stage],
+                    };
+                    VK_CHECK(vkResetFences(device, 1, &ctx->fence));
+                    VK_CHECK(vkQueueSubmit(ctx->queue, 1, &submitInfo, ctx->fence));
+                    double waitStart = getTimeSeconds();
+                    VK_CHECK(vkWaitForFences(device, 1, &ctx->fence, VK_TRUE, UINT64_MAX));
+                    hostWait += getTimeSeconds() - waitStart;
+                }
+            }
+            double busyMs, gapMs;
+            graphGpuTimes(ctx, queryPool, &busyMs, &gapMs);
+            busyTotal += busyMs;
+            gapTotal += gapMs;
+        }
+        double wall = getTimeSeconds() - start;
+        if (useGraph) hostWait = graph.hostWaitSeconds;
+        uint32_t jobs = options->graphJobs;
+        printf("%-6s %14.3f %16.3f %14.3f %14.3f\n", useGraph ? "graph" : "waits", wall * 1000.0 / jobs,
+               hostWait * 1000.0 / jobs, busyTotal / jobs, gapTotal / jobs);
+    }
+
+    submitGraphDestroy(&graph);
+    vkFreeCommandBuffers(device, ctx->commandPool, GRAPH_STAGE_COUNT, commandBuffers);
+    vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    imageHasherDestroy(&hasher);
+    vkDestroyShaderModule(device, hashModule, hostCallbacks);
+    vkDestroyPipeline(device, postPipeline, hostCallbacks);
+    vkDestroyShaderModule(device, postModule, hostCallbacks);
+}
+
+// Renders frame 0 of the --shader kernel and compares the readback with the
+// CPU reference of the same shader (cpu_kernels.h) at the device's subgroup
+// size, then times both. The emulator assumes full subgroups of exactly that
+// size, so the checked pipeline pins it with subgroup size control; without
+// that the driver may pick another size and the check is skipped. Returns 1
+// if every channel is within CPU_KERNEL_TOLERANCE or the check was skipped.
+int checkAgainstCpu(const ComputeContext* ctx, const ComputeOptions* options) {
+    CpuKernel kernel = cpuKernelForShader(options->shaderPath);
+    if (kernel == CPU_KERNEL_COUNT) {
+        fprintf(stderr, "No CPU reference for %s\n", options->shaderPath);
+        return 0;
+    }
+    if (!subgroupEmuSizeSupported(ctx->subgroupSize)) {
+        fprintf(stderr, "The CPU emulator does not support subgroup size %u\n", ctx->subgroupSize);
+        return 0;
+    }
+    if (kernel == CPU_KERNEL_GRADIENT && ctx->dispatch1D) {
+        fprintf(stderr, "shaderCompute.comp does not use the invocation mapping; check it with a 2D dispatch\n");
+        return 0;
+    }
+    const VkPhysicalDeviceSubgroupSizeControlProperties* sizeControl = &ctx->sizeControl;
+    if (!ctx->subgroupSizeControl || !ctx->computeFullSubgroups ||
+        !(sizeControl->requiredSubgroupSizeStages & VK_SHADER_STAGE_COMPUTE_BIT) ||
+        ctx->subgroupSize < sizeControl->minSubgroupSize || ctx->subgroupSize > sizeControl->maxSubgroupSize) {
+        printf("CPU reference skipped: the device can't pin compute subgroups to size %u, so the comparison is unreliable\n",
+               ctx->subgroupSize);
+        return 1;
+    }
+    VkShaderModule module = loadShaderModule(ctx->device, options->shaderPath);
+    VkPipeline pipeline = createMappedComputePipeline(ctx->device, ctx->pipelineLayout, module, &options->mapping, 0,
+                                                      ctx->subgroupSize);
+
+    recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(ctx, NULL);
+
+    size_t size = (size_t)ctx->width * ctx->height * 4;
+    uint8_t* expected = (uint8_t*)malloc(size);
+    runCpuKernel(ctx, kernel, &options->mapping, expected);
+
+    void* mappedMemory = NULL;
+    VK_CHECK(vkMapMemory(ctx->device, ctx->stagingBufferMemory, 0, size, 0, &mappedMemory));
+    int maxDifference;
+    uint64_t mismatches = cpuCompareImages(expected, (const uint8_t*)mappedMemory, ctx->width, ctx->height, &maxDifference);
+    vkUnmapMemory(ctx->device, ctx->stagingBufferMemory);
+    free(expected);
+
+    uint64_t pixels = (uint64_t)ctx->width * ctx->height;
+    printf("CPU reference (%s, subgroup size %u, %s lanes): %llu/%llu pixels bit-exact, max channel difference %d\n",
+           cpuKernelNames[kernel], ctx->subgroupSize, SUBGROUP_EMU_ISA, (unsigned long long)(pixels - mismatches),
+           (unsigned long long)pixels, maxDifference);
+
+    double gpuMs, hostMs;
+    measurePipeline(ctx, pipeline, 10, &gpuMs, &hostMs);
+    double cpuMs = measureCpuKernel(ctx, kernel, &options->mapping, 3);
+    printf("Throughput: CPU %.3f ms (%.1f Mpix/s, %u threads), GPU %.3f ms (%.1f Mpix/s)\n", cpuMs,
+           pixels / (cpuMs * 1000.0), hardwareThreadCount(), gpuMs > 0.0 ? gpuMs : hostMs,
+           pixels / ((gpuMs > 0.0 ? gpuMs : hostMs) * 1000.0));
+    vkDestroyPipeline(ctx->device, pipeline, hostCallbacks);
+    vkDestroyShaderModule(ctx->device, module, hostCallbacks);
+
+    if (maxDifference > CPU_KERNEL_TOLERANCE) {
+        fprintf(stderr, "GPU output does not match the CPU reference.\n");
+        return 0;
+    }
+    return 1;
+}
+
+// What a recording thread needs to record its share of the row dispatches.
+typedef struct {
+    const ComputeContext* ctx;
+    VkPipeline pipeline;
+    uint32_t rows;    // Workgroup rows in the image, one dispatch each.
+    uint32_t workers; // Worker w records rows [rows * w / workers, rows * (w + 1) / workers).
+} RowDispatchJob;
+
+// Binds the state (secondaries inherit none) and records one vkCmdDispatchBase
+// per workgroup row in the worker's share, for frame `round`. The shaders
+// derive the tile from gl_WorkGroupID, which includes the base, so a band of
+// full-width rows lands where the single 2D dispatch would put it.
+void recordRowDispatches(VkCommandBuffer commandBuffer, uint32_t worker, uint32_t round, void* user) {
+    const RowDispatchJob* job = (const RowDispatchJob*)user;
+    const ComputeContext* ctx = job->ctx;
+    FrameParams params = frameParamsAt(round, ctx->shufflePattern, ctx->frameRate);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, job->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, ctx->pipelineLayout, 0, 1, &ctx->descriptorSet, 0, NULL);
+    vkCmdPushConstants(commandBuffer, ctx->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+    uint32_t first = job->rows * worker / job->workers;
+    uint32_t end = job->rows * (worker + 1) / job->workers;
+    for (uint32_t row = first; row < end; row++) {
+        vkCmdDispatchBase(commandBuffer, 0, row, 0, ctx->width / WORKGROUP_DIM, 1, 1);
+    }
+}
+
+// Records the frame around the per-round work: layout transition, timestamps
+// and a compute barrier between rounds (rounds rewrite the same pixels). With
+// a recorder each round executes its secondaries; without one the rows are
+// recorded straight into the primary.
+void recordRowFrame(const ComputeContext* ctx, RowDispatchJob* job, const ParallelRecorder* recorder,
+                    uint32_t rounds, VkQueryPool queryPool) {
+    VkCommandBuffer commandBuffer = ctx->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+
+    VkImageMemoryBarrier toGeneral = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = ctx->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &toGeneral);
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+
+    VkMemoryBarrier roundBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    for (uint32_t round = 0; round < rounds; round++) {
+        if (round > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &roundBarrier, 0, NULL, 0, NULL);
+        }
+        if (recorder) {
+            parallelRecorderExecute(recorder, commandBuffer, round);
+        } else {
+            recordRowDispatches(commandBuffer, 0, round, job);
+        }
+    }
+
+    vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+// Next thread count of the recording sweep after `workers`: 1, 2, 4, ...,
+// with the last step clamped to `maxWorkers` so the full count is measured
+// even when it isn't a power of two. Past maxWorkers the sweep ends.
+uint32_t nextWorkerCount(uint32_t workers, uint32_t maxWorkers) {
+    if (workers == 0) return 1;
+    if (workers >= maxWorkers) return maxWorkers + 1;
+    return workers * 2 < maxWorkers ? workers * 2 : maxWorkers;
+}
+
+// Records `options->recordRounds` rounds of one dispatch per workgroup row
+// (rounds * height / 16 dispatches, each with its own bind and push) and
+// compares recording them on one thread straight into the primary with
+// 1, 2, 4, ... threads recording secondaries from their own command pools.
+// Reports the best of several recordings (secondaries plus the primary that
+// executes them), the primary's share of that and the GPU time of the result.
+void benchmarkParallelRecording(const ComputeContext* ctx, const ComputeOptions* options) {
+    if (vkCmdDispatchBase == NULL || ctx->timestampValidBits == 0) {
+        printf("Parallel recording benchmark skipped: needs vkCmdDispatchBase (Vulkan 1.1) and timestamps.\n");
+        return;
+    }
+    const uint32_t repeats = 5;
+    VkDevice device = ctx->device;
+    VkShaderModule module = loadShaderModule(device, options->shaderPath);
+    VkPipeline pipeline = createMappedComputePipeline(device, ctx->pipelineLayout, module, &options->mapping,
+                                                      VK_PIPELINE_CREATE_DISPATCH_BASE_BIT, 0);
+    VkQueryPoolCreateInfo queryPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .queryType = VK_QUERY_TYPE_TIMESTAMP,
+        .queryCount = 2,
+    };
+    VkQueryPool queryPool;
+    VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+
+    uint32_t rows = ctx->height / WORKGROUP_DIM;
+    uint32_t rounds = options->recordRounds;
+    uint32_t maxWorkers = hardwareThreadCount();
+    if (maxWorkers > rows) maxWorkers = rows;
+    if (maxWorkers > PARALLEL_RECORD_MAX_WORKERS) maxWorkers = PARALLEL_RECORD_MAX_WORKERS;
+
+    printf("Parallel recording benchmark: %ux%u, %u rounds x %u row dispatches, up to %u threads\n",
+           ctx->width, ctx->height, rounds, rows, maxWorkers);
+    printf("%-10s %8s %12s %9s %12s %12s\n", "mode", "threads", "record ms", "speedup", "primary ms", "gpu ms");
+
+    // workers == 0 is the single-threaded baseline recording into the primary.
+    double baselineMs = 0.0;
+    for (uint32_t workers = 0; workers <= maxWorkers; workers = nextWorkerCount(workers, maxWorkers)) {
+        RowDispatchJob job = { ctx, pipeline, rows, workers ? workers : 1 };
+        ParallelRecorder recorder;
+        if (workers > 0 && !parallelRecorderInit(&recorder, device, ctx->queueFamilyIndex, workers, rounds)) {
+            fprintf(stderr, "Failed to create the recording threads!\n");
+            exit(EXIT_FAILURE);
+        }
+
+        double recordMs = 0.0, primaryMs = 0.0;
+        for (uint32_t repeat = 0; repeat < repeats; repeat++) {
+            double secondaryMs = 0.0;
+            if (workers > 0) {
+                secondaryMs = parallelRecorderRecord(&recorder, recordRowDispatches, &job) * 1000.0;
+                VK_CHECK(recorder.result);
+            }
+            double start = getTimeSeconds();
+            recordRowFrame(ctx, &job, workers > 0 ? &recorder : NULL, rounds, queryPool);
+            double frameMs = (getTimeSeconds() - start) * 1000.0;
+            // The secondaries only pay off if recording them plus the primary that
+            // executes them beats recording everything into the primary.
+            double totalMs = secondaryMs + frameMs;
+            if (repeat == 0 || totalMs < recordMs) {
+                recordMs = totalMs;
+                primaryMs = workers > 0 ? frameMs : 0.0;
+            }
+        }
+        submitAndWait(ctx, NULL);
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        double gpuMs = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6;
+
+        if (workers == 0) baselineMs = recordMs;
+        printf("%-10s %8u %12.3f %8.2fx %12.3f %12.3f\n", workers ? "secondary" : "primary", job.workers, recordMs,
+               recordMs > 0.0 ? baselineMs / recordMs : 0.0, primaryMs, gpuMs);
+
+        if (workers > 0) parallelRecorderDestroy(&recorder);
+    }
+
+    vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    vkDestroyPipeline(device, pipeline, hostCallbacks);
+    vkDestroyShaderModule(device, module, hostCallbacks);
+}
+
+// Compares the host allocator modes on the two places the driver allocates
+// host memory: pipeline creation (startup) and command recording (every
+// frame). Each mode creates its own pipelines and command pool with its
+// callbacks, by swapping hostCallbacks for the duration; the device and the
+// rest of `ctx` keep the allocator they were created with. The first pipeline
+// of each mode is not timed, so the driver's shader cache is warm for all.
+void benchmarkHostAllocators(const ComputeContext* ctx, VkShaderModule shaderModule, const ComputeOptions* options) {
+    const uint32_t pipelines = 8;
+    uint32_t frames = options->allocBenchFrames;
+    const VkAllocationCallbacks* startupCallbacks = hostCallbacks;
+
+    printf("Host allocator benchmark: %u pipelines, %u frames per mode\n", pipelines, frames);
+    printf("%-9s %12s %16s %16s %13s %10s\n", "mode", "pipeline ms", "record us/frame", "total us/frame",
+           "allocs/frame", "peak KiB");
+    for (uint32_t mode = 0; mode < HOST_ALLOC_MODE_COUNT; mode++) {
+        HostAllocator allocator;
+        hostCallbacks = hostAllocatorInit(&allocator, (HostAllocMode)mode);
+
+        vkDestroyPipeline(ctx->device, createComputePipeline(ctx->device, ctx->pipelineLayout, shaderModule, &options->mapping), hostCallbacks);
+        double start = getTimeSeconds();
+        for (uint32_t i = 0; i < pipelines; i++) {
+            VkPipeline pipeline = createComputePipeline(ctx->device, ctx->pipelineLayout, shaderModule, &options->mapping);
+            vkDestroyPipeline(ctx->device, pipeline, hostCallbacks);
+        }
+        double pipelineMs = (getTimeSeconds() - start) * 1000.0 / pipelines;
+
+        // Per-frame: re-record and submit from a pool owned by this mode.
+        VkPipeline pipeline = createComputePipeline(ctx->device, ctx->pipelineLayout, shaderModule, &options->mapping);
+        VkCommandPoolCreateInfo poolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+            .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
+            .queueFamilyIndex = ctx->queueFamilyIndex,
+        };
+        ComputeContext frameCtx = *ctx;
+        VK_CHECK(vkCreateCommandPool(ctx->device, &poolCreateInfo, hostCallbacks, &frameCtx.commandPool));
+        VkCommandBufferAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = frameCtx.commandPool,
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        VK_CHECK(vkAllocateCommandBuffers(ctx->device, &allocInfo, &frameCtx.commandBuffer));
+        recordComputeCommands(&frameCtx, pipeline, 1, VK_NULL_HANDLE, 0);
+        submitAndWait(&frameCtx, NULL);
+
+        uint64_t callsBefore = hostAllocatorCalls(&allocator);
+        double recordSeconds = 0.0;
+        start = getTimeSeconds();
+        for (uint32_t frame = 0; frame < frames; frame++) {
+            double recordStart = getTimeSeconds();
+            recordComputeCommands(&frameCtx, pipeline, 1, VK_NULL_HANDLE, frame);
+            recordSeconds += getTimeSeconds() - recordStart;
+            submitAndWait(&frameCtx, NULL);
+        }
+        double totalSeconds = getTimeSeconds() - start;
+        uint64_t calls = hostAllocatorCalls(&allocator) - callsBefore;
+
+        vkDestroyCommandPool(ctx->device, frameCtx.commandPool, hostCallbacks);
+        vkDestroyPipeline(ctx->device, pipeline, hostCallbacks);
+        if (mode == HOST_ALLOC_SYSTEM) {
+            printf("%-9s %12.3f %16.2f %16.2f %13s %10s\n", hostAllocModeNames[mode], pipelineMs,
+                   recordSeconds * 1e6 / frames, totalSeconds * 1e6 / frames, "-", "-");
+        } else {
+            printf("%-9s %12.3f %16.2f %16.2f %13.1f %10.1f\n", hostAllocModeNames[mode], pipelineMs,
+                   recordSeconds * 1e6 / frames, totalSeconds * 1e6 / frames, (double)calls / frames,
+                   allocator.peakBytes / 1024.0);
+        }
+        hostAllocatorDestroy(&allocator);
+    }
+    hostCallbacks = startupCallbacks;
+}
+
+// Occupancy counters written by the -DLANE_STATS kernels (laneStats.glsl).
+typedef struct {
+    uint32_t subgroups;
+    uint32_t activeLanes;
+    uint32_t helperLanes;
+    uint32_t quads;
+    uint32_t blockQuads;
+} LaneStats;
+
+// One side of the graphics vs compute comparison. Both render into their own
+// image and copy it into the shared staging buffer.
+typedef struct {
+    const char* name;
+    const GraphicsPass* pass; // NULL for the compute kernel.
+    VkPipeline pipeline;
+    VkPipeline statsPipeline; // VK_NULL_HANDLE when the counters can't be collected.
+    VkPipelineLayout pipelineLayout;
+} VersusKernel;
+
+// Records `iterations` images from `pipeline` followed by the readback copy,
+// with timestamps 0 and 1 around the images when `queryPool` is given. The
+// compute side is recordComputeCommands(); the graphics side mirrors it with
+// one render pass per image.
+void recordVersusCommands(const ComputeContext* ctx, const VersusKernel* kernel, VkPipeline pipeline, uint32_t iterations,
+                          VkQueryPool queryPool, uint32_t firstFrame) {
+    if (kernel->pass == NULL) {
+        ComputeContext kernelCtx = *ctx;
+        kernelCtx.pipelineLayout = kernel->pipelineLayout;
+        recordComputeCommands(&kernelCtx, pipeline, iterations, queryPool, firstFrame);
+        return;
+    }
+
+    VkCommandBuffer commandBuffer = ctx->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+    for (uint32_t i = 0; i < iterations; i++) {
+        FrameParams params = frameParamsAt(firstFrame + i, ctx->shufflePattern, ctx->frameRate);
+        graphicsPassRecord(kernel->pass, commandBuffer, pipeline, kernel->pipelineLayout, ctx->descriptorSet, &params);
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+    }
+
+    // The render pass leaves the attachment in TRANSFER_SRC_OPTIMAL.
+    VkBufferImageCopy region = {
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = {ctx->width, ctx->height, 1},
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, kernel->pass->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ctx->stagingBuffer, 1, &region);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+// Timings of one kernel, per image.
+typedef struct {
+    double gpuMs;       // From timestamps, 0 if unsupported.
+    double hostMs;      // Submit to fence, all images in one submission.
+    double endToEndMs;  // Record, submit, wait and read the pixels, one image at a time.
+    LaneStats stats;
+    int hasStats;
+} VersusResult;
+
+void measureVersus(const ComputeContext* ctx, const VersusKernel* kernel, uint32_t iterations, VkQueryPool queryPool,
+                   LaneStats* mappedStats, VersusResult* result) {
+    memset(result, 0, sizeof(*result));
+
+    // Warm-up, so compilation and first-touch costs aren't measured.
+    recordVersusCommands(ctx, kernel, kernel->pipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(ctx, NULL);
+
+    recordVersusCommands(ctx, kernel, kernel->pipeline, iterations, queryPool, 0);
+    double start = getTimeSeconds();
+    submitAndWait(ctx, NULL);
+    result->hostMs = (getTimeSeconds() - start) * 1000.0 / iterations;
+    if (queryPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        result->gpuMs = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6 / iterations;
+    }
+
+    // What an image generator pays per image: every step until the host has
+    // the bytes (averageChannel maps and reads the whole staging buffer).
+    start = getTimeSeconds();
+    for (uint32_t i = 0; i < iterations; i++) {
+        recordVersusCommands(ctx, kernel, kernel->pipeline, 1, VK_NULL_HANDLE, i);
+        submitAndWait(ctx, NULL);
+        averageChannel(ctx, 1);
+    }
+    result->endToEndMs = (getTimeSeconds() - start) * 1000.0 / iterations;
+
+    if (kernel->statsPipeline != VK_NULL_HANDLE) {
+        memset(mappedStats, 0, sizeof(LaneStats));
+        recordVersusCommands(ctx, kernel, kernel->statsPipeline, 1, VK_NULL_HANDLE, 0);
+        submitAndWait(ctx, NULL);
+        result->stats = *mappedStats;
+        result->hasStats = 1;
+    }
+}
+
+// Renders the same image (shaderVersus.frag, shaderComputeVersus.comp) from a
+// full-screen triangle and from the compute kernel under the selected
+// mapping, at the same size and number of images, and reports GPU cost per
+// pixel, end-to-end time to host bytes and how each one fills its subgroups:
+// lanes per subgroup, helper lanes and quads that cover a 2x2 pixel block.
+void benchmarkVersus(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_BALLOT_BIT | VK_SUBGROUP_FEATURE_SHUFFLE_BIT;
+    VkShaderStageFlags stages = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    if ((ctx->subgroupStages & stages) != stages || (ctx->subgroupOperations & needed) != needed) {
+        printf("Versus benchmark skipped: needs subgroup ballot and shuffle in compute and fragment shaders\n");
+        return;
+    }
+
+    // Lane counters, read straight from mapped memory.
+    VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeof(LaneStats),
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer statsBuffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &statsBuffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, statsBuffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+    };
+    VkDeviceMemory statsMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &statsMemory, "lane stats"));
+    VK_CHECK(vkBindBufferMemory(device, statsBuffer, statsMemory, 0));
+    LaneStats* mappedStats = NULL;
+    VK_CHECK(vkMapMemory(device, statsMemory, 0, VK_WHOLE_SIZE, 0, (void**)&mappedStats));
+
+    // One set for both kernels: binding 0 the storage image (compute only),
+    // binding 1 the counters.
+    VkDescriptorSetLayoutBinding layoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, NULL },
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = layoutBindings,
+    };
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes,
+        .maxSets = 1,
+    };
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkDescriptorSet descriptorSet;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+
+    VkDescriptorImageInfo imageInfo = { .imageView = ctx->imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { .buffer = statsBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &imageInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfo,
+        },
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    // The push constants go to a different stage on each side.
+    VkPipelineLayout pipelineLayouts[2];
+    VkShaderStageFlags pushStages[2] = { VK_SHADER_STAGE_FRAGMENT_BIT, VK_SHADER_STAGE_COMPUTE_BIT };
+    for (uint32_t i = 0; i < 2; i++) {
+        VkPushConstantRange pushConstantRange = framePushConstantRange(pushStages[i]);
+        VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+            .setLayoutCount = 1,
+            .pSetLayouts = &descriptorSetLayout,
+            .pushConstantRangeCount = 1,
+            .pPushConstantRanges = &pushConstantRange,
+        };
+        VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &pipelineLayouts[i]));
+    }
+
+    GraphicsPass pass;
+    if (!graphicsPassCreate(&pass, device, ctx->physicalDevice, ctx->width, ctx->height)) {
+        fprintf(stderr, "Failed to create the offscreen render pass\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // The fragment shader gets the render size through specialization
+    // constants; the compute kernel reads it from the image.
+    uint32_t renderSize[2] = { ctx->width, ctx->height };
+    VkSpecializationMapEntry sizeEntries[] = {
+        { 0, 0, sizeof(uint32_t) },
+        { 1, sizeof(uint32_t), sizeof(uint32_t) },
+    };
+    VkSpecializationInfo sizeSpecialization = {
+        .mapEntryCount = 2,
+        .pMapEntries = sizeEntries,
+        .dataSize = sizeof(renderSize),
+        .pData = renderSize,
+    };
+
+    VkShaderModule vertModule = loadShaderModule(device, "spv/shader.vert.spv");
+    VkShaderModule fragModule = loadShaderModule(device, "spv/shaderVersus.frag.spv");
+    VkShaderModule computeModule = loadShaderModule(device, "spv/shaderComputeVersus.comp.spv");
+    VkShaderModule computeStatsModule = loadShaderModule(device, "spv/shaderComputeVersusStats.comp.spv");
+    // Fragment shaders may only write memory with fragmentStoresAndAtomics.
+    VkShaderModule fragStatsModule = ctx->fragmentStoresAndAtomics
+                                         ? loadShaderModule(device, "spv/shaderVersusStats.frag.spv")
+                                         : VK_NULL_HANDLE;
+
+    VersusKernel kernels[2] = {
+        {
+            .name = "fragment",
+            .pass = &pass,
+            .pipeline = graphicsPassCreatePipeline(&pass, pipelineLayouts[0], vertModule, fragModule, &sizeSpecialization),
+            .statsPipeline = fragStatsModule != VK_NULL_HANDLE
+                                 ? graphicsPassCreatePipeline(&pass, pipelineLayouts[0], vertModule, fragStatsModule, &sizeSpecialization)
+                                 : VK_NULL_HANDLE,
+            .pipelineLayout = pipelineLayouts[0],
+        },
+        {
+            .name = "compute",
+            .pass = NULL,
+            .pipeline = createComputePipeline(device, pipelineLayouts[1], computeModule, &options->mapping),
+            .statsPipeline = createComputePipeline(device, pipelineLayouts[1], computeStatsModule, &options->mapping),
+            .pipelineLayout = pipelineLayouts[1],
+        },
+    };
+    if (kernels[0].pipeline == VK_NULL_HANDLE) {
+        fprintf(stderr, "Failed to create the fragment pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    ComputeContext versusCtx = *ctx;
+    versusCtx.descriptorSet = descriptorSet;
+    uint32_t iterations = options->versusIterations;
+    VersusResult results[2];
+    for (uint32_t k = 0; k < 2; k++) {
+        measureVersus(&versusCtx, &kernels[k], iterations, queryPool, mappedStats, &results[k]);
+    }
+
+    double pixels = (double)ctx->width * ctx->height;
+    printf("Graphics vs compute: %ux%u, %u images each, %s pattern, %s mapping for compute\n", ctx->width, ctx->height,
+           iterations, shufflePatternNames[ctx->shufflePattern], mappingNames[options->mapping.mapping]);
+    printf("%-9s %12s %10s %13s %12s\n", "kernel", "gpu ms/img", "ns/pixel", "host ms/img", "e2e ms/img");
+    for (uint32_t k = 0; k < 2; k++) {
+        const VersusResult* r = &results[k];
+        double ms = r->gpuMs > 0.0 ? r->gpuMs : r->hostMs;
+        printf("%-9s %12.4f %10.4f %13.4f %12.4f\n", kernels[k].name, r->gpuMs, ms * 1e6 / pixels, r->hostMs, r->endToEndMs);
+    }
+
+    printf("Lane occupancy of one image (subgroup size %u):\n", ctx->subgroupSize);
+    printf("%-9s %10s %15s %12s %13s %11s\n", "kernel", "subgroups", "lanes/subgroup", "utilization", "helper lanes", "2x2 quads");
+    for (uint32_t k = 0; k < 2; k++) {
+        const LaneStats* s = &results[k].stats;
+        if (!results[k].hasStats) {
+            printf("%-9s %10s %15s %12s %13s %11s\n", kernels[k].name, "-", "-", "-", "-", "-");
+            continue;
+        }
+        double subgroups = s->subgroups ? (double)s->subgroups : 1.0;
+        printf("%-9s %10u %15.2f %11.1f%% %13u %10.1f%%\n", kernels[k].name, s->subgroups, s->activeLanes / subgroups,
+               100.0 * s->activeLanes / (subgroups * ctx->subgroupSize), s->helperLanes,
+               s->quads ? 100.0 * s->blockQuads / s->quads : 0.0);
+    }
+    if (!results[0].hasStats) {
+        printf("fragment counters need fragmentStoresAndAtomics, which this device lacks\n");
+    }
+
+    double fragmentMs = results[0].gpuMs > 0.0 ? results[0].gpuMs : results[0].hostMs;
+    double computeMs = results[1].gpuMs > 0.0 ? results[1].gpuMs : results[1].hostMs;
+    printf("Per pixel: %s is %.2fx faster; end to end: %s is %.2fx faster\n",
+           fragmentMs <= computeMs ? "fragment" : "compute",
+           fragmentMs <= computeMs ? computeMs / fragmentMs : fragmentMs / computeMs,
+           results[0].endToEndMs <= results[1].endToEndMs ? "fragment" : "compute",
+           results[0].endToEndMs <= results[1].endToEndMs ? results[1].endToEndMs / results[0].endToEndMs
+                                                          : results[0].endToEndMs / results[1].endToEndMs);
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    }
+    for (uint32_t k = 0; k < 2; k++) {
+        vkDestroyPipeline(device, kernels[k].pipeline, hostCallbacks);
+        vkDestroyPipeline(device, kernels[k].statsPipeline, hostCallbacks);
+    }
+    vkDestroyShaderModule(device, fragStatsModule, hostCallbacks);
+    vkDestroyShaderModule(device, computeStatsModule, hostCallbacks);
+    vkDestroyShaderModule(device, computeModule, hostCallbacks);
+    vkDestroyShaderModule(device, fragModule, hostCallbacks);
+    vkDestroyShaderModule(device, vertModule, hostCallbacks);
+    graphicsPassDestroy(&pass);
+    for (uint32_t i = 0; i < 2; i++) {
+        vkDestroyPipelineLayout(device, pipelineLayouts[i], hostCallbacks);
+    }
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkUnmapMemory(device, statsMemory);
+    vkDestroyBuffer(device, statsBuffer, hostCallbacks);
+    memoryBudgetFree(device, statsMemory);
+}
+
+// Runs the 2x2 filter of quadFilter.glsl with quad operations and with the
+// equivalent shuffles, in a fragment shader and in a compute kernel, and
+// reports per stage whether the quad path beats the shuffles. A stage is
+// skipped when the device lacks quad operations there; with
+// quadOperationsInAllStages unset Vulkan still guarantees fragment and compute.
+void benchmarkQuadOps(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    if (!(ctx->subgroupOperations & VK_SUBGROUP_FEATURE_QUAD_BIT)) {
+        printf("Quad benchmark skipped: the device has no subgroup quad operations\n");
+        return;
+    }
+    int fragmentSupported = (ctx->subgroupStages & VK_SHADER_STAGE_FRAGMENT_BIT) != 0;
+    int computeSupported = (ctx->subgroupStages & VK_SHADER_STAGE_COMPUTE_BIT) != 0;
+
+    // The fragment kernels bind no descriptors, only the push constants.
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VkPipelineLayout fragmentLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &fragmentLayout));
+
+    GraphicsPass pass;
+    if (!graphicsPassCreate(&pass, device, ctx->physicalDevice, ctx->width, ctx->height)) {
+        fprintf(stderr, "Failed to create the offscreen render pass\n");
+        exit(EXIT_FAILURE);
+    }
+    uint32_t renderSize[2] = { ctx->width, ctx->height };
+    VkSpecializationMapEntry sizeEntries[] = {
+        { 0, 0, sizeof(uint32_t) },
+        { 1, sizeof(uint32_t), sizeof(uint32_t) },
+    };
+    VkSpecializationInfo sizeSpecialization = {
+        .mapEntryCount = 2,
+        .pMapEntries = sizeEntries,
+        .dataSize = sizeof(renderSize),
+        .pData = renderSize,
+    };
+
+    // Quads only cover 2x2 blocks in compute under the morton mapping.
+    MappingSpecialization morton = { MAPPING_MORTON, options->mapping.tileWidth, options->mapping.tileHeight };
+
+    const char* shaderPaths[4] = {
+        "spv/shaderQuad.frag.spv",
+        "spv/shaderQuadShuffle.frag.spv",
+        "spv/shaderComputeQuad.comp.spv",
+        "spv/shaderComputeQuadShuffle.comp.spv",
+    };
+    VkShaderModule vertModule = loadShaderModule(device, "spv/shader.vert.spv");
+    VkShaderModule modules[4] = {0};
+    VersusKernel kernels[4] = {
+        { .name = "quad", .pass = &pass, .pipelineLayout = fragmentLayout },
+        { .name = "shuffle", .pass = &pass, .pipelineLayout = fragmentLayout },
+        { .name = "quad", .pass = NULL, .pipelineLayout = ctx->pipelineLayout },
+        { .name = "shuffle", .pass = NULL, .pipelineLayout = ctx->pipelineLayout },
+    };
+    for (uint32_t k = 0; k < 4; k++) {
+        if (!(k < 2 ? fragmentSupported : computeSupported)) continue;
+        modules[k] = loadShaderModule(device, shaderPaths[k]);
+        kernels[k].pipeline = k < 2 ? graphicsPassCreatePipeline(&pass, fragmentLayout, vertModule, modules[k], &sizeSpecialization)
+                                    : createComputePipeline(device, ctx->pipelineLayout, modules[k], &morton);
+        if (kernels[k].pipeline == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to create the %s pipeline\n", shaderPaths[k]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    ComputeContext fragmentCtx = *ctx;
+    fragmentCtx.descriptorSet = VK_NULL_HANDLE;
+    uint32_t iterations = options->quadBenchIterations;
+    double pixels = (double)ctx->width * ctx->height;
+    printf("Quad benchmark: %ux%u, %u images each, subgroup size %u, quadOperationsInAllStages %s\n", ctx->width,
+           ctx->height, iterations, ctx->subgroupSize, ctx->quadOperationsInAllStages ? "yes" : "no");
+    printf("%-9s %-8s %12s %10s %13s %8s\n", "stage", "kernel", "gpu ms/img", "ns/pixel", "host ms/img", "avg R");
+    for (uint32_t stage = 0; stage < 2; stage++) {
+        const char* stageName = stage == 0 ? "fragment" : "compute";
+        if (!(stage == 0 ? fragmentSupported : computeSupported)) {
+            printf("%-9s skipped: no subgroup operations in this stage\n", stageName);
+            continue;
+        }
+        double ms[2];
+        double red[2];
+        for (uint32_t v = 0; v < 2; v++) {
+            const VersusKernel* kernel = &kernels[stage * 2 + v];
+            VersusResult result;
+            measureVersus(stage == 0 ? &fragmentCtx : ctx, kernel, iterations, queryPool, NULL, &result);
+            // The staging buffer holds the last image of the end-to-end loop.
+            red[v] = averageChannel(ctx, 0);
+            ms[v] = result.gpuMs > 0.0 ? result.gpuMs : result.hostMs;
+            printf("%-9s %-8s %12.4f %10.4f %13.4f %8.4f\n", stageName, kernel->name, result.gpuMs, ms[v] * 1e6 / pixels,
+                   result.hostMs, red[v]);
+        }
+        double redDifference = red[0] > red[1] ? red[0] - red[1] : red[1] - red[0];
+        printf("%-9s quad operations are %.2fx %s than shuffles%s\n", stageName, ms[0] <= ms[1] ? ms[1] / ms[0] : ms[0] / ms[1],
+               ms[0] <= ms[1] ? "faster" : "slower", redDifference > 1.0 / 255.0 ? " (images differ!)" : "");
+    }
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    }
+    for (uint32_t k = 0; k < 4; k++) {
+        vkDestroyPipeline(device, kernels[k].pipeline, hostCallbacks);
+        vkDestroyShaderModule(device, modules[k], hostCallbacks);
+    }
+    vkDestroyShaderModule(device, vertModule, hostCallbacks);
+    graphicsPassDestroy(&pass);
+    vkDestroyPipelineLayout(device, fragmentLayout, hostCallbacks);
+}
+
+// Fragment variants that move the shuffled color with fewer or narrower
+// shuffles, each timed against the unpacked shader of its group.
+typedef struct {
+    const char* name;
+    const char* path;
+    int reference;     // The unpacked shader the following rows are compared with.
+    int needsFloat16;  // f16vec4 shuffles.
+    int needsInt8;     // uint8_t shuffles.
+} PackedVariant;
+const PackedVariant packedVariants[] = {
+    { "vec4", "spv/shaderShuffle.frag.spv", 1, 0, 0 },
+    { "unorm4x8", "spv/shaderShufflePacked.frag.spv", 0, 0, 0 },
+    { "half2x16", "spv/shaderShuffleHalf.frag.spv", 0, 0, 0 },
+    { "f16vec4", "spv/shaderShuffleFloat16.frag.spv", 0, 1, 0 },
+    { "gray f32", "spv/shaderSubgroupShuffleGray.frag.spv", 1, 0, 0 },
+    { "gray u8", "spv/shaderSubgroupShuffleGray8.frag.spv", 0, 0, 1 },
+};
+
+// Renders every packed fragment variant and reports its time per image and
+// speedup over the reference of its group. The red channel holds the
+// shuffled value in every variant, so its average flags a variant that
+// moves the wrong data. Variants whose types the device lacks are skipped.
+void benchmarkPackedShuffles(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    if (!(ctx->subgroupStages & VK_SHADER_STAGE_FRAGMENT_BIT) || !(ctx->subgroupOperations & VK_SUBGROUP_FEATURE_SHUFFLE_BIT)) {
+        printf("Packed shuffle benchmark skipped: no subgroup shuffles in fragment shaders\n");
+        return;
+    }
+
+    // The variants bind no descriptors; only shaderShuffle.frag and
+    // shaderSubgroupShuffleGray.frag read the push constants.
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VkPipelineLayout fragmentLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &fragmentLayout));
+
+    GraphicsPass pass;
+    if (!graphicsPassCreate(&pass, device, ctx->physicalDevice, ctx->width, ctx->height)) {
+        fprintf(stderr, "Failed to create the offscreen render pass\n");
+        exit(EXIT_FAILURE);
+    }
+    VkShaderModule vertModule = loadShaderModule(device, "spv/shader.vert.spv");
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    ComputeContext fragmentCtx = *ctx;
+    fragmentCtx.descriptorSet = VK_NULL_HANDLE;
+    uint32_t iterations = options->packedBenchIterations;
+    double pixels = (double)ctx->width * ctx->height;
+    printf("Packed shuffle benchmark: %ux%u, %u images each, subgroup size %u\n", ctx->width, ctx->height, iterations,
+           ctx->subgroupSize);
+    printf("%-9s %12s %10s %13s %8s %9s\n", "variant", "gpu ms/img", "ns/pixel", "host ms/img", "avg R", "speedup");
+
+    double referenceMs = 0.0;
+    double referenceRed = 0.0;
+    for (uint32_t v = 0; v < sizeof(packedVariants) / sizeof(packedVariants[0]); v++) {
+        const PackedVariant* variant = &packedVariants[v];
+        if ((variant->needsFloat16 && !(ctx->shaderFloat16 && ctx->subgroupExtendedTypes)) ||
+            (variant->needsInt8 && !(ctx->shaderInt8 && ctx->subgroupExtendedTypes))) {
+            printf("%-9s skipped (%s / shaderSubgroupExtendedTypes not supported)\n", variant->name,
+                   variant->needsFloat16 ? "shaderFloat16" : "shaderInt8");
+            continue;
+        }
+        VkShaderModule fragModule = loadShaderModule(device, variant->path);
+        VersusKernel kernel = {
+            .name = variant->name,
+            .pass = &pass,
+            .pipeline = graphicsPassCreatePipeline(&pass, fragmentLayout, vertModule, fragModule, NULL),
+            .pipelineLayout = fragmentLayout,
+        };
+        if (kernel.pipeline == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to create the %s pipeline\n", variant->path);
+            exit(EXIT_FAILURE);
+        }
+
+        VersusResult result;
+        measureVersus(&fragmentCtx, &kernel, iterations, queryPool, NULL, &result);
+        // The staging buffer holds the last image of the end-to-end loop.
+        double red = averageChannel(ctx, 0);
+        double ms = result.gpuMs > 0.0 ? result.gpuMs : result.hostMs;
+        printf("%-9s %12.4f %10.4f %13.4f %8.4f", variant->name, result.gpuMs, ms * 1e6 / pixels, result.hostMs, red);
+        if (variant->reference) {
+            referenceMs = ms;
+            referenceRed = red;
+            printf(" %9s\n", "-");
+        } else {
+            double redDifference = red > referenceRed ? red - referenceRed : referenceRed - red;
+            printf(" %8.2fx%s\n", referenceMs / ms, redDifference > 1.0 / 255.0 ? " (image differs!)" : "");
+        }
+
+        vkDestroyPipeline(device, kernel.pipeline, hostCallbacks);
+        vkDestroyShaderModule(device, fragModule, hostCallbacks);
+    }
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    }
+    vkDestroyShaderModule(device, vertModule, hostCallbacks);
+    graphicsPassDestroy(&pass);
+    vkDestroyPipelineLayout(device, fragmentLayout, hostCallbacks);
+}
+
+// Per-tile workloads of shaderComputeWorkQueue.comp (constant_id 3).
+enum {
+    WORKLOAD_UNIFORM = 0,
+    WORKLOAD_SKEWED = 1,
+    WORKLOAD_COUNT
+};
+const char* workloadNames[WORKLOAD_COUNT] = { "uniform", "skewed" };
+
+// Busy-loop iterations per pixel of a light tile (constant_id 4).
+#define WORK_QUEUE_BASE_COST 16
+
+// Records `iterations` runs of the work queue kernel followed by the readback
+// copy, with timestamps 0 and 1 around the runs. The image starts out as
+// unwrittenSentinel, so tiles no run reached show in the readback.
+// `persistentGroups` is 0 for the plain grid; otherwise that many workgroups
+// are launched and the tile counter is cleared before each run.
+void recordWorkQueueCommands(const ComputeContext* ctx, VkPipeline pipeline, VkPipelineLayout pipelineLayout,
+                             VkDescriptorSet descriptorSet, VkBuffer counterBuffer, uint32_t persistentGroups,
+                             uint32_t iterations, VkQueryPool queryPool) {
+    VkCommandBuffer commandBuffer = ctx->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+    }
+
+    recordSentinelClear(ctx, commandBuffer);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+
+    // Each run waits for the previous one: its image writes, and for the
+    // persistent kernel its last reads of the counter before the clear.
+    VkMemoryBarrier runBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    VkMemoryBarrier clearBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (i > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &runBarrier, 0,
+                                 NULL, 0, NULL);
+        }
+        if (persistentGroups > 0) {
+            vkCmdFillBuffer(commandBuffer, counterBuffer, 0, VK_WHOLE_SIZE, 0);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                 &clearBarrier, 0, NULL, 0, NULL);
+            vkCmdDispatch(commandBuffer, persistentGroups, 1, 1);
+        } else {
+            vkCmdDispatch(commandBuffer, ctx->width / WORKGROUP_DIM, ctx->height / WORKGROUP_DIM, 1);
+        }
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+    }
+
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = ctx->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+    VkBufferImageCopy region = {
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = {ctx->width, ctx->height, 1},
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, ctx->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ctx->stagingBuffer, 1, &region);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+// GPU (or, without timestamps, host) milliseconds per run, after a warm-up.
+double measureWorkQueue(const ComputeContext* ctx, VkPipeline pipeline, VkPipelineLayout pipelineLayout,
+                        VkDescriptorSet descriptorSet, VkBuffer counterBuffer, uint32_t persistentGroups,
+                        uint32_t iterations, VkQueryPool queryPool) {
+    recordWorkQueueCommands(ctx, pipeline, pipelineLayout, descriptorSet, counterBuffer, persistentGroups, 1, VK_NULL_HANDLE);
+    submitAndWait(ctx, NULL);
+    recordWorkQueueCommands(ctx, pipeline, pipelineLayout, descriptorSet, counterBuffer, persistentGroups, iterations, queryPool);
+    double start = getTimeSeconds();
+    submitAndWait(ctx, NULL);
+    double ms = (getTimeSeconds() - start) * 1000.0 / iterations;
+    if (queryPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        ms = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6 / iterations;
+    }
+    return ms;
+}
+
+// Compares the plain grid (one workgroup per tile) against persistent
+// workgroups that pull tiles from an atomic counter, on a uniform and on a
+// skewed per-tile cost. Vulkan doesn't report how many workgroups the device
+// keeps resident, so the persistent kernel is swept over a range of sizes and
+// the best one is compared. Each run starts from a sentinel image, so the
+// "written" column and the average red show whether every tile was drawn.
+void benchmarkWorkQueue(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    if ((ctx->subgroupOperations & needed) != needed) {
+        printf("Work queue benchmark skipped: needs subgroup ballot in compute shaders\n");
+        return;
+    }
+
+    // The tile counter, cleared on the GPU before each persistent run.
+    VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeof(uint32_t),
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer counterBuffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &counterBuffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, counterBuffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    VkDeviceMemory counterMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &counterMemory, "work queue"));
+    VK_CHECK(vkBindBufferMemory(device, counterBuffer, counterMemory, 0));
+
+    // Binding 0 the storage image, binding 1 the counter.
+    VkDescriptorSetLayoutBinding layoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = layoutBindings,
+    };
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes,
+        .maxSets = 1,
+    };
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkDescriptorSet descriptorSet;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+    VkDescriptorImageInfo imageInfo = { .imageView = ctx->imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { .buffer = counterBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &imageInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfo,
+        },
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkPipelineLayout pipelineLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &pipelineLayout));
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    VkShaderModule plainModule = loadShaderModule(device, "spv/shaderComputeWorkQueue.comp.spv");
+    VkShaderModule persistentModule = loadShaderModule(device, "spv/shaderComputeWorkQueuePersistent.comp.spv");
+    uint32_t tileCount = (ctx->width / WORKGROUP_DIM) * (ctx->height / WORKGROUP_DIM);
+    uint32_t iterations = options->queueBenchIterations;
+    printf("Work queue benchmark: %ux%u, %u tiles, %u runs each, subgroup size %u\n", ctx->width, ctx->height, tileCount,
+           iterations, ctx->subgroupSize);
+    printf("%-8s %-22s %12s %9s %8s %8s\n", "workload", "kernel", "gpu ms/run", "speedup", "avg R", "written");
+
+    for (uint32_t workload = 0; workload < WORKLOAD_COUNT; workload++) {
+        uint32_t constants[2] = { workload, WORK_QUEUE_BASE_COST };
+        VkSpecializationMapEntry mapEntries[] = {
+            { 3, 0, sizeof(uint32_t) },
+            { 4, sizeof(uint32_t), sizeof(uint32_t) },
+        };
+        VkSpecializationInfo specializationInfo = {
+            .mapEntryCount = 2,
+            .pMapEntries = mapEntries,
+            .dataSize = sizeof(constants),
+            .pData = constants,
+        };
+        VkPipeline plainPipeline = createComputePipelineSpecialized(device, pipelineLayout, plainModule, &specializationInfo);
+        VkPipeline persistentPipeline = createComputePipelineSpecialized(device, pipelineLayout, persistentModule, &specializationInfo);
+
+        double plainMs = measureWorkQueue(ctx, plainPipeline, pipelineLayout, descriptorSet, counterBuffer, 0, iterations, queryPool);
+        double plainRed = averageChannel(ctx, 0);
+        double plainWritten = averageChannel(ctx, 3);
+        printf("%-8s %-22s %12.4f %9s %8.4f %7.2f%%%s\n", workloadNames[workload], "grid", plainMs, "1.00x", plainRed,
+               plainWritten * 100.0, plainWritten < 1.0 ? " (tiles missing!)" : "");
+
+        // 64-lane workgroups, from a handful up to one per tile.
+        double bestMs = 0.0;
+        uint32_t bestGroups = 0;
+        for (uint32_t groups = 16; groups <= tileCount && groups <= 8192; groups *= 2) {
+            double ms = measureWorkQueue(ctx, persistentPipeline, pipelineLayout, descriptorSet, counterBuffer, groups,
+                                         iterations, queryPool);
+            double red = averageChannel(ctx, 0);
+            double written = averageChannel(ctx, 3);
+            double redDifference = red > plainRed ? red - plainRed : plainRed - red;
+            char name[32];
+            snprintf(name, sizeof(name), "persistent x%u", groups);
+            printf("%-8s %-22s %12.4f %8.2fx %8.4f %7.2f%%%s\n", workloadNames[workload], name, ms, plainMs / ms, red,
+                   written * 100.0, written < 1.0 ? " (tiles missing!)" : redDifference > 1.0 / 255.0 ? " (image differs!)" : "");
+            if (bestGroups == 0 || ms < bestMs) {
+                bestMs = ms;
+                bestGroups = groups;
+            }
+        }
+        if (bestGroups > 0) {
+            printf("%-8s best: %u persistent workgroups, %.2fx the grid\n", workloadNames[workload], bestGroups, plainMs / bestMs);
+        }
+
+        vkDestroyPipeline(device, persistentPipeline, hostCallbacks);
+        vkDestroyPipeline(device, plainPipeline, hostCallbacks);
+    }
+
+    vkDestroyShaderModule(device, persistentModule, hostCallbacks);
+    vkDestroyShaderModule(device, plainModule, hostCallbacks);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkDestroyBuffer(device, counterBuffer, hostCallbacks);
+    memoryBudgetFree(device, counterMemory);
+}
+
+// Builds one compute pipeline of shaderComputeShufflePattern.comp for the
+// shuffle variant cache.
+typedef struct {
+    VkDevice device;
+    VkPipelineLayout pipelineLayout;
+    VkShaderModule module;
+} PatternPipelineSource;
+
+VkPipeline buildPatternPipeline(const VkSpecializationInfo* specialization, void* user) {
+    const PatternPipelineSource* source = (const PatternPipelineSource*)user;
+    return createComputePipelineSpecialized(source->device, source->pipelineLayout, source->module, specialization);
+}
+
+// Sweeps the specialization-constant shuffle patterns (shuffle_variants.h)
+// on one .spv: builds every variant once through the cache, shows that a
+// second pass is all cache hits, then times each variant.
+void benchmarkPatternSweep(const ComputeContext* ctx, const ComputeOptions* options) {
+    uint32_t size = ctx->subgroupSize;
+    uint32_t half = size > 1 ? size / 2 : 1;
+    ShuffleVariant variants[] = {
+        { SHUFFLE_SPEC_REVERSE, 0 },
+        { SHUFFLE_SPEC_ROTATE, 1 },
+        { SHUFFLE_SPEC_ROTATE, half },
+        { SHUFFLE_SPEC_XOR, 1 },
+        { SHUFFLE_SPEC_XOR, half },
+        { SHUFFLE_SPEC_XOR, size - 1 },
+        { SHUFFLE_SPEC_BROADCAST, 0 },
+        { SHUFFLE_SPEC_BROADCAST, size - 1 },
+        { SHUFFLE_SPEC_RANDOM, 1 },
+        { SHUFFLE_SPEC_RANDOM, 2 },
+    };
+    uint32_t variantCount = sizeof(variants) / sizeof(variants[0]);
+
+    PatternPipelineSource source = {
+        .device = ctx->device,
+        .pipelineLayout = ctx->pipelineLayout,
+        .module = loadShaderModule(ctx->device, "spv/shaderComputeShufflePattern.comp.spv"),
+    };
+    uint32_t mappingIds[3] = { 0, 1, 2 };
+    uint32_t mappingValues[3] = { options->mapping.mapping, options->mapping.tileWidth, options->mapping.tileHeight };
+    ShuffleVariantCache cache;
+    shuffleVariantCacheInit(&cache, ctx->device, size, mappingIds, mappingValues, 3, buildPatternPipeline, &source);
+
+    double start = getTimeSeconds();
+    for (uint32_t v = 0; v < variantCount; v++) {
+        if (shuffleVariantCacheGet(&cache, variants[v]) == VK_NULL_HANDLE) {
+            fprintf(stderr, "Failed to build shuffle variant %u\n", v);
+            exit(EXIT_FAILURE);
+        }
+    }
+    double buildMs = (getTimeSeconds() - start) * 1000.0;
+    start = getTimeSeconds();
+    for (uint32_t v = 0; v < variantCount; v++) {
+        shuffleVariantCacheGet(&cache, variants[v]);
+    }
+    double lookupMs = (getTimeSeconds() - start) * 1000.0;
+
+    printf("Shuffle pattern sweep: %ux%u, %u dispatches each, subgroup size %u, %s mapping\n", ctx->width, ctx->height,
+           options->patternSweepIterations, size, mappingNames[options->mapping.mapping]);
+    printf("Built %u variants from one module in %.2f ms; second pass %.4f ms (%u hits, %u builds)\n", cache.count, buildMs,
+           lookupMs, cache.hits, cache.misses);
+    printf("%-14s %12s %13s %8s\n", "pattern", "gpu ms", "host ms", "avg R");
+    for (uint32_t v = 0; v < variantCount; v++) {
+        double gpuMs = 0.0;
+        double hostMs = 0.0;
+        measurePipeline(ctx, shuffleVariantCacheGet(&cache, variants[v]), options->patternSweepIterations, &gpuMs, &hostMs);
+        char name[32];
+        shuffleVariantName(variants[v], name, sizeof(name));
+        printf("%-14s %12.4f %13.4f %8.4f\n", name, gpuMs, hostMs, averageChannel(ctx, 0));
+    }
+
+    shuffleVariantCacheDestroy(&cache);
+    vkDestroyShaderModule(ctx->device, source.module, hostCallbacks);
+}
+
+// Active tiles per 256 swept by the indirect dispatch benchmark (constant_id 3).
+const uint32_t sparseDensities[] = { 256, 64, 16, 4, 1 };
+
+// Busy-loop iterations per pixel of an active tile (constant_id 4).
+#define SPARSE_BASE_COST 64
+
+// Host twin of tileActive() in sparseTiles.glsl.
+int sparseTileActive(uint32_t tile, uint32_t density) {
+    tile ^= tile >> 16;
+    tile *= 0x7feb352du;
+    tile ^= tile >> 15;
+    tile *= 0x846ca68bu;
+    tile ^= tile >> 16;
+    return (tile & 255u) < density;
+}
+
+// Average of `channel` over the active tiles only; inactive tiles are never
+// written, so their contents are whatever the image held before.
+double averageActiveChannel(const ComputeContext* ctx, uint32_t density, uint32_t channel) {
+    void* mappedMemory = NULL;
+    VkDeviceSize size = (VkDeviceSize)ctx->width * ctx->height * 4;
+    VK_CHECK(vkMapMemory(ctx->device, ctx->stagingBufferMemory, 0, size, 0, &mappedMemory));
+    const uint8_t* pixels = (const uint8_t*)mappedMemory;
+    uint32_t tilesX = ctx->width / WORKGROUP_DIM;
+    uint64_t sum = 0;
+    uint64_t count = 0;
+    for (uint32_t y = 0; y < ctx->height; y++) {
+        for (uint32_t x = 0; x < ctx->width; x++) {
+            if (sparseTileActive((y / WORKGROUP_DIM) * tilesX + x / WORKGROUP_DIM, density)) {
+                sum += pixels[((uint64_t)y * ctx->width + x) * 4 + channel];
+                count++;
+            }
+        }
+    }
+    vkUnmapMemory(ctx->device, ctx->stagingBufferMemory);
+    return count > 0 ? (double)sum / ((double)count * 255.0) : 0.0;
+}
+
+// Records `iterations` runs of the sparse workload followed by the readback
+// copy, with timestamps 0 and 1 around the runs. With a `classifyPipeline`
+// each run resets the list header, compacts the active tiles into
+// `tileBuffer` and launches `shadePipeline` with vkCmdDispatchIndirect;
+// without one it launches `shadePipeline` over the whole image. The image
+// starts out as unwrittenSentinel, and with a classification the last run's
+// list header is copied into `headerBuffer`.
+void recordIndirectCommands(const ComputeContext* ctx, VkPipeline classifyPipeline, VkPipeline shadePipeline,
+                            VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, VkBuffer tileBuffer,
+                            VkBuffer headerBuffer, uint32_t iterations, VkQueryPool queryPool) {
+    VkCommandBuffer commandBuffer = ctx->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+    }
+
+    recordSentinelClear(ctx, commandBuffer);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+
+    // Each run waits for the previous one: its image writes, and its reads
+    // of the tile list (as indirect arguments and as a buffer) before the
+    // header is reset.
+    VkMemoryBarrier runBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+    };
+    VkMemoryBarrier resetBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    VkMemoryBarrier listBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_SHADER_READ_BIT,
+    };
+    VkDispatchIndirectCommand emptyList = { 0, 1, 1 };
+    uint32_t tileCount = (ctx->width / WORKGROUP_DIM) * (ctx->height / WORKGROUP_DIM);
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (i > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                                 VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &runBarrier, 0,
+                                 NULL, 0, NULL);
+        }
+        if (classifyPipeline != VK_NULL_HANDLE) {
+            vkCmdUpdateBuffer(commandBuffer, tileBuffer, 0, sizeof(emptyList), &emptyList);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1,
+                                 &resetBarrier, 0, NULL, 0, NULL);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, classifyPipeline);
+            vkCmdDispatch(commandBuffer, (tileCount + 63) / 64, 1, 1);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &listBarrier,
+                                 0, NULL, 0, NULL);
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, shadePipeline);
+            vkCmdDispatchIndirect(commandBuffer, tileBuffer, 0);
+        } else {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, shadePipeline);
+            vkCmdDispatch(commandBuffer, ctx->width / WORKGROUP_DIM, ctx->height / WORKGROUP_DIM, 1);
+        }
+    }
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+    }
+
+    VkImageMemoryBarrier toTransfer = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = ctx->image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+    VkBufferImageCopy region = {
+        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
+        .imageExtent = {ctx->width, ctx->height, 1},
+    };
+    vkCmdCopyImageToBuffer(commandBuffer, ctx->image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, ctx->stagingBuffer, 1, &region);
+    if (classifyPipeline != VK_NULL_HANDLE) {
+        VkMemoryBarrier headerBarrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+            .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1,
+                             &headerBarrier, 0, NULL, 0, NULL);
+        VkBufferCopy headerRegion = { 0, 0, sizeof(VkDispatchIndirectCommand) };
+        vkCmdCopyBuffer(commandBuffer, tileBuffer, headerBuffer, 1, &headerRegion);
+    }
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+}
+
+// GPU (or, without timestamps, host) milliseconds per run, after a warm-up.
+double measureIndirect(const ComputeContext* ctx, VkPipeline classifyPipeline, VkPipeline shadePipeline,
+                       VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, VkBuffer tileBuffer,
+                       VkBuffer headerBuffer, uint32_t iterations, VkQueryPool queryPool) {
+    recordIndirectCommands(ctx, classifyPipeline, shadePipeline, pipelineLayout, descriptorSet, tileBuffer, headerBuffer, 1,
+                           VK_NULL_HANDLE);
+    submitAndWait(ctx, NULL);
+    recordIndirectCommands(ctx, classifyPipeline, shadePipeline, pipelineLayout, descriptorSet, tileBuffer, headerBuffer,
+                           iterations, queryPool);
+    double start = getTimeSeconds();
+    submitAndWait(ctx, NULL);
+    double ms = (getTimeSeconds() - start) * 1000.0 / iterations;
+    if (queryPool != VK_NULL_HANDLE) {
+        uint64_t timestamps[2];
+        VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                       VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+        ms = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6 / iterations;
+    }
+    return ms;
+}
+
+// Compares dispatching the whole image, where inactive tiles exit at once,
+// against a classification pass that compacts the active tiles with subgroup
+// ballots and writes the VkDispatchIndirectCommand of a second pass over
+// only those tiles. Swept from every tile active down to one in 256; the
+// indirect time includes the classification. Each mode starts from a
+// sentinel image, and the list's groupCountX is read back and checked
+// against the host's count of active tiles.
+void benchmarkIndirectDispatch(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    VkSubgroupFeatureFlags needed = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT;
+    if ((ctx->subgroupOperations & needed) != needed) {
+        printf("Indirect dispatch benchmark skipped: needs subgroup ballot in compute shaders\n");
+        return;
+    }
+
+    // The tile list: a VkDispatchIndirectCommand, then one entry per tile.
+    uint32_t tileCount = (ctx->width / WORKGROUP_DIM) * (ctx->height / WORKGROUP_DIM);
+    VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeof(VkDispatchIndirectCommand) + (VkDeviceSize)tileCount * sizeof(uint32_t),
+        .usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT |
+                 VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer tileBuffer;
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &tileBuffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, tileBuffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    VkDeviceMemory tileMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &tileMemory, "tile list"));
+    VK_CHECK(vkBindBufferMemory(device, tileBuffer, tileMemory, 0));
+
+    // The list header of the last run, copied out for the host to check.
+    VkBufferCreateInfo headerCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = sizeof(VkDispatchIndirectCommand),
+        .usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VkBuffer headerBuffer;
+    VK_CHECK(vkCreateBuffer(device, &headerCreateInfo, hostCallbacks, &headerBuffer));
+    vkGetBufferMemoryRequirements(device, headerBuffer, &memRequirements);
+    VkMemoryAllocateInfo headerAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+    };
+    VkDeviceMemory headerMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &headerAllocInfo, &headerMemory, "tile list header"));
+    VK_CHECK(vkBindBufferMemory(device, headerBuffer, headerMemory, 0));
+    const VkDispatchIndirectCommand* mappedHeader = NULL;
+    VK_CHECK(vkMapMemory(device, headerMemory, 0, VK_WHOLE_SIZE, 0, (void**)&mappedHeader));
+
+    // Binding 0 the storage image, binding 1 the tile list.
+    VkDescriptorSetLayoutBinding layoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 2,
+        .pBindings = layoutBindings,
+    };
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 2,
+        .pPoolSizes = poolSizes,
+        .maxSets = 1,
+    };
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkDescriptorSet descriptorSet;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+    VkDescriptorImageInfo imageInfo = { .imageView = ctx->imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { .buffer = tileBuffer, .offset = 0, .range = VK_WHOLE_SIZE };
+    VkWriteDescriptorSet writes[] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 0,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+            .descriptorCount = 1,
+            .pImageInfo = &imageInfo,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+            .dstSet = descriptorSet,
+            .dstBinding = 1,
+            .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+            .descriptorCount = 1,
+            .pBufferInfo = &bufferInfo,
+        },
+    };
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkPipelineLayout pipelineLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &pipelineLayout));
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
+
+    VkShaderModule classifyModule = loadShaderModule(device, "spv/shaderComputeClassify.comp.spv");
+    VkShaderModule gridModule = loadShaderModule(device, "spv/shaderComputeSparse.comp.spv");
+    VkShaderModule listModule = loadShaderModule(device, "spv/shaderComputeSparseList.comp.spv");
+    uint32_t iterations = options->indirectBenchIterations;
+    printf("Indirect dispatch benchmark: %ux%u, %u tiles, %u runs each, subgroup size %u\n", ctx->width, ctx->height,
+           tileCount, iterations, ctx->subgroupSize);
+    printf("%-8s %12s %-10s %12s %9s %8s %8s\n", "density", "active", "kernel", "gpu ms/run", "speedup", "avg R", "written");
+
+    for (uint32_t d = 0; d < sizeof(sparseDensities) / sizeof(sparseDensities[0]); d++) {
+        uint32_t density = sparseDensities[d];
+        uint32_t activeTiles = 0;
+        for (uint32_t tile = 0; tile < tileCount; tile++) {
+            activeTiles += sparseTileActive(tile, density);
+        }
+        uint32_t constants[2] = { density, SPARSE_BASE_COST };
+        VkSpecializationMapEntry mapEntries[] = {
+            { 3, 0, sizeof(uint32_t) },
+            { 4, sizeof(uint32_t), sizeof(uint32_t) },
+        };
+        VkSpecializationInfo specializationInfo = {
+            .mapEntryCount = 2,
+            .pMapEntries = mapEntries,
+            .dataSize = sizeof(constants),
+            .pData = constants,
+        };
+        VkPipeline classifyPipeline = createComputePipelineSpecialized(device, pipelineLayout, classifyModule, &specializationInfo);
+        VkPipeline gridPipeline = createComputePipelineSpecialized(device, pipelineLayout, gridModule, &specializationInfo);
+        VkPipeline listPipeline = createComputePipelineSpecialized(device, pipelineLayout, listModule, &specializationInfo);
+
+        char densityName[16];
+        char activeName[32];
+        snprintf(densityName, sizeof(densityName), "%u/256", density);
+        snprintf(activeName, sizeof(activeName), "%u (%.1f%%)", activeTiles, 100.0 * activeTiles / tileCount);
+        double gridMs = measureIndirect(ctx, VK_NULL_HANDLE, gridPipeline, pipelineLayout, descriptorSet, tileBuffer,
+                                        headerBuffer, iterations, queryPool);
+        double gridRed = averageActiveChannel(ctx, density, 0);
+        double gridWritten = averageActiveChannel(ctx, density, 3);
+        printf("%-8s %12s %-10s %12.4f %9s %8.4f %7.2f%%%s\n", densityName, activeName, "grid", gridMs, "1.00x", gridRed,
+               gridWritten * 100.0, gridWritten < 1.0 ? " (tiles missing!)" : "");
+        double listMs = measureIndirect(ctx, classifyPipeline, listPipeline, pipelineLayout, descriptorSet, tileBuffer,
+                                        headerBuffer, iterations, queryPool);
+        double listRed = averageActiveChannel(ctx, density, 0);
+        double listWritten = averageActiveChannel(ctx, density, 3);
+        double redDifference = listRed > gridRed ? listRed - gridRed : gridRed - listRed;
+        printf("%-8s %12s %-10s %12.4f %8.2fx %8.4f %7.2f%%%s\n", densityName, activeName, "indirect", listMs, gridMs / listMs,
+               listRed, listWritten * 100.0,
+               listWritten < 1.0 ? " (tiles missing!)" : redDifference > 1.0 / 255.0 ? " (image differs!)" : "");
+        if (mappedHeader->x != activeTiles) {
+            printf("%-8s the classification listed %u tiles, expected %u\n", densityName, mappedHeader->x, activeTiles);
+        }
+
+        vkDestroyPipeline(device, listPipeline, hostCallbacks);
+        vkDestroyPipeline(device, gridPipeline, hostCallbacks);
+        vkDestroyPipeline(device, classifyPipeline, hostCallbacks);
+    }
+
+    vkDestroyShaderModule(device, listModule, hostCallbacks);
+    vkDestroyShaderModule(device, gridModule, hostCallbacks);
+    vkDestroyShaderModule(device, classifyModule, hostCallbacks);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    }
+    vkDestroyPipelineLayout(device, pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkUnmapMemory(device, headerMemory);
+    vkDestroyBuffer(device, headerBuffer, hostCallbacks);
+    memoryBudgetFree(device, headerMemory);
+    vkDestroyBuffer(device, tileBuffer, hostCallbacks);
+    memoryBudgetFree(device, tileMemory);
+}
+
+// How the async compute benchmark submits one round.
+enum {
+    ASYNC_GRAPHICS_ONLY,
+    ASYNC_COMPUTE_ONLY,
+    ASYNC_BACK_TO_BACK,
+    ASYNC_CONCURRENT,
+    ASYNC_MODE_COUNT
+};
+const char* asyncModeNames[ASYNC_MODE_COUNT] = { "graphics only", "compute only", "back-to-back", "concurrent" };
+
+// Rounds per mode; the fastest one is reported.
+#define ASYNC_ROUNDS 3
+
+// Submits one round in `mode` and returns the host milliseconds until the
+// fence signals. Back-to-back chains the compute submission behind the
+// graphics one with `semaphore`. Concurrent submits both independently and
+// joins them with an empty graphics-queue submission that waits on the
+// compute side's `semaphore`, so the fence covers both.
+double runAsyncRound(const ComputeContext* ctx, VkCommandBuffer graphicsCommands, VkCommandBuffer computeCommands,
+                     VkSemaphore semaphore, VkFence fence, uint32_t mode) {
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+    VkSubmitInfo graphicsSubmit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &graphicsCommands,
+    };
+    VkSubmitInfo computeSubmit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .commandBufferCount = 1,
+        .pCommandBuffers = &computeCommands,
+    };
+    VkSubmitInfo joinSubmit = {
+        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+        .waitSemaphoreCount = 1,
+        .pWaitSemaphores = &semaphore,
+        .pWaitDstStageMask = &waitStage,
+    };
+
+    VK_CHECK(vkResetFences(ctx->device, 1, &fence));
+    double start = getTimeSeconds();
+    if (mode == ASYNC_GRAPHICS_ONLY) {
+        VK_CHECK(vkQueueSubmit(ctx->queue, 1, &graphicsSubmit, fence));
+    } else if (mode == ASYNC_COMPUTE_ONLY) {
+        VK_CHECK(vkQueueSubmit(ctx->asyncQueue, 1, &computeSubmit, fence));
+    } else if (mode == ASYNC_BACK_TO_BACK) {
+        graphicsSubmit.signalSemaphoreCount = 1;
+        graphicsSubmit.pSignalSemaphores = &semaphore;
+        computeSubmit.waitSemaphoreCount = 1;
+        computeSubmit.pWaitSemaphores = &semaphore;
+        computeSubmit.pWaitDstStageMask = &waitStage;
+        VK_CHECK(vkQueueSubmit(ctx->queue, 1, &graphicsSubmit, VK_NULL_HANDLE));
+        VK_CHECK(vkQueueSubmit(ctx->asyncQueue, 1, &computeSubmit, fence));
+    } else {
+        computeSubmit.signalSemaphoreCount = 1;
+        computeSubmit.pSignalSemaphores = &semaphore;
+        VK_CHECK(vkQueueSubmit(ctx->asyncQueue, 1, &computeSubmit, VK_NULL_HANDLE));
+        VK_CHECK(vkQueueSubmit(ctx->queue, 1, &graphicsSubmit, VK_NULL_HANDLE));
+        VK_CHECK(vkQueueSubmit(ctx->queue, 1, &joinSubmit, fence));
+    }
+    VK_CHECK(vkWaitForFences(ctx->device, 1, &fence, VK_TRUE, UINT64_MAX));
+    return (getTimeSeconds() - start) * 1000.0;
+}
+
+// Runs fragment renders (shaderVersus.frag into an offscreen attachment) on
+// the graphics queue and compute kernels (shaderComputeWorkQueue.comp into
+// a separate storage image) on the async compute queue. Each side is timed
+// alone, then both together: back-to-back, and submitted concurrently. The
+// two sides share no resources, so only the semaphores order them.
+void benchmarkAsyncCompute(const ComputeContext* ctx, const ComputeOptions* options) {
+    VkDevice device = ctx->device;
+    uint32_t iterations = options->asyncBenchIterations;
+
+    // Graphics side: a push-constant-only layout, as shaderVersus.frag
+    // without LANE_STATS binds no descriptors.
+    GraphicsPass pass;
+    if (!graphicsPassCreate(&pass, device, ctx->physicalDevice, ctx->width, ctx->height)) {
+        fprintf(stderr, "Failed to create the offscreen render pass\n");
+        exit(EXIT_FAILURE);
+    }
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT);
+    VkPipelineLayoutCreateInfo graphicsLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VkPipelineLayout graphicsLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &graphicsLayoutCreateInfo, hostCallbacks, &graphicsLayout));
+    uint32_t renderSize[2] = { ctx->width, ctx->height };
+    VkSpecializationMapEntry sizeEntries[] = {
+        { 0, 0, sizeof(uint32_t) },
+        { 1, sizeof(uint32_t), sizeof(uint32_t) },
+    };
+    VkSpecializationInfo sizeSpecialization = {
+        .mapEntryCount = 2,
+        .pMapEntries = sizeEntries,
+        .dataSize = sizeof(renderSize),
+        .pData = renderSize,
+    };
+    VkShaderModule vertModule = loadShaderModule(device, "spv/shader.vert.spv");
+    VkShaderModule fragModule = loadShaderModule(device, "spv/shaderVersus.frag.spv");
+    VkPipeline graphicsPipeline = graphicsPassCreatePipeline(&pass, graphicsLayout, vertModule, fragModule, &sizeSpecialization);
+    if (graphicsPipeline == VK_NULL_HANDLE) {
+        fprintf(stderr, "Failed to create the fragment pipeline\n");
+        exit(EXIT_FAILURE);
+    }
+
+    // Compute side: its own storage image, owned by the async queue family.
+    VkImageCreateInfo imageCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+        .imageType = VK_IMAGE_TYPE_2D,
+        .format = VK_FORMAT_R8G8B8A8_UNORM,
+        .extent = {ctx->width, ctx->height, 1},
+        .mipLevels = 1,
+        .arrayLayers = 1,
+        .samples = VK_SAMPLE_COUNT_1_BIT,
+        .tiling = VK_IMAGE_TILING_OPTIMAL,
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT,
+        .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+    };
+    VkImage image;
+    VK_CHECK(vkCreateImage(device, &imageCreateInfo, hostCallbacks, &image));
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+    };
+    VkDeviceMemory imageMemory;
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &imageMemory, "async compute image"));
+    VK_CHECK(vkBindImageMemory(device, image, imageMemory, 0));
+    VkImageViewCreateInfo imageViewCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+        .image = image,
+        .viewType = VK_IMAGE_VIEW_TYPE_2D,
+        .format = imageCreateInfo.format,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    VkImageView imageView;
+    VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, hostCallbacks, &imageView));
+
+    VkDescriptorSetLayoutBinding layoutBinding = { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &layoutBinding,
+    };
+    VkDescriptorSetLayout descriptorSetLayout;
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize,
+        .maxSets = 1,
+    };
+    VkDescriptorPool descriptorPool;
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkDescriptorSet descriptorSet;
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &descriptorSet));
+    VkDescriptorImageInfo imageInfo = { .imageView = imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = descriptorSet,
+        .dstBinding = 0,
+        .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+        .descriptorCount = 1,
+        .pImageInfo = &imageInfo,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+    VkPipelineLayoutCreateInfo computeLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &descriptorSetLayout,
+    };
+    VkPipelineLayout computeLayout;
+    VK_CHECK(vkCreatePipelineLayout(device, &computeLayoutCreateInfo, hostCallbacks, &computeLayout));
+    uint32_t constants[2] = { WORKLOAD_UNIFORM, WORK_QUEUE_BASE_COST };
+    VkSpecializationMapEntry mapEntries[] = {
+        { 3, 0, sizeof(uint32_t) },
+        { 4, sizeof(uint32_t), sizeof(uint32_t) },
+    };
+    VkSpecializationInfo workloadSpecialization = {
+        .mapEntryCount = 2,
+        .pMapEntries = mapEntries,
+        .dataSize = sizeof(constants),
+        .pData = constants,
+    };
+    VkShaderModule computeModule = loadShaderModule(device, "spv/shaderComputeWorkQueue.comp.spv");
+    VkPipeline computePipeline = createComputePipelineSpecialized(device, computeLayout, computeModule, &workloadSpecialization);
+
+    // One command buffer per side, each from a pool of its queue's family,
+    // recorded once and resubmitted every round.
+    VkCommandPoolCreateInfo commandPoolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .queueFamilyIndex = ctx->queueFamilyIndex,
+    };
+    VkCommandPool commandPools[2];
+    VK_CHECK(vkCreateCommandPool(device, &commandPoolCreateInfo, hostCallbacks, &commandPools[0]));
+    commandPoolCreateInfo.queueFamilyIndex = ctx->asyncQueueFamilyIndex;
+    VK_CHECK(vkCreateCommandPool(device, &commandPoolCreateInfo, hostCallbacks, &commandPools[1]));
+    VkCommandBuffer commandBuffers[2];
+    for (uint32_t i = 0; i < 2; i++) {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo = {
+            .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+            .commandPool = commandPools[i],
+            .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+            .commandBufferCount = 1,
+        };
+        VK_CHECK(vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffers[i]));
+    }
+    VkCommandBufferBeginInfo beginInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+
+    VK_CHECK(vkBeginCommandBuffer(commandBuffers[0], &beginInfo));
+    for (uint32_t i = 0; i < iterations; i++) {
+        FrameParams params = frameParamsAt(i, ctx->shufflePattern, ctx->frameRate);
+        graphicsPassRecord(&pass, commandBuffers[0], graphicsPipeline, graphicsLayout, VK_NULL_HANDLE, &params);
+    }
+    VK_CHECK(vkEndCommandBuffer(commandBuffers[0]));
+
+    VK_CHECK(vkBeginCommandBuffer(commandBuffers[1], &beginInfo));
+    VkImageMemoryBarrier toGeneral = {
+        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+        .srcAccessMask = 0,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+        .image = image,
+        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+    };
+    vkCmdPipelineBarrier(commandBuffers[1], VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &toGeneral);
+    vkCmdBindPipeline(commandBuffers[1], VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
+    vkCmdBindDescriptorSets(commandBuffers[1], VK_PIPELINE_BIND_POINT_COMPUTE, computeLayout, 0, 1, &descriptorSet, 0, NULL);
+    VkMemoryBarrier runBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (i > 0) {
+            vkCmdPipelineBarrier(commandBuffers[1], VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+                                 1, &runBarrier, 0, NULL, 0, NULL);
+        }
+        vkCmdDispatch(commandBuffers[1], ctx->width / WORKGROUP_DIM, ctx->height / WORKGROUP_DIM, 1);
+    }
+    VK_CHECK(vkEndCommandBuffer(commandBuffers[1]));
+
+    VkSemaphoreCreateInfo semaphoreCreateInfo = { .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+    VkSemaphore semaphore;
+    VK_CHECK(vkCreateSemaphore(device, &semaphoreCreateInfo, hostCallbacks, &semaphore));
+    VkFenceCreateInfo fenceCreateInfo = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence;
+    VK_CHECK(vkCreateFence(device, &fenceCreateInfo, hostCallbacks, &fence));
+
+    const char* queueKind = ctx->asyncQueue == ctx->queue ? "the graphics queue itself, no second queue available"
+                          : ctx->asyncQueueFamilyIndex != ctx->queueFamilyIndex ? "a compute-only family"
+                                                                               : "a second queue of the graphics family";
+    printf("Async compute benchmark: %ux%u, %u renders and %u dispatches per round, best of %d rounds\n", ctx->width,
+           ctx->height, iterations, iterations, ASYNC_ROUNDS);
+    printf("Graphics on queue family %u, compute on queue family %u (%s)\n", ctx->queueFamilyIndex,
+           ctx->asyncQueueFamilyIndex, queueKind);
+    printf("%-14s %12s\n", "mode", "host ms");
+
+    double best[ASYNC_MODE_COUNT];
+    for (uint32_t mode = 0; mode < ASYNC_MODE_COUNT; mode++) {
+        runAsyncRound(ctx, commandBuffers[0], commandBuffers[1], semaphore, fence, mode); // Warm-up.
+        best[mode] = 0.0;
+        for (uint32_t round = 0; round < ASYNC_ROUNDS; round++) {
+            double ms = runAsyncRound(ctx, commandBuffers[0], commandBuffers[1], semaphore, fence, mode);
+            if (round == 0 || ms < best[mode]) {
+                best[mode] = ms;
+            }
+        }
+        printf("%-14s %12.3f\n", asyncModeNames[mode], best[mode]);
+    }
+    // Perfect overlap would hide the shorter side entirely.
+    double longest = best[ASYNC_GRAPHICS_ONLY] > best[ASYNC_COMPUTE_ONLY] ? best[ASYNC_GRAPHICS_ONLY] : best[ASYNC_COMPUTE_ONLY];
+    printf("Overlap: concurrent runs %.2fx the back-to-back throughput (perfect overlap: %.2fx)\n",
+           best[ASYNC_BACK_TO_BACK] / best[ASYNC_CONCURRENT], best[ASYNC_BACK_TO_BACK] / longest);
+
+    vkDestroyFence(device, fence, hostCallbacks);
+    vkDestroySemaphore(device, semaphore, hostCallbacks);
+    vkDestroyCommandPool(device, commandPools[1], hostCallbacks);
+    vkDestroyCommandPool(device, commandPools[0], hostCallbacks);
+    vkDestroyPipeline(device, computePipeline, hostCallbacks);
+    vkDestroyShaderModule(device, computeModule, hostCallbacks);
+    vkDestroyPipelineLayout(device, computeLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkDestroyImageView(device, imageView, hostCallbacks);
+    vkDestroyImage(device, image, hostCallbacks);
+    memoryBudgetFree(device, imageMemory);
+    vkDestroyPipeline(device, graphicsPipeline, hostCallbacks);
+    vkDestroyShaderModule(device, fragModule, hostCallbacks);
+    vkDestroyShaderModule(device, vertModule, hostCallbacks);
+    vkDestroyPipelineLayout(device, graphicsLayout, hostCallbacks);
+    graphicsPassDestroy(&pass);
+}
+
+// Times `iterations` dispatches of the main kernel as measurePipeline() does,
+// with pipeline statistics and performance counters around every dispatch,
+// and reports their per-dispatch averages next to the times. Counters the
+// device can't provide are left out of the report.
+void benchmarkCounters(const ComputeContext* ctx, VkPipeline pipeline, uint32_t iterations) {
+    if (!ctx->pipelineStatisticsQuery && !ctx->performanceQuery) {
+        printf("Counters: neither pipelineStatisticsQuery nor VK_KHR_performance_query is supported\n");
+        return;
+    }
+    GpuCounters counters;
+    VkQueryPipelineStatisticFlags statistics = ctx->pipelineStatisticsQuery ? VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT : 0;
+    if (!gpuCountersCreate(&counters, ctx->device, ctx->physicalDevice, ctx->queueFamilyIndex, statistics, ctx->performanceQuery,
+                           iterations)) {
+        fprintf(stderr, "Failed to create the counter query pools\n");
+        exit(EXIT_FAILURE);
+    }
+
+    ComputeContext countedCtx = *ctx;
+    countedCtx.counters = &counters;
+    double gpuMs, hostMs;
+    measurePipeline(&countedCtx, pipeline, iterations, &gpuMs, &hostMs);
+    GpuCounterValues values;
+    int haveValues = gpuCountersRead(&counters, 0, iterations, &values);
+
+    printf("Counters: %ux%u, %u dispatches, %.3f ms GPU, %.3f ms host per dispatch\n", ctx->width, ctx->height, iterations, gpuMs,
+           hostMs);
+    if (!ctx->performanceQuery) {
+        printf("  (VK_KHR_performance_query unavailable: pipeline statistics only)\n");
+    }
+    if (haveValues) {
+        gpuCountersPrint(&counters, &values, "dispatch");
+        if (counters.statisticsPool != VK_NULL_HANDLE) {
+            // One invocation per pixel of every layer the dispatch covers.
+            printf("  %-40s %16llu per dispatch\n", "expected invocations",
+                   (unsigned long long)ctx->width * ctx->height * ctx->layers);
+        }
+    } else {
+        printf("  Query results unavailable\n");
+    }
+    gpuCountersDestroy(&counters);
+}
+
+// Output layouts compared by the layout benchmark.
+enum {
+    STORE_OPTIMAL_IMAGE, // Storage image, optimal tiling, copied into a buffer.
+    STORE_LINEAR_IMAGE,  // Storage image, linear tiling, host-visible, mapped.
+    STORE_BUFFER,        // Storage buffer with a padded row pitch, host-visible.
+    STORE_TEXEL_BUFFER,  // rgba8 storage texel buffer, host-visible.
+    STORE_BACKEND_COUNT
+};
+const char* storeBackendNames[STORE_BACKEND_COUNT] = { "optimal+copy", "linear image", "buffer", "texel buffer" };
+
+// Row alignment of the storage buffer backend, the copy pitch most drivers
+// are fastest with. Rows of width * 4 bytes are padded up to it.
+#define STORE_ROW_ALIGNMENT 256
+
+// Host-visible memory for results the host reads: cached when the device has
+// it, since reading uncached (write-combined) memory is slow. Returns
+// UINT32_MAX if `typeFilter` has no host-visible type. `cached` reports which.
+uint32_t findReadbackMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, int* cached) {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    VkMemoryPropertyFlags wanted[2] = {
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT,
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+    };
+    for (uint32_t w = 0; w < 2; w++) {
+        for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
+            if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & wanted[w]) == wanted[w]) {
+                *cached = w == 0;
+                return i;
+            }
+        }
+    }
+    return UINT32_MAX;
+}
+
+// Everything one backend renders into and the host reads from.
+typedef struct {
+    uint32_t backend;
+    int supported;
+    VkImage image;            // Image backends.
+    VkImageView imageView;
+    VkDeviceMemory imageMemory;
+    VkBuffer buffer;          // Readback buffer (optimal) or the output itself.
+    VkBufferView bufferView;  // Texel buffer backend.
+    VkDeviceMemory memory;    // Host-visible memory the host reads.
+    int cached;
+    const uint8_t* pixels;    // Mapped first pixel.
+    VkDeviceSize rowPitch;    // Bytes between rows as the host sees them.
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkPipelineLayout pipelineLayout;
+    VkShaderModule module;
+    VkPipeline pipeline;
+} StoreTarget;
+
+// Creates a host-visible buffer for `target` of `size` bytes with `usage`,
+// mapped. Returns 0 if the device has no host-visible memory for it.
+int createStoreBuffer(const ComputeContext* ctx, StoreTarget* target, VkDeviceSize size, VkBufferUsageFlags usage) {
+    VkBufferCreateInfo bufferCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+        .size = size,
+        .usage = usage,
+        .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
+    };
+    VK_CHECK(vkCreateBuffer(ctx->device, &bufferCreateInfo, hostCallbacks, &target->buffer));
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(ctx->device, target->buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+        .allocationSize = memRequirements.size,
+        .memoryTypeIndex = findReadbackMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, &target->cached),
+    };
+    if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+        memoryBudgetAllocate(ctx->device, &allocInfo, &target->memory, "layout output") != VK_SUCCESS) {
+        return 0;
+    }
+    VK_CHECK(vkBindBufferMemory(ctx->device, target->buffer, target->memory, 0));
+    VK_CHECK(vkMapMemory(ctx->device, target->memory, 0, VK_WHOLE_SIZE, 0, (void**)&target->pixels));
+    return 1;
+}
+
+// Creates the output of `backend`, its descriptor set and its pipeline.
+// Leaves target->supported at 0 when the device can't host the backend.
+void createStoreTarget(const ComputeContext* ctx, const ComputeOptions* options, uint32_t backend, StoreTarget* target) {
+    VkDevice device = ctx->device;
+    memset(target, 0, sizeof(*target));
+    target->backend = backend;
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx->physicalDevice, &properties);
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(ctx->physicalDevice, VK_FORMAT_R8G8B8A8_UNORM, &formatProperties);
+    VkDeviceSize imageBytes = (VkDeviceSize)ctx->width * ctx->height * 4;
+
+    VkDescriptorType descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    if (backend == STORE_OPTIMAL_IMAGE) {
+        // The regular storage image, copied into a buffer of our own so every
+        // backend is read from the same kind of memory.
+        target->image = ctx->image;
+        target->imageView = ctx->imageView;
+        target->rowPitch = (VkDeviceSize)ctx->width * 4;
+        if (!createStoreBuffer(ctx, target, imageBytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT)) return;
+    } else if (backend == STORE_LINEAR_IMAGE) {
+        if (!(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_STORAGE_IMAGE_BIT)) return;
+        VkImageCreateInfo imageCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+            .imageType = VK_IMAGE_TYPE_2D,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .extent = {ctx->width, ctx->height, 1},
+            .mipLevels = 1,
+            .arrayLayers = 1,
+            .samples = VK_SAMPLE_COUNT_1_BIT,
+            .tiling = VK_IMAGE_TILING_LINEAR,
+            .usage = VK_IMAGE_USAGE_STORAGE_BIT,
+            .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+        };
+        if (vkCreateImage(device, &imageCreateInfo, hostCallbacks, &target->image) != VK_SUCCESS) return;
+        VkMemoryRequirements memRequirements;
+        vkGetImageMemoryRequirements(device, target->image, &memRequirements);
+        VkMemoryAllocateInfo allocInfo = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+            .allocationSize = memRequirements.size,
+            .memoryTypeIndex = findReadbackMemoryType(ctx->physicalDevice, memRequirements.memoryTypeBits, &target->cached),
+        };
+        if (allocInfo.memoryTypeIndex == UINT32_MAX ||
+            memoryBudgetAllocate(device, &allocInfo, &target->memory, "layout output") != VK_SUCCESS) {
+            return;
+        }
+        VK_CHECK(vkBindImageMemory(device, target->image, target->memory, 0));
+        VkImageSubresource subresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0 };
+        VkSubresourceLayout layout;
+        vkGetImageSubresourceLayout(device, target->image, &subresource, &layout);
+        void* mapped;
+        VK_CHECK(vkMapMemory(device, target->memory, 0, VK_WHOLE_SIZE, 0, &mapped));
+        target->pixels = (const uint8_t*)mapped + layout.offset;
+        target->rowPitch = layout.rowPitch;
+        VkImageViewCreateInfo imageViewCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO,
+            .image = target->image,
+            .viewType = VK_IMAGE_VIEW_TYPE_2D,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+        VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, hostCallbacks, &target->imageView));
+    } else if (backend == STORE_BUFFER) {
+        descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        target->rowPitch = ((VkDeviceSize)ctx->width * 4 + STORE_ROW_ALIGNMENT - 1) / STORE_ROW_ALIGNMENT * STORE_ROW_ALIGNMENT;
+        if (target->rowPitch * ctx->height > properties.limits.maxStorageBufferRange) return;
+        if (!createStoreBuffer(ctx, target, target->rowPitch * ctx->height, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT)) return;
+    } else {
+        descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER;
+        if (!(formatProperties.bufferFeatures & VK_FORMAT_FEATURE_STORAGE_TEXEL_BUFFER_BIT) ||
+            (uint64_t)ctx->width * ctx->height > properties.limits.maxTexelBufferElements) {
+            return;
+        }
+        target->rowPitch = (VkDeviceSize)ctx->width * 4;
+        if (!createStoreBuffer(ctx, target, imageBytes, VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT)) return;
+        VkBufferViewCreateInfo bufferViewCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO,
+            .buffer = target->buffer,
+            .format = VK_FORMAT_R8G8B8A8_UNORM,
+            .offset = 0,
+            .range = VK_WHOLE_SIZE,
+        };
+        VK_CHECK(vkCreateBufferView(device, &bufferViewCreateInfo, hostCallbacks, &target->bufferView));
+    }
+
+    VkDescriptorSetLayoutBinding layoutBinding = {
+        .binding = 0,
+        .descriptorType = descriptorType,
+        .descriptorCount = 1,
+        .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT,
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO,
+        .bindingCount = 1,
+        .pBindings = &layoutBinding,
+    };
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &target->setLayout));
+    VkDescriptorPoolSize poolSize = { descriptorType, 1 };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO,
+        .poolSizeCount = 1,
+        .pPoolSizes = &poolSize,
+        .maxSets = 1,
+    };
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &target->descriptorPool));
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
+        .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO,
+        .descriptorPool = target->descriptorPool,
+        .descriptorSetCount = 1,
+        .pSetLayouts = &target->setLayout,
+    };
+    VK_CHECK(vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &target->descriptorSet));
+
+    VkDescriptorImageInfo imageInfo = { .imageView = target->imageView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { .buffer = target->buffer, .offset = 0, .range = VK_WHOLE_SIZE };
+    VkWriteDescriptorSet write = {
+        .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET,
+        .dstSet = target->descriptorSet,
+        .dstBinding = 0,
+        .descriptorType = descriptorType,
+        .descriptorCount = 1,
+        .pImageInfo = &imageInfo,
+        .pBufferInfo = &bufferInfo,
+        .pTexelBufferView = &target->bufferView,
+    };
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
 
-#include "vulkan_functions.h"
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT);
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
+        .setLayoutCount = 1,
+        .pSetLayouts = &target->setLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
+    };
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &target->pipelineLayout));
 
-// Simple error handling macro.
-#define VK_CHECK(result)                                                 \
-    if (result != VK_SUCCESS) {                                          \
-        fprintf(stderr, "Vulkan error in %s at line %d: %d\n", __FILE__, \
-                __LINE__, result);                                       \
-        exit(EXIT_FAILURE);                                              \
+    // The mapping constants (0..2) plus the output size and pitch (5..7),
+    // which only the buffer shaders declare.
+    uint32_t constants[6] = {
+        options->mapping.mapping, options->mapping.tileWidth, options->mapping.tileHeight,
+        ctx->width, ctx->height, (uint32_t)(target->rowPitch / 4),
+    };
+    VkSpecializationMapEntry mapEntries[6] = {
+        { 0, 0, sizeof(uint32_t) },
+        { 1, 4, sizeof(uint32_t) },
+        { 2, 8, sizeof(uint32_t) },
+        { 5, 12, sizeof(uint32_t) },
+        { 6, 16, sizeof(uint32_t) },
+        { 7, 20, sizeof(uint32_t) },
+    };
+    VkSpecializationInfo specializationInfo = {
+        .mapEntryCount = 6,
+        .pMapEntries = mapEntries,
+        .dataSize = sizeof(constants),
+        .pData = constants,
+    };
+    const char* shaderPaths[STORE_BACKEND_COUNT] = {
+        "spv/shaderComputeSubgroupShuffle.comp.spv",
+        "spv/shaderComputeSubgroupShuffle.comp.spv",
+        "spv/shaderComputeStoreBuffer.comp.spv",
+        "spv/shaderComputeStoreTexelBuffer.comp.spv",
+    };
+    target->module = loadShaderModule(device, shaderPaths[backend]);
+    target->pipeline = createComputePipelineSpecialized(device, target->pipelineLayout, target->module, &specializationInfo);
+    target->supported = 1;
+}
+
+void destroyStoreTarget(const ComputeContext* ctx, StoreTarget* target) {
+    VkDevice device = ctx->device;
+    vkDestroyPipeline(device, target->pipeline, hostCallbacks);
+    vkDestroyShaderModule(device, target->module, hostCallbacks);
+    vkDestroyPipelineLayout(device, target->pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, target->descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, target->setLayout, hostCallbacks);
+    vkDestroyBufferView(device, target->bufferView, hostCallbacks);
+    vkDestroyBuffer(device, target->buffer, hostCallbacks);
+    if (target->backend == STORE_LINEAR_IMAGE) {
+        vkDestroyImageView(device, target->imageView, hostCallbacks);
+        vkDestroyImage(device, target->image, hostCallbacks);
     }
+    memoryBudgetFree(device, target->memory);
+}
 
-// Function to find a suitable memory type index.
-uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+// Records `iterations` dispatches into `target` with timestamps 0 and 1
+// around them, then makes the pixels visible to the host: through the copy
+// for the optimal image, directly for the others.
+void recordStoreCommands(const ComputeContext* ctx, const StoreTarget* target, uint32_t iterations, VkQueryPool queryPool,
+                         uint32_t firstFrame) {
+    if (target->backend == STORE_OPTIMAL_IMAGE) {
+        ComputeContext copyCtx = *ctx;
+        copyCtx.stagingBuffer = target->buffer;
+        recordComputeCommands(&copyCtx, target->pipeline, iterations, queryPool, firstFrame);
+        return;
+    }
 
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
+    VkCommandBuffer commandBuffer = ctx->commandBuffer;
+    VkCommandBufferBeginInfo beginInfo = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+        .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT,
+    };
+    VK_CHECK(vkResetCommandBuffer(commandBuffer, 0));
+    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+    }
+    if (target->backend == STORE_LINEAR_IMAGE) {
+        VkImageMemoryBarrier toGeneral = {
+            .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+            .srcAccessMask = 0,
+            .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+            .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+            .newLayout = VK_IMAGE_LAYOUT_GENERAL,
+            .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+            .image = target->image,
+            .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        };
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &toGeneral);
+    }
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, target->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, target->pipelineLayout, 0, 1, &target->descriptorSet, 0, NULL);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+    VkMemoryBarrier writeBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+    };
+    for (uint32_t i = 0; i < iterations; i++) {
+        if (i > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &writeBarrier, 0, NULL, 0, NULL);
         }
+        FrameParams params = frameParamsAt(firstFrame + i, ctx->shufflePattern, ctx->frameRate);
+        vkCmdPushConstants(commandBuffer, target->pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(params), &params);
+        recordDispatch(commandBuffer, ctx->width, ctx->height, 1, ctx->dispatch1D);
     }
-    fprintf(stderr, "Failed to find suitable memory type!\n");
-    exit(EXIT_FAILURE);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, 1);
+    }
+    VkMemoryBarrier hostBarrier = {
+        .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER,
+        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
+        .dstAccessMask = VK_ACCESS_HOST_READ_BIT,
+    };
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, NULL, 0, NULL);
+    VK_CHECK(vkEndCommandBuffer(commandBuffer));
 }
 
-// Function to read a binary file (like our SPIR-V shader).
-char* readFile(const char* filename, size_t* pSize) {
-    FILE* file = fopen(filename, "rb");
-    if (!file) {
-        fprintf(stderr, "Failed to open file: %s\n", filename);
-        exit(EXIT_FAILURE);
+// Sum of the green channel, row by row through the target's pitch: touches
+// every byte the host would read, and should agree between backends.
+uint64_t storeChecksum(const ComputeContext* ctx, const StoreTarget* target) {
+    uint64_t sum = 0;
+    for (uint32_t y = 0; y < ctx->height; y++) {
+        const uint8_t* row = target->pixels + y * target->rowPitch;
+        for (uint32_t x = 0; x < ctx->width; x++) {
+            sum += row[x * 4 + 1];
+        }
     }
+    return sum;
+}
 
-    fseek(file, 0, SEEK_END);
-    *pSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
+// Renders with the regular kernel into each output layout and reports GPU
+// write time and throughput, the host's read time and the total time until
+// the host has the bytes of one image. Layouts the device can't host are
+// listed as unsupported.
+void benchmarkOutputLayouts(const ComputeContext* ctx, const ComputeOptions* options) {
+    uint32_t iterations = options->layoutBenchIterations;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (ctx->timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolCreateInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_TIMESTAMP,
+            .queryCount = 2,
+        };
+        VK_CHECK(vkCreateQueryPool(ctx->device, &queryPoolCreateInfo, hostCallbacks, &queryPool));
+    }
 
-    char* buffer = (char*)malloc(*pSize);
-    if (!buffer) {
-        fprintf(stderr, "Failed to allocate memory for file content.\n");
-        fclose(file);
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(ctx->physicalDevice, &properties);
+    double bytes = (double)ctx->width * ctx->height * 4;
+    printf("Output layout benchmark on %s: %ux%u, %u images, %s mapping\n", properties.deviceName, ctx->width,
+           ctx->height, iterations, mappingNames[options->mapping.mapping]);
+    printf("%-13s %7s %10s %12s %13s %12s %14s %8s\n", "layout", "cached", "row pitch", "gpu ms/img", "GB/s written",
+           "read ms/img", "to host ms/img", "avg G");
+
+    for (uint32_t backend = 0; backend < STORE_BACKEND_COUNT; backend++) {
+        StoreTarget target;
+        createStoreTarget(ctx, options, backend, &target);
+        if (!target.supported) {
+            printf("%-13s unsupported on this device\n", storeBackendNames[backend]);
+            destroyStoreTarget(ctx, &target);
+            continue;
+        }
+
+        // Warm-up, then the GPU side alone.
+        recordStoreCommands(ctx, &target, 1, VK_NULL_HANDLE, 0);
+        submitAndWait(ctx, NULL);
+        recordStoreCommands(ctx, &target, iterations, queryPool, 0);
+        double start = getTimeSeconds();
+        submitAndWait(ctx, NULL);
+        double gpuMs = (getTimeSeconds() - start) * 1000.0 / iterations;
+        if (queryPool != VK_NULL_HANDLE) {
+            uint64_t timestamps[2];
+            VK_CHECK(vkGetQueryPoolResults(ctx->device, queryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                           VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+            gpuMs = (double)(timestamps[1] - timestamps[0]) * ctx->timestampPeriod * 1e-6 / iterations;
+        }
+
+        // One image at a time until the host has read every pixel.
+        double readSeconds = 0.0;
+        uint64_t checksum = 0;
+        start = getTimeSeconds();
+        for (uint32_t i = 0; i < iterations; i++) {
+            recordStoreCommands(ctx, &target, 1, VK_NULL_HANDLE, i);
+            submitAndWait(ctx, NULL);
+            double readStart = getTimeSeconds();
+            checksum += storeChecksum(ctx, &target);
+            readSeconds += getTimeSeconds() - readStart;
+        }
+        double totalMs = (getTimeSeconds() - start) * 1000.0 / iterations;
+
+        printf("%-13s %7s %10llu %12.4f %13.2f %12.4f %14.4f %8.4f\n", storeBackendNames[backend], target.cached ? "yes" : "no",
+               (unsigned long long)target.rowPitch, gpuMs, bytes / (gpuMs * 1e-3) * 1e-9, readSeconds * 1000.0 / iterations,
+               totalMs, (double)checksum / ((double)ctx->width * ctx->height * iterations * 255.0));
+        destroyStoreTarget(ctx, &target);
+    }
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(ctx->device, queryPool, hostCallbacks);
+    }
+}
+
+// Hashes the output of `pipeline` on the GPU (shaderImageHash.comp) so only 16
+// bytes are read back. With --hash it also runs the full readback path, hashes
+// the pixels on the CPU, checks both hashes agree and reports the time saved.
+// With --verify the GPU hash is compared against the expected one. Returns 1 if
+// every check passed.
+int verifyOutput(const ComputeContext* ctx, VkPipeline pipeline, const ComputeOptions* options) {
+    if (!imageHashSupported(ctx->physicalDevice)) {
+        fprintf(stderr, "Image hashing needs subgroup arithmetic in compute shaders.\n");
+        return 0;
+    }
+    VkShaderModule module = loadShaderModule(ctx->device, "spv/shaderImageHash.comp.spv");
+    ImageHasher hasher;
+    if (!imageHasherCreate(&hasher, ctx->device, ctx->physicalDevice, module, ctx->imageView)) {
+        fprintf(stderr, "Failed to create the image hash pipeline!\n");
         exit(EXIT_FAILURE);
     }
+    ComputeContext hashCtx = *ctx;
+    hashCtx.hasher = &hasher;
 
-    fread(buffer, 1, *pSize, file);
-    fclose(file);
-    return buffer;
+    // Warm-up, then render + hash + read 16 bytes.
+    recordComputeCommands(&hashCtx, pipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(&hashCtx, NULL);
+    double start = getTimeSeconds();
+    recordComputeCommands(&hashCtx, pipeline, 1, VK_NULL_HANDLE, 0);
+    submitAndWait(&hashCtx, NULL);
+    uint32_t gpuWords[IMAGE_HASH_WORDS];
+    memcpy(gpuWords, hasher.words, sizeof(gpuWords));
+    double gpuSeconds = getTimeSeconds() - start;
+
+    char gpuHex[IMAGE_HASH_HEX_LENGTH + 1];
+    imageHashToHex(gpuWords, gpuHex);
+    printf("GPU hash %s (%ux%u, %.3f ms render + hash + 16-byte readback)\n", gpuHex, ctx->width, ctx->height,
+           gpuSeconds * 1000.0);
+
+    int passed = 1;
+    if (options->hashOutput) {
+        // Render + full copy + CPU hash of the mapped pixels.
+        recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, 0);
+        submitAndWait(ctx, NULL);
+        start = getTimeSeconds();
+        recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, 0);
+        submitAndWait(ctx, NULL);
+        void* mappedMemory = NULL;
+        VK_CHECK(vkMapMemory(ctx->device, ctx->stagingBufferMemory, 0, VK_WHOLE_SIZE, 0, &mappedMemory));
+        uint32_t cpuWords[IMAGE_HASH_WORDS];
+        imageHashCpu((const uint8_t*)mappedMemory, ctx->width, ctx->height, cpuWords);
+        vkUnmapMemory(ctx->device, ctx->stagingBufferMemory);
+        double readbackSeconds = getTimeSeconds() - start;
+
+        char cpuHex[IMAGE_HASH_HEX_LENGTH + 1];
+        imageHashToHex(cpuWords, cpuHex);
+        printf("CPU hash %s (%.3f ms render + %.1f MB readback + hash)\n", cpuHex, readbackSeconds * 1000.0,
+               (double)ctx->width * ctx->height * 4 / (1024.0 * 1024.0));
+        printf("Saved %.3f ms per verification (%.1fx)\n", (readbackSeconds - gpuSeconds) * 1000.0,
+               readbackSeconds / gpuSeconds);
+        if (memcmp(gpuWords, cpuWords, sizeof(gpuWords)) != 0) {
+            fprintf(stderr, "GPU and CPU hashes differ!\n");
+            passed = 0;
+        }
+    }
+
+    if (options->expectedHash) {
+        uint32_t expectedWords[IMAGE_HASH_WORDS];
+        imageHashFromHex(options->expectedHash, expectedWords);
+        int match = memcmp(gpuWords, expectedWords, sizeof(gpuWords)) == 0;
+        printf("Verify: %s (expected %s)\n", match ? "PASS" : "FAIL", options->expectedHash);
+        passed = passed && match;
+    }
+
+    imageHasherDestroy(&hasher);
+    vkDestroyShaderModule(ctx->device, module, hostCallbacks);
+    return passed;
 }
 
-// Function to save the image buffer to a .ppm file.
-void saveImage(const char* filename, const void* buffer, uint32_t width, uint32_t height) {
-    FILE* file = fopen(filename, "wb");
-    if (!file) {
-        fprintf(stderr, "Failed to open file for writing: %s\n", filename);
-        return;
+// Renders `options->frames` frames and pushes each one into a frame stream.
+// The staging buffer stays mapped for the whole run; the copy into the
+// stream's queue is the only host-side work per frame, conversion and I/O
+// happen on the writer thread.
+void streamFrames(const ComputeContext* ctx, VkPipeline pipeline, const ComputeOptions* options) {
+    FrameStream* stream = frameStreamOpen(options->streamPath, options->streamFormat, ctx->width, ctx->height,
+                                          options->fps, options->streamQueue, options->streamDrop);
+    if (!stream) {
+        exit(EXIT_FAILURE);
     }
 
-    // Write PPM header (P6 format for binary color).
-    fprintf(file, "P6\n%d %d\n255\n", width, height);
+    void* mappedMemory = NULL;
+    VkDeviceSize size = (VkDeviceSize)ctx->width * ctx->height * 4;
+    VK_CHECK(vkMapMemory(ctx->device, ctx->stagingBufferMemory, 0, size, 0, &mappedMemory));
 
-    // The shader outputs RGBA, but PPM P6 is RGB. We need to convert.
-    const uint8_t* pixelData = (const uint8_t*)buffer;
-    for (uint32_t i = 0; i < width * height; ++i) {
-        fwrite(pixelData, 3, 1, file); // Write R, G, B
-        pixelData += 4;                 // Skip Alpha
+    double recordSeconds = 0.0;
+    double renderSeconds = 0.0;
+    uint32_t frame = 0;
+    for (; frame < options->frames; frame++) {
+        // Only the push constants change between frames.
+        double recordStart = getTimeSeconds();
+        recordComputeCommands(ctx, pipeline, 1, VK_NULL_HANDLE, frame);
+        recordSeconds += getTimeSeconds() - recordStart;
+
+        VkFrameBoundaryEXT frameBoundaryInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAME_BOUNDARY_EXT,
+            .flags = VK_FRAME_BOUNDARY_FRAME_END_BIT_EXT,
+            .frameID = frame + 1,
+            .imageCount = 1,
+            .pImages = &ctx->image,
+        };
+        double start = getTimeSeconds();
+        submitAndWait(ctx, &frameBoundaryInfo);
+        renderSeconds += getTimeSeconds() - start;
+
+        if (!frameStreamPush(stream, mappedMemory)) {
+            break;
+        }
     }
 
-    fclose(file);
-    printf("Image saved to %s\n", filename);
+    vkUnmapMemory(ctx->device, ctx->stagingBufferMemory);
+    frameStreamClose(stream);
+    fprintf(stderr, "Rendered %u frames, %.1f us recording and %.3f ms GPU+submit per frame\n", frame,
+            frame > 0 ? recordSeconds * 1e6 / frame : 0.0, frame > 0 ? renderSeconds * 1000.0 / frame : 0.0);
 }
 
+int main(int argc, char** argv) {
+    ComputeOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // Streaming, reporting or logging memory to stdout: claim it before
+    // anything is printed, so the tables go to stderr. Only one output can
+    // have it.
+    int streamToStdout = options.streamPath && strcmp(options.streamPath, "-") == 0;
+    int reportToStdout = options.reportPath && strcmp(options.reportPath, "-") == 0;
+    int memoryLogToStdout = options.memoryLogPath && strcmp(options.memoryLogPath, "-") == 0;
+    if (streamToStdout + reportToStdout + memoryLogToStdout > 1) {
+        fprintf(stderr, "Only one of --stream -, --report - and --memory-log - can write to stdout\n");
+        return EXIT_FAILURE;
+    }
+    if (streamToStdout || reportToStdout || memoryLogToStdout) {
+        stdoutClaim();
+    }
 
-int main() {
 #if defined(__linux__)
     // --- 1. Load Vulkan Loader ---
     void* vulkan_library = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
@@ -99,7 +4043,7 @@ int main() {
         fprintf(stderr, "Failed to load Vulkan library.\n");
         return EXIT_FAILURE;
     }
-    
+
     // Load exported functions
     #define EXPORTED_VULKAN_FUNCTION( name ) \
         name = (PFN_##name)dlsym(vulkan_library, #name); \
@@ -129,6 +4073,15 @@ int main() {
 
     // --- 1. Vulkan Instance and Device Setup ---
 
+    // Route the driver's host allocations through the chosen allocator. The
+    // startup time below runs from here to a ready pipeline.
+    double startupStart = getTimeSeconds();
+    HostAllocator hostAllocator;
+    hostCallbacks = hostAllocatorInit(&hostAllocator, options.hostAlloc);
+    if (options.bundlePath && !spirvBundleOpen(&shaderBundle, options.bundlePath)) {
+        return EXIT_FAILURE;
+    }
+
     // Create a Vulkan instance.
     VkApplicationInfo appInfo = {
         .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
@@ -143,7 +4096,7 @@ int main() {
         .pApplicationInfo = &appInfo,
     };
     VkInstance instance;
-    VK_CHECK(vkCreateInstance(&instanceCreateInfo, NULL, &instance));
+    VK_CHECK(vkCreateInstance(&instanceCreateInfo, hostCallbacks, &instance));
 
     // Load global and instance level functions
     #define GLOBAL_LEVEL_VULKAN_FUNCTION( name ) \
@@ -158,63 +4111,181 @@ int main() {
             fprintf(stderr, "Could not load instance-level Vulkan function %s\n", #name); \
             return EXIT_FAILURE; \
         }
+    // Extension functions stay NULL when the loader doesn't know them.
+    #define OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( name ) \
+        name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);
     #include "vulkan_functions.h"
 
-    // Select a physical device.
+    // Select a physical device: the best scoring one with a compute queue,
+    // unless --device or $SUBGROUP_DEVICE names another. --versus,
+    // --quad-bench, --packed-bench and --async-bench also draw, so they need
+    // a queue that does both.
+    int drawing = options.versusIterations > 0 || options.quadBenchIterations > 0 || options.packedBenchIterations > 0 ||
+                  options.asyncBenchIterations > 0;
+    VkQueueFlags requiredQueueFlags = VK_QUEUE_COMPUTE_BIT;
+    VkShaderStageFlags scoredStages = VK_SHADER_STAGE_COMPUTE_BIT;
+    if (drawing) {
+        requiredQueueFlags |= VK_QUEUE_GRAPHICS_BIT;
+        scoredStages |= VK_SHADER_STAGE_FRAGMENT_BIT;
+    }
     uint32_t physicalDeviceCount = 0;
-    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, NULL);
-    VkPhysicalDevice* physicalDevices = (VkPhysicalDevice*)malloc(physicalDeviceCount * sizeof(VkPhysicalDevice));
-    vkEnumeratePhysicalDevices(instance, &physicalDeviceCount, physicalDevices);
-
-    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    uint32_t computeQueueFamilyIndex = UINT32_MAX;
-
-    for (uint32_t i = 0; i < physicalDeviceCount; i++) {
-        uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[i], &queueFamilyCount, NULL);
-        VkQueueFamilyProperties* queueFamilies = (VkQueueFamilyProperties*)malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
-        vkGetPhysicalDeviceQueueFamilyProperties(physicalDevices[i], &queueFamilyCount, queueFamilies);
-
-        for (uint32_t j = 0; j < queueFamilyCount; j++) {
-            if (queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT) {
-                physicalDevice = physicalDevices[i];
-                computeQueueFamilyIndex = j;
-                break;
-            }
-        }
-        free(queueFamilies);
-        if (physicalDevice != VK_NULL_HANDLE) break;
+    DeviceInfo* deviceInfos = deviceQueryAll(instance, requiredQueueFlags, scoredStages, &physicalDeviceCount);
+    int selectedDevice = deviceSelect(deviceInfos, physicalDeviceCount, options.deviceSelector);
+    if (options.reportPath && !deviceWriteReport(options.reportPath, deviceInfos, physicalDeviceCount, selectedDevice)) {
+        return EXIT_FAILURE;
+    }
+    if (selectedDevice < 0) {
+        fprintf(stderr, "Failed to find a suitable physical device with a %s queue.\n",
+                drawing ? "graphics and compute" : "compute");
+        return EXIT_FAILURE;
     }
-    free(physicalDevices);
+    VkPhysicalDevice physicalDevice = deviceInfos[selectedDevice].physicalDevice;
+    uint32_t computeQueueFamilyIndex = deviceInfos[selectedDevice].queueFamilyIndex;
+    uint32_t timestampValidBits = deviceInfos[selectedDevice].timestampValidBits;
+    uint32_t subgroupSize = deviceInfos[selectedDevice].subgroup.subgroupSize;
+    VkShaderStageFlags subgroupSupportedStages = deviceInfos[selectedDevice].subgroup.supportedStages;
+    VkSubgroupFeatureFlags subgroupOperations = deviceInfos[selectedDevice].subgroup.supportedOperations;
+    VkBool32 quadOperationsInAllStages = deviceInfos[selectedDevice].subgroup.quadOperationsInAllStages;
+    int hasSizeControl = deviceInfos[selectedDevice].hasSizeControl;
+    VkPhysicalDeviceSubgroupSizeControlProperties sizeControl = deviceInfos[selectedDevice].sizeControl;
+    deviceReportSubgroup(&deviceInfos[selectedDevice]);
+    free(deviceInfos);
 
-    if (physicalDevice == VK_NULL_HANDLE) {
-        fprintf(stderr, "Failed to find a suitable physical device with a compute queue.\n");
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+    if (options.dispatch1D &&
+        (options.width / WORKGROUP_DIM) * (options.height / WORKGROUP_DIM) > deviceProperties.limits.maxComputeWorkGroupCount[0]) {
+        fprintf(stderr, "1D dispatch of %ux%u exceeds maxComputeWorkGroupCount[0] = %u\n",
+                options.width, options.height, deviceProperties.limits.maxComputeWorkGroupCount[0]);
         return EXIT_FAILURE;
     }
 
-    // Create a logical device.
-    float queuePriority = 1.0f;
-    VkDeviceQueueCreateInfo queueCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
-        .queueFamilyIndex = computeQueueFamilyIndex,
-        .queueCount = 1,
-        .pQueuePriorities = &queuePriority,
+    // Batched images share one array image and one dispatch z dimension.
+    if (options.batchLayers > deviceProperties.limits.maxImageArrayLayers ||
+        options.batchLayers > deviceProperties.limits.maxComputeWorkGroupCount[2]) {
+        fprintf(stderr, "--batch %u exceeds maxImageArrayLayers = %u or maxComputeWorkGroupCount[2] = %u\n",
+                options.batchLayers, deviceProperties.limits.maxImageArrayLayers,
+                deviceProperties.limits.maxComputeWorkGroupCount[2]);
+        return EXIT_FAILURE;
+    }
+
+    // Create a logical device. --async-bench adds a compute queue, from a
+    // compute-only family when the device has one.
+    uint32_t asyncQueueFamilyIndex = computeQueueFamilyIndex;
+    uint32_t asyncQueueIndex = 0;
+    if (options.asyncBenchIterations > 0) {
+        asyncQueueFamilyIndex = deviceFindAsyncComputeQueue(physicalDevice, computeQueueFamilyIndex, &asyncQueueIndex);
+    }
+    float queuePriorities[2] = { 1.0f, 1.0f };
+    VkDeviceQueueCreateInfo queueCreateInfos[2] = {
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = computeQueueFamilyIndex,
+            .queueCount = asyncQueueIndex + 1,
+            .pQueuePriorities = queuePriorities,
+        },
+        {
+            .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+            .queueFamilyIndex = asyncQueueFamilyIndex,
+            .queueCount = 1,
+            .pQueuePriorities = queuePriorities,
+        },
     };
 
     // --- NEW: Enable the frame boundary extension ---
-    const char* deviceExtensions[] = {
+    const char* deviceExtensions[4] = {
         VK_EXT_FRAME_BOUNDARY_EXTENSION_NAME
     };
+    uint32_t deviceExtensionCount = 1;
+
+    // Heap budgets and usage for memory_budget.h, when the device reports them.
+    int hasMemoryBudget = deviceHasExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (hasMemoryBudget) {
+        deviceExtensions[deviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+
+    // Enable the optional shader features the kernels can use, but only those
+    // the device reports. Vulkan 1.2 feature structs need a 1.2 device.
+    VkPhysicalDeviceVulkan11Features supportedFeatures11 = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_11_FEATURES };
+    VkPhysicalDeviceVulkan12Features supportedFeatures12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+        .pNext = &supportedFeatures11,
+    };
+    VkPhysicalDeviceFeatures2 supportedFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+    int hasVulkan12 = deviceProperties.apiVersion >= VK_API_VERSION_1_2;
+    if (hasVulkan12) {
+        supportedFeatures.pNext = &supportedFeatures12;
+    }
+    // Subgroup size control lets --cpu-check pin the size the emulator assumes.
+    VkPhysicalDeviceSubgroupSizeControlFeatures supportedSizeControl = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES,
+    };
+    if (hasSizeControl) {
+        supportedSizeControl.pNext = supportedFeatures.pNext;
+        supportedFeatures.pNext = &supportedSizeControl;
+        if (deviceProperties.apiVersion < VK_API_VERSION_1_3) {
+            deviceExtensions[deviceExtensionCount++] = VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME;
+        }
+    }
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+    // --stats: pipeline statistics, plus hardware counters where the driver
+    // exposes VK_KHR_performance_query.
+    GpuCounterSupport counterSupport;
+    gpuCountersQuerySupport(&counterSupport, physicalDevice, &supportedFeatures.features,
+                            hasVulkan12 ? supportedFeatures12.hostQueryReset : VK_FALSE);
+    int counting = options.statsIterations > 0;
+    if (counting && counterSupport.performanceQuery) {
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME;
+    }
+
+    VkPhysicalDeviceVulkan11Features enabledFeatures11 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_11_FEATURES,
+        .storageBuffer16BitAccess = supportedFeatures11.storageBuffer16BitAccess,
+    };
+    VkPhysicalDeviceVulkan12Features enabledFeatures12 = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES,
+        .pNext = &enabledFeatures11,
+        .storageBuffer8BitAccess = supportedFeatures12.storageBuffer8BitAccess,
+        .shaderInt8 = supportedFeatures12.shaderInt8,
+        .shaderFloat16 = supportedFeatures12.shaderFloat16,
+        .shaderSubgroupExtendedTypes = supportedFeatures12.shaderSubgroupExtendedTypes,
+        .timelineSemaphore = supportedFeatures12.timelineSemaphore,
+        .hostQueryReset = counting && counterSupport.performanceQuery,
+    };
+    VkPhysicalDeviceFeatures2 enabledFeatures = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = hasVulkan12 ? &enabledFeatures12 : NULL,
+        .features = {
+            .shaderInt16 = supportedFeatures.features.shaderInt16,
+            .shaderInt64 = supportedFeatures.features.shaderInt64,
+            .fragmentStoresAndAtomics = supportedFeatures.features.fragmentStoresAndAtomics,
+            .pipelineStatisticsQuery = counting && counterSupport.pipelineStatistics,
+        },
+    };
+    if (counting) {
+        gpuCountersEnableFeatures(&counterSupport, &enabledFeatures);
+    }
+    VkPhysicalDeviceSubgroupSizeControlFeatures enabledSizeControl = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_FEATURES,
+        .subgroupSizeControl = supportedSizeControl.subgroupSizeControl,
+        .computeFullSubgroups = supportedSizeControl.computeFullSubgroups,
+    };
+    if (hasSizeControl) {
+        enabledSizeControl.pNext = enabledFeatures.pNext;
+        enabledFeatures.pNext = &enabledSizeControl;
+    }
 
     VkDeviceCreateInfo deviceCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
-        .pQueueCreateInfos = &queueCreateInfo,
-        .queueCreateInfoCount = 1,
-        .enabledExtensionCount = 1,
+        .pNext = &enabledFeatures,
+        .pQueueCreateInfos = queueCreateInfos,
+        .queueCreateInfoCount = asyncQueueFamilyIndex != computeQueueFamilyIndex ? 2 : 1,
+        .enabledExtensionCount = deviceExtensionCount,
         .ppEnabledExtensionNames = deviceExtensions,
     };
     VkDevice device;
-    VK_CHECK(vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device));
+    VK_CHECK(vkCreateDevice(physicalDevice, &deviceCreateInfo, hostCallbacks, &device));
 
     // Load device level functions
     #define DEVICE_LEVEL_VULKAN_FUNCTION( name ) \
@@ -223,11 +4294,25 @@ int main() {
             fprintf(stderr, "Could not load device-level Vulkan function %s\n", #name); \
             return EXIT_FAILURE; \
         }
+    // Optional functions stay NULL when the device doesn't provide them.
+    #define OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( name ) \
+        name = (PFN_##name)vkGetDeviceProcAddr(device, #name);
     #include "vulkan_functions.h"
 
+    memoryBudgetInit(physicalDevice, hasMemoryBudget);
+
+    // The bundle's pipeline cache, from the last run with the same modules.
+    char pipelineCachePath[1024];
+    if (shaderBundle.data != NULL) {
+        spirvBundleCachePath(&shaderBundle, options.bundlePath, pipelineCachePath, sizeof(pipelineCachePath));
+        pipelineCache = spirvBundleLoadPipelineCache(device, pipelineCachePath);
+    }
+
     // Get the compute queue.
     VkQueue computeQueue;
     vkGetDeviceQueue(device, computeQueueFamilyIndex, 0, &computeQueue);
+    VkQueue asyncQueue;
+    vkGetDeviceQueue(device, asyncQueueFamilyIndex, asyncQueueIndex, &asyncQueue);
 
     // --- 2. Create Storage Image and Buffer ---
 
@@ -235,16 +4320,17 @@ int main() {
         .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
         .imageType = VK_IMAGE_TYPE_2D,
         .format = VK_FORMAT_R8G8B8A8_UNORM, // RGBA 8-bit unsigned normalized
-        .extent = {IMAGE_WIDTH, IMAGE_HEIGHT, 1},
+        .extent = {options.width, options.height, 1},
         .mipLevels = 1,
         .arrayLayers = 1,
         .samples = VK_SAMPLE_COUNT_1_BIT,
         .tiling = VK_IMAGE_TILING_OPTIMAL,
-        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+        // TRANSFER_DST for the sentinel clear of the coverage checks.
+        .usage = VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
         .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
     };
     VkImage image;
-    VK_CHECK(vkCreateImage(device, &imageCreateInfo, NULL, &image));
+    VK_CHECK(vkCreateImage(device, &imageCreateInfo, hostCallbacks, &image));
 
     // Allocate memory for the image.
     VkMemoryRequirements memRequirements;
@@ -255,7 +4341,7 @@ int main() {
         .memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
     };
     VkDeviceMemory imageMemory;
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, NULL, &imageMemory));
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &imageMemory, "storage image"));
     VK_CHECK(vkBindImageMemory(device, image, imageMemory, 0));
 
     // Create an image view.
@@ -267,10 +4353,10 @@ int main() {
         .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
     };
     VkImageView imageView;
-    VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, NULL, &imageView));
+    VK_CHECK(vkCreateImageView(device, &imageViewCreateInfo, hostCallbacks, &imageView));
 
     // Create a buffer to copy the image data to for reading on the CPU.
-    VkDeviceSize bufferSize = IMAGE_WIDTH * IMAGE_HEIGHT * 4; // 4 bytes per pixel (RGBA)
+    VkDeviceSize bufferSize = (VkDeviceSize)options.width * options.height * 4; // 4 bytes per pixel (RGBA)
     VkBufferCreateInfo bufferCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
         .size = bufferSize,
@@ -278,14 +4364,14 @@ int main() {
         .sharingMode = VK_SHARING_MODE_EXCLUSIVE,
     };
     VkBuffer stagingBuffer;
-    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, NULL, &stagingBuffer));
+    VK_CHECK(vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &stagingBuffer));
 
     // Allocate memory for the staging buffer.
     vkGetBufferMemoryRequirements(device, stagingBuffer, &memRequirements);
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
     VkDeviceMemory stagingBufferMemory;
-    VK_CHECK(vkAllocateMemory(device, &allocInfo, NULL, &stagingBufferMemory));
+    VK_CHECK(memoryBudgetAllocate(device, &allocInfo, &stagingBufferMemory, "staging buffer"));
     VK_CHECK(vkBindBufferMemory(device, stagingBuffer, stagingBufferMemory, 0));
 
 
@@ -304,7 +4390,7 @@ int main() {
         .pBindings = &layoutBinding,
     };
     VkDescriptorSetLayout descriptorSetLayout;
-    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, NULL, &descriptorSetLayout));
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &descriptorSetLayout));
 
     // Create a descriptor pool.
     VkDescriptorPoolSize poolSize = {
@@ -318,7 +4404,7 @@ int main() {
         .maxSets = 1,
     };
     VkDescriptorPool descriptorPool;
-    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, NULL, &descriptorPool));
+    VK_CHECK(vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &descriptorPool));
 
     // Allocate the descriptor set.
     VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {
@@ -345,49 +4431,37 @@ int main() {
         .pImageInfo = &imageInfo,
     };
     vkUpdateDescriptorSets(device, 1, &writeDescriptorSet, 0, NULL);
-    
+
     // Create the compute pipeline.
-    size_t shaderCodeSize;
-    char* shaderCode = readFile("spv/shaderComputeSubgroupShuffle.comp.spv", &shaderCodeSize);
-    VkShaderModuleCreateInfo shaderModuleCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO,
-        .codeSize = shaderCodeSize,
-        .pCode = (const uint32_t*)shaderCode,
-    };
-    VkShaderModule computeShaderModule;
-    VK_CHECK(vkCreateShaderModule(device, &shaderModuleCreateInfo, NULL, &computeShaderModule));
-    free(shaderCode);
+    VkShaderModule computeShaderModule = loadShaderModule(device, options.shaderPath);
 
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_COMPUTE_BIT);
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO,
         .setLayoutCount = 1,
         .pSetLayouts = &descriptorSetLayout,
+        .pushConstantRangeCount = 1,
+        .pPushConstantRanges = &pushConstantRange,
     };
     VkPipelineLayout pipelineLayout;
-    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, NULL, &pipelineLayout));
+    VK_CHECK(vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &pipelineLayout));
 
-    VkComputePipelineCreateInfo pipelineCreateInfo = {
-        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
-        .stage = {
-            .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO,
-            .stage = VK_SHADER_STAGE_COMPUTE_BIT,
-            .module = computeShaderModule,
-            .pName = "main",
-        },
-        .layout = pipelineLayout,
-    };
-    VkPipeline pipeline;
-    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, NULL, &pipeline));
+    VkPipeline pipeline = createComputePipeline(device, pipelineLayout, computeShaderModule, &options.mapping);
+    if (options.hostAllocReport) {
+        printf("Startup (%s host allocator): %.2f ms from instance to pipeline\n",
+               hostAllocModeNames[options.hostAlloc], (getTimeSeconds() - startupStart) * 1000.0);
+    }
 
     // --- 4. Command Buffer Recording and Submission ---
 
     // Create a command pool and command buffer.
     VkCommandPoolCreateInfo cmdPoolCreateInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+        .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT,
         .queueFamilyIndex = computeQueueFamilyIndex,
     };
     VkCommandPool commandPool;
-    VK_CHECK(vkCreateCommandPool(device, &cmdPoolCreateInfo, NULL, &commandPool));
+    VK_CHECK(vkCreateCommandPool(device, &cmdPoolCreateInfo, hostCallbacks, &commandPool));
 
     VkCommandBufferAllocateInfo cmdBufAllocInfo = {
         .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
@@ -398,113 +4472,217 @@ int main() {
     VkCommandBuffer commandBuffer;
     VK_CHECK(vkAllocateCommandBuffers(device, &cmdBufAllocInfo, &commandBuffer));
 
-    // Record commands.
-    VkCommandBufferBeginInfo beginInfo = { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
-    VK_CHECK(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+    VkFenceCreateInfo fenceCreateInfo = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
+    VkFence fence;
+    VK_CHECK(vkCreateFence(device, &fenceCreateInfo, hostCallbacks, &fence));
 
-    // Transition image layout to general for shader writing.
-    VkImageMemoryBarrier barrier1 = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = 0,
-        .dstAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-        .newLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+    ComputeContext ctx = {
+        .physicalDevice = physicalDevice,
+        .device = device,
+        .queue = computeQueue,
+        .queueFamilyIndex = computeQueueFamilyIndex,
+        .asyncQueue = asyncQueue,
+        .asyncQueueFamilyIndex = asyncQueueFamilyIndex,
+        .timestampPeriod = deviceProperties.limits.timestampPeriod,
+        .timestampValidBits = timestampValidBits,
+        .commandPool = commandPool,
+        .commandBuffer = commandBuffer,
+        .fence = fence,
+        .pipelineLayout = pipelineLayout,
+        .descriptorSet = descriptorSet,
         .image = image,
-        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
+        .imageView = imageView,
+        .stagingBuffer = stagingBuffer,
+        .stagingBufferMemory = stagingBufferMemory,
+        .width = options.width,
+        .height = options.height,
+        .layers = 1,
+        .dispatch1D = options.dispatch1D,
+        .subgroupSize = subgroupSize,
+        .subgroupSizeControl = enabledSizeControl.subgroupSizeControl,
+        .computeFullSubgroups = enabledSizeControl.computeFullSubgroups,
+        .sizeControl = sizeControl,
+        .subgroupStages = subgroupSupportedStages,
+        .subgroupOperations = subgroupOperations,
+        .quadOperationsInAllStages = quadOperationsInAllStages,
+        .shufflePattern = options.shufflePattern,
+        .frameRate = (float)options.fps,
+        .shaderInt8 = enabledFeatures12.shaderInt8,
+        .shaderInt16 = enabledFeatures.features.shaderInt16,
+        .shaderInt64 = enabledFeatures.features.shaderInt64,
+        .shaderFloat16 = enabledFeatures12.shaderFloat16,
+        .subgroupExtendedTypes = enabledFeatures12.shaderSubgroupExtendedTypes,
+        .storageBuffer16BitAccess = enabledFeatures11.storageBuffer16BitAccess,
+        .storageBuffer8BitAccess = enabledFeatures12.storageBuffer8BitAccess,
+        .timelineSemaphore = enabledFeatures12.timelineSemaphore,
+        .fragmentStoresAndAtomics = enabledFeatures.features.fragmentStoresAndAtomics,
+        .pipelineStatisticsQuery = enabledFeatures.features.pipelineStatisticsQuery,
+        .performanceQuery = counting && counterSupport.performanceQuery,
     };
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier1);
 
-    // Bind pipeline and descriptor sets.
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    // Optional: compare the invocation mappings on the stencil kernel.
+    if (options.benchIterations > 0) {
+        benchmarkMappings(&ctx, &options);
+    }
 
-    // Dispatch the compute shader.
-    // We need to dispatch enough workgroups to cover the entire image.
-    // Workgroup size is 16x16, image is 256x256. So, 256/16 = 16 workgroups in each dimension.
-    vkCmdDispatch(commandBuffer, IMAGE_WIDTH / 16, IMAGE_HEIGHT / 16, 1);
+    // Optional: compare shuffle payload widths.
+    if (options.shuffleBenchIterations > 0) {
+        benchmarkShufflePayloads(&ctx, &options);
+    }
 
-    // Transition image layout for transfer source.
-    VkImageMemoryBarrier barrier2 = {
-        .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
-        .srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT,
-        .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT,
-        .oldLayout = VK_IMAGE_LAYOUT_GENERAL,
-        .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
-        .image = image,
-        .subresourceRange = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1},
-    };
-    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &barrier2);
+    // Optional: compare fp32 / fp16 / int8 kernels.
+    if (options.precisionBenchIterations > 0) {
+        benchmarkPrecisions(&ctx, &options);
+    }
 
-    // Copy image to staging buffer.
-    VkBufferImageCopy region = {
-        .bufferOffset = 0,
-        .bufferRowLength = 0,
-        .bufferImageHeight = 0,
-        .imageSubresource = {VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1},
-        .imageOffset = {0, 0, 0},
-        .imageExtent = {IMAGE_WIDTH, IMAGE_HEIGHT, 1},
-    };
-    vkCmdCopyImageToBuffer(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, stagingBuffer, 1, &region);
+    // Optional: per-frame cost of push-constant driven frames.
+    if (options.pushBenchFrames > 0) {
+        benchmarkPushConstants(&ctx, pipeline, options.pushBenchFrames);
+    }
 
-    VK_CHECK(vkEndCommandBuffer(commandBuffer));
+    // Optional: many images in one dispatch vs one image per submission.
+    if (options.batchLayers > 0) {
+        benchmarkBatch(&ctx, pipeline, &options);
+    }
 
-    // --- NEW: Define the frame boundary info ---
-    VkFrameBoundaryEXT frameBoundaryInfo = {
-        .sType = VK_STRUCTURE_TYPE_FRAME_BOUNDARY_EXT,
-        .pNext = NULL,
-        .flags = VK_FRAME_BOUNDARY_FRAME_END_BIT_EXT, // This single submission is the whole frame
-        .frameID = 1,
-        .imageCount = 1,
-        .pImages = &image,
-        .bufferCount = 0,
-        .pBuffers = NULL,
-        .tagName = 0,
-        .tagSize = 0,
-        .pTag = NULL,
-    };
-
-    // Submit to the queue and wait for completion.
-    VkSubmitInfo submitInfo = {
-        .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-        .pNext = &frameBoundaryInfo, // Chain the frame boundary info
-        .commandBufferCount = 1,
-        .pCommandBuffers = &commandBuffer,
-    };
+    // Optional: multi-stage jobs chained by a timeline semaphore vs host waits.
+    if (options.graphJobs > 0) {
+        benchmarkSubmitGraph(&ctx, pipeline, &options);
+    }
 
-    VkFenceCreateInfo fenceCreateInfo = { .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-    VkFence fence;
-    VK_CHECK(vkCreateFence(device, &fenceCreateInfo, NULL, &fence));
+    // Optional: record row dispatches on one thread vs many.
+    if (options.recordRounds > 0) {
+        benchmarkParallelRecording(&ctx, &options);
+    }
 
-    VK_CHECK(vkQueueSubmit(computeQueue, 1, &submitInfo, fence));
-    VK_CHECK(vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX));
+    // Optional: system vs tracking vs arena host allocations.
+    if (options.allocBenchFrames > 0) {
+        benchmarkHostAllocators(&ctx, computeShaderModule, &options);
+    }
 
-    // --- 5. Read Data and Cleanup ---
+    // Optional: the same image from a fragment shader and a compute kernel.
+    if (options.versusIterations > 0) {
+        benchmarkVersus(&ctx, &options);
+    }
 
-    // Map memory, read data, and save to file.
-    void* mappedMemory = NULL;
-    VK_CHECK(vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &mappedMemory));
-    saveImage("output.ppm", mappedMemory, IMAGE_WIDTH, IMAGE_HEIGHT);
-    vkUnmapMemory(device, stagingBufferMemory);
+    // Optional: where the kernel writes and how the host gets the bytes.
+    if (options.layoutBenchIterations > 0) {
+        benchmarkOutputLayouts(&ctx, &options);
+    }
+
+    // Optional: subgroup quad operations against the equivalent shuffles.
+    if (options.quadBenchIterations > 0) {
+        benchmarkQuadOps(&ctx, &options);
+    }
+
+    // Optional: packed and narrow fragment shuffles against the vec4 ones.
+    if (options.packedBenchIterations > 0) {
+        benchmarkPackedShuffles(&ctx, &options);
+    }
+
+    // Optional: persistent workgroups pulling tiles from an atomic counter.
+    if (options.queueBenchIterations > 0) {
+        benchmarkWorkQueue(&ctx, &options);
+    }
+
+    // Optional: shuffle patterns chosen by specialization constants.
+    if (options.patternSweepIterations > 0) {
+        benchmarkPatternSweep(&ctx, &options);
+    }
+
+    // Optional: a GPU-sized dispatch over the active tiles of a sparse workload.
+    if (options.indirectBenchIterations > 0) {
+        benchmarkIndirectDispatch(&ctx, &options);
+    }
+
+    // Optional: graphics and async compute queues overlapping.
+    if (options.asyncBenchIterations > 0) {
+        benchmarkAsyncCompute(&ctx, &options);
+    }
+
+    // Optional: pipeline statistics and performance counters per dispatch.
+    if (options.statsIterations > 0) {
+        benchmarkCounters(&ctx, pipeline, options.statsIterations);
+    }
+
+    int exitCode = EXIT_SUCCESS;
+
+    // Optional: check the kernel against the CPU subgroup emulator.
+    if (options.cpuCheck && !checkAgainstCpu(&ctx, &options)) {
+        exitCode = EXIT_FAILURE;
+    }
+
+    if (options.hashOutput || options.expectedHash) {
+        // Verify instead of writing the image.
+        if (!verifyOutput(&ctx, pipeline, &options)) {
+            exitCode = EXIT_FAILURE;
+        }
+    } else if (options.streamPath) {
+        // Stream frames instead of writing a single image.
+        streamFrames(&ctx, pipeline, &options);
+    } else {
+        // Record the image generation and readback.
+        recordComputeCommands(&ctx, pipeline, 1, VK_NULL_HANDLE, 0);
+
+        // --- NEW: Define the frame boundary info ---
+        VkFrameBoundaryEXT frameBoundaryInfo = {
+            .sType = VK_STRUCTURE_TYPE_FRAME_BOUNDARY_EXT,
+            .pNext = NULL,
+            .flags = VK_FRAME_BOUNDARY_FRAME_END_BIT_EXT, // This single submission is the whole frame
+            .frameID = 1,
+            .imageCount = 1,
+            .pImages = &image,
+            .bufferCount = 0,
+            .pBuffers = NULL,
+            .tagName = 0,
+            .tagSize = 0,
+            .pTag = NULL,
+        };
+
+        // Submit to the queue (chaining the frame boundary info) and wait for completion.
+        submitAndWait(&ctx, &frameBoundaryInfo);
+
+        // --- 5. Read Data and Cleanup ---
+
+        // Map memory, read data, and save to file.
+        void* mappedMemory = NULL;
+        VK_CHECK(vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &mappedMemory));
+        saveImage(options.outputPath, mappedMemory, options.width, options.height);
+        vkUnmapMemory(device, stagingBufferMemory);
+    }
 
     // Cleanup Vulkan objects.
-    vkDestroyFence(device, fence, NULL);
-    vkDestroyCommandPool(device, commandPool, NULL);
-    vkDestroyPipeline(device, pipeline, NULL);
-    vkDestroyPipelineLayout(device, pipelineLayout, NULL);
-    vkDestroyShaderModule(device, computeShaderModule, NULL);
-    vkDestroyDescriptorPool(device, descriptorPool, NULL);
-    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, NULL);
-    vkDestroyBuffer(device, stagingBuffer, NULL);
-    vkFreeMemory(device, stagingBufferMemory, NULL);
-    vkDestroyImageView(device, imageView, NULL);
-    vkDestroyImage(device, image, NULL);
-    vkFreeMemory(device, imageMemory, NULL);
-    vkDestroyDevice(device, NULL);
-    vkDestroyInstance(instance, NULL);
-
-    return EXIT_SUCCESS;
+    vkDestroyFence(device, fence, hostCallbacks);
+    vkDestroyCommandPool(device, commandPool, hostCallbacks);
+    vkDestroyPipeline(device, pipeline, hostCallbacks);
+    vkDestroyPipelineLayout(device, pipelineLayout, hostCallbacks);
+    vkDestroyShaderModule(device, computeShaderModule, hostCallbacks);
+    vkDestroyDescriptorPool(device, descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, descriptorSetLayout, hostCallbacks);
+    vkDestroyBuffer(device, stagingBuffer, hostCallbacks);
+    memoryBudgetFree(device, stagingBufferMemory);
+    vkDestroyImageView(device, imageView, hostCallbacks);
+    vkDestroyImage(device, image, hostCallbacks);
+    memoryBudgetFree(device, imageMemory);
+    if (pipelineCache != VK_NULL_HANDLE) {
+        spirvBundleSavePipelineCache(device, pipelineCache, pipelineCachePath);
+    }
+    vkDestroyDevice(device, hostCallbacks);
+    vkDestroyInstance(instance, hostCallbacks);
+    spirvBundleClose(&shaderBundle);
+
+    if (options.memoryLogPath) {
+        memoryBudgetReport(stderr);
+        if (!memoryBudgetWriteTimeline(options.memoryLogPath)) {
+            exitCode = EXIT_FAILURE;
+        }
+    }
+    memoryBudgetDestroy();
+
+    if (options.hostAllocReport) {
+        hostAllocatorReport(&hostAllocator);
+    }
+    hostAllocatorDestroy(&hostAllocator);
+
+    return exitCode;
 }
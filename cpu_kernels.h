@@ -0,0 +1,325 @@
+// cpu_kernels.h
+// C reference versions of the compute shaders, running on the subgroup
+// emulator in subgroup_emu.h. Each kernel walks the 16x16 workgroups of the
+// image, splits every workgroup into subgroups of consecutive
+// gl_LocalInvocationIndex values (the packing shaderComputeStencilShuffle.comp
+// assumes) and evaluates one subgroup at a time, so the rgba8 output matches
+// what the GPU writes for the same subgroup size, mapping and FrameParams.
+//
+// Float math follows the shaders in single precision and stores through the
+// rgba8 UNORM conversion (round to nearest). GLSL allows a few ULP of error
+// in division, sin and cos, so a driver may differ from the reference by one
+// step in those channels; shuffled and integer-derived values are exact.
+
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "subgroup_emu.h"
+#include "frame_params.h"
+#include "threading.h"
+
+#define CPU_KERNEL_WORKGROUP_DIM 16u
+#define CPU_KERNEL_INVOCATIONS (CPU_KERNEL_WORKGROUP_DIM * CPU_KERNEL_WORKGROUP_DIM)
+
+typedef enum {
+    CPU_KERNEL_GRADIENT, // shaderCompute.comp
+    CPU_KERNEL_SUBGROUP, // shaderComputeSubgroup.comp
+    CPU_KERNEL_SHUFFLE,  // shaderComputeSubgroupShuffle.comp
+    CPU_KERNEL_STENCIL,  // shaderComputeStencilShuffle.comp
+    CPU_KERNEL_COUNT,
+} CpuKernel;
+
+static const char* const cpuKernelNames[CPU_KERNEL_COUNT] = {"gradient", "subgroup", "shuffle", "stencil"};
+static const char* const cpuKernelShaders[CPU_KERNEL_COUNT] = {
+    "shaderCompute.comp.spv",
+    "shaderComputeSubgroup.comp.spv",
+    "shaderComputeSubgroupShuffle.comp.spv",
+    "shaderComputeStencilShuffle.comp.spv",
+};
+
+// Largest per-channel difference from the GPU that still counts as a match.
+#define CPU_KERNEL_TOLERANCE 1
+
+typedef struct {
+    uint32_t width; // Multiples of CPU_KERNEL_WORKGROUP_DIM.
+    uint32_t height;
+    uint32_t subgroupSize;
+    uint32_t mapping; // invocationMapping.glsl constants: 0 linear, 1 morton, 2 tiled.
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    FrameParams params;
+    uint8_t* rgba; // width * height * 4 bytes.
+} CpuKernelArgs;
+
+// Kernel whose SPIR-V file name ends `shaderPath`, or CPU_KERNEL_COUNT.
+static CpuKernel cpuKernelForShader(const char* shaderPath) {
+    size_t pathLength = strlen(shaderPath);
+    for (uint32_t k = 0; k < CPU_KERNEL_COUNT; k++) {
+        size_t length = strlen(cpuKernelShaders[k]);
+        if (pathLength >= length && strcmp(shaderPath + pathLength - length, cpuKernelShaders[k]) == 0 &&
+            (pathLength == length || shaderPath[pathLength - length - 1] == '/' ||
+             shaderPath[pathLength - length - 1] == '\\')) {
+            return (CpuKernel)k;
+        }
+    }
+    return CPU_KERNEL_COUNT;
+}
+
+static CpuKernel cpuKernelByName(const char* name) {
+    uint32_t k = 0;
+    while (k < CPU_KERNEL_COUNT && strcmp(name, cpuKernelNames[k]) != 0) k++;
+    return (CpuKernel)k;
+}
+
+static uint32_t cpuFloatBits(float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+static float cpuBitsFloat(uint32_t bits) {
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// imageStore() into an rgba8 image.
+static uint8_t cpuUnorm8(float value) {
+    if (!(value > 0.0f)) return 0;
+    if (value >= 1.0f) return 255;
+    return (uint8_t)(value * 255.0f + 0.5f);
+}
+
+static void cpuStorePixel(const CpuKernelArgs* args, uint32_t x, uint32_t y, float r, float g, float b) {
+    uint8_t* p = args->rgba + ((size_t)y * args->width + x) * 4;
+    p[0] = cpuUnorm8(r);
+    p[1] = cpuUnorm8(g);
+    p[2] = cpuUnorm8(b);
+    p[3] = 255;
+}
+
+// --- invocationMapping.glsl ---
+
+static uint32_t cpuCompactEvenBits(uint32_t v) {
+    v &= 0x55u;
+    v = (v | (v >> 1)) & 0x33u;
+    v = (v | (v >> 2)) & 0x0Fu;
+    return v;
+}
+
+static uint32_t cpuSpreadEvenBits(uint32_t v) {
+    v &= 0x0Fu;
+    v = (v | (v << 2)) & 0x33u;
+    v = (v | (v << 1)) & 0x55u;
+    return v;
+}
+
+static void cpuMapLocalIndex(const CpuKernelArgs* args, uint32_t index, uint32_t* x, uint32_t* y) {
+    if (args->mapping == 1) {
+        *x = cpuCompactEvenBits(index);
+        *y = cpuCompactEvenBits(index >> 1);
+    } else if (args->mapping == 2) {
+        uint32_t blockSize = args->tileWidth * args->tileHeight;
+        uint32_t blocksPerRow = CPU_KERNEL_WORKGROUP_DIM / args->tileWidth;
+        uint32_t block = index / blockSize;
+        uint32_t within = index % blockSize;
+        *x = (block % blocksPerRow) * args->tileWidth + within % args->tileWidth;
+        *y = (block / blocksPerRow) * args->tileHeight + within / args->tileWidth;
+    } else {
+        *x = index % CPU_KERNEL_WORKGROUP_DIM;
+        *y = index / CPU_KERNEL_WORKGROUP_DIM;
+    }
+}
+
+static uint32_t cpuUnmapLocalPos(const CpuKernelArgs* args, uint32_t x, uint32_t y) {
+    if (args->mapping == 1) {
+        return cpuSpreadEvenBits(x) | (cpuSpreadEvenBits(y) << 1);
+    } else if (args->mapping == 2) {
+        uint32_t blocksPerRow = CPU_KERNEL_WORKGROUP_DIM / args->tileWidth;
+        uint32_t block = (y / args->tileHeight) * blocksPerRow + x / args->tileWidth;
+        return block * args->tileWidth * args->tileHeight + (y % args->tileHeight) * args->tileWidth + x % args->tileWidth;
+    }
+    return y * CPU_KERNEL_WORKGROUP_DIM + x;
+}
+
+// --- frameParams.glsl ---
+
+static uint32_t cpuShuffleSource(const FrameParams* params, uint32_t lane, uint32_t size) {
+    if (params->shufflePattern == 1u) {
+        return (lane + params->frameIndex) % size;
+    }
+    if (params->shufflePattern == 2u) {
+        return lane ^ (params->frameIndex & (size - 1u));
+    }
+    return size - 1u - lane;
+}
+
+static float cpuFrameGradient(const FrameParams* params, float x, float y, float width, float height) {
+    float px = (x + params->offset[0]) * params->scale / width;
+    float py = (y + params->offset[1]) * params->scale / height;
+    float sum = px + py;
+    return sum - floorf(sum);
+}
+
+// --- Kernels: one workgroup at a time, one subgroup at a time ---
+
+static float cpuStencilSignal(int32_t x, int32_t y) {
+    return 0.5f + 0.5f * sinf((float)x * 0.21f) * cosf((float)y * 0.17f);
+}
+
+static void cpuRunWorkgroup(CpuKernel kernel, const CpuKernelArgs* args, uint32_t originX, uint32_t originY) {
+    uint32_t size = args->subgroupSize;
+    float blue = (float)size / 64.0f;
+
+    for (uint32_t first = 0; first < CPU_KERNEL_INVOCATIONS; first += size) {
+        uint32_t posX[SUBGROUP_EMU_MAX_SIZE], posY[SUBGROUP_EMU_MAX_SIZE];
+        for (uint32_t lane = 0; lane < size; lane++) {
+            uint32_t index = first + lane;
+            if (kernel == CPU_KERNEL_GRADIENT) {
+                // shaderCompute.comp uses gl_GlobalInvocationID directly.
+                posX[lane] = index % CPU_KERNEL_WORKGROUP_DIM;
+                posY[lane] = index / CPU_KERNEL_WORKGROUP_DIM;
+            } else {
+                cpuMapLocalIndex(args, index, &posX[lane], &posY[lane]);
+            }
+        }
+
+        if (kernel == CPU_KERNEL_GRADIENT) {
+            for (uint32_t lane = 0; lane < size; lane++) {
+                uint32_t x = originX + posX[lane], y = originY + posY[lane];
+                cpuStorePixel(args, x, y, (float)x / (float)(args->width - 1), (float)y / (float)(args->height - 1), 0.25f);
+            }
+        } else if (kernel == CPU_KERNEL_SUBGROUP) {
+            for (uint32_t lane = 0; lane < size; lane++) {
+                cpuStorePixel(args, originX + posX[lane], originY + posY[lane], (float)lane / (float)(size - 1), 0.0f, blue);
+            }
+        } else if (kernel == CPU_KERNEL_SHUFFLE) {
+            uint32_t red[SUBGROUP_EMU_MAX_SIZE], ids[SUBGROUP_EMU_MAX_SIZE], shuffled[SUBGROUP_EMU_MAX_SIZE];
+            for (uint32_t lane = 0; lane < size; lane++) {
+                red[lane] = cpuFloatBits((float)lane / (float)(size - 1));
+                ids[lane] = cpuShuffleSource(&args->params, lane, size);
+            }
+            subgroupEmuShuffle(red, ids, shuffled, size);
+            for (uint32_t lane = 0; lane < size; lane++) {
+                uint32_t x = originX + posX[lane], y = originY + posY[lane];
+                float green = cpuFrameGradient(&args->params, (float)x, (float)y, (float)args->width, (float)args->height);
+                cpuStorePixel(args, x, y, cpuBitsFloat(shuffled[lane]), green, blue);
+            }
+        } else {
+            static const int32_t offsets[4][2] = {{-1, 0}, {1, 0}, {0, -1}, {0, 1}};
+            uint32_t center[SUBGROUP_EMU_MAX_SIZE], ids[SUBGROUP_EMU_MAX_SIZE], shuffled[SUBGROUP_EMU_MAX_SIZE];
+            uint32_t hits[SUBGROUP_EMU_MAX_SIZE] = {0};
+            float sum[SUBGROUP_EMU_MAX_SIZE];
+            for (uint32_t lane = 0; lane < size; lane++) {
+                float value = cpuStencilSignal((int32_t)(originX + posX[lane]), (int32_t)(originY + posY[lane]));
+                center[lane] = cpuFloatBits(value);
+                sum[lane] = 4.0f * value;
+            }
+            // fetchNeighbour(): shuffle from the owning lane, else recompute.
+            for (int n = 0; n < 4; n++) {
+                int inSubgroup[SUBGROUP_EMU_MAX_SIZE];
+                for (uint32_t lane = 0; lane < size; lane++) {
+                    int32_t nx = (int32_t)posX[lane] + offsets[n][0];
+                    int32_t ny = (int32_t)posY[lane] + offsets[n][1];
+                    int inTile = nx >= 0 && ny >= 0 && nx < (int32_t)CPU_KERNEL_WORKGROUP_DIM && ny < (int32_t)CPU_KERNEL_WORKGROUP_DIM;
+                    uint32_t cx = nx < 0 ? 0 : (nx > 15 ? 15 : (uint32_t)nx);
+                    uint32_t cy = ny < 0 ? 0 : (ny > 15 ? 15 : (uint32_t)ny);
+                    uint32_t owner = cpuUnmapLocalPos(args, cx, cy) - first;
+                    ids[lane] = owner < size ? owner : size - 1;
+                    inSubgroup[lane] = inTile && owner < size;
+                }
+                subgroupEmuShuffle(center, ids, shuffled, size);
+                for (uint32_t lane = 0; lane < size; lane++) {
+                    if (inSubgroup[lane]) {
+                        hits[lane]++;
+                        sum[lane] += cpuBitsFloat(shuffled[lane]);
+                    } else {
+                        sum[lane] += cpuStencilSignal((int32_t)(originX + posX[lane]) + offsets[n][0],
+                                                      (int32_t)(originY + posY[lane]) + offsets[n][1]);
+                    }
+                }
+            }
+            for (uint32_t lane = 0; lane < size; lane++) {
+                cpuStorePixel(args, originX + posX[lane], originY + posY[lane], sum[lane] / 8.0f,
+                              (float)hits[lane] / 4.0f, blue);
+            }
+        }
+    }
+}
+
+typedef struct {
+    CpuKernel kernel;
+    const CpuKernelArgs* args;
+    uint32_t firstRow; // Workgroup rows [firstRow, endRow).
+    uint32_t endRow;
+} CpuKernelSlice;
+
+static void* cpuKernelSliceMain(void* argument) {
+    const CpuKernelSlice* slice = (const CpuKernelSlice*)argument;
+    uint32_t groupsX = slice->args->width / CPU_KERNEL_WORKGROUP_DIM;
+    for (uint32_t gy = slice->firstRow; gy < slice->endRow; gy++) {
+        for (uint32_t gx = 0; gx < groupsX; gx++) {
+            cpuRunWorkgroup(slice->kernel, slice->args, gx * CPU_KERNEL_WORKGROUP_DIM, gy * CPU_KERNEL_WORKGROUP_DIM);
+        }
+    }
+    return NULL;
+}
+
+// Renders `kernel` into args->rgba, splitting workgroup rows over `threads`
+// threads (the calling thread takes the first slice). Returns 0 if the
+// subgroup size is outside what the emulator supports.
+static int cpuKernelRun(CpuKernel kernel, const CpuKernelArgs* args, uint32_t threads) {
+    if (!subgroupEmuSizeSupported(args->subgroupSize) || kernel >= CPU_KERNEL_COUNT) {
+        return 0;
+    }
+    uint32_t rows = args->height / CPU_KERNEL_WORKGROUP_DIM;
+    if (threads < 1) threads = 1;
+    if (threads > rows) threads = rows > 0 ? rows : 1;
+
+    CpuKernelSlice* slices = (CpuKernelSlice*)malloc(threads * sizeof(CpuKernelSlice));
+    Thread* workers = (Thread*)malloc(threads * sizeof(Thread));
+    int* started = (int*)calloc(threads, sizeof(int));
+    for (uint32_t t = 0; t < threads; t++) {
+        slices[t].kernel = kernel;
+        slices[t].args = args;
+        slices[t].firstRow = rows * t / threads;
+        slices[t].endRow = rows * (t + 1) / threads;
+    }
+    for (uint32_t t = 1; t < threads; t++) {
+        started[t] = threadCreate(&workers[t], cpuKernelSliceMain, &slices[t]);
+        if (!started[t]) cpuKernelSliceMain(&slices[t]);
+    }
+    cpuKernelSliceMain(&slices[0]);
+    for (uint32_t t = 1; t < threads; t++) {
+        if (started[t]) threadJoin(workers[t]);
+    }
+    free(started);
+    free(workers);
+    free(slices);
+    return 1;
+}
+
+// Compares two rgba8 images. Returns the number of pixels that differ at all
+// and stores the largest per-channel difference.
+static uint64_t cpuCompareImages(const uint8_t* expected, const uint8_t* actual, uint32_t width, uint32_t height,
+                                 int* maxDifference) {
+    uint64_t mismatches = 0;
+    *maxDifference = 0;
+    for (uint64_t i = 0; i < (uint64_t)width * height; i++) {
+        int differs = 0;
+        for (int c = 0; c < 4; c++) {
+            int difference = abs((int)expected[i * 4 + c] - (int)actual[i * 4 + c]);
+            if (difference > *maxDifference) *maxDifference = difference;
+            differs |= difference != 0;
+        }
+        mismatches += differs;
+    }
+    return mismatches;
+}
+
+#endif // CPU_KERNELS_H
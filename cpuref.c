@@ -0,0 +1,195 @@
+// cpuref.c
+// Runs the compute kernels on the CPU subgroup emulator, without Vulkan. It
+// writes the same image the GPU would for a given subgroup size, prints its
+// hash (compare with `compute --verify`) and reports throughput as a CPU
+// baseline for the GPU and lavapipe numbers.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "timing.h"
+#include "frame_params.h"
+#include "image_hash.h"
+#include "cpu_kernels.h"
+
+// Command line options.
+typedef struct {
+    CpuKernel kernel;
+    const char* outputPath;
+    uint32_t width;
+    uint32_t height;
+    uint32_t subgroupSize;
+    uint32_t mapping;
+    uint32_t tileWidth;
+    uint32_t tileHeight;
+    uint32_t shufflePattern;
+    uint32_t frame;
+    uint32_t threads;
+    uint32_t iterations;
+} CpuRefOptions;
+
+static const char* const cpuMappingNames[] = { "linear", "morton", "tiled" };
+
+void printUsage(const char* program) {
+    fprintf(stderr,
+            "Usage: %s [options]\n"
+            "  --kernel <name>        gradient, subgroup, shuffle, stencil (default shuffle)\n"
+            "  --output <file.ppm>    output image (default cpuref.ppm)\n"
+            "  --size <W>x<H>         image size, multiples of %u (default 256x256)\n"
+            "  --subgroup <N>         emulated subgroup size, power of two %d..%d (default 32)\n"
+            "  --mapping <name>       invocation mapping: linear, morton, tiled (default linear)\n"
+            "  --tile <N>x<M>         sub-tile shape for the tiled mapping (default 8x4)\n"
+            "  --pattern <name>       shuffle pattern: reverse, rotate, xor (default reverse)\n"
+            "  --frame <N>            frame index for the per-frame parameters (default 0)\n"
+            "  --threads <N>          worker threads (default: all hardware threads)\n"
+            "  --iterations <N>       timed runs after one warm-up (default 10)\n",
+            program, CPU_KERNEL_WORKGROUP_DIM, SUBGROUP_EMU_MIN_SIZE, SUBGROUP_EMU_MAX_SIZE);
+}
+
+// Parses "<a>x<b>" into two non-zero integers.
+int parseDimensions(const char* text, uint32_t* a, uint32_t* b) {
+    return sscanf(text, "%ux%u", a, b) == 2 && *a > 0 && *b > 0;
+}
+
+// Fills `options` from argv. Returns 0 on invalid input.
+int parseOptions(int argc, char** argv, CpuRefOptions* options) {
+    *options = (CpuRefOptions){
+        .kernel = CPU_KERNEL_SHUFFLE,
+        .outputPath = "cpuref.ppm",
+        .width = 256,
+        .height = 256,
+        .subgroupSize = 32,
+        .tileWidth = 8,
+        .tileHeight = 4,
+        .threads = hardwareThreadCount(),
+        .iterations = 10,
+    };
+
+    for (int i = 1; i < argc; i++) {
+        const char* arg = argv[i];
+        const char* value = (i + 1 < argc) ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0) {
+            return 0;
+        }
+        if (!value) {
+            fprintf(stderr, "Missing value for %s\n", arg);
+            return 0;
+        }
+        i++;
+
+        if (strcmp(arg, "--kernel") == 0) {
+            options->kernel = cpuKernelByName(value);
+            if (options->kernel == CPU_KERNEL_COUNT) {
+                fprintf(stderr, "Unknown kernel: %s\n", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--output") == 0) {
+            options->outputPath = value;
+        } else if (strcmp(arg, "--size") == 0) {
+            if (!parseDimensions(value, &options->width, &options->height) ||
+                options->width % CPU_KERNEL_WORKGROUP_DIM != 0 || options->height % CPU_KERNEL_WORKGROUP_DIM != 0) {
+                fprintf(stderr, "Invalid --size %s (must be multiples of %u)\n", value, CPU_KERNEL_WORKGROUP_DIM);
+                return 0;
+            }
+        } else if (strcmp(arg, "--subgroup") == 0) {
+            options->subgroupSize = (uint32_t)strtoul(value, NULL, 10);
+            if (!subgroupEmuSizeSupported(options->subgroupSize)) {
+                fprintf(stderr, "Invalid --subgroup %s\n", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--mapping") == 0) {
+            uint32_t m = 0;
+            while (m < 3 && strcmp(value, cpuMappingNames[m]) != 0) m++;
+            if (m == 3) {
+                fprintf(stderr, "Unknown mapping: %s\n", value);
+                return 0;
+            }
+            options->mapping = m;
+        } else if (strcmp(arg, "--tile") == 0) {
+            uint32_t tw, th;
+            if (!parseDimensions(value, &tw, &th) || CPU_KERNEL_WORKGROUP_DIM % tw != 0 || CPU_KERNEL_WORKGROUP_DIM % th != 0) {
+                fprintf(stderr, "Invalid --tile %s (both sides must divide %u)\n", value, CPU_KERNEL_WORKGROUP_DIM);
+                return 0;
+            }
+            options->tileWidth = tw;
+            options->tileHeight = th;
+        } else if (strcmp(arg, "--pattern") == 0) {
+            options->shufflePattern = parseShufflePattern(value);
+            if (options->shufflePattern == SHUFFLE_PATTERN_COUNT) {
+                fprintf(stderr, "Unknown pattern: %s\n", value);
+                return 0;
+            }
+        } else if (strcmp(arg, "--frame") == 0) {
+            options->frame = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options->threads = (uint32_t)strtoul(value, NULL, 10);
+        } else if (strcmp(arg, "--iterations") == 0) {
+            options->iterations = (uint32_t)strtoul(value, NULL, 10);
+        } else {
+            fprintf(stderr, "Unknown option: %s\n", arg);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+void saveImage(const char* filename, const uint8_t* pixels, uint32_t width, uint32_t height) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        fprintf(stderr, "Failed to open file for writing: %s\n", filename);
+        return;
+    }
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    for (uint32_t i = 0; i < width * height; ++i) {
+        fwrite(pixels + (size_t)i * 4, 3, 1, file);
+    }
+    fclose(file);
+    printf("Image saved to %s\n", filename);
+}
+
+int main(int argc, char** argv) {
+    CpuRefOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint8_t* pixels = (uint8_t*)malloc((size_t)options.width * options.height * 4);
+    CpuKernelArgs args = {
+        .width = options.width,
+        .height = options.height,
+        .subgroupSize = options.subgroupSize,
+        .mapping = options.mapping,
+        .tileWidth = options.tileWidth,
+        .tileHeight = options.tileHeight,
+        .params = frameParamsAt(options.frame, options.shufflePattern, 60.0f),
+        .rgba = pixels,
+    };
+
+    // Warm-up (first touch of the output), then the timed runs.
+    cpuKernelRun(options.kernel, &args, options.threads);
+    double start = getTimeSeconds();
+    for (uint32_t i = 0; i < options.iterations; i++) {
+        cpuKernelRun(options.kernel, &args, options.threads);
+    }
+    double seconds = getTimeSeconds() - start;
+
+    uint32_t words[IMAGE_HASH_WORDS];
+    char hex[IMAGE_HASH_HEX_LENGTH + 1];
+    imageHashCpu(pixels, options.width, options.height, words);
+    imageHashToHex(words, hex);
+
+    printf("Kernel %s, %ux%u, subgroup size %u, %s lanes, %u threads\n", cpuKernelNames[options.kernel],
+           options.width, options.height, options.subgroupSize, SUBGROUP_EMU_ISA, options.threads);
+    if (options.iterations > 0) {
+        double ms = seconds * 1000.0 / options.iterations;
+        printf("CPU: %.3f ms/image, %.1f Mpix/s\n", ms, (double)options.width * options.height / (ms * 1000.0));
+    }
+    printf("Hash: %s\n", hex);
+    saveImage(options.outputPath, pixels, options.width, options.height);
+
+    free(pixels);
+    return EXIT_SUCCESS;
+}
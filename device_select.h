@@ -0,0 +1,384 @@
+// device_select.h
+// Physical device selection for both programs. Every device is scored by
+// type, device-local memory and the subgroup features the shaders use; the
+// best one wins unless an override (--device or the SUBGROUP_DEVICE
+// environment variable) names a device by index, name or UUID. Also writes a
+// JSON capability report; with "-" it claims stdout (see stdout_claim.h), so
+// the selection messages go to stderr. Include after vulkan_functions.h.
+
+#ifndef DEVICE_SELECT_H
+#define DEVICE_SELECT_H
+
+#include <ctype.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stdout_claim.h"
+
+// Environment variable consulted when no --device option is given.
+#define DEVICE_SELECT_ENV "SUBGROUP_DEVICE"
+
+typedef struct {
+    VkPhysicalDevice physicalDevice;
+    uint32_t index; // Position in vkEnumeratePhysicalDevices.
+    VkPhysicalDeviceProperties properties;
+    VkPhysicalDeviceSubgroupProperties subgroup;
+    VkPhysicalDeviceSubgroupSizeControlProperties sizeControl;
+    int hasSizeControl;
+    uint8_t deviceUUID[VK_UUID_SIZE];
+    int hasUUID;
+    VkDeviceSize deviceLocalBytes; // Sum of the device-local heaps.
+    // First queue family with the required flags, UINT32_MAX if none.
+    uint32_t queueFamilyIndex;
+    uint32_t timestampValidBits;
+    int64_t score; // Negative when the device cannot run the program.
+} DeviceInfo;
+
+static const char* deviceTypeName(VkPhysicalDeviceType type) {
+    switch (type) {
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return "integrated";
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return "discrete";
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return "virtual";
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: return "cpu";
+    default: return "other";
+    }
+}
+
+static int deviceHasExtension(VkPhysicalDevice physicalDevice, const char* name) {
+    uint32_t count = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &count, NULL);
+    VkExtensionProperties* extensions = (VkExtensionProperties*)malloc(count * sizeof(VkExtensionProperties));
+    vkEnumerateDeviceExtensionProperties(physicalDevice, NULL, &count, extensions);
+    int found = 0;
+    for (uint32_t i = 0; i < count && !found; i++) {
+        found = strcmp(extensions[i].extensionName, name) == 0;
+    }
+    free(extensions);
+    return found;
+}
+
+// Ranks a device. The type dominates (discrete > integrated > virtual > cpu),
+// then subgroup shuffles in `stage`, which every shuffle kernel needs, then
+// the other subgroup operations, device-local memory and timestamps. A type
+// step (1,000,000) outweighs all other terms together (at most 57,524), and
+// the shuffle bonus outweighs everything after it (at most 7,524). A device
+// without a queue family that has `requiredQueueFlags` scores -1.
+static int64_t deviceScore(const DeviceInfo* info, VkShaderStageFlags stage) {
+    if (info->queueFamilyIndex == UINT32_MAX) {
+        return -1;
+    }
+    int64_t score = 0;
+    switch (info->properties.deviceType) {
+    case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: score += 4000000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: score += 3000000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: score += 2000000; break;
+    case VK_PHYSICAL_DEVICE_TYPE_CPU: score += 1000000; break;
+    default: break;
+    }
+    int stageSupported = (info->subgroup.supportedStages & stage) == stage;
+    if (stageSupported && (info->subgroup.supportedOperations & VK_SUBGROUP_FEATURE_SHUFFLE_BIT)) {
+        score += 50000;
+    }
+    for (uint32_t bit = 0; bit < 32; bit++) {
+        if (stageSupported && (info->subgroup.supportedOperations & (1u << bit))) score += 200;
+    }
+    // One point per 64 MiB of device-local memory, capped at 64 GiB.
+    VkDeviceSize megabytes = info->deviceLocalBytes >> 20;
+    score += (int64_t)(megabytes < 65536 ? megabytes : 65536) / 64;
+    if (info->timestampValidBits > 0) score += 100;
+    return score;
+}
+
+// Fills `info` for one device. Subgroup and ID properties need Vulkan 1.1,
+// the size-control range Vulkan 1.3 or VK_EXT_subgroup_size_control.
+static void deviceQuery(VkPhysicalDevice physicalDevice, uint32_t index, VkQueueFlags requiredQueueFlags,
+                        VkShaderStageFlags stage, DeviceInfo* info) {
+    memset(info, 0, sizeof(*info));
+    info->physicalDevice = physicalDevice;
+    info->index = index;
+    vkGetPhysicalDeviceProperties(physicalDevice, &info->properties);
+
+    uint32_t apiVersion = info->properties.apiVersion;
+    info->subgroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceIDProperties idProperties = {0};
+    idProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES;
+    idProperties.pNext = &info->subgroup;
+    info->sizeControl.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_SIZE_CONTROL_PROPERTIES;
+    info->hasSizeControl = apiVersion >= VK_API_VERSION_1_3 ||
+                           deviceHasExtension(physicalDevice, VK_EXT_SUBGROUP_SIZE_CONTROL_EXTENSION_NAME);
+    if (info->hasSizeControl) {
+        info->subgroup.pNext = &info->sizeControl;
+    }
+    if (apiVersion >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceProperties2 properties2 = {0};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &idProperties;
+        vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+        memcpy(info->deviceUUID, idProperties.deviceUUID, VK_UUID_SIZE);
+        info->hasUUID = 1;
+    } else {
+        info->hasSizeControl = 0;
+    }
+    info->subgroup.pNext = NULL;
+    info->sizeControl.pNext = NULL;
+
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+        if (memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            info->deviceLocalBytes += memoryProperties.memoryHeaps[i].size;
+        }
+    }
+
+    info->queueFamilyIndex = UINT32_MAX;
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties* queueFamilies = (VkQueueFamilyProperties*)malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies);
+    for (uint32_t j = 0; j < queueFamilyCount; j++) {
+        if ((queueFamilies[j].queueFlags & requiredQueueFlags) == requiredQueueFlags) {
+            info->queueFamilyIndex = j;
+            info->timestampValidBits = queueFamilies[j].timestampValidBits;
+            break;
+        }
+    }
+    free(queueFamilies);
+
+    info->score = deviceScore(info, stage);
+}
+
+// Picks a queue for async compute next to `primaryFamily`: a family with
+// compute but no graphics if the device has one, else a second queue of
+// `primaryFamily`, else the primary queue itself (family `primaryFamily`,
+// index 0). Returns the family and sets `queueIndex`.
+static uint32_t deviceFindAsyncComputeQueue(VkPhysicalDevice physicalDevice, uint32_t primaryFamily, uint32_t* queueIndex) {
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, NULL);
+    VkQueueFamilyProperties* queueFamilies = (VkQueueFamilyProperties*)malloc(queueFamilyCount * sizeof(VkQueueFamilyProperties));
+    vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilies);
+    uint32_t family = primaryFamily;
+    *queueIndex = 0;
+    for (uint32_t j = 0; j < queueFamilyCount; j++) {
+        if (j != primaryFamily && (queueFamilies[j].queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+            !(queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT)) {
+            family = j;
+            break;
+        }
+    }
+    if (family == primaryFamily && queueFamilies[primaryFamily].queueCount > 1) {
+        *queueIndex = 1;
+    }
+    free(queueFamilies);
+    return family;
+}
+
+static void deviceFormatUUID(const uint8_t* uuid, char* text) {
+    for (int i = 0; i < VK_UUID_SIZE; i++) {
+        sprintf(text + i * 2, "%02x", uuid[i]);
+    }
+}
+
+// Does `selector` name this device? All digits: the enumeration index.
+// 32 hex digits (dashes ignored): the device UUID. Otherwise a
+// case-insensitive substring of the device name.
+static int deviceMatches(const DeviceInfo* info, const char* selector) {
+    size_t length = strlen(selector);
+    size_t digits = strspn(selector, "0123456789");
+    if (length > 0 && digits == length) {
+        return strtoul(selector, NULL, 10) == info->index;
+    }
+
+    char hex[VK_UUID_SIZE * 2 + 1];
+    size_t hexLength = 0;
+    int isUUID = 1;
+    for (const char* c = selector; *c && isUUID; c++) {
+        if (*c == '-') continue;
+        if (!isxdigit((unsigned char)*c) || hexLength == VK_UUID_SIZE * 2) {
+            isUUID = 0;
+        } else {
+            hex[hexLength++] = (char)tolower((unsigned char)*c);
+        }
+    }
+    if (isUUID && hexLength == VK_UUID_SIZE * 2) {
+        char uuid[VK_UUID_SIZE * 2 + 1];
+        hex[hexLength] = '\0';
+        deviceFormatUUID(info->deviceUUID, uuid);
+        return info->hasUUID && strcmp(hex, uuid) == 0;
+    }
+
+    const char* name = info->properties.deviceName;
+    for (size_t start = 0; name[start]; start++) {
+        size_t i = 0;
+        while (i < length && name[start + i] &&
+               tolower((unsigned char)name[start + i]) == tolower((unsigned char)selector[i])) {
+            i++;
+        }
+        if (i == length) return 1;
+    }
+    return 0;
+}
+
+// Queries every device into a malloc'd array (free with free()).
+static DeviceInfo* deviceQueryAll(VkInstance instance, VkQueueFlags requiredQueueFlags, VkShaderStageFlags stage,
+                                  uint32_t* count) {
+    *count = 0;
+    vkEnumeratePhysicalDevices(instance, count, NULL);
+    VkPhysicalDevice* physicalDevices = (VkPhysicalDevice*)malloc(*count * sizeof(VkPhysicalDevice));
+    vkEnumeratePhysicalDevices(instance, count, physicalDevices);
+    DeviceInfo* infos = (DeviceInfo*)calloc(*count ? *count : 1, sizeof(DeviceInfo));
+    for (uint32_t i = 0; i < *count; i++) {
+        deviceQuery(physicalDevices[i], i, requiredQueueFlags, stage, &infos[i]);
+    }
+    free(physicalDevices);
+    return infos;
+}
+
+// Picks a device from `infos`: the first one matching `selector` (falling back
+// to $SUBGROUP_DEVICE when NULL), else the highest score. Prints the
+// candidates. Returns the index into `infos`, or -1 if nothing usable matched.
+static int deviceSelect(const DeviceInfo* infos, uint32_t count, const char* selector) {
+    if (selector == NULL) {
+        selector = getenv(DEVICE_SELECT_ENV);
+        if (selector != NULL && selector[0] == '\0') selector = NULL;
+    }
+
+    int best = -1;
+    for (uint32_t i = 0; i < count; i++) {
+        const DeviceInfo* info = &infos[i];
+        printf("Device %u: %s (%s), score %lld\n", info->index, info->properties.deviceName,
+               deviceTypeName(info->properties.deviceType), (long long)info->score);
+        if (info->score < 0) continue;
+        if (selector != NULL) {
+            if (best < 0 && deviceMatches(info, selector)) best = (int)i;
+        } else if (best < 0 || info->score > infos[best].score) {
+            best = (int)i;
+        }
+    }
+    if (selector != NULL && best < 0) {
+        fprintf(stderr, "No usable device matches \"%s\".\n", selector);
+    }
+    return best;
+}
+
+// Prints the subgroup capabilities of the selected device.
+static void deviceReportSubgroup(const DeviceInfo* info) {
+    printf("Using device %u: %s\n", info->index, info->properties.deviceName);
+    printf("Subgroup size: %u, stages 0x%x, operations 0x%x, quad ops in all stages: %s\n",
+           info->subgroup.subgroupSize, info->subgroup.supportedStages, info->subgroup.supportedOperations,
+           info->subgroup.quadOperationsInAllStages ? "yes" : "no");
+    if (info->hasSizeControl) {
+        printf("Subgroup size control: %u..%u\n", info->sizeControl.minSubgroupSize, info->sizeControl.maxSubgroupSize);
+    }
+}
+
+// Writes `text` as a JSON string: quotes and backslashes escaped, control
+// characters as \u escapes (driver names are not ours to trust).
+static void deviceWriteString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (; *text; text++) {
+        unsigned char c = (unsigned char)*text;
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if (c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+static void deviceWriteFlagNames(FILE* file, uint32_t flags, const char* const* names, uint32_t nameCount) {
+    int first = 1;
+    fprintf(file, "[");
+    for (uint32_t bit = 0; bit < nameCount; bit++) {
+        if (flags & (1u << bit)) {
+            fprintf(file, "%s\"%s\"", first ? "" : ", ", names[bit]);
+            first = 0;
+        }
+    }
+    fprintf(file, "]");
+}
+
+// Writes every device's capabilities as JSON to `path` ("-" for stdout,
+// which the caller should claim with stdoutClaim() before printing anything).
+// Returns 0 if the file could not be written.
+static int deviceWriteReport(const char* path, const DeviceInfo* infos, uint32_t count, int selected) {
+    static const char* const stageNames[] = {
+        "vertex", "tessellation_control", "tessellation_evaluation", "geometry", "fragment", "compute",
+    };
+    static const char* const operationNames[] = {
+        "basic", "vote", "arithmetic", "ballot", "shuffle", "shuffle_relative", "clustered", "quad",
+    };
+    int toStdout = strcmp(path, "-") == 0;
+    FILE* file = toStdout ? stdoutClaim() : fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open %s for writing\n", path);
+        return 0;
+    }
+
+    fprintf(file, "{\n  \"selected\": %d,\n  \"devices\": [\n", selected);
+    for (uint32_t i = 0; i < count; i++) {
+        const DeviceInfo* info = &infos[i];
+        const VkPhysicalDeviceProperties* p = &info->properties;
+        char uuid[VK_UUID_SIZE * 2 + 1] = "";
+        if (info->hasUUID) deviceFormatUUID(info->deviceUUID, uuid);
+
+        fprintf(file, "    {\n");
+        fprintf(file, "      \"index\": %u,\n", info->index);
+        fprintf(file, "      \"name\": ");
+        deviceWriteString(file, p->deviceName);
+        fprintf(file, ",\n");
+        fprintf(file, "      \"type\": \"%s\",\n", deviceTypeName(p->deviceType));
+        fprintf(file, "      \"uuid\": \"%s\",\n", uuid);
+        fprintf(file, "      \"vendorID\": %u,\n      \"deviceID\": %u,\n", p->vendorID, p->deviceID);
+        fprintf(file, "      \"apiVersion\": \"%u.%u.%u\",\n", VK_API_VERSION_MAJOR(p->apiVersion),
+                VK_API_VERSION_MINOR(p->apiVersion), VK_API_VERSION_PATCH(p->apiVersion));
+        fprintf(file, "      \"driverVersion\": %u,\n", p->driverVersion);
+        fprintf(file, "      \"deviceLocalBytes\": %llu,\n", (unsigned long long)info->deviceLocalBytes);
+        fprintf(file, "      \"score\": %lld,\n", (long long)info->score);
+        if (info->queueFamilyIndex == UINT32_MAX) {
+            fprintf(file, "      \"queueFamilyIndex\": null,\n");
+        } else {
+            fprintf(file, "      \"queueFamilyIndex\": %u,\n", info->queueFamilyIndex);
+        }
+        fprintf(file, "      \"subgroup\": {\n");
+        fprintf(file, "        \"subgroupSize\": %u,\n", info->subgroup.subgroupSize);
+        fprintf(file, "        \"supportedStages\": ");
+        deviceWriteFlagNames(file, info->subgroup.supportedStages, stageNames, sizeof(stageNames) / sizeof(stageNames[0]));
+        fprintf(file, ",\n        \"supportedOperations\": ");
+        deviceWriteFlagNames(file, info->subgroup.supportedOperations, operationNames,
+                             sizeof(operationNames) / sizeof(operationNames[0]));
+        fprintf(file, ",\n        \"quadOperationsInAllStages\": %s,\n",
+                info->subgroup.quadOperationsInAllStages ? "true" : "false");
+        if (info->hasSizeControl) {
+            fprintf(file, "        \"sizeControl\": { \"minSubgroupSize\": %u, \"maxSubgroupSize\": %u, "
+                          "\"maxComputeWorkgroupSubgroups\": %u, \"requiredSubgroupSizeStages\": ",
+                    info->sizeControl.minSubgroupSize, info->sizeControl.maxSubgroupSize,
+                    info->sizeControl.maxComputeWorkgroupSubgroups);
+            deviceWriteFlagNames(file, info->sizeControl.requiredSubgroupSizeStages, stageNames,
+                                 sizeof(stageNames) / sizeof(stageNames[0]));
+            fprintf(file, " }\n");
+        } else {
+            fprintf(file, "        \"sizeControl\": null\n");
+        }
+        fprintf(file, "      },\n");
+        fprintf(file, "      \"timestamps\": { \"validBits\": %u, \"periodNs\": %g, \"computeAndGraphics\": %s }\n",
+                info->timestampValidBits, p->limits.timestampPeriod,
+                p->limits.timestampComputeAndGraphics ? "true" : "false");
+        fprintf(file, "    }%s\n", i + 1 < count ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+
+    if (toStdout) {
+        fflush(file);
+    } else {
+        fclose(file);
+    }
+    return 1;
+}
+
+#endif // DEVICE_SELECT_H
@@ -0,0 +1,39 @@
+// frameParams.glsl
+// Per-frame parameters, passed as push constants unless FRAME_PARAMS_FROM_BUFFER
+// is defined. Must match FrameParams in frame_params.h (24 bytes, well under
+// the 128-byte guaranteed push-constant minimum, and a 24-byte std430 stride).
+
+struct FrameParamsData {
+    vec2 offset;          // Pattern offset in pixels.
+    float scale;          // Pattern scale.
+    float time;           // Seconds since the first frame.
+    uint frameIndex;
+    uint shufflePattern;  // 0 reverse, 1 rotate by frameIndex, 2 xor with frameIndex.
+};
+
+#ifdef FRAME_PARAMS_FROM_BUFFER
+// The including shader fills this per invocation (e.g. per layer from an SSBO).
+FrameParamsData frameParams;
+#else
+layout(push_constant) uniform FrameParamsBlock {
+    FrameParamsData frameParams;
+};
+#endif
+
+// Source lane for subgroupShuffle under the selected pattern. Every pattern is
+// a permutation of [0, size), so each lane is read exactly once.
+uint shuffleSource(uint lane, uint size) {
+    if (frameParams.shufflePattern == 1u) {
+        return (lane + frameParams.frameIndex) % size;
+    }
+    if (frameParams.shufflePattern == 2u) {
+        return lane ^ (frameParams.frameIndex & (size - 1u));
+    }
+    return size - 1u - lane;
+}
+
+// A moving gradient driven by offset and scale, in [0, 1).
+float frameGradient(vec2 pos, vec2 size) {
+    vec2 p = (pos + frameParams.offset) * frameParams.scale / size;
+    return fract(p.x + p.y);
+}
@@ -0,0 +1,60 @@
+// frame_params.h
+// Per-frame push constants shared by the render and compute programs. The
+// layout matches the push_constant block in frameParams.glsl. Include after
+// <vulkan/vulkan.h> for framePushConstantRange().
+
+#ifndef FRAME_PARAMS_H
+#define FRAME_PARAMS_H
+
+#include <stdint.h>
+#include <string.h>
+
+typedef enum {
+    SHUFFLE_PATTERN_REVERSE,
+    SHUFFLE_PATTERN_ROTATE,
+    SHUFFLE_PATTERN_XOR,
+    SHUFFLE_PATTERN_COUNT,
+} ShufflePattern;
+
+static const char* const shufflePatternNames[SHUFFLE_PATTERN_COUNT] = {"reverse", "rotate", "xor"};
+
+typedef struct {
+    float offset[2];
+    float scale;
+    float time;
+    uint32_t frameIndex;
+    uint32_t shufflePattern;
+} FrameParams;
+
+// Looks up a pattern by name. Returns SHUFFLE_PATTERN_COUNT if unknown.
+static uint32_t parseShufflePattern(const char* name) {
+    uint32_t pattern = 0;
+    while (pattern < SHUFFLE_PATTERN_COUNT && strcmp(name, shufflePatternNames[pattern]) != 0) pattern++;
+    return pattern;
+}
+
+// Parameters for frame `frameIndex` of an animation running at `fps`: the
+// gradient scrolls diagonally and slowly zooms, so consecutive frames differ.
+static FrameParams frameParamsAt(uint32_t frameIndex, uint32_t shufflePattern, float fps) {
+    FrameParams params;
+    params.offset[0] = (float)frameIndex * 2.0f;
+    params.offset[1] = (float)frameIndex;
+    params.scale = 1.0f + 0.5f * (float)(frameIndex % 240) / 240.0f;
+    params.time = (float)frameIndex / fps;
+    params.frameIndex = frameIndex;
+    params.shufflePattern = shufflePattern;
+    return params;
+}
+
+#ifdef VK_VERSION_1_0
+// The push-constant range covering FrameParams for the given stages.
+static VkPushConstantRange framePushConstantRange(VkShaderStageFlags stageFlags) {
+    VkPushConstantRange range;
+    range.stageFlags = stageFlags;
+    range.offset = 0;
+    range.size = sizeof(FrameParams);
+    return range;
+}
+#endif
+
+#endif // FRAME_PARAMS_H
@@ -0,0 +1,323 @@
+// frame_stream.h
+// Streams RGBA frames to stdout, a FIFO or a file, either as YUV4MPEG2 (I420)
+// or as raw RGBA, so an encoder can consume them directly, e.g.
+//
+//   ./compute --frames 600 --stream - | ffmpeg -i - out.mp4
+//   ./compute --frames 600 --stream - --stream-format rgba |
+//       ffmpeg -f rawvideo -pix_fmt rgba -s 256x256 -i - out.mp4
+//
+// Frames are copied into a bounded queue and written by a background thread,
+// so the renderer only blocks when the consumer falls behind by more than the
+// queue depth (or drops frames instead, if asked to).
+
+#ifndef FRAME_STREAM_H
+#define FRAME_STREAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define FRAME_STREAM_SSE2 1
+#endif
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#include "stdout_claim.h"
+#include "threading.h"
+#include "timing.h"
+
+typedef enum {
+    FRAME_STREAM_Y4M,
+    FRAME_STREAM_RGBA,
+} FrameStreamFormat;
+
+typedef struct {
+    FILE* file;
+    FrameStreamFormat format;
+    uint32_t width;
+    uint32_t height;
+    size_t rgbaSize;
+    size_t outputSize;
+
+    // Bounded queue of RGBA frames waiting for the writer thread.
+    uint8_t** slots;
+    uint32_t slotCount;
+    uint32_t head;
+    uint32_t count;
+    int dropWhenFull;
+    int closing;
+    int broken; // The consumer went away (EPIPE or short write).
+    Mutex mutex;
+    CondVar cond;
+    Thread writer;
+
+    // Statistics.
+    uint64_t framesPushed;
+    uint64_t framesWritten;
+    uint64_t framesDropped;
+    double producerWaitSeconds;
+    double startTime;
+} FrameStream;
+
+// Scalar BT.601 limited-range conversion, the reference for the SSE2 path:
+// Y = ((66 R + 129 G + 25 B + 128) >> 8) + 16.
+static inline uint8_t rgbToY(int r, int g, int b) {
+    return (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+}
+static inline uint8_t rgbToU(int r, int g, int b) {
+    return (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+}
+static inline uint8_t rgbToV(int r, int g, int b) {
+    return (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+#ifdef FRAME_STREAM_SSE2
+// Splits 8 RGBA pixels (two 16-byte loads) into 16-bit R, G and B vectors.
+static inline void deinterleaveRgba8(const uint8_t* src, __m128i* r, __m128i* g, __m128i* b) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i p0 = _mm_loadu_si128((const __m128i*)src);
+    __m128i p1 = _mm_loadu_si128((const __m128i*)(src + 16));
+    *r = _mm_packs_epi32(_mm_and_si128(p0, mask), _mm_and_si128(p1, mask));
+    *g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 8), mask), _mm_and_si128(_mm_srli_epi32(p1, 8), mask));
+    *b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(p0, 16), mask), _mm_and_si128(_mm_srli_epi32(p1, 16), mask));
+}
+
+// Luma for 8 pixels. The weighted sum is at most 56228, so unsigned 16-bit
+// lanes hold it and a logical shift gives the exact scalar result.
+static inline __m128i lumaFromRgb16(__m128i r, __m128i g, __m128i b) {
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(r, _mm_set1_epi16(66)), _mm_mullo_epi16(g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_mullo_epi16(b, _mm_set1_epi16(25)));
+    y = _mm_srli_epi16(_mm_add_epi16(y, _mm_set1_epi16(128)), 8);
+    return _mm_add_epi16(y, _mm_set1_epi16(16));
+}
+
+// Sums horizontal pairs of a 16-bit vector into four 16-bit values (lanes 0..3).
+static inline __m128i pairSum16(__m128i v) {
+    __m128i sums = _mm_madd_epi16(v, _mm_set1_epi16(1));
+    return _mm_packs_epi32(sums, sums);
+}
+#endif
+
+// Converts one RGBA frame to planar I420 (Y, then U and V at half resolution,
+// each chroma sample the average of a 2x2 block). Width and height must be even.
+static void convertRgbaToI420(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* yPlane, uint8_t* uPlane, uint8_t* vPlane) {
+    size_t stride = (size_t)width * 4;
+    for (uint32_t y = 0; y < height; y += 2) {
+        const uint8_t* row0 = rgba + y * stride;
+        const uint8_t* row1 = row0 + stride;
+        uint8_t* y0 = yPlane + (size_t)y * width;
+        uint8_t* y1 = y0 + width;
+        uint8_t* u = uPlane + (size_t)(y / 2) * (width / 2);
+        uint8_t* v = vPlane + (size_t)(y / 2) * (width / 2);
+        uint32_t x = 0;
+
+#ifdef FRAME_STREAM_SSE2
+        for (; x + 8 <= width; x += 8) {
+            __m128i r0, g0, b0, r1, g1, b1;
+            deinterleaveRgba8(row0 + x * 4, &r0, &g0, &b0);
+            deinterleaveRgba8(row1 + x * 4, &r1, &g1, &b1);
+
+            __m128i luma0 = lumaFromRgb16(r0, g0, b0);
+            __m128i luma1 = lumaFromRgb16(r1, g1, b1);
+            _mm_storel_epi64((__m128i*)(y0 + x), _mm_packus_epi16(luma0, luma0));
+            _mm_storel_epi64((__m128i*)(y1 + x), _mm_packus_epi16(luma1, luma1));
+
+            // 2x2 averages with rounding, in lanes 0..3.
+            const __m128i two = _mm_set1_epi16(2);
+            __m128i rAvg = _mm_srli_epi16(_mm_add_epi16(pairSum16(_mm_add_epi16(r0, r1)), two), 2);
+            __m128i gAvg = _mm_srli_epi16(_mm_add_epi16(pairSum16(_mm_add_epi16(g0, g1)), two), 2);
+            __m128i bAvg = _mm_srli_epi16(_mm_add_epi16(pairSum16(_mm_add_epi16(b0, b1)), two), 2);
+
+            // Chroma sums stay within +-28688, so signed 16-bit lanes suffice.
+            __m128i cu = _mm_add_epi16(_mm_mullo_epi16(rAvg, _mm_set1_epi16(-38)), _mm_mullo_epi16(gAvg, _mm_set1_epi16(-74)));
+            cu = _mm_add_epi16(cu, _mm_mullo_epi16(bAvg, _mm_set1_epi16(112)));
+            cu = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(cu, _mm_set1_epi16(128)), 8), _mm_set1_epi16(128));
+            __m128i cv = _mm_add_epi16(_mm_mullo_epi16(rAvg, _mm_set1_epi16(112)), _mm_mullo_epi16(gAvg, _mm_set1_epi16(-94)));
+            cv = _mm_add_epi16(cv, _mm_mullo_epi16(bAvg, _mm_set1_epi16(-18)));
+            cv = _mm_add_epi16(_mm_srai_epi16(_mm_add_epi16(cv, _mm_set1_epi16(128)), 8), _mm_set1_epi16(128));
+
+            uint32_t packedU = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(cu, cu));
+            uint32_t packedV = (uint32_t)_mm_cvtsi128_si32(_mm_packus_epi16(cv, cv));
+            memcpy(u + x / 2, &packedU, 4);
+            memcpy(v + x / 2, &packedV, 4);
+        }
+#endif
+
+        for (; x < width; x += 2) {
+            const uint8_t* p00 = row0 + x * 4;
+            const uint8_t* p01 = p00 + 4;
+            const uint8_t* p10 = row1 + x * 4;
+            const uint8_t* p11 = p10 + 4;
+            y0[x] = rgbToY(p00[0], p00[1], p00[2]);
+            y0[x + 1] = rgbToY(p01[0], p01[1], p01[2]);
+            y1[x] = rgbToY(p10[0], p10[1], p10[2]);
+            y1[x + 1] = rgbToY(p11[0], p11[1], p11[2]);
+            int r = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+            int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+            int b = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+            u[x / 2] = rgbToU(r, g, b);
+            v[x / 2] = rgbToV(r, g, b);
+        }
+    }
+}
+
+// Writer thread: converts and writes queued frames until the stream closes.
+static void* frameStreamWriter(void* argument) {
+    FrameStream* stream = (FrameStream*)argument;
+    uint8_t* converted = stream->format == FRAME_STREAM_Y4M ? (uint8_t*)malloc(stream->outputSize) : NULL;
+
+    for (;;) {
+        mutexLock(&stream->mutex);
+        while (stream->count == 0 && !stream->closing) {
+            condWait(&stream->cond, &stream->mutex);
+        }
+        if (stream->count == 0 || stream->broken) {
+            mutexUnlock(&stream->mutex);
+            break;
+        }
+        uint8_t* frame = stream->slots[stream->head];
+        mutexUnlock(&stream->mutex);
+
+        // The slot stays owned by the queue until the write finishes.
+        int ok;
+        if (stream->format == FRAME_STREAM_Y4M) {
+            size_t lumaSize = (size_t)stream->width * stream->height;
+            convertRgbaToI420(frame, stream->width, stream->height, converted, converted + lumaSize, converted + lumaSize + lumaSize / 4);
+            ok = fputs("FRAME\n", stream->file) >= 0 && fwrite(converted, 1, stream->outputSize, stream->file) == stream->outputSize;
+        } else {
+            ok = fwrite(frame, 1, stream->outputSize, stream->file) == stream->outputSize;
+        }
+
+        mutexLock(&stream->mutex);
+        stream->head = (stream->head + 1) % stream->slotCount;
+        stream->count--;
+        if (ok) {
+            stream->framesWritten++;
+        } else {
+            stream->broken = 1;
+            stream->closing = 1;
+        }
+        condBroadcast(&stream->cond);
+        mutexUnlock(&stream->mutex);
+    }
+
+    free(converted);
+    return NULL;
+}
+
+// Opens a stream on `path` ("-" for stdout, see stdoutClaim).
+static FrameStream* frameStreamOpen(const char* path, FrameStreamFormat format, uint32_t width, uint32_t height,
+                                    uint32_t fps, uint32_t queueDepth, int dropWhenFull) {
+    if (format == FRAME_STREAM_Y4M && (width % 2 != 0 || height % 2 != 0)) {
+        fprintf(stderr, "YUV4MPEG2 output needs even dimensions (got %ux%u)\n", width, height);
+        return NULL;
+    }
+
+    FILE* file;
+    if (strcmp(path, "-") == 0) {
+        file = stdoutClaim();
+    } else {
+        // Opening a FIFO blocks here until the consumer opens the other end.
+        file = fopen(path, "wb");
+    }
+    if (!file) {
+        fprintf(stderr, "Failed to open frame stream: %s\n", path);
+        return NULL;
+    }
+#ifndef _WIN32
+    // A consumer that exits early should end the stream, not kill the process.
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    FrameStream* stream = (FrameStream*)calloc(1, sizeof(FrameStream));
+    stream->file = file;
+    stream->format = format;
+    stream->width = width;
+    stream->height = height;
+    stream->rgbaSize = (size_t)width * height * 4;
+    stream->outputSize = format == FRAME_STREAM_Y4M ? (size_t)width * height * 3 / 2 : stream->rgbaSize;
+    stream->slotCount = queueDepth > 0 ? queueDepth : 1;
+    stream->slots = (uint8_t**)calloc(stream->slotCount, sizeof(uint8_t*));
+    for (uint32_t i = 0; i < stream->slotCount; i++) {
+        stream->slots[i] = (uint8_t*)malloc(stream->rgbaSize);
+    }
+    stream->dropWhenFull = dropWhenFull;
+    mutexInit(&stream->mutex);
+    condInit(&stream->cond);
+
+    if (format == FRAME_STREAM_Y4M) {
+        fprintf(file, "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n", width, height, fps);
+    }
+
+    stream->startTime = getTimeSeconds();
+    if (!threadCreate(&stream->writer, frameStreamWriter, stream)) {
+        fprintf(stderr, "Failed to start frame stream writer thread.\n");
+        exit(EXIT_FAILURE);
+    }
+    return stream;
+}
+
+// Queues one RGBA frame. Blocks while the queue is full unless the stream
+// drops frames. Returns 0 once the consumer has gone away.
+static int frameStreamPush(FrameStream* stream, const void* rgba) {
+    mutexLock(&stream->mutex);
+    stream->framesPushed++;
+    if (stream->count == stream->slotCount && stream->dropWhenFull && !stream->broken) {
+        stream->framesDropped++;
+        mutexUnlock(&stream->mutex);
+        return 1;
+    }
+    double waitStart = getTimeSeconds();
+    while (stream->count == stream->slotCount && !stream->broken) {
+        condWait(&stream->cond, &stream->mutex);
+    }
+    stream->producerWaitSeconds += getTimeSeconds() - waitStart;
+    if (stream->broken) {
+        mutexUnlock(&stream->mutex);
+        return 0;
+    }
+    uint32_t tail = (stream->head + stream->count) % stream->slotCount;
+    uint8_t* slot = stream->slots[tail];
+    mutexUnlock(&stream->mutex);
+
+    // Only the producer writes to slots beyond head + count, so the copy can
+    // happen outside the lock.
+    memcpy(slot, rgba, stream->rgbaSize);
+
+    mutexLock(&stream->mutex);
+    stream->count++;
+    condBroadcast(&stream->cond);
+    mutexUnlock(&stream->mutex);
+    return 1;
+}
+
+// Drains the queue, closes the output and prints throughput statistics.
+static void frameStreamClose(FrameStream* stream) {
+    mutexLock(&stream->mutex);
+    stream->closing = 1;
+    condBroadcast(&stream->cond);
+    mutexUnlock(&stream->mutex);
+    threadJoin(stream->writer);
+
+    fclose(stream->file);
+    double elapsed = getTimeSeconds() - stream->startTime;
+    fprintf(stderr, "Frame stream: %llu/%llu frames written, %llu dropped, %.1f frames/s, producer blocked %.3f s%s\n",
+            (unsigned long long)stream->framesWritten, (unsigned long long)stream->framesPushed,
+            (unsigned long long)stream->framesDropped, elapsed > 0.0 ? stream->framesWritten / elapsed : 0.0,
+            stream->producerWaitSeconds, stream->broken ? " (consumer closed the stream)" : "");
+
+    for (uint32_t i = 0; i < stream->slotCount; i++) {
+        free(stream->slots[i]);
+    }
+    free(stream->slots);
+    condDestroy(&stream->cond);
+    mutexDestroy(&stream->mutex);
+    free(stream);
+}
+
+#endif // FRAME_STREAM_H
@@ -0,0 +1,330 @@
+// gpu_counters.h
+// Pipeline statistics and hardware performance counters around recorded work,
+// one query per render pass or dispatch. Statistics need the
+// pipelineStatisticsQuery feature; counters need VK_KHR_performance_query
+// with performanceCounterQueryPools and hostQueryReset. Either part is simply
+// left out when the device lacks it (lavapipe has statistics but no
+// counters). Counters are limited to those that fit in a single pass and
+// aren't command-buffer scoped, so one submission of the work measures them
+// all. Include after vulkan_functions.h and device_select.h.
+
+#ifndef GPU_COUNTERS_H
+#define GPU_COUNTERS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_alloc.h"
+
+#define GPU_COUNTERS_MAX 8
+
+// Statistics the report knows, in result order (ascending bit).
+#define GPU_STATISTIC_COUNT 3
+static const VkQueryPipelineStatisticFlagBits gpuStatisticBits[GPU_STATISTIC_COUNT] = {
+    VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT,
+    VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT,
+    VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT,
+};
+static const char* const gpuStatisticNames[GPU_STATISTIC_COUNT] = {
+    "clipping primitives",
+    "fragment invocations",
+    "compute invocations",
+};
+
+// Indexed by VkPerformanceCounterUnitKHR.
+static const char* const gpuCounterUnitNames[] = {"", "%", "ns", "B", "B/s", "K", "W", "V", "A", "Hz", "cycles"};
+
+// What the device offers, filled in before vkCreateDevice.
+typedef struct {
+    VkBool32 pipelineStatistics;
+    VkBool32 performanceQuery;
+    // Chained into the enabled features by gpuCountersEnableFeatures().
+    VkPhysicalDevicePerformanceQueryFeaturesKHR performanceFeatures;
+} GpuCounterSupport;
+
+// `features` are the device's supported features; `hostQueryReset` comes
+// from its Vulkan 1.2 features (VK_FALSE on older devices), since counter
+// pools can't be reset in the command buffer that uses them.
+static void gpuCountersQuerySupport(GpuCounterSupport* support, VkPhysicalDevice physicalDevice,
+                                    const VkPhysicalDeviceFeatures* features, VkBool32 hostQueryReset) {
+    memset(support, 0, sizeof(*support));
+    support->pipelineStatistics = features->pipelineStatisticsQuery;
+    support->performanceFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PERFORMANCE_QUERY_FEATURES_KHR;
+    if (!hostQueryReset || !deviceHasExtension(physicalDevice, VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME) ||
+        vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR == NULL) {
+        return;
+    }
+    VkPhysicalDeviceFeatures2 supported = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2,
+        .pNext = &support->performanceFeatures,
+    };
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+    support->performanceQuery = support->performanceFeatures.performanceCounterQueryPools;
+    support->performanceFeatures.pNext = NULL;
+    support->performanceFeatures.performanceCounterMultipleQueryPools = VK_FALSE;
+}
+
+// Adds the counter query pool feature to `enabled`. The caller also enables
+// VK_KHR_performance_query and hostQueryReset when support->performanceQuery.
+static void gpuCountersEnableFeatures(GpuCounterSupport* support, VkPhysicalDeviceFeatures2* enabled) {
+    if (support->performanceQuery) {
+        support->performanceFeatures.pNext = enabled->pNext;
+        enabled->pNext = &support->performanceFeatures;
+    }
+}
+
+typedef struct {
+    VkDevice device;
+    uint32_t queryCount;
+    // Pipeline statistics; VK_NULL_HANDLE when none were asked for.
+    VkQueryPool statisticsPool;
+    VkQueryPipelineStatisticFlags statistics;
+    uint32_t statisticCount;
+    // Performance counters; VK_NULL_HANDLE when unsupported.
+    VkQueryPool counterPool;
+    uint32_t counterCount;
+    VkPerformanceCounterKHR counters[GPU_COUNTERS_MAX];
+    VkPerformanceCounterDescriptionKHR descriptions[GPU_COUNTERS_MAX];
+} GpuCounters;
+
+// Per-query averages over a range of queries.
+typedef struct {
+    double statistics[GPU_STATISTIC_COUNT];
+    double counters[GPU_COUNTERS_MAX];
+} GpuCounterValues;
+
+// Picks up to GPU_COUNTERS_MAX counters of `queueFamilyIndex` that still fit
+// in one pass. Returns how many were picked.
+static uint32_t gpuCountersSelect(GpuCounters* gpuCounters, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                                  uint32_t* indices) {
+    uint32_t available = 0;
+    if (vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR(physicalDevice, queueFamilyIndex, &available, NULL, NULL) != VK_SUCCESS ||
+        available == 0) {
+        return 0;
+    }
+    VkPerformanceCounterKHR* counters = (VkPerformanceCounterKHR*)calloc(available, sizeof(VkPerformanceCounterKHR));
+    VkPerformanceCounterDescriptionKHR* descriptions =
+        (VkPerformanceCounterDescriptionKHR*)calloc(available, sizeof(VkPerformanceCounterDescriptionKHR));
+    for (uint32_t i = 0; i < available; i++) {
+        counters[i].sType = VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_KHR;
+        descriptions[i].sType = VK_STRUCTURE_TYPE_PERFORMANCE_COUNTER_DESCRIPTION_KHR;
+    }
+    uint32_t count = 0;
+    if (vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR(physicalDevice, queueFamilyIndex, &available, counters,
+                                                                        descriptions) == VK_SUCCESS) {
+        VkQueryPoolPerformanceCreateInfoKHR performanceInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_PERFORMANCE_CREATE_INFO_KHR,
+            .queueFamilyIndex = queueFamilyIndex,
+            .pCounterIndices = indices,
+        };
+        for (uint32_t i = 0; i < available && count < GPU_COUNTERS_MAX; i++) {
+            // Command buffer scoped counters would have to start the command buffer.
+            if (counters[i].scope == VK_PERFORMANCE_COUNTER_SCOPE_COMMAND_BUFFER_KHR) {
+                continue;
+            }
+            indices[count] = i;
+            performanceInfo.counterIndexCount = count + 1;
+            uint32_t passes = 0;
+            vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR(physicalDevice, &performanceInfo, &passes);
+            if (passes == 1) {
+                gpuCounters->counters[count] = counters[i];
+                gpuCounters->descriptions[count] = descriptions[i];
+                gpuCounters->counters[count].pNext = NULL;
+                gpuCounters->descriptions[count].pNext = NULL;
+                count++;
+            }
+        }
+    }
+    free(descriptions);
+    free(counters);
+    return count;
+}
+
+// Creates `queryCount` queries of each kind. `statistics` is a mask of
+// gpuStatisticBits (0 for none); the statistics must suit the queue family.
+// Counters are only set up when `performanceQuery`, and holding them takes
+// the device's profiling lock until gpuCountersDestroy(). Returns 0 if a
+// query pool can't be created.
+static int gpuCountersCreate(GpuCounters* gpuCounters, VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex,
+                             VkQueryPipelineStatisticFlags statistics, VkBool32 performanceQuery, uint32_t queryCount) {
+    memset(gpuCounters, 0, sizeof(*gpuCounters));
+    gpuCounters->device = device;
+    gpuCounters->queryCount = queryCount;
+
+    for (uint32_t i = 0; i < GPU_STATISTIC_COUNT; i++) {
+        if (statistics & gpuStatisticBits[i]) {
+            gpuCounters->statistics |= gpuStatisticBits[i];
+            gpuCounters->statisticCount++;
+        }
+    }
+    if (gpuCounters->statisticCount > 0) {
+        VkQueryPoolCreateInfo statisticsPoolInfo = {
+            .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+            .queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS,
+            .queryCount = queryCount,
+            .pipelineStatistics = gpuCounters->statistics,
+        };
+        if (vkCreateQueryPool(device, &statisticsPoolInfo, hostCallbacks, &gpuCounters->statisticsPool) != VK_SUCCESS) {
+            return 0;
+        }
+    }
+
+    if (!performanceQuery || vkAcquireProfilingLockKHR == NULL) {
+        return 1;
+    }
+    uint32_t indices[GPU_COUNTERS_MAX];
+    gpuCounters->counterCount = gpuCountersSelect(gpuCounters, physicalDevice, queueFamilyIndex, indices);
+    if (gpuCounters->counterCount == 0) {
+        printf("No single-pass performance counters on queue family %u\n", queueFamilyIndex);
+        return 1;
+    }
+    VkAcquireProfilingLockInfoKHR lockInfo = {
+        .sType = VK_STRUCTURE_TYPE_ACQUIRE_PROFILING_LOCK_INFO_KHR,
+        .timeout = UINT64_MAX,
+    };
+    if (vkAcquireProfilingLockKHR(device, &lockInfo) != VK_SUCCESS) {
+        printf("Profiling lock unavailable; performance counters skipped\n");
+        gpuCounters->counterCount = 0;
+        return 1;
+    }
+    VkQueryPoolPerformanceCreateInfoKHR performanceInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_PERFORMANCE_CREATE_INFO_KHR,
+        .queueFamilyIndex = queueFamilyIndex,
+        .counterIndexCount = gpuCounters->counterCount,
+        .pCounterIndices = indices,
+    };
+    VkQueryPoolCreateInfo counterPoolInfo = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO,
+        .pNext = &performanceInfo,
+        .queryType = VK_QUERY_TYPE_PERFORMANCE_QUERY_KHR,
+        .queryCount = queryCount,
+    };
+    if (vkCreateQueryPool(device, &counterPoolInfo, hostCallbacks, &gpuCounters->counterPool) != VK_SUCCESS) {
+        vkReleaseProfilingLockKHR(device);
+        gpuCounters->counterCount = 0;
+        return 0;
+    }
+    return 1;
+}
+
+// Resets every query before the command buffer that uses them is recorded.
+// Counter queries are reset from the host, so the previous submission using
+// them must have finished.
+static void gpuCountersReset(const GpuCounters* gpuCounters, VkCommandBuffer commandBuffer) {
+    if (gpuCounters->statisticsPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, gpuCounters->statisticsPool, 0, gpuCounters->queryCount);
+    }
+    if (gpuCounters->counterPool != VK_NULL_HANDLE) {
+        vkResetQueryPool(gpuCounters->device, gpuCounters->counterPool, 0, gpuCounters->queryCount);
+    }
+}
+
+// Brackets one render pass or dispatch. Both calls go outside any render
+// pass instance.
+static void gpuCountersBegin(const GpuCounters* gpuCounters, VkCommandBuffer commandBuffer, uint32_t query) {
+    if (gpuCounters->statisticsPool != VK_NULL_HANDLE) {
+        vkCmdBeginQuery(commandBuffer, gpuCounters->statisticsPool, query, 0);
+    }
+    if (gpuCounters->counterPool != VK_NULL_HANDLE) {
+        vkCmdBeginQuery(commandBuffer, gpuCounters->counterPool, query, 0);
+    }
+}
+
+static void gpuCountersEnd(const GpuCounters* gpuCounters, VkCommandBuffer commandBuffer, uint32_t query) {
+    if (gpuCounters->counterPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, gpuCounters->counterPool, query);
+    }
+    if (gpuCounters->statisticsPool != VK_NULL_HANDLE) {
+        vkCmdEndQuery(commandBuffer, gpuCounters->statisticsPool, query);
+    }
+}
+
+static double gpuCounterResultValue(VkPerformanceCounterStorageKHR storage, VkPerformanceCounterResultKHR result) {
+    switch (storage) {
+    case VK_PERFORMANCE_COUNTER_STORAGE_INT32_KHR: return (double)result.int32;
+    case VK_PERFORMANCE_COUNTER_STORAGE_INT64_KHR: return (double)result.int64;
+    case VK_PERFORMANCE_COUNTER_STORAGE_UINT32_KHR: return (double)result.uint32;
+    case VK_PERFORMANCE_COUNTER_STORAGE_UINT64_KHR: return (double)result.uint64;
+    case VK_PERFORMANCE_COUNTER_STORAGE_FLOAT32_KHR: return (double)result.float32;
+    default: return result.float64;
+    }
+}
+
+// Waits for queries [first, first + count) and averages them per query.
+// Returns 0 if the results can't be read.
+static int gpuCountersRead(const GpuCounters* gpuCounters, uint32_t first, uint32_t count, GpuCounterValues* values) {
+    memset(values, 0, sizeof(*values));
+    if (count == 0) {
+        return 1;
+    }
+    if (gpuCounters->statisticsPool != VK_NULL_HANDLE) {
+        size_t stride = gpuCounters->statisticCount * sizeof(uint64_t);
+        uint64_t* results = (uint64_t*)malloc(stride * count);
+        VkResult result = vkGetQueryPoolResults(gpuCounters->device, gpuCounters->statisticsPool, first, count, stride * count,
+                                                results, stride, VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT);
+        if (result == VK_SUCCESS) {
+            for (uint32_t query = 0; query < count; query++) {
+                uint32_t slot = 0;
+                for (uint32_t i = 0; i < GPU_STATISTIC_COUNT; i++) {
+                    if (gpuCounters->statistics & gpuStatisticBits[i]) {
+                        values->statistics[i] += (double)results[query * gpuCounters->statisticCount + slot++] / count;
+                    }
+                }
+            }
+        }
+        free(results);
+        if (result != VK_SUCCESS) {
+            return 0;
+        }
+    }
+    if (gpuCounters->counterPool != VK_NULL_HANDLE) {
+        // Counter results come without 64_BIT or availability flags.
+        size_t stride = gpuCounters->counterCount * sizeof(VkPerformanceCounterResultKHR);
+        VkPerformanceCounterResultKHR* results = (VkPerformanceCounterResultKHR*)malloc(stride * count);
+        VkResult result = vkGetQueryPoolResults(gpuCounters->device, gpuCounters->counterPool, first, count, stride * count,
+                                                results, stride, VK_QUERY_RESULT_WAIT_BIT);
+        if (result == VK_SUCCESS) {
+            for (uint32_t query = 0; query < count; query++) {
+                for (uint32_t i = 0; i < gpuCounters->counterCount; i++) {
+                    values->counters[i] +=
+                        gpuCounterResultValue(gpuCounters->counters[i].storage, results[query * gpuCounters->counterCount + i]) / count;
+                }
+            }
+        }
+        free(results);
+        if (result != VK_SUCCESS) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// One indented line per statistic and counter; `per` names what a query
+// covered, e.g. "dispatch".
+static void gpuCountersPrint(const GpuCounters* gpuCounters, const GpuCounterValues* values, const char* per) {
+    for (uint32_t i = 0; i < GPU_STATISTIC_COUNT; i++) {
+        if (gpuCounters->statistics & gpuStatisticBits[i]) {
+            printf("  %-40s %16.0f per %s\n", gpuStatisticNames[i], values->statistics[i], per);
+        }
+    }
+    for (uint32_t i = 0; i < gpuCounters->counterCount; i++) {
+        uint32_t unit = (uint32_t)gpuCounters->counters[i].unit;
+        const char* unitName = unit < sizeof(gpuCounterUnitNames) / sizeof(gpuCounterUnitNames[0]) ? gpuCounterUnitNames[unit] : "";
+        printf("  %-40.40s %16.2f %s per %s\n", gpuCounters->descriptions[i].name, values->counters[i], unitName, per);
+    }
+}
+
+static void gpuCountersDestroy(GpuCounters* gpuCounters) {
+    if (gpuCounters->counterPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(gpuCounters->device, gpuCounters->counterPool, hostCallbacks);
+        vkReleaseProfilingLockKHR(gpuCounters->device);
+    }
+    if (gpuCounters->statisticsPool != VK_NULL_HANDLE) {
+        vkDestroyQueryPool(gpuCounters->device, gpuCounters->statisticsPool, hostCallbacks);
+    }
+    memset(gpuCounters, 0, sizeof(*gpuCounters));
+}
+
+#endif // GPU_COUNTERS_H
@@ -0,0 +1,232 @@
+// graphics_pass.h
+// An offscreen full-screen pass for the compute program: an rgba8 colour
+// attachment, a render pass that leaves it in TRANSFER_SRC_OPTIMAL for the
+// readback copy, and pipelines that draw shader.vert's single triangle with
+// any fragment shader. Render passes recorded back to back are ordered like
+// the compute dispatches, so each one waits for the previous write. Include
+// after vulkan_functions.h; the including file provides findMemoryType().
+
+#ifndef GRAPHICS_PASS_H
+#define GRAPHICS_PASS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "frame_params.h"
+#include "host_alloc.h"
+#include "memory_budget.h"
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+typedef struct {
+    VkDevice device;
+    uint32_t width;
+    uint32_t height;
+    VkImage image;
+    VkDeviceMemory memory;
+    VkImageView imageView;
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+} GraphicsPass;
+
+// Creates the attachment, render pass and framebuffer. Returns 0 on failure.
+static int graphicsPassCreate(GraphicsPass* pass, VkDevice device, VkPhysicalDevice physicalDevice, uint32_t width, uint32_t height) {
+    memset(pass, 0, sizeof(*pass));
+    pass->device = device;
+    pass->width = width;
+    pass->height = height;
+
+    VkImageCreateInfo imageCreateInfo = {0};
+    imageCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    imageCreateInfo.extent.width = width;
+    imageCreateInfo.extent.height = height;
+    imageCreateInfo.extent.depth = 1;
+    imageCreateInfo.mipLevels = 1;
+    imageCreateInfo.arrayLayers = 1;
+    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
+    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
+    imageCreateInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    if (vkCreateImage(device, &imageCreateInfo, hostCallbacks, &pass->image) != VK_SUCCESS) {
+        return 0;
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetImageMemoryRequirements(device, pass->image, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    if (memoryBudgetAllocate(device, &allocInfo, &pass->memory, "color attachment") != VK_SUCCESS ||
+        vkBindImageMemory(device, pass->image, pass->memory, 0) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkImageViewCreateInfo viewCreateInfo = {0};
+    viewCreateInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+    viewCreateInfo.image = pass->image;
+    viewCreateInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
+    viewCreateInfo.format = VK_FORMAT_R8G8B8A8_UNORM;
+    viewCreateInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    viewCreateInfo.subresourceRange.levelCount = 1;
+    viewCreateInfo.subresourceRange.layerCount = 1;
+    if (vkCreateImageView(device, &viewCreateInfo, hostCallbacks, &pass->imageView) != VK_SUCCESS) {
+        return 0;
+    }
+
+    // The triangle covers every pixel, so the old contents are never loaded.
+    VkAttachmentDescription colorAttachment = {0};
+    colorAttachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+    colorAttachment.samples = VK_SAMPLE_COUNT_1_BIT;
+    colorAttachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    colorAttachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+    colorAttachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+    colorAttachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    colorAttachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+
+    VkAttachmentReference colorAttachmentRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+    VkSubpassDescription subpass = {0};
+    subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+    subpass.colorAttachmentCount = 1;
+    subpass.pColorAttachments = &colorAttachmentRef;
+
+    // Wait for the previous pass (or readback copy) before writing, and make
+    // the result available to the copy afterwards.
+    VkSubpassDependency dependencies[2] = {{0}, {0}};
+    dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[0].dstSubpass = 0;
+    dependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].srcSubpass = 0;
+    dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+    dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+    VkRenderPassCreateInfo renderPassCreateInfo = {0};
+    renderPassCreateInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
+    renderPassCreateInfo.attachmentCount = 1;
+    renderPassCreateInfo.pAttachments = &colorAttachment;
+    renderPassCreateInfo.subpassCount = 1;
+    renderPassCreateInfo.pSubpasses = &subpass;
+    renderPassCreateInfo.dependencyCount = 2;
+    renderPassCreateInfo.pDependencies = dependencies;
+    if (vkCreateRenderPass(device, &renderPassCreateInfo, hostCallbacks, &pass->renderPass) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkFramebufferCreateInfo framebufferCreateInfo = {0};
+    framebufferCreateInfo.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
+    framebufferCreateInfo.renderPass = pass->renderPass;
+    framebufferCreateInfo.attachmentCount = 1;
+    framebufferCreateInfo.pAttachments = &pass->imageView;
+    framebufferCreateInfo.width = width;
+    framebufferCreateInfo.height = height;
+    framebufferCreateInfo.layers = 1;
+    return vkCreateFramebuffer(device, &framebufferCreateInfo, hostCallbacks, &pass->framebuffer) == VK_SUCCESS;
+}
+
+// Creates a pipeline drawing `vertModule` (shader.vert) and `fragModule` into
+// the pass with a fixed viewport covering the attachment. Returns
+// VK_NULL_HANDLE on failure.
+static VkPipeline graphicsPassCreatePipeline(const GraphicsPass* pass, VkPipelineLayout pipelineLayout, VkShaderModule vertModule,
+                                             VkShaderModule fragModule, const VkSpecializationInfo* fragSpecialization) {
+    VkPipelineShaderStageCreateInfo stages[2] = {{0}, {0}};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertModule;
+    stages[0].pName = "main";
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragModule;
+    stages[1].pName = "main";
+    stages[1].pSpecializationInfo = fragSpecialization;
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = {0};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkViewport viewport = { 0.0f, 0.0f, (float)pass->width, (float)pass->height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { pass->width, pass->height } };
+    VkPipelineViewportStateCreateInfo viewportState = {0};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {0};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {0};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = stages;
+    pipelineCreateInfo.pVertexInputState = &vertexInput;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+    pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pRasterizationState = &rasterizer;
+    pipelineCreateInfo.pMultisampleState = &multisampling;
+    pipelineCreateInfo.pColorBlendState = &colorBlending;
+    pipelineCreateInfo.layout = pipelineLayout;
+    pipelineCreateInfo.renderPass = pass->renderPass;
+    VkPipeline pipeline;
+    if (vkCreateGraphicsPipelines(pass->device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, hostCallbacks, &pipeline) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    return pipeline;
+}
+
+// Records one render pass drawing the full-screen triangle with `params` as
+// fragment push constants. `descriptorSet` may be VK_NULL_HANDLE.
+static void graphicsPassRecord(const GraphicsPass* pass, VkCommandBuffer commandBuffer, VkPipeline pipeline,
+                               VkPipelineLayout pipelineLayout, VkDescriptorSet descriptorSet, const FrameParams* params) {
+    VkRenderPassBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    beginInfo.renderPass = pass->renderPass;
+    beginInfo.framebuffer = pass->framebuffer;
+    beginInfo.renderArea.extent.width = pass->width;
+    beginInfo.renderArea.extent.height = pass->height;
+    vkCmdBeginRenderPass(commandBuffer, &beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    if (descriptorSet != VK_NULL_HANDLE) {
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+    }
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(*params), params);
+    vkCmdDraw(commandBuffer, 3, 1, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+}
+
+static void graphicsPassDestroy(GraphicsPass* pass) {
+    VkDevice device = pass->device;
+    vkDestroyFramebuffer(device, pass->framebuffer, hostCallbacks);
+    vkDestroyRenderPass(device, pass->renderPass, hostCallbacks);
+    vkDestroyImageView(device, pass->imageView, hostCallbacks);
+    vkDestroyImage(device, pass->image, hostCallbacks);
+    memoryBudgetFree(device, pass->memory);
+}
+
+#endif // GRAPHICS_PASS_H
@@ -0,0 +1,404 @@
+// host_alloc.h
+// VkAllocationCallbacks for the driver's host allocations, which otherwise go
+// to the system malloc unseen (lavapipe makes thousands while compiling a
+// pipeline). hostCallbacks is what every vkCreate*/vkDestroy*/vkAllocateMemory/
+// vkFreeMemory call passes; it stays NULL (the driver's own allocator) unless
+// hostAllocatorInit() installs one of:
+//   tracking  malloc/free behind a 16-byte header; counts calls and tracks
+//             live and peak bytes per VkSystemAllocationScope
+//   arena     the same statistics, but COMMAND-scope blocks (which live only
+//             for the duration of one Vulkan call) are bump-allocated from
+//             chunks that rewind whenever the arena empties, and small
+//             OBJECT-scope blocks come from per-size-class free lists. Other
+//             scopes, large or over-aligned blocks fall back to malloc.
+// The driver may call back from any thread, so the state is under a mutex.
+// Include after vulkan_functions.h.
+
+#ifndef HOST_ALLOC_H
+#define HOST_ALLOC_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "threading.h"
+
+#define HOST_ALLOC_SCOPE_COUNT 5
+#define HOST_ALLOC_MIN_ALIGN 16
+#define HOST_ALLOC_CHUNK_SIZE ((size_t)1 << 20)
+#define HOST_ALLOC_ARENA_MAX (HOST_ALLOC_CHUNK_SIZE / 4)
+#define HOST_ALLOC_POOL_MIN_SHIFT 5  // 32-byte smallest class
+#define HOST_ALLOC_POOL_CLASSES 8    // ... up to 4 KiB
+
+typedef enum {
+    HOST_ALLOC_SYSTEM,
+    HOST_ALLOC_TRACKING,
+    HOST_ALLOC_ARENA,
+    HOST_ALLOC_MODE_COUNT
+} HostAllocMode;
+
+static const char* const hostAllocModeNames[HOST_ALLOC_MODE_COUNT] = { "system", "tracking", "arena" };
+static const char* const hostAllocScopeNames[HOST_ALLOC_SCOPE_COUNT] = { "command", "object", "cache", "device", "instance" };
+
+// Passed as pAllocator everywhere. NULL until hostAllocatorInit() says otherwise.
+static const VkAllocationCallbacks* hostCallbacks = NULL;
+
+typedef struct {
+    uint64_t allocations;
+    uint64_t reallocations;
+    uint64_t frees;
+    uint64_t liveBytes;
+    uint64_t peakBytes;
+    uint64_t totalBytes;
+    uint64_t internalBytes; // Reported through pfnInternalAllocation.
+} HostAllocScopeStats;
+
+enum { HOST_BLOCK_MALLOC, HOST_BLOCK_ARENA, HOST_BLOCK_POOL };
+
+// Sits immediately before every returned block.
+typedef struct {
+    uint64_t size;
+    uint32_t offset;    // Block start minus the malloc() result (HOST_BLOCK_MALLOC).
+    uint8_t scope;
+    uint8_t kind;
+    uint16_t sizeClass; // HOST_BLOCK_POOL.
+} HostAllocHeader;
+
+typedef struct HostAllocChunk {
+    struct HostAllocChunk* next;
+    size_t capacity;
+    size_t used;
+} HostAllocChunk;
+
+typedef struct {
+    HostAllocMode mode;
+    VkAllocationCallbacks callbacks;
+    Mutex mutex;
+    HostAllocScopeStats scopes[HOST_ALLOC_SCOPE_COUNT];
+    uint64_t liveBytes;
+    uint64_t peakBytes;
+    uint64_t systemCalls;      // malloc/free reaching the C library.
+    // Arena mode.
+    HostAllocChunk* arenaChunks;
+    HostAllocChunk* arenaCurrent;
+    uint64_t arenaLive;        // Blocks not yet freed.
+    uint64_t arenaRewinds;
+    HostAllocChunk* poolChunks;
+    void* poolFree[HOST_ALLOC_POOL_CLASSES];
+    uint64_t poolReuses;
+} HostAllocator;
+
+static uintptr_t hostAlignUp(uintptr_t value, size_t alignment) {
+    return (value + alignment - 1) & ~(uintptr_t)(alignment - 1);
+}
+
+static HostAllocHeader* hostHeader(void* block) {
+    return (HostAllocHeader*)block - 1;
+}
+
+static char* hostChunkData(HostAllocChunk* chunk) {
+    return (char*)chunk + hostAlignUp(sizeof(HostAllocChunk), HOST_ALLOC_MIN_ALIGN);
+}
+
+static HostAllocChunk* hostChunkNew(HostAllocator* allocator, size_t capacity) {
+    HostAllocChunk* chunk = (HostAllocChunk*)malloc(hostAlignUp(sizeof(HostAllocChunk), HOST_ALLOC_MIN_ALIGN) + capacity);
+    if (!chunk) return NULL;
+    chunk->next = NULL;
+    chunk->capacity = capacity;
+    chunk->used = 0;
+    allocator->systemCalls++;
+    return chunk;
+}
+
+static void hostChunkFreeAll(HostAllocChunk* chunk) {
+    while (chunk) {
+        HostAllocChunk* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+}
+
+// Statistics; the caller holds the mutex.
+static void hostCountAlloc(HostAllocator* allocator, uint32_t scope, uint64_t size) {
+    HostAllocScopeStats* stats = &allocator->scopes[scope];
+    stats->allocations++;
+    stats->totalBytes += size;
+    stats->liveBytes += size;
+    if (stats->liveBytes > stats->peakBytes) stats->peakBytes = stats->liveBytes;
+    allocator->liveBytes += size;
+    if (allocator->liveBytes > allocator->peakBytes) allocator->peakBytes = allocator->liveBytes;
+}
+
+static void hostCountFree(HostAllocator* allocator, uint32_t scope, uint64_t size) {
+    allocator->scopes[scope].frees++;
+    allocator->scopes[scope].liveBytes -= size;
+    allocator->liveBytes -= size;
+}
+
+static void* hostMallocBlock(size_t size, size_t alignment, uint32_t scope) {
+    char* base = (char*)malloc(size + alignment + sizeof(HostAllocHeader));
+    if (!base) return NULL;
+    char* block = (char*)hostAlignUp((uintptr_t)base + sizeof(HostAllocHeader), alignment);
+    HostAllocHeader* header = hostHeader(block);
+    header->size = size;
+    header->offset = (uint32_t)(block - base);
+    header->scope = (uint8_t)scope;
+    header->kind = HOST_BLOCK_MALLOC;
+    return block;
+}
+
+// Bump allocation from the current chunk, moving on to the next (retained
+// after a rewind) or a new one when it is full.
+static void* hostArenaBlock(HostAllocator* allocator, size_t size, size_t alignment, uint32_t scope) {
+    for (;;) {
+        HostAllocChunk* chunk = allocator->arenaCurrent;
+        if (chunk) {
+            uintptr_t begin = (uintptr_t)hostChunkData(chunk);
+            uintptr_t block = hostAlignUp(begin + chunk->used + sizeof(HostAllocHeader), alignment);
+            if (block + size <= begin + chunk->capacity) {
+                chunk->used = block + size - begin;
+                HostAllocHeader* header = hostHeader((void*)block);
+                header->size = size;
+                header->scope = (uint8_t)scope;
+                header->kind = HOST_BLOCK_ARENA;
+                allocator->arenaLive++;
+                return (void*)block;
+            }
+            if (chunk->next) {
+                allocator->arenaCurrent = chunk->next;
+                allocator->arenaCurrent->used = 0;
+                continue;
+            }
+        }
+        HostAllocChunk* fresh = hostChunkNew(allocator, HOST_ALLOC_CHUNK_SIZE);
+        if (!fresh) return NULL;
+        if (chunk) {
+            chunk->next = fresh;
+        } else {
+            allocator->arenaChunks = fresh;
+        }
+        allocator->arenaCurrent = fresh;
+    }
+}
+
+static void* hostPoolBlock(HostAllocator* allocator, size_t size, uint32_t scope) {
+    uint32_t sizeClass = 0;
+    while (((size_t)1 << (HOST_ALLOC_POOL_MIN_SHIFT + sizeClass)) < size) sizeClass++;
+    void* block = allocator->poolFree[sizeClass];
+    if (block) {
+        allocator->poolFree[sizeClass] = *(void**)block;
+        allocator->poolReuses++;
+    } else {
+        size_t stride = sizeof(HostAllocHeader) + ((size_t)1 << (HOST_ALLOC_POOL_MIN_SHIFT + sizeClass));
+        HostAllocChunk* chunk = allocator->poolChunks;
+        if (!chunk || chunk->used + stride > chunk->capacity) {
+            chunk = hostChunkNew(allocator, HOST_ALLOC_CHUNK_SIZE);
+            if (!chunk) return NULL;
+            chunk->next = allocator->poolChunks;
+            allocator->poolChunks = chunk;
+        }
+        block = hostChunkData(chunk) + chunk->used + sizeof(HostAllocHeader);
+        chunk->used += stride;
+    }
+    HostAllocHeader* header = hostHeader(block);
+    header->size = size;
+    header->scope = (uint8_t)scope;
+    header->kind = HOST_BLOCK_POOL;
+    header->sizeClass = (uint16_t)sizeClass;
+    return block;
+}
+
+// Returns a block to wherever it came from; the caller holds the mutex.
+static void hostReleaseLocked(HostAllocator* allocator, void* block) {
+    HostAllocHeader* header = hostHeader(block);
+    hostCountFree(allocator, header->scope, header->size);
+    if (header->kind == HOST_BLOCK_ARENA) {
+        if (--allocator->arenaLive == 0) {
+            allocator->arenaCurrent = allocator->arenaChunks;
+            allocator->arenaCurrent->used = 0;
+            allocator->arenaRewinds++;
+        }
+    } else if (header->kind == HOST_BLOCK_POOL) {
+        *(void**)block = allocator->poolFree[header->sizeClass];
+        allocator->poolFree[header->sizeClass] = block;
+    } else {
+        allocator->systemCalls++;
+        free((char*)block - header->offset);
+    }
+}
+
+static void* VKAPI_PTR hostAllocate(void* userData, size_t size, size_t alignment, VkSystemAllocationScope scope) {
+    HostAllocator* allocator = (HostAllocator*)userData;
+    if (size == 0) return NULL;
+    if (alignment < HOST_ALLOC_MIN_ALIGN) alignment = HOST_ALLOC_MIN_ALIGN;
+    uint32_t scopeIndex = (uint32_t)scope < HOST_ALLOC_SCOPE_COUNT ? (uint32_t)scope : VK_SYSTEM_ALLOCATION_SCOPE_OBJECT;
+    void* block = NULL;
+
+    mutexLock(&allocator->mutex);
+    if (allocator->mode == HOST_ALLOC_ARENA && scopeIndex == VK_SYSTEM_ALLOCATION_SCOPE_COMMAND &&
+        size + alignment <= HOST_ALLOC_ARENA_MAX) {
+        block = hostArenaBlock(allocator, size, alignment, scopeIndex);
+    } else if (allocator->mode == HOST_ALLOC_ARENA && scopeIndex == VK_SYSTEM_ALLOCATION_SCOPE_OBJECT &&
+               alignment == HOST_ALLOC_MIN_ALIGN &&
+               size <= ((size_t)1 << (HOST_ALLOC_POOL_MIN_SHIFT + HOST_ALLOC_POOL_CLASSES - 1))) {
+        block = hostPoolBlock(allocator, size, scopeIndex);
+    } else {
+        allocator->systemCalls++;
+        mutexUnlock(&allocator->mutex);
+        block = hostMallocBlock(size, alignment, scopeIndex);
+        mutexLock(&allocator->mutex);
+    }
+    if (block) hostCountAlloc(allocator, scopeIndex, size);
+    mutexUnlock(&allocator->mutex);
+    return block;
+}
+
+static void VKAPI_PTR hostFree(void* userData, void* memory) {
+    HostAllocator* allocator = (HostAllocator*)userData;
+    if (!memory) return;
+    mutexLock(&allocator->mutex);
+    hostReleaseLocked(allocator, memory);
+    mutexUnlock(&allocator->mutex);
+}
+
+static void* VKAPI_PTR hostReallocate(void* userData, void* original, size_t size, size_t alignment,
+                                      VkSystemAllocationScope scope) {
+    HostAllocator* allocator = (HostAllocator*)userData;
+    if (!original) return hostAllocate(userData, size, alignment, scope);
+    if (size == 0) {
+        hostFree(userData, original);
+        return NULL;
+    }
+    HostAllocHeader* header = hostHeader(original);
+
+    // Grow or shrink in place: the newest arena block, or within a pool class.
+    mutexLock(&allocator->mutex);
+    int inPlace = 0;
+    if (header->kind == HOST_BLOCK_ARENA) {
+        HostAllocChunk* chunk = allocator->arenaCurrent;
+        uintptr_t begin = (uintptr_t)hostChunkData(chunk);
+        if ((uintptr_t)original + header->size == begin + chunk->used && (uintptr_t)original + size <= begin + chunk->capacity) {
+            chunk->used = (uintptr_t)original + size - begin;
+            inPlace = 1;
+        }
+    } else if (header->kind == HOST_BLOCK_POOL) {
+        inPlace = size <= ((size_t)1 << (HOST_ALLOC_POOL_MIN_SHIFT + header->sizeClass));
+    }
+    if (inPlace) {
+        HostAllocScopeStats* stats = &allocator->scopes[header->scope];
+        stats->reallocations++;
+        stats->liveBytes = stats->liveBytes - header->size + size;
+        if (stats->liveBytes > stats->peakBytes) stats->peakBytes = stats->liveBytes;
+        allocator->liveBytes = allocator->liveBytes - header->size + size;
+        if (allocator->liveBytes > allocator->peakBytes) allocator->peakBytes = allocator->liveBytes;
+        header->size = size;
+        mutexUnlock(&allocator->mutex);
+        return original;
+    }
+    mutexUnlock(&allocator->mutex);
+
+    void* block = hostAllocate(userData, size, alignment, scope);
+    if (!block) return NULL;
+    memcpy(block, original, header->size < size ? header->size : size);
+    mutexLock(&allocator->mutex);
+    // Count the move as one reallocation, not an allocation plus a free.
+    uint32_t oldScope = header->scope;
+    hostReleaseLocked(allocator, original);
+    allocator->scopes[oldScope].frees--;
+    HostAllocScopeStats* stats = &allocator->scopes[hostHeader(block)->scope];
+    stats->allocations--;
+    stats->reallocations++;
+    mutexUnlock(&allocator->mutex);
+    return block;
+}
+
+static void VKAPI_PTR hostInternalAllocation(void* userData, size_t size, VkInternalAllocationType type,
+                                             VkSystemAllocationScope scope) {
+    HostAllocator* allocator = (HostAllocator*)userData;
+    (void)type;
+    if ((uint32_t)scope >= HOST_ALLOC_SCOPE_COUNT) return;
+    mutexLock(&allocator->mutex);
+    allocator->scopes[scope].internalBytes += size;
+    mutexUnlock(&allocator->mutex);
+}
+
+static void VKAPI_PTR hostInternalFree(void* userData, size_t size, VkInternalAllocationType type,
+                                       VkSystemAllocationScope scope) {
+    HostAllocator* allocator = (HostAllocator*)userData;
+    (void)type;
+    if ((uint32_t)scope >= HOST_ALLOC_SCOPE_COUNT) return;
+    mutexLock(&allocator->mutex);
+    allocator->scopes[scope].internalBytes -= size;
+    mutexUnlock(&allocator->mutex);
+}
+
+// Prepares `allocator` and returns the callbacks to pass as pAllocator, or
+// NULL for HOST_ALLOC_SYSTEM. Objects must be destroyed with the same
+// callbacks they were created with, and before hostAllocatorDestroy().
+static const VkAllocationCallbacks* hostAllocatorInit(HostAllocator* allocator, HostAllocMode mode) {
+    memset(allocator, 0, sizeof(*allocator));
+    allocator->mode = mode;
+    if (mode == HOST_ALLOC_SYSTEM) {
+        return NULL;
+    }
+    mutexInit(&allocator->mutex);
+    allocator->callbacks.pUserData = allocator;
+    allocator->callbacks.pfnAllocation = hostAllocate;
+    allocator->callbacks.pfnReallocation = hostReallocate;
+    allocator->callbacks.pfnFree = hostFree;
+    allocator->callbacks.pfnInternalAllocation = hostInternalAllocation;
+    allocator->callbacks.pfnInternalFree = hostInternalFree;
+    return &allocator->callbacks;
+}
+
+// Allocations plus reallocations so far, for per-frame deltas.
+static uint64_t hostAllocatorCalls(HostAllocator* allocator) {
+    if (allocator->mode == HOST_ALLOC_SYSTEM) return 0;
+    mutexLock(&allocator->mutex);
+    uint64_t calls = 0;
+    for (uint32_t s = 0; s < HOST_ALLOC_SCOPE_COUNT; s++) {
+        calls += allocator->scopes[s].allocations + allocator->scopes[s].reallocations;
+    }
+    mutexUnlock(&allocator->mutex);
+    return calls;
+}
+
+// Prints the per-scope table. Bytes still live after every object is gone are
+// a leak (or a driver-side cache freed with the instance).
+static void hostAllocatorReport(HostAllocator* allocator) {
+    if (allocator->mode == HOST_ALLOC_SYSTEM) return;
+    mutexLock(&allocator->mutex);
+    printf("Host allocations (%s): peak %.1f KiB, %llu bytes live, %llu C library calls\n",
+           hostAllocModeNames[allocator->mode], allocator->peakBytes / 1024.0,
+           (unsigned long long)allocator->liveBytes, (unsigned long long)allocator->systemCalls);
+    printf("%-9s %10s %10s %10s %12s %12s %12s\n", "scope", "allocs", "reallocs", "frees", "peak KiB", "total KiB", "internal KiB");
+    for (uint32_t s = 0; s < HOST_ALLOC_SCOPE_COUNT; s++) {
+        const HostAllocScopeStats* stats = &allocator->scopes[s];
+        printf("%-9s %10llu %10llu %10llu %12.1f %12.1f %12.1f\n", hostAllocScopeNames[s],
+               (unsigned long long)stats->allocations, (unsigned long long)stats->reallocations,
+               (unsigned long long)stats->frees, stats->peakBytes / 1024.0, stats->totalBytes / 1024.0,
+               stats->internalBytes / 1024.0);
+    }
+    if (allocator->mode == HOST_ALLOC_ARENA) {
+        printf("Arena: %llu rewinds; pool: %llu reuses\n", (unsigned long long)allocator->arenaRewinds,
+               (unsigned long long)allocator->poolReuses);
+    }
+    mutexUnlock(&allocator->mutex);
+}
+
+static void hostAllocatorDestroy(HostAllocator* allocator) {
+    if (allocator->mode == HOST_ALLOC_SYSTEM) return;
+    hostChunkFreeAll(allocator->arenaChunks);
+    hostChunkFreeAll(allocator->poolChunks);
+    mutexDestroy(&allocator->mutex);
+}
+
+// Parses a mode name; HOST_ALLOC_MODE_COUNT if unknown.
+static HostAllocMode parseHostAllocMode(const char* name) {
+    uint32_t mode = 0;
+    while (mode < HOST_ALLOC_MODE_COUNT && strcmp(name, hostAllocModeNames[mode]) != 0) mode++;
+    return (HostAllocMode)mode;
+}
+
+#endif // HOST_ALLOC_H
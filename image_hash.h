@@ -0,0 +1,233 @@
+// image_hash.h
+// GPU image hashing (shaderImageHash.comp) shared by the render and compute
+// programs, plus the matching CPU reference. Include after vulkan_functions.h;
+// the including file provides findMemoryType(). Without <vulkan/vulkan.h>
+// only the CPU reference and the hex helpers are declared.
+
+#ifndef IMAGE_HASH_H
+#define IMAGE_HASH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define IMAGE_HASH_WORDS 4
+#define IMAGE_HASH_HEX_LENGTH (IMAGE_HASH_WORDS * 8)
+
+static const uint32_t imageHashSeeds[IMAGE_HASH_WORDS] = {0x243F6A88u, 0x85A308D3u, 0x13198A2Eu, 0x03707344u};
+
+static uint32_t imageHashMix(uint32_t h) {
+    h ^= h >> 16;
+    h *= 0x85EBCA6Bu;
+    h ^= h >> 13;
+    h *= 0xC2B2AE35u;
+    h ^= h >> 16;
+    return h;
+}
+
+// CPU reference of shaderImageHash.comp over tightly packed RGBA8 pixels.
+static void imageHashCpu(const uint8_t* rgba, uint32_t width, uint32_t height, uint32_t words[IMAGE_HASH_WORDS]) {
+    memset(words, 0, sizeof(uint32_t) * IMAGE_HASH_WORDS);
+    uint32_t count = width * height;
+    for (uint32_t index = 0; index < count; index++) {
+        const uint8_t* p = rgba + (size_t)index * 4;
+        uint32_t pixel = (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+        words[0] += imageHashMix(pixel ^ imageHashMix(index ^ imageHashSeeds[0]));
+        words[1] += imageHashMix(pixel ^ imageHashMix(index ^ imageHashSeeds[1]));
+        words[2] ^= imageHashMix(pixel ^ imageHashMix(index ^ imageHashSeeds[2]));
+        words[3] ^= imageHashMix(pixel ^ imageHashMix(index ^ imageHashSeeds[3]));
+    }
+}
+
+// Formats the words as 32 hex digits; `text` needs IMAGE_HASH_HEX_LENGTH + 1 bytes.
+static void imageHashToHex(const uint32_t words[IMAGE_HASH_WORDS], char* text) {
+    for (uint32_t i = 0; i < IMAGE_HASH_WORDS; i++) {
+        snprintf(text + i * 8, 9, "%08x", words[i]);
+    }
+}
+
+// Parses 32 hex digits. Returns 0 on malformed input.
+static int imageHashFromHex(const char* text, uint32_t words[IMAGE_HASH_WORDS]) {
+    if (strlen(text) != IMAGE_HASH_HEX_LENGTH) {
+        return 0;
+    }
+    for (uint32_t i = 0; i < IMAGE_HASH_WORDS; i++) {
+        char chunk[9];
+        char* end;
+        memcpy(chunk, text + i * 8, 8);
+        chunk[8] = '\0';
+        words[i] = (uint32_t)strtoul(chunk, &end, 16);
+        if (*end != '\0') {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// The GPU side needs the Vulkan types; the CPU reference above does not.
+#ifdef VK_VERSION_1_0
+
+#include "host_alloc.h"
+#include "memory_budget.h"
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// Everything needed to record the hash pass for one storage image view.
+typedef struct {
+    VkDevice device;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    uint32_t* words; // Persistently mapped result.
+} ImageHasher;
+
+// Builds the hash pipeline for `imageView` (rgba8, GENERAL layout when the
+// pass runs) from the shaderImageHash.comp module. Returns 0 on failure.
+static int imageHasherCreate(ImageHasher* hasher, VkDevice device, VkPhysicalDevice physicalDevice,
+                             VkShaderModule module, VkImageView imageView) {
+    memset(hasher, 0, sizeof(*hasher));
+    hasher->device = device;
+
+    VkBufferCreateInfo bufferCreateInfo = {0};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = sizeof(uint32_t) * IMAGE_HASH_WORDS;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &hasher->buffer) != VK_SUCCESS) {
+        return 0;
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, hasher->buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (memoryBudgetAllocate(device, &allocInfo, &hasher->memory, "image hash") != VK_SUCCESS ||
+        vkBindBufferMemory(device, hasher->buffer, hasher->memory, 0) != VK_SUCCESS ||
+        vkMapMemory(device, hasher->memory, 0, VK_WHOLE_SIZE, 0, (void**)&hasher->words) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorSetLayoutBinding layoutBindings[] = {
+        { 0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+        { 1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_COMPUTE_BIT, NULL },
+    };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {0};
+    setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutCreateInfo.bindingCount = 2;
+    setLayoutCreateInfo.pBindings = layoutBindings;
+    if (vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &hasher->setLayout) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorPoolSize poolSizes[] = {
+        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+        { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+    };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {0};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.poolSizeCount = 2;
+    poolCreateInfo.pPoolSizes = poolSizes;
+    poolCreateInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &hasher->descriptorPool) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {0};
+    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocInfo.descriptorPool = hasher->descriptorPool;
+    descriptorSetAllocInfo.descriptorSetCount = 1;
+    descriptorSetAllocInfo.pSetLayouts = &hasher->setLayout;
+    if (vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &hasher->descriptorSet) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorImageInfo imageInfo = { VK_NULL_HANDLE, imageView, VK_IMAGE_LAYOUT_GENERAL };
+    VkDescriptorBufferInfo bufferInfo = { hasher->buffer, 0, VK_WHOLE_SIZE };
+    VkWriteDescriptorSet writes[2] = {{0}, {0}};
+    writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[0].dstSet = hasher->descriptorSet;
+    writes[0].dstBinding = 0;
+    writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+    writes[0].descriptorCount = 1;
+    writes[0].pImageInfo = &imageInfo;
+    writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    writes[1].dstSet = hasher->descriptorSet;
+    writes[1].dstBinding = 1;
+    writes[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    writes[1].descriptorCount = 1;
+    writes[1].pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(device, 2, writes, 0, NULL);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {0};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &hasher->setLayout;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &hasher->pipelineLayout) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkComputePipelineCreateInfo pipelineCreateInfo = {0};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineCreateInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineCreateInfo.stage.module = module;
+    pipelineCreateInfo.stage.pName = "main";
+    pipelineCreateInfo.layout = hasher->pipelineLayout;
+    return vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineCreateInfo, hostCallbacks, &hasher->pipeline) == VK_SUCCESS;
+}
+
+// Records the hash of `image` (already in GENERAL layout, with the producer's
+// writes made available to compute-shader reads by the caller) into the
+// hasher's buffer, and makes the result visible to the host.
+static void imageHasherRecord(const ImageHasher* hasher, VkCommandBuffer commandBuffer, uint32_t width, uint32_t height) {
+    vkCmdFillBuffer(commandBuffer, hasher->buffer, 0, VK_WHOLE_SIZE, 0);
+
+    VkMemoryBarrier clearBarrier = {0};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, NULL, 0, NULL);
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hasher->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, hasher->pipelineLayout, 0, 1, &hasher->descriptorSet, 0, NULL);
+    vkCmdDispatch(commandBuffer, (width + 15) / 16, (height + 15) / 16, 1);
+
+    VkMemoryBarrier hostBarrier = {0};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, NULL, 0, NULL);
+}
+
+static void imageHasherDestroy(ImageHasher* hasher) {
+    VkDevice device = hasher->device;
+    vkDestroyPipeline(device, hasher->pipeline, hostCallbacks);
+    vkDestroyPipelineLayout(device, hasher->pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, hasher->descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, hasher->setLayout, hostCallbacks);
+    vkDestroyBuffer(device, hasher->buffer, hostCallbacks);
+    memoryBudgetFree(device, hasher->memory);
+}
+
+// Whether the device can run shaderImageHash.comp (subgroup arithmetic in compute).
+static int imageHashSupported(VkPhysicalDevice physicalDevice) {
+    VkPhysicalDeviceSubgroupProperties subgroupProperties = {0};
+    subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+    VkPhysicalDeviceProperties2 properties2 = {0};
+    properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+    properties2.pNext = &subgroupProperties;
+    vkGetPhysicalDeviceProperties2(physicalDevice, &properties2);
+    return (subgroupProperties.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+           (subgroupProperties.supportedOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT);
+}
+
+#endif // VK_VERSION_1_0
+
+#endif // IMAGE_HASH_H
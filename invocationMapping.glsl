@@ -0,0 +1,75 @@
+// invocationMapping.glsl
+// Shared remapping layer for the 16x16 compute kernels.
+//
+// Instead of using gl_GlobalInvocationID.xy directly, kernels call
+// mappedInvocationPos() to decide which pixel an invocation owns. The mapping
+// is chosen at pipeline creation time through specialization constants, so
+// the driver folds the index math away:
+//
+//   INVOCATION_MAPPING = 0  linear  - row-major, a 32-wide subgroup covers a 16x2 strip
+//   INVOCATION_MAPPING = 1  morton  - Z-order curve, a 32-wide subgroup covers an 8x4 block
+//   INVOCATION_MAPPING = 2  tiled   - row-major TILE_WIDTH x TILE_HEIGHT blocks
+//
+// The tile origin is derived from the flattened workgroup index, so the same
+// shader works for both a (W/16, H/16, 1) and a (W/16 * H/16, 1, 1) dispatch.
+
+#define WORKGROUP_DIM 16u
+
+layout(constant_id = 0) const uint INVOCATION_MAPPING = 0;
+layout(constant_id = 1) const uint TILE_WIDTH = 8;
+layout(constant_id = 2) const uint TILE_HEIGHT = 4;
+
+// Compacts the even bits of an 8-bit value into the low nibble.
+uint compactEvenBits(uint v) {
+    v &= 0x55u;
+    v = (v | (v >> 1)) & 0x33u;
+    v = (v | (v >> 2)) & 0x0Fu;
+    return v;
+}
+
+// Inverse of compactEvenBits: spreads a nibble into the even bits of a byte.
+uint spreadEvenBits(uint v) {
+    v &= 0x0Fu;
+    v = (v | (v << 2)) & 0x33u;
+    v = (v | (v << 1)) & 0x55u;
+    return v;
+}
+
+// Maps gl_LocalInvocationIndex (0..255) to a position inside the 16x16 tile.
+uvec2 mapLocalIndex(uint index) {
+    if (INVOCATION_MAPPING == 1u) {
+        return uvec2(compactEvenBits(index), compactEvenBits(index >> 1));
+    } else if (INVOCATION_MAPPING == 2u) {
+        uint blockSize = TILE_WIDTH * TILE_HEIGHT;
+        uint blocksPerRow = WORKGROUP_DIM / TILE_WIDTH;
+        uint block = index / blockSize;
+        uint within = index % blockSize;
+        return uvec2((block % blocksPerRow) * TILE_WIDTH + within % TILE_WIDTH,
+                     (block / blocksPerRow) * TILE_HEIGHT + within / TILE_WIDTH);
+    }
+    return uvec2(index % WORKGROUP_DIM, index / WORKGROUP_DIM);
+}
+
+// Inverse of mapLocalIndex: which local invocation owns a position in the tile.
+uint unmapLocalPos(uvec2 pos) {
+    if (INVOCATION_MAPPING == 1u) {
+        return spreadEvenBits(pos.x) | (spreadEvenBits(pos.y) << 1);
+    } else if (INVOCATION_MAPPING == 2u) {
+        uint blocksPerRow = WORKGROUP_DIM / TILE_WIDTH;
+        uint block = (pos.y / TILE_HEIGHT) * blocksPerRow + pos.x / TILE_WIDTH;
+        return block * TILE_WIDTH * TILE_HEIGHT + (pos.y % TILE_HEIGHT) * TILE_WIDTH + pos.x % TILE_WIDTH;
+    }
+    return pos.y * WORKGROUP_DIM + pos.x;
+}
+
+// Top-left pixel of the tile owned by the current workgroup.
+uvec2 workgroupOrigin(ivec2 size) {
+    uint tilesX = (uint(size.x) + WORKGROUP_DIM - 1u) / WORKGROUP_DIM;
+    uint groupIndex = gl_WorkGroupID.y * gl_NumWorkGroups.x + gl_WorkGroupID.x;
+    return uvec2(groupIndex % tilesX, groupIndex / tilesX) * WORKGROUP_DIM;
+}
+
+// Pixel coordinate owned by the current invocation.
+ivec2 mappedInvocationPos(ivec2 size) {
+    return ivec2(workgroupOrigin(size) + mapLocalIndex(gl_LocalInvocationIndex));
+}
@@ -0,0 +1,49 @@
+// laneStats.glsl
+// Subgroup occupancy counters for the graphics vs compute kernels
+// (shaderVersus.frag, shaderComputeVersus.comp). Built with -DLANE_STATS the
+// kernels call recordLaneStats() once per invocation; without it the call is
+// empty, so timed runs pay nothing. Needs the basic, ballot and shuffle
+// subgroup extensions.
+//
+// A quad is lanes 4k..4k+3. It counts as a 2x2 block when those lanes own
+// the pixels (x, y), (x+1, y), (x, y+1), (x+1, y+1) in that order, which is
+// how fragment quads are laid out and what the morton mapping produces.
+
+#ifdef LANE_STATS
+layout(set = 0, binding = 1, std430) buffer LaneStats {
+    uint subgroups;   // Subgroups with at least one non-helper lane.
+    uint activeLanes; // Non-helper lanes in those subgroups.
+    uint helperLanes; // Helper lanes that took part in subgroup operations.
+    uint quads;       // Quads with all four lanes active.
+    uint blockQuads;  // Of those, quads that cover one 2x2 pixel block.
+} laneStats;
+#endif
+
+void recordLaneStats(ivec2 pixel, bool helper) {
+#ifdef LANE_STATS
+    uint lane = gl_SubgroupInvocationID;
+    uvec4 active = subgroupBallot(true);
+    uvec4 real = subgroupBallot(!helper);
+
+    // Where the rest of this lane's quad landed. Only read for full quads,
+    // since shuffling from an inactive lane is undefined.
+    ivec2 right = subgroupShuffleXor(pixel, 1u);
+    ivec2 below = subgroupShuffleXor(pixel, 2u);
+    ivec2 diagonal = subgroupShuffleXor(pixel, 3u);
+    uint first = lane & ~3u;
+    bool quadActive = subgroupBallotBitExtract(active, first) && subgroupBallotBitExtract(active, first + 1u) &&
+                      subgroupBallotBitExtract(active, first + 2u) && subgroupBallotBitExtract(active, first + 3u);
+    bool block = right == pixel + ivec2(1, 0) && below == pixel + ivec2(0, 1) && diagonal == pixel + ivec2(1, 1);
+    uvec4 quads = subgroupBallot(lane == first && quadActive);
+    uvec4 blockQuads = subgroupBallot(lane == first && quadActive && block);
+
+    // Helper invocations can't write memory, so a real lane reports.
+    if (!helper && lane == subgroupBallotFindLSB(real)) {
+        atomicAdd(laneStats.subgroups, 1u);
+        atomicAdd(laneStats.activeLanes, subgroupBallotBitCount(real));
+        atomicAdd(laneStats.helperLanes, subgroupBallotBitCount(active) - subgroupBallotBitCount(real));
+        atomicAdd(laneStats.quads, subgroupBallotBitCount(quads));
+        atomicAdd(laneStats.blockQuads, subgroupBallotBitCount(blockQuads));
+    }
+#endif
+}
@@ -0,0 +1,267 @@
+// lane_sweep.h
+// Fragment-stage lane utilization for the render program (--lane-sweep):
+// draws instanced grids of small triangles (shaderGrid.vert) with
+// shaderLaneStats.frag, which counts per-subgroup active lanes, helper lanes
+// and primitives into a host-visible buffer. Sweeping the triangle size and
+// count shows where fragment subgroups stop filling up. Include after
+// vulkan_functions.h; the including file provides findMemoryType().
+
+#ifndef LANE_SWEEP_H
+#define LANE_SWEEP_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "host_alloc.h"
+#include "memory_budget.h"
+
+uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties);
+
+// Non-helper lane counts 0..128, the largest subgroup Vulkan allows.
+#define LANE_SWEEP_HISTOGRAM_BINS 129
+
+// Matches the LaneUtilization block in shaderLaneStats.frag.
+typedef struct {
+    uint32_t subgroups;
+    uint32_t activeLanes;
+    uint32_t helperLanes;
+    uint32_t primitives;
+    uint32_t histogram[LANE_SWEEP_HISTOGRAM_BINS];
+} LaneSweepStats;
+
+// Matches the push constants of shaderGrid.vert.
+typedef struct {
+    uint32_t cellSize;
+    uint32_t columns;
+} LaneSweepGrid;
+
+typedef struct {
+    VkDevice device;
+    VkDescriptorSetLayout setLayout;
+    VkDescriptorPool descriptorPool;
+    VkDescriptorSet descriptorSet;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    VkBuffer buffer;
+    VkDeviceMemory memory;
+    LaneSweepStats* stats; // Persistently mapped counters.
+} LaneSweep;
+
+// Builds the grid pipeline for `renderPass` (one rgba8 attachment of
+// width x height) from the shaderGrid.vert and shaderLaneStats.frag modules.
+// Returns 0 on failure.
+static int laneSweepCreate(LaneSweep* sweep, VkDevice device, VkPhysicalDevice physicalDevice, VkRenderPass renderPass,
+                           uint32_t width, uint32_t height, VkShaderModule vertModule, VkShaderModule fragModule,
+                           VkPipelineCache pipelineCache) {
+    memset(sweep, 0, sizeof(*sweep));
+    sweep->device = device;
+
+    VkBufferCreateInfo bufferCreateInfo = {0};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = sizeof(LaneSweepStats);
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    if (vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &sweep->buffer) != VK_SUCCESS) {
+        return 0;
+    }
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, sweep->buffer, &memRequirements);
+    VkMemoryAllocateInfo allocInfo = {0};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = memRequirements.size;
+    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits,
+                                               VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    if (memoryBudgetAllocate(device, &allocInfo, &sweep->memory, "lane sweep stats") != VK_SUCCESS ||
+        vkBindBufferMemory(device, sweep->buffer, sweep->memory, 0) != VK_SUCCESS ||
+        vkMapMemory(device, sweep->memory, 0, VK_WHOLE_SIZE, 0, (void**)&sweep->stats) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorSetLayoutBinding layoutBinding = { 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, NULL };
+    VkDescriptorSetLayoutCreateInfo setLayoutCreateInfo = {0};
+    setLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    setLayoutCreateInfo.bindingCount = 1;
+    setLayoutCreateInfo.pBindings = &layoutBinding;
+    if (vkCreateDescriptorSetLayout(device, &setLayoutCreateInfo, hostCallbacks, &sweep->setLayout) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 };
+    VkDescriptorPoolCreateInfo poolCreateInfo = {0};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolCreateInfo.poolSizeCount = 1;
+    poolCreateInfo.pPoolSizes = &poolSize;
+    poolCreateInfo.maxSets = 1;
+    if (vkCreateDescriptorPool(device, &poolCreateInfo, hostCallbacks, &sweep->descriptorPool) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorSetAllocateInfo descriptorSetAllocInfo = {0};
+    descriptorSetAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    descriptorSetAllocInfo.descriptorPool = sweep->descriptorPool;
+    descriptorSetAllocInfo.descriptorSetCount = 1;
+    descriptorSetAllocInfo.pSetLayouts = &sweep->setLayout;
+    if (vkAllocateDescriptorSets(device, &descriptorSetAllocInfo, &sweep->descriptorSet) != VK_SUCCESS) {
+        return 0;
+    }
+
+    VkDescriptorBufferInfo bufferInfo = { sweep->buffer, 0, VK_WHOLE_SIZE };
+    VkWriteDescriptorSet write = {0};
+    write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    write.dstSet = sweep->descriptorSet;
+    write.dstBinding = 0;
+    write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    write.descriptorCount = 1;
+    write.pBufferInfo = &bufferInfo;
+    vkUpdateDescriptorSets(device, 1, &write, 0, NULL);
+
+    VkPushConstantRange pushConstantRange = { VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(LaneSweepGrid) };
+    VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo = {0};
+    pipelineLayoutCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutCreateInfo.setLayoutCount = 1;
+    pipelineLayoutCreateInfo.pSetLayouts = &sweep->setLayout;
+    pipelineLayoutCreateInfo.pushConstantRangeCount = 1;
+    pipelineLayoutCreateInfo.pPushConstantRanges = &pushConstantRange;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, hostCallbacks, &sweep->pipelineLayout) != VK_SUCCESS) {
+        return 0;
+    }
+
+    // The grid maps pixels to clip space itself, so it needs the target size.
+    uint32_t renderSize[2] = { width, height };
+    VkSpecializationMapEntry sizeEntries[2] = { { 0, 0, sizeof(uint32_t) }, { 1, sizeof(uint32_t), sizeof(uint32_t) } };
+    VkSpecializationInfo vertSpecialization = { 2, sizeEntries, sizeof(renderSize), renderSize };
+
+    VkPipelineShaderStageCreateInfo stages[2] = {{0}, {0}};
+    stages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    stages[0].module = vertModule;
+    stages[0].pName = "main";
+    stages[0].pSpecializationInfo = &vertSpecialization;
+    stages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    stages[1].module = fragModule;
+    stages[1].pName = "main";
+
+    VkPipelineVertexInputStateCreateInfo vertexInput = {0};
+    vertexInput.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {0};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+
+    VkViewport viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { width, height } };
+    VkPipelineViewportStateCreateInfo viewportState = {0};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.pViewports = &viewport;
+    viewportState.scissorCount = 1;
+    viewportState.pScissors = &scissor;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer = {0};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling = {0};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment = {0};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    VkPipelineColorBlendStateCreateInfo colorBlending = {0};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
+
+    VkGraphicsPipelineCreateInfo pipelineCreateInfo = {0};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stageCount = 2;
+    pipelineCreateInfo.pStages = stages;
+    pipelineCreateInfo.pVertexInputState = &vertexInput;
+    pipelineCreateInfo.pInputAssemblyState = &inputAssembly;
+    pipelineCreateInfo.pViewportState = &viewportState;
+    pipelineCreateInfo.pRasterizationState = &rasterizer;
+    pipelineCreateInfo.pMultisampleState = &multisampling;
+    pipelineCreateInfo.pColorBlendState = &colorBlending;
+    pipelineCreateInfo.layout = sweep->pipelineLayout;
+    pipelineCreateInfo.renderPass = renderPass;
+    return vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCreateInfo, hostCallbacks, &sweep->pipeline) == VK_SUCCESS;
+}
+
+// Records one sweep point: clears the counters, draws `count` triangles with
+// legs of `cellSize` pixels in the render pass of `beginInfo`, and makes the
+// counters visible to the host. Timestamps 0 and 1 of `queryPool` bracket
+// the draw unless it is VK_NULL_HANDLE.
+static void laneSweepRecord(const LaneSweep* sweep, VkCommandBuffer commandBuffer, const VkRenderPassBeginInfo* beginInfo,
+                            uint32_t cellSize, uint32_t count, VkQueryPool queryPool) {
+    vkCmdFillBuffer(commandBuffer, sweep->buffer, 0, VK_WHOLE_SIZE, 0);
+
+    // The clear reaches the fragment atomics; the previous point's colour
+    // writes finish before this pass clears the attachment again.
+    VkMemoryBarrier clearBarrier = {0};
+    clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+                         VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 1, &clearBarrier, 0, NULL, 0, NULL);
+
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, 2);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+    LaneSweepGrid grid = { cellSize, beginInfo->renderArea.extent.width / cellSize };
+    vkCmdBeginRenderPass(commandBuffer, beginInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sweep->pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, sweep->pipelineLayout, 0, 1, &sweep->descriptorSet, 0, NULL);
+    vkCmdPushConstants(commandBuffer, sweep->pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(grid), &grid);
+    vkCmdDraw(commandBuffer, 3, count, 0, 0);
+    vkCmdEndRenderPass(commandBuffer);
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, 1);
+    }
+
+    VkMemoryBarrier hostBarrier = {0};
+    hostBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    hostBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    hostBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &hostBarrier, 0, NULL, 0, NULL);
+}
+
+// Prints one row of the sweep table from the counters of the last point.
+// `gpuMs` is negative when the device has no timestamps.
+static void laneSweepPrintRow(const LaneSweep* sweep, uint32_t cellSize, uint32_t count, uint32_t subgroupSize, double gpuMs) {
+    const LaneSweepStats* stats = sweep->stats;
+    printf("%5u px %7u  %8u", cellSize, count, stats->subgroups);
+    if (stats->subgroups == 0) {
+        printf("  (no fragments)\n");
+        return;
+    }
+    double lanes = (double)stats->activeLanes / stats->subgroups;
+    double helpers = (double)stats->helperLanes / stats->subgroups;
+    // The most common non-helper lane count.
+    uint32_t mode = 0;
+    for (uint32_t bin = 1; bin < LANE_SWEEP_HISTOGRAM_BINS; bin++) {
+        if (stats->histogram[bin] > stats->histogram[mode]) mode = bin;
+    }
+    printf("  %6.1f %5.1f%%  %6.1f  %4u  %9.2f", lanes, 100.0 * lanes / subgroupSize, helpers, mode,
+           (double)stats->primitives / stats->subgroups);
+    if (gpuMs >= 0.0) {
+        printf("  %8.3f", gpuMs);
+    }
+    printf("\n");
+}
+
+static void laneSweepDestroy(LaneSweep* sweep) {
+    VkDevice device = sweep->device;
+    vkDestroyPipeline(device, sweep->pipeline, hostCallbacks);
+    vkDestroyPipelineLayout(device, sweep->pipelineLayout, hostCallbacks);
+    vkDestroyDescriptorPool(device, sweep->descriptorPool, hostCallbacks);
+    vkDestroyDescriptorSetLayout(device, sweep->setLayout, hostCallbacks);
+    vkDestroyBuffer(device, sweep->buffer, hostCallbacks);
+    memoryBudgetFree(device, sweep->memory);
+}
+
+#endif // LANE_SWEEP_H
@@ -25,29 +25,25 @@ const int HEIGHT = 256;
 #define EXPORTED_VULKAN_FUNCTION( name ) PFN_##name name;
 #define GLOBAL_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
 #define INSTANCE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
+#define OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
 #define DEVICE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
+#define OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( name ) PFN_##name name;
 
 #include "vulkan_functions.h"
 
-// --- Helper Functions ---
-
-void queryAndReportSubgroupSize(VkPhysicalDevice physicalDevice) {
-#if defined(VK_KHR_get_physical_device_properties2)
-    VkPhysicalDeviceSubgroupProperties subgroupProps = {0};
-    subgroupProps.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
-
-    VkPhysicalDeviceProperties2 deviceProps2 = {0};
-    deviceProps2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
-    deviceProps2.pNext = &subgroupProps;
-
-    vkGetPhysicalDeviceProperties2(physicalDevice, &deviceProps2);
+#include "timing.h"
+#include "host_alloc.h"
+#include "memory_budget.h"
+#include "trace.h"
+#include "frame_params.h"
+#include "image_hash.h"
+#include "device_select.h"
+#include "shuffle_variants.h"
+#include "spirv_bundle.h"
+#include "lane_sweep.h"
+#include "gpu_counters.h"
 
-    // subgroupProps.subgroupSize now holds the subgroup size (number of invocations per subgroup)
-    printf("Subgroup size: %u\n", subgroupProps.subgroupSize);
-#else
-    printf("VK_KHR_get_physical_device_properties2 not supported. Cannot query subgroup size.\n");
-#endif
-};
+// --- Helper Functions ---
 
 // Finds a suitable memory type index.
 uint32_t findMemoryType(VkPhysicalDevice physicalDevice, uint32_t typeFilter, VkMemoryPropertyFlags properties) {
@@ -88,6 +84,28 @@ char* readShaderFile(const char* filename, size_t* pSize) {
 }
 
 // Creates a VkShaderModule from SPIR-V code.
+VkShaderModule createShaderModule(VkDevice device, const char* code, size_t size);
+
+// Creates a VkShaderModule straight from the bundle's mapping when it holds
+// `path`, otherwise from the file. Returns VK_NULL_HANDLE if the file can't
+// be read.
+VkShaderModule loadShaderModule(VkDevice device, const SpirvBundle* bundle, const char* path) {
+    if (bundle->data != NULL) {
+        VkShaderModule bundledModule = spirvBundleCreateModule(device, bundle, path);
+        if (bundledModule != VK_NULL_HANDLE) {
+            return bundledModule;
+        }
+    }
+    size_t size;
+    char* code = readShaderFile(path, &size);
+    if (!code) {
+        return VK_NULL_HANDLE;
+    }
+    VkShaderModule shaderModule = createShaderModule(device, code, size);
+    free(code);
+    return shaderModule;
+}
+
 VkShaderModule createShaderModule(VkDevice device, const char* code, size_t size) {
     VkShaderModuleCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
@@ -95,7 +113,7 @@ VkShaderModule createShaderModule(VkDevice device, const char* code, size_t size
     createInfo.pCode = (const uint32_t*)code;
 
     VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &createInfo, NULL, &shaderModule) != VK_SUCCESS) {
+    if (vkCreateShaderModule(device, &createInfo, hostCallbacks, &shaderModule) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create shader module!\n");
         exit(EXIT_FAILURE);
     }
@@ -105,6 +123,112 @@ VkShaderModule createShaderModule(VkDevice device, const char* code, size_t size
 
 // --- Main Application Logic ---
 int main(int argc, char **argv) {
+    // Usage: render <vert.spv> <frag.spv> <output.ppm> [frames] [reverse|rotate|xor] [--hash] [--verify <hex>] [--device <sel>] [--report <file|->] [--host-alloc system|tracking|arena] [--memory-log <file|->] [--trace <file.json>] [--spec-pattern <name[:arg]>] [--bundle <file.spvb>] [--lane-sweep] [--stats]
+    if (argc < 4) {
+        fprintf(stderr, "Usage: %s <vert.spv> <frag.spv> <output.ppm> [frames] [reverse|rotate|xor] [--hash] [--verify <hex>] [--device <sel>] [--report <file|->] [--host-alloc system|tracking|arena] [--memory-log <file|->] [--trace <file.json>] [--spec-pattern <name[:arg]>] [--bundle <file.spvb>] [--lane-sweep] [--stats]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint32_t frameCount = 1;
+    uint32_t shufflePattern = SHUFFLE_PATTERN_REVERSE;
+    int hashOutput = 0;             // GPU hash checked against a full readback.
+    const char* expectedHash = NULL; // GPU hash only, no image readback.
+    uint32_t expectedWords[IMAGE_HASH_WORDS];
+    const char* deviceSelector = NULL; // Index, name or UUID; see device_select.h.
+    const char* reportPath = NULL;     // JSON capability report.
+    HostAllocMode hostAlloc = HOST_ALLOC_SYSTEM; // Driver host allocations, see host_alloc.h.
+    int hostAllocReport = 0;
+    const char* memoryLogPath = NULL; // Device memory timeline, see memory_budget.h.
+    const char* tracePath = NULL;     // Chrome trace-event JSON, see trace.h.
+    int specPattern = 0;              // Specialize the fragment shader, see shuffle_variants.h.
+    ShuffleVariant shuffleVariant = {};
+    const char* bundlePath = NULL;    // Shaders from one mapped file, see spirv_bundle.h.
+    int laneSweep = 0;                // Fragment subgroup packing vs geometry, see lane_sweep.h.
+    int stats = 0;                    // Statistics and counters per render pass, see gpu_counters.h.
+    int positional = 0;
+    const char* valueFlags[] = { "--verify", "--device", "--report", "--host-alloc", "--memory-log", "--trace", "--bundle", "--spec-pattern" };
+    for (int i = 4; i < argc; i++) {
+        // A value flag as the last argument must not fall through to the positionals.
+        for (size_t f = 0; f < sizeof(valueFlags) / sizeof(valueFlags[0]); f++) {
+            if (strcmp(argv[i], valueFlags[f]) == 0 && i + 1 >= argc) {
+                fprintf(stderr, "Missing value for %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        if (strcmp(argv[i], "--hash") == 0) {
+            hashOutput = 1;
+        } else if (strcmp(argv[i], "--verify") == 0) {
+            expectedHash = argv[++i];
+            if (!imageHashFromHex(expectedHash, expectedWords)) {
+                fprintf(stderr, "Invalid --verify %s (expected %d hex digits)\n", expectedHash, IMAGE_HASH_HEX_LENGTH);
+                return EXIT_FAILURE;
+            }
+        } else if (strcmp(argv[i], "--device") == 0) {
+            deviceSelector = argv[++i];
+        } else if (strcmp(argv[i], "--report") == 0) {
+            reportPath = argv[++i];
+        } else if (strcmp(argv[i], "--host-alloc") == 0) {
+            hostAlloc = parseHostAllocMode(argv[++i]);
+            if (hostAlloc == HOST_ALLOC_MODE_COUNT) {
+                fprintf(stderr, "Unknown host allocator: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            hostAllocReport = 1;
+        } else if (strcmp(argv[i], "--memory-log") == 0) {
+            memoryLogPath = argv[++i];
+        } else if (strcmp(argv[i], "--trace") == 0) {
+            tracePath = argv[++i];
+        } else if (strcmp(argv[i], "--lane-sweep") == 0) {
+            laneSweep = 1;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats = 1;
+        } else if (strcmp(argv[i], "--bundle") == 0) {
+            bundlePath = argv[++i];
+        } else if (strcmp(argv[i], "--spec-pattern") == 0) {
+            if (!parseShuffleVariant(argv[++i], &shuffleVariant)) {
+                fprintf(stderr, "Unknown shuffle pattern: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            specPattern = 1;
+        } else if (positional == 0) {
+            frameCount = (uint32_t)strtoul(argv[i], NULL, 10);
+            positional++;
+        } else {
+            shufflePattern = parseShufflePattern(argv[i]);
+            positional++;
+        }
+    }
+    if (frameCount == 0 || shufflePattern == SHUFFLE_PATTERN_COUNT) {
+        fprintf(stderr, "Invalid frame count or shuffle pattern.\n");
+        return EXIT_FAILURE;
+    }
+    // --report - or --memory-log -: claim stdout for it before anything is
+    // printed. Only one of them can have it.
+    int reportToStdout = reportPath != NULL && strcmp(reportPath, "-") == 0;
+    int memoryLogToStdout = memoryLogPath != NULL && strcmp(memoryLogPath, "-") == 0;
+    if (reportToStdout && memoryLogToStdout) {
+        fprintf(stderr, "--report - and --memory-log - can't both write to stdout.\n");
+        return EXIT_FAILURE;
+    }
+    if (reportToStdout || memoryLogToStdout) {
+        stdoutClaim();
+    }
+    int hashing = hashOutput || expectedHash != NULL;
+
+    // Every startup phase below is a CPU span in the trace.
+    traceInit(tracePath != NULL);
+    double span = traceBegin();
+
+    // With --bundle the shaders and the pipeline cache key come from one
+    // mapped file; paths the bundle lacks are still read from disk.
+    SpirvBundle shaderBundle = {};
+    if (bundlePath != NULL) {
+        if (!spirvBundleOpen(&shaderBundle, bundlePath)) {
+            return EXIT_FAILURE;
+        }
+        traceEnd("map shader bundle", span);
+        span = traceBegin();
+    }
+
 #if defined(__linux__)
     // --- 1. Load Vulkan Loader ---
     void* vulkan_library = dlopen("libvulkan.so.1", RTLD_NOW | RTLD_LOCAL);
@@ -139,8 +263,15 @@ int main(int argc, char **argv) {
 #endif
 
     #include "vulkan_functions.h"
+    traceEnd("load Vulkan loader", span);
 
     // --- 2. Create Vulkan Instance ---
+    // Driver host allocations go through the chosen allocator from here on;
+    // startup is timed from here to a ready pipeline.
+    double startupStart = getTimeSeconds();
+    HostAllocator hostAllocator;
+    hostCallbacks = hostAllocatorInit(&hostAllocator, hostAlloc);
+
     VkApplicationInfo appInfo = {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName = "Offscreen Renderer";
@@ -154,10 +285,13 @@ int main(int argc, char **argv) {
     instanceCreateInfo.pApplicationInfo = &appInfo;
 
     VkInstance instance;
-    if (vkCreateInstance(&instanceCreateInfo, NULL, &instance) != VK_SUCCESS) {
+    span = traceBegin();
+    if (vkCreateInstance(&instanceCreateInfo, hostCallbacks, &instance) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create Vulkan instance!\n");
         return EXIT_FAILURE;
     }
+    traceEnd("vkCreateInstance", span);
+    span = traceBegin();
     
     // Load global and instance level functions
     #define GLOBAL_LEVEL_VULKAN_FUNCTION( name ) \
@@ -172,49 +306,50 @@ int main(int argc, char **argv) {
             fprintf(stderr, "Could not load instance-level Vulkan function %s\n", #name); \
             return EXIT_FAILURE; \
         }
+    // Extension functions stay NULL when the loader doesn't know them.
+    #define OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( name ) \
+        name = (PFN_##name)vkGetInstanceProcAddr(instance, #name);
     #include "vulkan_functions.h"
+    traceEnd("load instance functions", span);
 
 
     // --- 3. Select Physical Device ---
+    // The best scoring device with a suitable queue, unless --device or
+    // $SUBGROUP_DEVICE names another. The hash pass runs on the same queue,
+    // so it must support compute too.
+    span = traceBegin();
+    VkQueueFlags requiredQueueFlags = VK_QUEUE_GRAPHICS_BIT | (hashing ? VK_QUEUE_COMPUTE_BIT : 0);
     uint32_t deviceCount = 0;
-    vkEnumeratePhysicalDevices(instance, &deviceCount, NULL);
+    DeviceInfo* deviceInfos = deviceQueryAll(instance, requiredQueueFlags, VK_SHADER_STAGE_FRAGMENT_BIT, &deviceCount);
     if (deviceCount == 0) {
         fprintf(stderr, "Failed to find GPUs with Vulkan support!\n");
         return EXIT_FAILURE;
     }
-    VkPhysicalDevice* devices = (VkPhysicalDevice*)malloc(sizeof(VkPhysicalDevice) * deviceCount);
-    vkEnumeratePhysicalDevices(instance, &deviceCount, devices);
-
-    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
-    uint32_t queueFamilyIndex = -1;
-
-    for (uint32_t i = 0; i < deviceCount; i++) {
-        uint32_t queueFamilyCount = 0;
-        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &queueFamilyCount, NULL);
-        VkQueueFamilyProperties* queueFamilies = (VkQueueFamilyProperties*)malloc(sizeof(VkQueueFamilyProperties) * queueFamilyCount);
-        vkGetPhysicalDeviceQueueFamilyProperties(devices[i], &queueFamilyCount, queueFamilies);
-
-        for (uint32_t j = 0; j < queueFamilyCount; j++) {
-            if (queueFamilies[j].queueFlags & VK_QUEUE_GRAPHICS_BIT) {
-                physicalDevice = devices[i];
-                queueFamilyIndex = j;
-                break;
-            }
-        }
-        free(queueFamilies);
-        if (physicalDevice != VK_NULL_HANDLE) {
-            break;
-        }
+    int selectedDevice = deviceSelect(deviceInfos, deviceCount, deviceSelector);
+    if (reportPath != NULL && !deviceWriteReport(reportPath, deviceInfos, deviceCount, selectedDevice)) {
+        return EXIT_FAILURE;
     }
-    free(devices);
-
-    if (physicalDevice == VK_NULL_HANDLE) {
+    if (selectedDevice < 0) {
         fprintf(stderr, "Failed to find a suitable GPU!\n");
         return EXIT_FAILURE;
     }
-
-    // aside: query subgroup size
-    queryAndReportSubgroupSize(physicalDevice);
+    VkPhysicalDevice physicalDevice = deviceInfos[selectedDevice].physicalDevice;
+    uint32_t queueFamilyIndex = deviceInfos[selectedDevice].queueFamilyIndex;
+    uint32_t timestampValidBits = deviceInfos[selectedDevice].timestampValidBits;
+    uint32_t subgroupSize = deviceInfos[selectedDevice].subgroup.subgroupSize;
+    VkShaderStageFlags subgroupStages = deviceInfos[selectedDevice].subgroup.supportedStages;
+    VkSubgroupFeatureFlags subgroupOperations = deviceInfos[selectedDevice].subgroup.supportedOperations;
+    char traceProcessName[300];
+    snprintf(traceProcessName, sizeof(traceProcessName), "render on %s", deviceInfos[selectedDevice].properties.deviceName);
+    traceSetProcessName(traceProcessName);
+    deviceReportSubgroup(&deviceInfos[selectedDevice]);
+    free(deviceInfos);
+    traceEnd("enumerate and select devices", span);
+
+    if (hashing && !imageHashSupported(physicalDevice)) {
+        fprintf(stderr, "Image hashing needs subgroup arithmetic in compute shaders.\n");
+        return EXIT_FAILURE;
+    }
 
     // --- 4. Create Logical Device and Queue ---
     VkDeviceQueueCreateInfo queueCreateInfo = {};
@@ -224,16 +359,74 @@ int main(int argc, char **argv) {
     float queuePriority = 1.0f;
     queueCreateInfo.pQueuePriorities = &queuePriority;
 
+    // Enable the features the packed shuffle shaders need (8-bit / 16-bit
+    // subgroup shuffles), but only when the device supports them.
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+    VkPhysicalDeviceVulkan12Features supportedFeatures12 = {};
+    supportedFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+    VkPhysicalDeviceFeatures2 supportedFeatures = {};
+    supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    if (deviceProperties.apiVersion >= VK_API_VERSION_1_2) {
+        supportedFeatures.pNext = &supportedFeatures12;
+    }
+    vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures);
+
+    // --stats: pipeline statistics, plus hardware counters where the driver
+    // exposes VK_KHR_performance_query.
+    GpuCounterSupport counterSupport;
+    gpuCountersQuerySupport(&counterSupport, physicalDevice, &supportedFeatures.features,
+                            (deviceProperties.apiVersion >= VK_API_VERSION_1_2) ? supportedFeatures12.hostQueryReset : VK_FALSE);
+    int performanceQuery = stats && counterSupport.performanceQuery;
+
+    VkPhysicalDeviceVulkan12Features enabledFeatures12 = {};
+    enabledFeatures12.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_12_FEATURES;
+    enabledFeatures12.shaderInt8 = supportedFeatures12.shaderInt8;
+    enabledFeatures12.shaderFloat16 = supportedFeatures12.shaderFloat16;
+    enabledFeatures12.shaderSubgroupExtendedTypes = supportedFeatures12.shaderSubgroupExtendedTypes;
+    enabledFeatures12.hostQueryReset = performanceQuery ? VK_TRUE : VK_FALSE;
+    if (!enabledFeatures12.shaderSubgroupExtendedTypes) {
+        printf("shaderSubgroupExtendedTypes not supported: 8/16-bit shuffle shaders will not load.\n");
+    }
+
+    VkPhysicalDeviceFeatures2 enabledFeatures = {};
+    enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+    enabledFeatures.pNext = (deviceProperties.apiVersion >= VK_API_VERSION_1_2) ? &enabledFeatures12 : NULL;
+    // The lane sweep's fragment shader counts with storage buffer atomics.
+    enabledFeatures.features.fragmentStoresAndAtomics = laneSweep ? supportedFeatures.features.fragmentStoresAndAtomics : VK_FALSE;
+    enabledFeatures.features.pipelineStatisticsQuery = stats ? counterSupport.pipelineStatistics : VK_FALSE;
+    if (performanceQuery) {
+        gpuCountersEnableFeatures(&counterSupport, &enabledFeatures);
+    }
+
     VkDeviceCreateInfo deviceCreateInfo = {};
     deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.pNext = &enabledFeatures;
     deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
     deviceCreateInfo.queueCreateInfoCount = 1;
-    
+
+    // Heap budgets and usage for memory_budget.h, when the device reports them.
+    const char* deviceExtensions[2];
+    uint32_t deviceExtensionCount = 0;
+    int hasMemoryBudget = deviceHasExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+    if (hasMemoryBudget) {
+        deviceExtensions[deviceExtensionCount++] = VK_EXT_MEMORY_BUDGET_EXTENSION_NAME;
+    }
+    if (performanceQuery) {
+        deviceExtensions[deviceExtensionCount++] = VK_KHR_PERFORMANCE_QUERY_EXTENSION_NAME;
+    }
+    deviceCreateInfo.enabledExtensionCount = deviceExtensionCount;
+    deviceCreateInfo.ppEnabledExtensionNames = deviceExtensions;
+
     VkDevice device;
-    if (vkCreateDevice(physicalDevice, &deviceCreateInfo, NULL, &device) != VK_SUCCESS) {
+    span = traceBegin();
+    if (vkCreateDevice(physicalDevice, &deviceCreateInfo, hostCallbacks, &device) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create logical device!\n");
         return EXIT_FAILURE;
     }
+    traceEnd("vkCreateDevice", span);
+    span = traceBegin();
 
     // Load device level functions
     #define DEVICE_LEVEL_VULKAN_FUNCTION( name ) \
@@ -242,12 +435,19 @@ int main(int argc, char **argv) {
             fprintf(stderr, "Could not load device-level Vulkan function %s\n", #name); \
             return EXIT_FAILURE; \
         }
+    // Optional functions stay NULL when the device doesn't provide them.
+    #define OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( name ) \
+        name = (PFN_##name)vkGetDeviceProcAddr(device, #name);
     #include "vulkan_functions.h"
+    traceEnd("load device functions", span);
+
+    memoryBudgetInit(physicalDevice, hasMemoryBudget);
 
     VkQueue graphicsQueue;
     vkGetDeviceQueue(device, queueFamilyIndex, 0, &graphicsQueue);
 
     // --- 5. Create Offscreen Framebuffer Resources ---
+    span = traceBegin();
     
     // Color Attachment (Image)
     VkImage colorImage;
@@ -266,10 +466,13 @@ int main(int argc, char **argv) {
     imageInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
     imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     imageInfo.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+    if (hashing) {
+        imageInfo.usage |= VK_IMAGE_USAGE_STORAGE_BIT; // Read by the hash pass.
+    }
     imageInfo.samples = VK_SAMPLE_COUNT_1_BIT;
     imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    if (vkCreateImage(device, &imageInfo, NULL, &colorImage) != VK_SUCCESS) {
+    if (vkCreateImage(device, &imageInfo, hostCallbacks, &colorImage) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create color attachment image!\n");
         return EXIT_FAILURE;
     }
@@ -282,7 +485,7 @@ int main(int argc, char **argv) {
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    if (vkAllocateMemory(device, &allocInfo, NULL, &colorImageMemory) != VK_SUCCESS) {
+    if (memoryBudgetAllocate(device, &allocInfo, &colorImageMemory, "color attachment") != VK_SUCCESS) {
         fprintf(stderr, "Failed to allocate image memory!\n");
         return EXIT_FAILURE;
     }
@@ -300,7 +503,7 @@ int main(int argc, char **argv) {
     viewInfo.subresourceRange.baseArrayLayer = 0;
     viewInfo.subresourceRange.layerCount = 1;
 
-    if (vkCreateImageView(device, &viewInfo, NULL, &colorImageView) != VK_SUCCESS) {
+    if (vkCreateImageView(device, &viewInfo, hostCallbacks, &colorImageView) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create image view!\n");
         return EXIT_FAILURE;
     }
@@ -333,7 +536,7 @@ int main(int argc, char **argv) {
     renderPassInfo.pSubpasses = &subpass;
 
     VkRenderPass renderPass;
-    if (vkCreateRenderPass(device, &renderPassInfo, NULL, &renderPass) != VK_SUCCESS) {
+    if (vkCreateRenderPass(device, &renderPassInfo, hostCallbacks, &renderPass) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create render pass!\n");
         return EXIT_FAILURE;
     }
@@ -349,25 +552,29 @@ int main(int argc, char **argv) {
     framebufferInfo.layers = 1;
 
     VkFramebuffer framebuffer;
-    if (vkCreateFramebuffer(device, &framebufferInfo, NULL, &framebuffer) != VK_SUCCESS) {
+    if (vkCreateFramebuffer(device, &framebufferInfo, hostCallbacks, &framebuffer) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create framebuffer!\n");
         return EXIT_FAILURE;
     }
 
+    traceEnd("framebuffer resources", span);
+
     // --- 6. Create Graphics Pipeline ---
-    size_t vertShaderSize, fragShaderSize;
-    char* vertShaderCode = readShaderFile(argv[1], &vertShaderSize);
-    char* fragShaderCode = readShaderFile(argv[2], &fragShaderSize);
-    
-    if (!vertShaderCode || !fragShaderCode) {
+    span = traceBegin();
+    VkShaderModule vertShaderModule = loadShaderModule(device, &shaderBundle, argv[1]);
+    VkShaderModule fragShaderModule = loadShaderModule(device, &shaderBundle, argv[2]);
+    if (vertShaderModule == VK_NULL_HANDLE || fragShaderModule == VK_NULL_HANDLE) {
         return EXIT_FAILURE;
     }
 
-    VkShaderModule vertShaderModule = createShaderModule(device, vertShaderCode, vertShaderSize);
-    VkShaderModule fragShaderModule = createShaderModule(device, fragShaderCode, fragShaderSize);
-
-    free(vertShaderCode);
-    free(fragShaderCode);
+    // The bundle's pipeline cache, from the last run with the same modules.
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+    char pipelineCachePath[1024];
+    if (shaderBundle.data != NULL) {
+        spirvBundleCachePath(&shaderBundle, bundlePath, pipelineCachePath, sizeof(pipelineCachePath));
+        pipelineCache = spirvBundleLoadPipelineCache(device, pipelineCachePath);
+    }
+    traceEnd("load shaders", span);
 
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -381,6 +588,14 @@ int main(int argc, char **argv) {
     fragShaderStageInfo.module = fragShaderModule;
     fragShaderStageInfo.pName = "main";
 
+    // With --spec-pattern the shuffle pattern is baked into the pipeline
+    // (shaderShufflePattern.frag); shaders without the constants ignore it.
+    ShuffleVariantSpecialization fragSpecialization;
+    if (specPattern) {
+        shuffleVariantSpecialize(&fragSpecialization, shuffleVariant, subgroupSize, NULL, NULL, 0);
+        fragShaderStageInfo.pSpecializationInfo = &fragSpecialization.info;
+    }
+
     VkPipelineShaderStageCreateInfo shaderStages[] = {vertShaderStageInfo, fragShaderStageInfo};
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
@@ -439,11 +654,16 @@ int main(int argc, char **argv) {
     colorBlending.attachmentCount = 1;
     colorBlending.pAttachments = &colorBlendAttachment;
 
+    // Per-frame parameters are push constants for the fragment stage.
+    VkPushConstantRange pushConstantRange = framePushConstantRange(VK_SHADER_STAGE_FRAGMENT_BIT);
+
     VkPipelineLayoutCreateInfo pipelineLayoutInfo = {};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
     
     VkPipelineLayout pipelineLayout;
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, NULL, &pipelineLayout) != VK_SUCCESS) {
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, hostCallbacks, &pipelineLayout) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create pipeline layout!\n");
         return EXIT_FAILURE;
     }
@@ -463,21 +683,29 @@ int main(int argc, char **argv) {
     pipelineInfo.subpass = 0;
 
     VkPipeline graphicsPipeline;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, NULL, &graphicsPipeline) != VK_SUCCESS) {
+    span = traceBegin();
+    if (vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineInfo, hostCallbacks, &graphicsPipeline) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create graphics pipeline!\n");
         return EXIT_FAILURE;
     }
+    traceEnd("vkCreateGraphicsPipelines", span);
 
-    vkDestroyShaderModule(device, fragShaderModule, NULL);
-    vkDestroyShaderModule(device, vertShaderModule, NULL);
+    vkDestroyShaderModule(device, fragShaderModule, hostCallbacks);
+    vkDestroyShaderModule(device, vertShaderModule, hostCallbacks);
+    if (hostAllocReport) {
+        printf("Startup (%s host allocator): %.2f ms from instance to pipeline\n",
+               hostAllocModeNames[hostAlloc], (getTimeSeconds() - startupStart) * 1000.0);
+    }
 
     // --- 7. Create Command Pool and Command Buffer ---
+    span = traceBegin();
     VkCommandPoolCreateInfo poolInfo = {};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT; // Re-recorded for the hash, readback and sweep.
     poolInfo.queueFamilyIndex = queueFamilyIndex;
     
     VkCommandPool commandPool;
-    if (vkCreateCommandPool(device, &poolInfo, NULL, &commandPool) != VK_SUCCESS) {
+    if (vkCreateCommandPool(device, &poolInfo, hostCallbacks, &commandPool) != VK_SUCCESS) {
         fprintf(stderr, "Failed to create command pool!\n");
         return EXIT_FAILURE;
     }
@@ -491,6 +719,38 @@ int main(int argc, char **argv) {
     VkCommandBuffer commandBuffer;
     vkAllocateCommandBuffers(device, &cmdAllocInfo, &commandBuffer);
 
+    // When tracing, timestamps around every frame become GPU spans.
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    if (tracePath != NULL && timestampValidBits != 0) {
+        VkQueryPoolCreateInfo queryPoolInfo = {};
+        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        queryPoolInfo.queryCount = frameCount + 1;
+        if (vkCreateQueryPool(device, &queryPoolInfo, hostCallbacks, &queryPool) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create timestamp query pool!\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    // With --stats, one query of each kind around every frame's render pass.
+    GpuCounters gpuCounters = {};
+    if (stats) {
+        VkQueryPipelineStatisticFlags statistics = 0;
+        if (counterSupport.pipelineStatistics) {
+            statistics = VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT | VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+        } else {
+            printf("pipelineStatisticsQuery not supported: no pipeline statistics.\n");
+        }
+        if (!performanceQuery) {
+            printf("VK_KHR_performance_query not supported: no performance counters.\n");
+        }
+        if (!gpuCountersCreate(&gpuCounters, device, physicalDevice, queueFamilyIndex, statistics, performanceQuery, frameCount)) {
+            fprintf(stderr, "Failed to create counter query pools!\n");
+            return EXIT_FAILURE;
+        }
+    }
+    traceEnd("command pool", span);
+
     // --- 8. Record Drawing Commands ---
     VkCommandBufferBeginInfo beginInfo = {};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -510,12 +770,41 @@ int main(int argc, char **argv) {
     renderPassBeginInfo.clearValueCount = 1;
     renderPassBeginInfo.pClearValues = &clearColor;
 
-    vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
-    vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Draw a single triangle
-    vkCmdEndRenderPass(commandBuffer);
+    // One render pass per frame; only the push constants differ between them.
+    // Each pass clears and rewrites the same image, so successive passes are
+    // ordered with a write-after-write barrier. The last frame is saved.
+    VkMemoryBarrier frameBarrier = {};
+    frameBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    frameBarrier.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+    frameBarrier.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+
+    double recordStart = getTimeSeconds();
+    if (queryPool != VK_NULL_HANDLE) {
+        vkCmdResetQueryPool(commandBuffer, queryPool, 0, frameCount + 1);
+        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, 0);
+    }
+    gpuCountersReset(&gpuCounters, commandBuffer);
+    for (uint32_t frame = 0; frame < frameCount; frame++) {
+        if (frame > 0) {
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, 0, 1, &frameBarrier, 0, NULL, 0, NULL);
+        }
+        FrameParams frameParams = frameParamsAt(frame, shufflePattern, 60.0f);
+
+        gpuCountersBegin(&gpuCounters, commandBuffer, frame);
+        vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(frameParams), &frameParams);
+        vkCmdDraw(commandBuffer, 3, 1, 0, 0); // Draw a single triangle
+        vkCmdEndRenderPass(commandBuffer);
+        gpuCountersEnd(&gpuCounters, commandBuffer, frame);
+        if (queryPool != VK_NULL_HANDLE) {
+            vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, frame + 1);
+        }
+    }
 
     vkEndCommandBuffer(commandBuffer);
+    double recordSeconds = getTimeSeconds() - recordStart;
+    traceEnd("record commands", recordStart);
 
     // --- 9. Submit Commands and Wait ---
     VkSubmitInfo submitInfo = {};
@@ -523,93 +812,315 @@ int main(int argc, char **argv) {
     submitInfo.commandBufferCount = 1;
     submitInfo.pCommandBuffers = &commandBuffer;
 
+    double submitStart = getTimeSeconds();
     vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
     vkQueueWaitIdle(graphicsQueue);
+    double renderSeconds = getTimeSeconds() - submitStart;
+    traceEnd("submit and wait", submitStart);
+
+    // GPU spans, anchored at the submit: frame i runs between timestamps i and i + 1.
+    if (queryPool != VK_NULL_HANDLE) {
+        uint64_t* timestamps = (uint64_t*)malloc((frameCount + 1) * sizeof(uint64_t));
+        if (vkGetQueryPoolResults(device, queryPool, 0, frameCount + 1, (frameCount + 1) * sizeof(uint64_t), timestamps,
+                                  sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS) {
+            float period = deviceProperties.limits.timestampPeriod;
+            for (uint32_t frame = 0; frame < frameCount; frame++) {
+                traceGpu("frame", frame + 1, submitStart, timestamps[0], timestamps[frame], timestamps[frame + 1], period);
+            }
+        }
+        free(timestamps);
+    }
 
-    // --- 10. Copy Image to Buffer and Save to File ---
-    // Create a host-visible buffer to copy the image data into
-    VkBuffer dstBuffer;
-    VkDeviceMemory dstBufferMemory;
-    VkDeviceSize bufferSize = WIDTH * HEIGHT * 4; // 4 bytes per pixel (R8G8B8A8)
+    if (frameCount > 1) {
+        printf("Rendered %u frames (%s pattern): %.2f us CPU recording and %.3f ms GPU+submit per frame\n",
+               frameCount, shufflePatternNames[shufflePattern], recordSeconds * 1e6 / frameCount,
+               renderSeconds * 1000.0 / frameCount);
+    }
+    if (stats) {
+        GpuCounterValues counterValues;
+        printf("Counters over %u render pass%s (%.3f ms GPU+submit per frame):\n", frameCount, frameCount > 1 ? "es" : "",
+               renderSeconds * 1000.0 / frameCount);
+        if (gpuCountersRead(&gpuCounters, 0, frameCount, &counterValues)) {
+            gpuCountersPrint(&gpuCounters, &counterValues, "render pass");
+            printf("  %-40s %16d pixels\n", "render area", WIDTH * HEIGHT);
+        } else {
+            printf("  Query results unavailable\n");
+        }
+    }
 
-    VkBufferCreateInfo bufferCreateInfo = {};
-    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferCreateInfo.size = bufferSize;
-    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
-    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    // --- 10. Hash the Image on the GPU (optional) ---
+    // Only IMAGE_HASH_WORDS words come back instead of the whole image.
+    int exitCode = EXIT_SUCCESS;
+    uint32_t gpuWords[IMAGE_HASH_WORDS];
+    double hashSeconds = 0.0;
+    if (hashing) {
+        span = traceBegin();
+        VkShaderModule hashShaderModule = loadShaderModule(device, &shaderBundle, "spv/shaderImageHash.comp.spv");
+        if (hashShaderModule == VK_NULL_HANDLE) {
+            return EXIT_FAILURE;
+        }
 
-    if (vkCreateBuffer(device, &bufferCreateInfo, NULL, &dstBuffer) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to create destination buffer!\n");
-        return EXIT_FAILURE;
-    }
+        ImageHasher hasher;
+        if (!imageHasherCreate(&hasher, device, physicalDevice, hashShaderModule, colorImageView)) {
+            fprintf(stderr, "Failed to create the image hash pipeline!\n");
+            return EXIT_FAILURE;
+        }
 
-    vkGetBufferMemoryRequirements(device, dstBuffer, &memRequirements);
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        double hashStart = getTimeSeconds();
+        vkResetCommandBuffer(commandBuffer, 0);
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+        // The render pass leaves the image in TRANSFER_SRC_OPTIMAL; the hash
+        // reads it as a storage image, then it goes back for the copy below.
+        VkImageMemoryBarrier toGeneral = {};
+        toGeneral.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        toGeneral.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+        toGeneral.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toGeneral.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        toGeneral.newLayout = VK_IMAGE_LAYOUT_GENERAL;
+        toGeneral.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toGeneral.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        toGeneral.image = colorImage;
+        toGeneral.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        toGeneral.subresourceRange.levelCount = 1;
+        toGeneral.subresourceRange.layerCount = 1;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, NULL, 0, NULL, 1, &toGeneral);
+
+        imageHasherRecord(&hasher, commandBuffer, WIDTH, HEIGHT);
+
+        VkImageMemoryBarrier toTransfer = toGeneral;
+        toTransfer.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        toTransfer.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        toTransfer.oldLayout = VK_IMAGE_LAYOUT_GENERAL;
+        toTransfer.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL, 1, &toTransfer);
+
+        vkEndCommandBuffer(commandBuffer);
+        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(graphicsQueue);
+        memcpy(gpuWords, hasher.words, sizeof(gpuWords));
+        hashSeconds = getTimeSeconds() - hashStart;
+
+        char gpuHex[IMAGE_HASH_HEX_LENGTH + 1];
+        imageHashToHex(gpuWords, gpuHex);
+        printf("GPU hash %s (%.3f ms hash + 16-byte readback)\n", gpuHex, hashSeconds * 1000.0);
+        if (expectedHash) {
+            int match = memcmp(gpuWords, expectedWords, sizeof(gpuWords)) == 0;
+            printf("Verify: %s (expected %s)\n", match ? "PASS" : "FAIL", expectedHash);
+            if (!match) {
+                exitCode = EXIT_FAILURE;
+            }
+        }
 
-    if (vkAllocateMemory(device, &allocInfo, NULL, &dstBufferMemory) != VK_SUCCESS) {
-        fprintf(stderr, "Failed to allocate destination buffer memory!\n");
-        return EXIT_FAILURE;
+        imageHasherDestroy(&hasher);
+        vkDestroyShaderModule(device, hashShaderModule, hostCallbacks);
+        traceEnd("GPU hash", span);
     }
-    vkBindBufferMemory(device, dstBuffer, dstBufferMemory, 0);
 
-    // Record copy command
-    vkResetCommandBuffer(commandBuffer, 0);
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    // --- 11. Copy Image to Buffer and Save to File ---
+    // Skipped when only verifying against an expected hash.
+    VkBuffer dstBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory dstBufferMemory = VK_NULL_HANDLE;
+    if (!expectedHash || hashOutput) {
+        span = traceBegin();
+        // Create a host-visible buffer to copy the image data into
+        VkDeviceSize bufferSize = WIDTH * HEIGHT * 4; // 4 bytes per pixel (R8G8B8A8)
+
+        VkBufferCreateInfo bufferCreateInfo = {};
+        bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferCreateInfo.size = bufferSize;
+        bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        if (vkCreateBuffer(device, &bufferCreateInfo, hostCallbacks, &dstBuffer) != VK_SUCCESS) {
+            fprintf(stderr, "Failed to create destination buffer!\n");
+            return EXIT_FAILURE;
+        }
+
+        vkGetBufferMemoryRequirements(device, dstBuffer, &memRequirements);
+        allocInfo.allocationSize = memRequirements.size;
+        allocInfo.memoryTypeIndex = findMemoryType(physicalDevice, memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        if (memoryBudgetAllocate(device, &allocInfo, &dstBufferMemory, "readback buffer") != VK_SUCCESS) {
+            fprintf(stderr, "Failed to allocate destination buffer memory!\n");
+            return EXIT_FAILURE;
+        }
+        vkBindBufferMemory(device, dstBuffer, dstBufferMemory, 0);
+
+        // Record copy command
+        double readbackStart = getTimeSeconds();
+        vkResetCommandBuffer(commandBuffer, 0);
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
     
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    region.imageOffset = (VkOffset3D){0, 0, 0};
-    region.imageExtent = (VkExtent3D){WIDTH, HEIGHT, 1};
-
-    vkCmdCopyImageToBuffer(commandBuffer, colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &region);
+        VkBufferImageCopy region = {};
+        region.bufferOffset = 0;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = 0;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageOffset = (VkOffset3D){0, 0, 0};
+        region.imageExtent = (VkExtent3D){WIDTH, HEIGHT, 1};
+
+        vkCmdCopyImageToBuffer(commandBuffer, colorImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, dstBuffer, 1, &region);
     
-    vkEndCommandBuffer(commandBuffer);
+        vkEndCommandBuffer(commandBuffer);
+
+        // Submit copy command
+        vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+        vkQueueWaitIdle(graphicsQueue);
+
+        // Map memory and save to file
+        void* data;
+        vkMapMemory(device, dstBufferMemory, 0, bufferSize, 0, &data);
+
+        // Full readback path of the verification: hash the pixels on the CPU.
+        if (hashOutput) {
+            uint32_t cpuWords[IMAGE_HASH_WORDS];
+            imageHashCpu((const uint8_t*)data, WIDTH, HEIGHT, cpuWords);
+            double readbackSeconds = getTimeSeconds() - readbackStart;
+            char cpuHex[IMAGE_HASH_HEX_LENGTH + 1];
+            imageHashToHex(cpuWords, cpuHex);
+            printf("CPU hash %s (%.3f ms copy + readback + hash), saved %.3f ms\n", cpuHex,
+                   readbackSeconds * 1000.0, (readbackSeconds - hashSeconds) * 1000.0);
+            if (memcmp(gpuWords, cpuWords, sizeof(gpuWords)) != 0) {
+                fprintf(stderr, "GPU and CPU hashes differ!\n");
+                exitCode = EXIT_FAILURE;
+            }
+        }
 
-    // Submit copy command
-    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-    vkQueueWaitIdle(graphicsQueue);
+        FILE* file = fopen(argv[3], "wb");
+        if (!file) {
+            fprintf(stderr, "Failed to open output file!\n");
+        } else {
+            fprintf(file, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
+            for (int y = 0; y < HEIGHT; y++) {
+                for (int x = 0; x < WIDTH; x++) {
+                    // PPM expects RGB, our buffer is RGBA. We skip the alpha channel.
+                    fwrite((unsigned char*)data + (y * WIDTH + x) * 4, 3, 1, file);
+                }
+            }
+            fclose(file);
+            printf("Successfully rendered image to %s\n", argv[3]);
+        }
+    
+        vkUnmapMemory(device, dstBufferMemory);
+        traceEnd("readback and save", span);
+    }
 
-    // Map memory and save to file
-    void* data;
-    vkMapMemory(device, dstBufferMemory, 0, bufferSize, 0, &data);
+    // --- 12. Lane Utilization Sweep (optional) ---
+    // Instanced grids of ever smaller triangles, to see where fragment
+    // subgroups stop filling up (lane_sweep.h). Runs after the image is
+    // saved, so the output is unchanged.
+    if (laneSweep) {
+        span = traceBegin();
+        VkSubgroupFeatureFlags sweepOperations = VK_SUBGROUP_FEATURE_VOTE_BIT | VK_SUBGROUP_FEATURE_BALLOT_BIT | VK_SUBGROUP_FEATURE_SHUFFLE_BIT;
+        if (!enabledFeatures.features.fragmentStoresAndAtomics || !(subgroupStages & VK_SHADER_STAGE_FRAGMENT_BIT) ||
+            (subgroupOperations & sweepOperations) != sweepOperations) {
+            printf("Lane sweep skipped: needs fragmentStoresAndAtomics and subgroup vote, ballot and shuffle in fragment shaders.\n");
+        } else {
+            VkShaderModule gridShaderModule = loadShaderModule(device, &shaderBundle, "spv/shaderGrid.vert.spv");
+            VkShaderModule laneShaderModule = loadShaderModule(device, &shaderBundle, "spv/shaderLaneStats.frag.spv");
+            if (gridShaderModule == VK_NULL_HANDLE || laneShaderModule == VK_NULL_HANDLE) {
+                return EXIT_FAILURE;
+            }
+            LaneSweep sweep;
+            if (!laneSweepCreate(&sweep, device, physicalDevice, renderPass, WIDTH, HEIGHT, gridShaderModule, laneShaderModule, pipelineCache)) {
+                fprintf(stderr, "Failed to create the lane sweep pipeline!\n");
+                return EXIT_FAILURE;
+            }
+            vkDestroyShaderModule(device, laneShaderModule, hostCallbacks);
+            vkDestroyShaderModule(device, gridShaderModule, hostCallbacks);
+
+            VkQueryPool sweepQueryPool = VK_NULL_HANDLE;
+            if (timestampValidBits != 0) {
+                VkQueryPoolCreateInfo queryPoolInfo = {};
+                queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+                queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+                queryPoolInfo.queryCount = 2;
+                if (vkCreateQueryPool(device, &queryPoolInfo, hostCallbacks, &sweepQueryPool) != VK_SUCCESS) {
+                    fprintf(stderr, "Failed to create timestamp query pool!\n");
+                    return EXIT_FAILURE;
+                }
+            }
 
-    FILE* file = fopen(argv[3], "wb");
-    if (!file) {
-        fprintf(stderr, "Failed to open output file!\n");
-    } else {
-        fprintf(file, "P6\n%d %d\n255\n", WIDTH, HEIGHT);
-        for (int y = 0; y < HEIGHT; y++) {
-            for (int x = 0; x < WIDTH; x++) {
-                // PPM expects RGB, our buffer is RGBA. We skip the alpha channel.
-                fwrite((unsigned char*)data + (y * WIDTH + x) * 4, 3, 1, file);
+            // Lanes and helpers are per subgroup; mode is the most common
+            // lane count and prims/sg the distinct triangles per subgroup.
+            printf("Lane utilization, %dx%d target, subgroup size %u:\n", WIDTH, HEIGHT, subgroupSize);
+            printf("triangle   count subgroups   lanes   util helpers  mode   prims/sg%s\n", sweepQueryPool != VK_NULL_HANDLE ? "    GPU ms" : "");
+            for (uint32_t cellSize = 128; cellSize >= 1; cellSize /= 2) {
+                // Counts grow 16x per row, up to a grid filling the target.
+                uint32_t capacity = (WIDTH / cellSize) * (HEIGHT / cellSize);
+                uint32_t count = 1;
+                while (1) {
+                    vkResetCommandBuffer(commandBuffer, 0);
+                    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+                    laneSweepRecord(&sweep, commandBuffer, &renderPassBeginInfo, cellSize, count, sweepQueryPool);
+                    vkEndCommandBuffer(commandBuffer);
+                    vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
+                    vkQueueWaitIdle(graphicsQueue);
+
+                    double gpuMs = -1.0;
+                    uint64_t timestamps[2];
+                    if (sweepQueryPool != VK_NULL_HANDLE &&
+                        vkGetQueryPoolResults(device, sweepQueryPool, 0, 2, sizeof(timestamps), timestamps, sizeof(uint64_t),
+                                              VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT) == VK_SUCCESS) {
+                        gpuMs = (double)(timestamps[1] - timestamps[0]) * deviceProperties.limits.timestampPeriod * 1e-6;
+                    }
+                    laneSweepPrintRow(&sweep, cellSize, count, subgroupSize, gpuMs);
+                    if (count == capacity) {
+                        break;
+                    }
+                    count = count * 16 < capacity ? count * 16 : capacity;
+                }
             }
+
+            vkDestroyQueryPool(device, sweepQueryPool, hostCallbacks);
+            laneSweepDestroy(&sweep);
         }
-        fclose(file);
-        printf("Successfully rendered image to %s\n", argv[3]);
+        traceEnd("lane sweep", span);
     }
-    
-    vkUnmapMemory(device, dstBufferMemory);
-
-    // --- 11. Cleanup ---
-    vkDestroyBuffer(device, dstBuffer, NULL);
-    vkFreeMemory(device, dstBufferMemory, NULL);
-    vkDestroyPipeline(device, graphicsPipeline, NULL);
-    vkDestroyPipelineLayout(device, pipelineLayout, NULL);
-    vkDestroyRenderPass(device, renderPass, NULL);
-    vkDestroyFramebuffer(device, framebuffer, NULL);
-    vkDestroyImageView(device, colorImageView, NULL);
-    vkDestroyImage(device, colorImage, NULL);
-    vkFreeMemory(device, colorImageMemory, NULL);
-    vkDestroyCommandPool(device, commandPool, NULL);
-    vkDestroyDevice(device, NULL);
-    vkDestroyInstance(instance, NULL);
+
+    // --- 13. Cleanup ---
+    span = traceBegin();
+    vkDestroyQueryPool(device, queryPool, hostCallbacks);
+    gpuCountersDestroy(&gpuCounters);
+    vkDestroyBuffer(device, dstBuffer, hostCallbacks);
+    memoryBudgetFree(device, dstBufferMemory);
+    vkDestroyPipeline(device, graphicsPipeline, hostCallbacks);
+    vkDestroyPipelineLayout(device, pipelineLayout, hostCallbacks);
+    vkDestroyRenderPass(device, renderPass, hostCallbacks);
+    vkDestroyFramebuffer(device, framebuffer, hostCallbacks);
+    vkDestroyImageView(device, colorImageView, hostCallbacks);
+    vkDestroyImage(device, colorImage, hostCallbacks);
+    memoryBudgetFree(device, colorImageMemory);
+    vkDestroyCommandPool(device, commandPool, hostCallbacks);
+    if (pipelineCache != VK_NULL_HANDLE) {
+        spirvBundleSavePipelineCache(device, pipelineCache, pipelineCachePath);
+    }
+    vkDestroyDevice(device, hostCallbacks);
+    vkDestroyInstance(instance, hostCallbacks);
+    spirvBundleClose(&shaderBundle);
+    traceEnd("cleanup", span);
+
+    if (tracePath != NULL && !traceWrite(tracePath)) {
+        exitCode = EXIT_FAILURE;
+    }
+    traceDestroy();
+
+    if (memoryLogPath != NULL) {
+        memoryBudgetReport(stderr);
+        if (!memoryBudgetWriteTimeline(memoryLogPath)) {
+            exitCode = EXIT_FAILURE;
+        }
+    }
+    memoryBudgetDestroy();
+
+    if (hostAllocReport) {
+        hostAllocatorReport(&hostAllocator);
+    }
+    hostAllocatorDestroy(&hostAllocator);
 
 #if defined(__linux__)
     dlclose(vulkan_library);
@@ -617,5 +1128,5 @@ int main(int argc, char **argv) {
     FreeLibrary(vulkan_library);
 #endif
 
-    return EXIT_SUCCESS;
+    return exitCode;
 }
@@ -0,0 +1,258 @@
+// memory_budget.h
+// Per-heap device memory accounting. Budgets and usage come from
+// VK_EXT_memory_budget when the device was created with it; usage then also
+// counts the driver and other processes. Without it the budget is
+// MEMORY_BUDGET_FALLBACK_PERCENT of the heap size and usage is only what we
+// allocated. Every vkAllocateMemory/vkFreeMemory goes through
+// memoryBudgetAllocate/memoryBudgetFree, which:
+//   - refuse an allocation that would take its heap past MEMORY_BUDGET_PERCENT
+//     of the budget, so callers can degrade before the driver fails (or
+//     starts paging);
+//   - keep our bytes, the reported usage and their peaks per heap;
+//   - log each allocation, free and refusal for memoryBudgetWriteTimeline()
+//     (with "-" it claims stdout, see stdout_claim.h).
+// The state is one global (memoryBudget) for the single device of the
+// program. Include after vulkan_functions.h and host_alloc.h.
+
+#ifndef MEMORY_BUDGET_H
+#define MEMORY_BUDGET_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "stdout_claim.h"
+#include "timing.h"
+
+#define MEMORY_BUDGET_PERCENT 90
+#define MEMORY_BUDGET_FALLBACK_PERCENT 80
+
+typedef struct {
+    VkDeviceMemory memory;
+    VkDeviceSize size;
+    uint32_t heap;
+    const char* label;
+} BudgetAllocation;
+
+typedef enum {
+    BUDGET_EVENT_ALLOCATE,
+    BUDGET_EVENT_FREE,
+    BUDGET_EVENT_REFUSE,
+    BUDGET_EVENT_FAIL, // Within budget, but the driver said no.
+} BudgetEventType;
+
+static const char* const budgetEventNames[] = { "allocate", "free", "refuse", "fail" };
+
+// One timeline row. Byte counts are for `heap` after the event.
+typedef struct {
+    double seconds;
+    BudgetEventType type;
+    const char* label;
+    uint32_t heap;
+    VkDeviceSize size;
+    VkDeviceSize ours;
+    VkDeviceSize usage;
+    VkDeviceSize budget;
+} BudgetEvent;
+
+typedef struct {
+    VkPhysicalDevice physicalDevice;
+    int hasBudgetExtension;
+    VkPhysicalDeviceMemoryProperties properties;
+    VkDeviceSize heapBudget[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize heapUsage[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize ours[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize oursPeak[VK_MAX_MEMORY_HEAPS];
+    VkDeviceSize usagePeak[VK_MAX_MEMORY_HEAPS];
+    uint32_t heapAllocations[VK_MAX_MEMORY_HEAPS];
+    uint32_t refusals;
+    BudgetAllocation* allocations;
+    uint32_t allocationCount;
+    uint32_t allocationCapacity;
+    BudgetEvent* events;
+    uint32_t eventCount;
+    uint32_t eventCapacity;
+    double start;
+} MemoryBudget;
+
+static MemoryBudget memoryBudget;
+
+// Re-reads budgets and usage (only our own usage without the extension).
+static void memoryBudgetRefresh(void) {
+    MemoryBudget* budget = &memoryBudget;
+    if (budget->hasBudgetExtension) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {0};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 properties2 = {0};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(budget->physicalDevice, &properties2);
+        for (uint32_t heap = 0; heap < budget->properties.memoryHeapCount; heap++) {
+            budget->heapBudget[heap] = budgetProperties.heapBudget[heap];
+            budget->heapUsage[heap] = budgetProperties.heapUsage[heap];
+        }
+    } else {
+        for (uint32_t heap = 0; heap < budget->properties.memoryHeapCount; heap++) {
+            budget->heapBudget[heap] = budget->properties.memoryHeaps[heap].size / 100 * MEMORY_BUDGET_FALLBACK_PERCENT;
+            budget->heapUsage[heap] = budget->ours[heap];
+        }
+    }
+    for (uint32_t heap = 0; heap < budget->properties.memoryHeapCount; heap++) {
+        if (budget->heapUsage[heap] > budget->usagePeak[heap]) budget->usagePeak[heap] = budget->heapUsage[heap];
+    }
+}
+
+// `hasBudgetExtension`: VK_EXT_memory_budget was enabled on the device.
+static void memoryBudgetInit(VkPhysicalDevice physicalDevice, int hasBudgetExtension) {
+    MemoryBudget* budget = &memoryBudget;
+    memset(budget, 0, sizeof(*budget));
+    budget->physicalDevice = physicalDevice;
+    budget->hasBudgetExtension = hasBudgetExtension;
+    budget->start = getTimeSeconds();
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &budget->properties);
+    memoryBudgetRefresh();
+}
+
+static uint32_t memoryBudgetHeap(uint32_t memoryTypeIndex) {
+    return memoryBudget.properties.memoryTypes[memoryTypeIndex].heapIndex;
+}
+
+// Bytes that can still be allocated from `heap` without passing
+// MEMORY_BUDGET_PERCENT of its budget, as of the last refresh.
+static VkDeviceSize memoryBudgetHeadroom(uint32_t heap) {
+    VkDeviceSize limit = memoryBudget.heapBudget[heap] / 100 * MEMORY_BUDGET_PERCENT;
+    return limit > memoryBudget.heapUsage[heap] ? limit - memoryBudget.heapUsage[heap] : 0;
+}
+
+// Whether allocations of sizes[i] from memory types types[i] fit together.
+static int memoryBudgetFits(const uint32_t* types, const VkDeviceSize* sizes, uint32_t count) {
+    VkDeviceSize needed[VK_MAX_MEMORY_HEAPS] = {0};
+    memoryBudgetRefresh();
+    for (uint32_t i = 0; i < count; i++) {
+        uint32_t heap = memoryBudgetHeap(types[i]);
+        needed[heap] += sizes[i];
+        if (needed[heap] > memoryBudgetHeadroom(heap)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void memoryBudgetLog(BudgetEventType type, const char* label, uint32_t heap, VkDeviceSize size) {
+    MemoryBudget* budget = &memoryBudget;
+    if (budget->eventCount == budget->eventCapacity) {
+        budget->eventCapacity = budget->eventCapacity ? budget->eventCapacity * 2 : 64;
+        budget->events = (BudgetEvent*)realloc(budget->events, budget->eventCapacity * sizeof(BudgetEvent));
+    }
+    BudgetEvent* event = &budget->events[budget->eventCount++];
+    event->seconds = getTimeSeconds() - budget->start;
+    event->type = type;
+    event->label = label;
+    event->heap = heap;
+    event->size = size;
+    event->ours = budget->ours[heap];
+    event->usage = budget->heapUsage[heap];
+    event->budget = budget->heapBudget[heap];
+}
+
+// vkAllocateMemory with budget enforcement. `label` (a string literal) names
+// the allocation in messages and the timeline. Returns
+// VK_ERROR_OUT_OF_DEVICE_MEMORY without calling the driver when the heap has
+// no headroom left.
+static VkResult memoryBudgetAllocate(VkDevice device, const VkMemoryAllocateInfo* allocInfo, VkDeviceMemory* memory,
+                                     const char* label) {
+    MemoryBudget* budget = &memoryBudget;
+    uint32_t heap = memoryBudgetHeap(allocInfo->memoryTypeIndex);
+    memoryBudgetRefresh();
+    if (allocInfo->allocationSize > memoryBudgetHeadroom(heap)) {
+        budget->refusals++;
+        memoryBudgetLog(BUDGET_EVENT_REFUSE, label, heap, allocInfo->allocationSize);
+        fprintf(stderr, "Refusing %s: %.1f MiB would take heap %u past %d%% of its %.1f MiB budget (%.1f MiB in use)\n",
+                label, allocInfo->allocationSize / 1048576.0, heap, MEMORY_BUDGET_PERCENT,
+                budget->heapBudget[heap] / 1048576.0, budget->heapUsage[heap] / 1048576.0);
+        return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+    }
+
+    VkResult result = vkAllocateMemory(device, allocInfo, hostCallbacks, memory);
+    if (result != VK_SUCCESS) {
+        memoryBudgetLog(BUDGET_EVENT_FAIL, label, heap, allocInfo->allocationSize);
+        return result;
+    }
+    if (budget->allocationCount == budget->allocationCapacity) {
+        budget->allocationCapacity = budget->allocationCapacity ? budget->allocationCapacity * 2 : 16;
+        budget->allocations = (BudgetAllocation*)realloc(budget->allocations, budget->allocationCapacity * sizeof(BudgetAllocation));
+    }
+    budget->allocations[budget->allocationCount++] = (BudgetAllocation){ *memory, allocInfo->allocationSize, heap, label };
+    budget->ours[heap] += allocInfo->allocationSize;
+    if (budget->ours[heap] > budget->oursPeak[heap]) budget->oursPeak[heap] = budget->ours[heap];
+    budget->heapAllocations[heap]++;
+    memoryBudgetRefresh();
+    memoryBudgetLog(BUDGET_EVENT_ALLOCATE, label, heap, allocInfo->allocationSize);
+    return VK_SUCCESS;
+}
+
+// vkFreeMemory for memory from memoryBudgetAllocate. VK_NULL_HANDLE is ignored.
+static void memoryBudgetFree(VkDevice device, VkDeviceMemory memory) {
+    MemoryBudget* budget = &memoryBudget;
+    if (memory == VK_NULL_HANDLE) {
+        return;
+    }
+    vkFreeMemory(device, memory, hostCallbacks);
+    for (uint32_t i = 0; i < budget->allocationCount; i++) {
+        if (budget->allocations[i].memory == memory) {
+            BudgetAllocation allocation = budget->allocations[i];
+            budget->allocations[i] = budget->allocations[--budget->allocationCount];
+            budget->ours[allocation.heap] -= allocation.size;
+            memoryBudgetRefresh();
+            memoryBudgetLog(BUDGET_EVENT_FREE, allocation.label, allocation.heap, allocation.size);
+            return;
+        }
+    }
+}
+
+// Peak summary, one line per heap we allocated from.
+static void memoryBudgetReport(FILE* out) {
+    MemoryBudget* budget = &memoryBudget;
+    fprintf(out, "Device memory (%s): %u allocations refused\n",
+            budget->hasBudgetExtension ? "VK_EXT_memory_budget" : "heap size estimate", budget->refusals);
+    fprintf(out, "%-5s %12s %12s %14s %16s %8s\n", "heap", "size MiB", "budget MiB", "our peak MiB", "usage peak MiB", "allocs");
+    for (uint32_t heap = 0; heap < budget->properties.memoryHeapCount; heap++) {
+        if (budget->heapAllocations[heap] == 0) continue;
+        fprintf(out, "%-5u %12.1f %12.1f %14.1f %16.1f %8u\n", heap, budget->properties.memoryHeaps[heap].size / 1048576.0,
+                budget->heapBudget[heap] / 1048576.0, budget->oursPeak[heap] / 1048576.0,
+                budget->usagePeak[heap] / 1048576.0, budget->heapAllocations[heap]);
+    }
+}
+
+// Writes the timeline as CSV to `path` ("-" for stdout). Returns 0 on failure.
+static int memoryBudgetWriteTimeline(const char* path) {
+    MemoryBudget* budget = &memoryBudget;
+    int toStdout = strcmp(path, "-") == 0;
+    FILE* file = toStdout ? stdoutClaim() : fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open memory timeline: %s\n", path);
+        return 0;
+    }
+    fprintf(file, "ms,event,label,heap,bytes,our_bytes,usage_bytes,budget_bytes\n");
+    for (uint32_t i = 0; i < budget->eventCount; i++) {
+        const BudgetEvent* event = &budget->events[i];
+        fprintf(file, "%.3f,%s,%s,%u,%llu,%llu,%llu,%llu\n", event->seconds * 1000.0, budgetEventNames[event->type],
+                event->label, event->heap, (unsigned long long)event->size, (unsigned long long)event->ours,
+                (unsigned long long)event->usage, (unsigned long long)event->budget);
+    }
+    if (toStdout) {
+        fflush(file);
+    } else {
+        fclose(file);
+    }
+    return 1;
+}
+
+static void memoryBudgetDestroy(void) {
+    free(memoryBudget.allocations);
+    free(memoryBudget.events);
+    memset(&memoryBudget, 0, sizeof(memoryBudget));
+}
+
+#endif // MEMORY_BUDGET_H
@@ -0,0 +1,210 @@
+// parallel_record.h
+// Records secondary command buffers on several threads at once. Every worker
+// owns a VkCommandPool (pools are externally synchronized, so sharing one
+// would serialize the workers) and one secondary command buffer per batch.
+// A caller-supplied function fills worker w's buffer for batch b; the main
+// thread then stitches a batch into its primary with vkCmdExecuteCommands.
+// Workers are persistent threads woken per recording, so thread start-up is
+// not part of the measured time. Include after vulkan_functions.h.
+
+#ifndef PARALLEL_RECORD_H
+#define PARALLEL_RECORD_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_alloc.h"
+#include "threading.h"
+#include "timing.h"
+
+#define PARALLEL_RECORD_MAX_WORKERS 64
+
+// Records the work of `worker` for `batch` into `commandBuffer`, which is
+// already begun as a secondary and is ended by the caller.
+typedef void (*RecordFunction)(VkCommandBuffer commandBuffer, uint32_t worker, uint32_t batch, void* user);
+
+typedef struct ParallelRecorder ParallelRecorder;
+
+typedef struct {
+    ParallelRecorder* recorder;
+    uint32_t index;
+} RecordWorker;
+
+struct ParallelRecorder {
+    VkDevice device;
+    uint32_t workerCount;
+    uint32_t batchCount;
+    VkCommandPool pools[PARALLEL_RECORD_MAX_WORKERS];
+    VkCommandBuffer* commandBuffers; // [batch * workerCount + worker]
+    VkResult result;                 // First failure of the last recording.
+
+    // Worker 0 is the calling thread; the others wait for a new generation.
+    Thread threads[PARALLEL_RECORD_MAX_WORKERS];
+    RecordWorker workers[PARALLEL_RECORD_MAX_WORKERS];
+    Mutex mutex;
+    CondVar wake;
+    CondVar done;
+    uint64_t generation;
+    uint32_t pending;
+    int quit;
+    RecordFunction function;
+    void* user;
+};
+
+static void parallelRecordWorker(ParallelRecorder* recorder, uint32_t worker) {
+    VkResult result = vkResetCommandPool(recorder->device, recorder->pools[worker], 0);
+    VkCommandBufferInheritanceInfo inheritanceInfo = {0};
+    inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    VkCommandBufferBeginInfo beginInfo = {0};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    beginInfo.pInheritanceInfo = &inheritanceInfo;
+
+    for (uint32_t batch = 0; batch < recorder->batchCount && result == VK_SUCCESS; batch++) {
+        VkCommandBuffer commandBuffer = recorder->commandBuffers[batch * recorder->workerCount + worker];
+        result = vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        if (result != VK_SUCCESS) break;
+        recorder->function(commandBuffer, worker, batch, recorder->user);
+        result = vkEndCommandBuffer(commandBuffer);
+    }
+
+    mutexLock(&recorder->mutex);
+    if (result != VK_SUCCESS && recorder->result == VK_SUCCESS) recorder->result = result;
+    mutexUnlock(&recorder->mutex);
+}
+
+static void* parallelRecordThread(void* argument) {
+    RecordWorker* worker = (RecordWorker*)argument;
+    ParallelRecorder* recorder = worker->recorder;
+    uint64_t seen = 0;
+    for (;;) {
+        mutexLock(&recorder->mutex);
+        while (!recorder->quit && recorder->generation == seen) {
+            condWait(&recorder->wake, &recorder->mutex);
+        }
+        if (recorder->quit) {
+            mutexUnlock(&recorder->mutex);
+            return NULL;
+        }
+        seen = recorder->generation;
+        mutexUnlock(&recorder->mutex);
+
+        parallelRecordWorker(recorder, worker->index);
+
+        mutexLock(&recorder->mutex);
+        if (--recorder->pending == 0) condBroadcast(&recorder->done);
+        mutexUnlock(&recorder->mutex);
+    }
+}
+
+// Stops worker threads 1..threadCount-1, destroys the pools (which frees
+// their buffers) and the synchronization objects. Pools never created are
+// VK_NULL_HANDLE, which vkDestroyCommandPool ignores.
+static void parallelRecorderRelease(ParallelRecorder* recorder, uint32_t threadCount) {
+    mutexLock(&recorder->mutex);
+    recorder->quit = 1;
+    condBroadcast(&recorder->wake);
+    mutexUnlock(&recorder->mutex);
+    for (uint32_t w = 1; w < threadCount; w++) {
+        threadJoin(recorder->threads[w]);
+    }
+    for (uint32_t w = 0; w < recorder->workerCount; w++) {
+        vkDestroyCommandPool(recorder->device, recorder->pools[w], hostCallbacks);
+    }
+    condDestroy(&recorder->done);
+    condDestroy(&recorder->wake);
+    mutexDestroy(&recorder->mutex);
+    free(recorder->commandBuffers);
+}
+
+// Creates `workerCount` pools with `batchCount` secondaries each and starts
+// the worker threads. Returns 0 on failure, after releasing whatever was
+// already created.
+static int parallelRecorderInit(ParallelRecorder* recorder, VkDevice device, uint32_t queueFamilyIndex,
+                                uint32_t workerCount, uint32_t batchCount) {
+    memset(recorder, 0, sizeof(*recorder));
+    if (workerCount < 1 || workerCount > PARALLEL_RECORD_MAX_WORKERS) {
+        return 0;
+    }
+    recorder->device = device;
+    recorder->workerCount = workerCount;
+    recorder->batchCount = batchCount;
+    recorder->commandBuffers = (VkCommandBuffer*)calloc((size_t)workerCount * batchCount, sizeof(VkCommandBuffer));
+    mutexInit(&recorder->mutex);
+    condInit(&recorder->wake);
+    condInit(&recorder->done);
+
+    VkCommandPoolCreateInfo poolCreateInfo = {0};
+    poolCreateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolCreateInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolCreateInfo.queueFamilyIndex = queueFamilyIndex;
+    VkCommandBuffer* perWorker = (VkCommandBuffer*)malloc(batchCount * sizeof(VkCommandBuffer));
+    for (uint32_t w = 0; w < workerCount; w++) {
+        if (vkCreateCommandPool(device, &poolCreateInfo, hostCallbacks, &recorder->pools[w]) != VK_SUCCESS) {
+            recorder->pools[w] = VK_NULL_HANDLE;
+            free(perWorker);
+            parallelRecorderRelease(recorder, 1);
+            return 0;
+        }
+        VkCommandBufferAllocateInfo allocInfo = {0};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = recorder->pools[w];
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = batchCount;
+        if (vkAllocateCommandBuffers(device, &allocInfo, perWorker) != VK_SUCCESS) {
+            free(perWorker);
+            parallelRecorderRelease(recorder, 1);
+            return 0;
+        }
+        for (uint32_t b = 0; b < batchCount; b++) {
+            recorder->commandBuffers[b * workerCount + w] = perWorker[b];
+        }
+    }
+    free(perWorker);
+
+    for (uint32_t w = 1; w < workerCount; w++) {
+        recorder->workers[w].recorder = recorder;
+        recorder->workers[w].index = w;
+        if (!threadCreate(&recorder->threads[w], parallelRecordThread, &recorder->workers[w])) {
+            parallelRecorderRelease(recorder, w);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Records every batch on all workers and returns the wall time in seconds.
+// Check recorder->result afterwards.
+static double parallelRecorderRecord(ParallelRecorder* recorder, RecordFunction function, void* user) {
+    double start = getTimeSeconds();
+    mutexLock(&recorder->mutex);
+    recorder->function = function;
+    recorder->user = user;
+    recorder->result = VK_SUCCESS;
+    recorder->pending = recorder->workerCount - 1;
+    recorder->generation++;
+    condBroadcast(&recorder->wake);
+    mutexUnlock(&recorder->mutex);
+
+    parallelRecordWorker(recorder, 0);
+
+    mutexLock(&recorder->mutex);
+    while (recorder->pending > 0) {
+        condWait(&recorder->done, &recorder->mutex);
+    }
+    mutexUnlock(&recorder->mutex);
+    return getTimeSeconds() - start;
+}
+
+// Executes every worker's secondary for `batch` from `primary`.
+static void parallelRecorderExecute(const ParallelRecorder* recorder, VkCommandBuffer primary, uint32_t batch) {
+    vkCmdExecuteCommands(primary, recorder->workerCount, &recorder->commandBuffers[batch * recorder->workerCount]);
+}
+
+// Stops the workers and destroys the pools (which frees their buffers).
+static void parallelRecorderDestroy(ParallelRecorder* recorder) {
+    parallelRecorderRelease(recorder, recorder->workerCount);
+}
+
+#endif // PARALLEL_RECORD_H
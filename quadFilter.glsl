@@ -0,0 +1,58 @@
+// quadFilter.glsl
+// 2x2 neighbourhood filter for the quad benchmark (compute --quad-bench).
+// Built with -DQUAD_OPS it exchanges values with subgroupQuadSwap*() and
+// subgroupQuadBroadcast() (GL_KHR_shader_subgroup_quad); without it, with
+// the same exchanges written as arbitrary-index subgroupShuffle(). Both
+// builds produce the same image, so only the instructions differ.
+//
+// A quad is lanes 4k..4k+3: (x, y), (x+1, y), (x, y+1), (x+1, y+1). Fragment
+// quads are laid out that way; compute kernels get it from the morton mapping.
+
+#ifdef QUAD_OPS
+#extension GL_KHR_shader_subgroup_quad : require
+#endif
+
+vec2 quadHorizontal(vec2 value) {
+#ifdef QUAD_OPS
+    return subgroupQuadSwapHorizontal(value);
+#else
+    return subgroupShuffle(value, gl_SubgroupInvocationID ^ 1u);
+#endif
+}
+
+vec2 quadVertical(vec2 value) {
+#ifdef QUAD_OPS
+    return subgroupQuadSwapVertical(value);
+#else
+    return subgroupShuffle(value, gl_SubgroupInvocationID ^ 2u);
+#endif
+}
+
+vec2 quadDiagonal(vec2 value) {
+#ifdef QUAD_OPS
+    return subgroupQuadSwapDiagonal(value);
+#else
+    return subgroupShuffle(value, gl_SubgroupInvocationID ^ 3u);
+#endif
+}
+
+vec2 quadFirst(vec2 value) {
+#ifdef QUAD_OPS
+    return subgroupQuadBroadcast(value, 0u);
+#else
+    return subgroupShuffle(value, gl_SubgroupInvocationID & ~3u);
+#endif
+}
+
+// Red: 2x2 box blur of the gradient. Green: gradient edges across the quad.
+// Blue: the lane gray of the quad's first pixel, a 2x downsample.
+vec4 quadFilter(vec2 value) {
+    vec2 horizontal = quadHorizontal(value);
+    vec2 vertical = quadVertical(value);
+    vec2 diagonal = quadDiagonal(value);
+    vec2 first = quadFirst(value);
+
+    float box = (value.y + horizontal.y + vertical.y + diagonal.y) * 0.25;
+    float edge = abs(value.y - horizontal.y) + abs(value.y - vertical.y);
+    return vec4(box, clamp(edge * 16.0, 0.0, 1.0), first.x, 1.0);
+}
@@ -0,0 +1,29 @@
+// shaderGrid.vert
+// Instanced triangle grid for the lane utilization sweep (render
+// --lane-sweep). Instance i is one right triangle filling the lower-left half
+// of cell i of a row-major grid of square cells, so the sweep controls both
+// the size and the number of primitives. Each instance is one primitive and
+// passes its index to the fragment shader.
+#version 450
+
+// Render target size in pixels.
+layout(constant_id = 0) const uint RENDER_WIDTH = 256;
+layout(constant_id = 1) const uint RENDER_HEIGHT = 256;
+
+// Must match LaneSweepGrid in lane_sweep.h.
+layout(push_constant) uniform GridBlock {
+    uint cellSize; // Cell edge and triangle leg, in pixels.
+    uint columns;  // Cells per row.
+} grid;
+
+layout(location = 0) flat out uint outPrimitive;
+
+void main() {
+    uint instance = uint(gl_InstanceIndex);
+    vec2 origin = vec2(instance % grid.columns, instance / grid.columns) * float(grid.cellSize);
+    vec2 corner = vec2(uint(gl_VertexIndex) == 1u ? 1.0 : 0.0, uint(gl_VertexIndex) == 2u ? 1.0 : 0.0);
+    vec2 pixel = origin + corner * float(grid.cellSize);
+
+    outPrimitive = instance;
+    gl_Position = vec4(pixel / vec2(RENDER_WIDTH, RENDER_HEIGHT) * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,54 @@
+// shaderLaneStats.frag
+// Fragment subgroup packing counters for the lane utilization sweep (render
+// --lane-sweep, drawn with shaderGrid.vert). One real lane of every subgroup
+// adds its subgroup's non-helper lanes, helper lanes and distinct primitives
+// to the counters, plus one to the histogram bin of its non-helper lane
+// count. Needs fragmentStoresAndAtomics and the basic, vote, ballot and
+// shuffle subgroup extensions in the fragment stage.
+#version 450
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_vote : require
+#extension GL_KHR_shader_subgroup_ballot : require
+#extension GL_KHR_shader_subgroup_shuffle : require
+
+layout(location = 0) flat in uint primitive;
+layout(location = 0) out vec4 outColor;
+
+// Must match LaneSweepStats in lane_sweep.h.
+layout(set = 0, binding = 0, std430) buffer LaneUtilization {
+    uint subgroups;   // Subgroups with at least one non-helper lane.
+    uint activeLanes; // Non-helper lanes in those subgroups.
+    uint helperLanes; // Helper lanes in those subgroups.
+    uint primitives;  // Sum over subgroups of the distinct primitives in each.
+    uint histogram[]; // Subgroups by non-helper lane count, 0..128.
+} stats;
+
+void main() {
+    uint lane = gl_SubgroupInvocationID;
+    uvec4 real = subgroupBallot(!gl_HelperInvocation);
+    uint activeCount = subgroupBallotBitCount(subgroupBallot(true));
+    uint realCount = subgroupBallotBitCount(real);
+
+    // Peel off one primitive per pass: the lowest pending lane names it and
+    // every lane of that primitive drops out. The loop is subgroup-uniform.
+    uint distinctPrimitives = 0u;
+    bool pending = true;
+    while (subgroupAny(pending)) {
+        uint leader = subgroupBallotFindLSB(subgroupBallot(pending));
+        uint leaderPrimitive = subgroupShuffle(primitive, leader);
+        pending = pending && primitive != leaderPrimitive;
+        distinctPrimitives++;
+    }
+
+    // Helper invocations can't write memory, so a real lane reports.
+    if (!gl_HelperInvocation && lane == subgroupBallotFindLSB(real)) {
+        atomicAdd(stats.subgroups, 1u);
+        atomicAdd(stats.activeLanes, realCount);
+        atomicAdd(stats.helperLanes, activeCount - realCount);
+        atomicAdd(stats.primitives, distinctPrimitives);
+        atomicAdd(stats.histogram[realCount], 1u);
+    }
+
+    // Red: share of the subgroup doing real work. Green: share of helpers.
+    outColor = vec4(float(realCount) / float(gl_SubgroupSize), float(activeCount - realCount) / float(gl_SubgroupSize), 0.0, 1.0);
+}
@@ -0,0 +1,25 @@
+// shaderQuad.frag
+// Fragment half of the quad benchmark (compute --quad-bench): the 2x2 filter
+// of quadFilter.glsl over the lane gray and the moving gradient. Built twice,
+// with -DQUAD_OPS (quad operations) and without (shuffles).
+#version 450
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_shuffle : require
+#extension GL_GOOGLE_include_directive : require
+
+// Per-frame push constants (shuffle pattern, offset, scale, time).
+#include "frameParams.glsl"
+#include "quadFilter.glsl"
+
+// Render target size, for the gradient.
+layout(constant_id = 0) const uint RENDER_WIDTH = 256;
+layout(constant_id = 1) const uint RENDER_HEIGHT = 256;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float gray = float(gl_SubgroupInvocationID) / float(gl_SubgroupSize - 1);
+    float gradient = frameGradient(vec2(pixel), vec2(RENDER_WIDTH, RENDER_HEIGHT));
+    outColor = quadFilter(vec2(gray, gradient));
+}
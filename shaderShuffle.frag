@@ -1,21 +1,25 @@
 #version 450
 #extension GL_KHR_shader_subgroup_basic : enable
 #extension GL_KHR_shader_subgroup_shuffle : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Per-frame push constants (shuffle pattern, offset, scale, time).
+#include "frameParams.glsl"
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
     // Get the screen-relative coordinates.
     float r = gl_FragCoord.x / 256.0;
-    float g = gl_FragCoord.y / 256.0;
-    vec4 color = vec4(r, g, 0.2, 1.0);
+    float g = frameGradient(gl_FragCoord.xy, vec2(256.0));
+    float b = 0.2 + 0.2 * sin(frameParams.time);
+    vec4 color = vec4(r, g, b, 1.0);
 
     // Convert the float color to uint for bitwise-safe shuffling.
     uvec4 packed = floatBitsToUint(color);
 
-    // Reverse the pixels within the subgroup.
-    uint subgroupSize = gl_SubgroupSize;
-    uint targetIndex = subgroupSize - 1 - gl_SubgroupInvocationID;
+    // Permute the pixels within the subgroup (reverse by default).
+    uint targetIndex = shuffleSource(gl_SubgroupInvocationID, gl_SubgroupSize);
 
     // Shuffle each component of the packed color vector.
     uvec4 shuffledPacked;
@@ -0,0 +1,24 @@
+#version 450
+#extension GL_KHR_shader_subgroup_basic : enable
+#extension GL_KHR_shader_subgroup_shuffle : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#extension GL_EXT_shader_subgroup_extended_types_float16 : require
+
+// Requires shaderFloat16 and shaderSubgroupExtendedTypes (enabled by main.c
+// when the device supports them).
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Get the screen-relative coordinates.
+    float r = gl_FragCoord.x / 256.0;
+    float g = gl_FragCoord.y / 256.0;
+    f16vec4 color = f16vec4(vec4(r, g, 0.2, 1.0));
+
+    // Reverse the pixels within the subgroup, moving the whole 64-bit
+    // f16vec4 with one shuffle.
+    uint targetIndex = gl_SubgroupSize - 1 - gl_SubgroupInvocationID;
+    color = subgroupShuffle(color, targetIndex);
+
+    outColor = vec4(color);
+}
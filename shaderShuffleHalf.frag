@@ -0,0 +1,24 @@
+#version 450
+#extension GL_KHR_shader_subgroup_basic : enable
+#extension GL_KHR_shader_subgroup_shuffle : enable
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Get the screen-relative coordinates.
+    float r = gl_FragCoord.x / 256.0;
+    float g = gl_FragCoord.y / 256.0;
+    vec4 color = vec4(r, g, 0.2, 1.0);
+
+    // Pack the color as four halfs in two 32-bit words. This needs no extra
+    // device features and halves the shuffle count of shaderShuffle.frag.
+    uvec2 packedColor = uvec2(packHalf2x16(color.rg), packHalf2x16(color.ba));
+
+    // Reverse the pixels within the subgroup.
+    uint targetIndex = gl_SubgroupSize - 1 - gl_SubgroupInvocationID;
+    packedColor.x = subgroupShuffle(packedColor.x, targetIndex);
+    packedColor.y = subgroupShuffle(packedColor.y, targetIndex);
+
+    // Unpack and write the shuffled color.
+    outColor = vec4(unpackHalf2x16(packedColor.x), unpackHalf2x16(packedColor.y));
+}
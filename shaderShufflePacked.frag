@@ -0,0 +1,24 @@
+#version 450
+#extension GL_KHR_shader_subgroup_basic : enable
+#extension GL_KHR_shader_subgroup_shuffle : enable
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    // Get the screen-relative coordinates.
+    float r = gl_FragCoord.x / 256.0;
+    float g = gl_FragCoord.y / 256.0;
+    vec4 color = vec4(r, g, 0.2, 1.0);
+
+    // The render target is rgba8, so 8 bits per channel is all the precision
+    // we keep anyway. Packing the color into one 32-bit word turns the four
+    // per-component shuffles of shaderShuffle.frag into a single one.
+    uint packedColor = packUnorm4x8(color);
+
+    // Reverse the pixels within the subgroup.
+    uint targetIndex = gl_SubgroupSize - 1 - gl_SubgroupInvocationID;
+    packedColor = subgroupShuffle(packedColor, targetIndex);
+
+    // Unpack and write the shuffled color.
+    outColor = unpackUnorm4x8(packedColor);
+}
@@ -0,0 +1,24 @@
+// shaderShufflePattern.frag
+// shaderSubgroupShuffleGray.frag with the shuffle pattern chosen by
+// specialization constants (shuffleSpec.glsl). render --spec-pattern picks
+// the variant at pipeline creation.
+#version 450
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_shuffle : require
+#extension GL_GOOGLE_include_directive : require
+
+// Per-frame push constants; the pattern field is unused.
+#include "frameParams.glsl"
+#include "shuffleSpec.glsl"
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    uint idx = gl_SubgroupInvocationID;
+    uint size = gl_SubgroupSize;
+
+    float gray = float(idx) / float(size - 1);
+    gray = subgroupShuffle(gray, shuffleSpecSource(idx, size));
+
+    outColor = vec4(gray, gray, gray, 1.0);
+}
@@ -2,13 +2,17 @@
 #extension GL_KHR_shader_subgroup_basic : enable
 #extension GL_KHR_shader_subgroup_basic : enable
 #extension GL_KHR_shader_subgroup_shuffle : enable
+#extension GL_GOOGLE_include_directive : require
+
+// Per-frame push constants (shuffle pattern, offset, scale, time).
+#include "frameParams.glsl"
 
 layout(location = 0) out vec4 outColor;
 
 void main() {
     uint idx = gl_SubgroupInvocationID;
     uint size = gl_SubgroupSize;
-    uint targetIndex = size - 1 - gl_SubgroupInvocationID;
+    uint targetIndex = shuffleSource(idx, size);
 
     // Normalize index to [0,1] range
     float gray = float(idx) / float(size - 1);
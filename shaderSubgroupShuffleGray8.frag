@@ -0,0 +1,24 @@
+#version 450
+#extension GL_KHR_shader_subgroup_basic : enable
+#extension GL_KHR_shader_subgroup_shuffle : enable
+#extension GL_EXT_shader_explicit_arithmetic_types_int8 : require
+#extension GL_EXT_shader_subgroup_extended_types_int8 : require
+
+// Requires shaderInt8 and shaderSubgroupExtendedTypes (enabled by main.c
+// when the device supports them).
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    uint idx = gl_SubgroupInvocationID;
+    uint size = gl_SubgroupSize;
+    uint targetIndex = size - 1 - gl_SubgroupInvocationID;
+
+    // Quantize the normalized index to 8 bits, which is all an rgba8 target
+    // keeps, and shuffle the byte instead of a 32-bit float.
+    uint8_t gray = uint8_t(round(255.0 * float(idx) / float(size - 1)));
+    gray = subgroupShuffle(gray, targetIndex);
+
+    float value = float(gray) / 255.0;
+    outColor = vec4(value, value, value, 1.0);
+}
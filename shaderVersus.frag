@@ -0,0 +1,32 @@
+// shaderVersus.frag
+// Fragment half of the graphics vs compute comparison (compute --versus).
+// Writes the same colour as shaderComputeVersus.comp: the shuffled lane
+// gray in red, the moving gradient in green and the subgroup size in blue.
+// Built twice, plain and with -DLANE_STATS (see laneStats.glsl).
+#version 450
+#extension GL_KHR_shader_subgroup_basic : require
+#extension GL_KHR_shader_subgroup_ballot : require
+#extension GL_KHR_shader_subgroup_shuffle : require
+#extension GL_GOOGLE_include_directive : require
+
+// Per-frame push constants (shuffle pattern, offset, scale, time).
+#include "frameParams.glsl"
+#include "laneStats.glsl"
+
+// Render target size, for the gradient (compute reads it from the image).
+layout(constant_id = 0) const uint RENDER_WIDTH = 256;
+layout(constant_id = 1) const uint RENDER_HEIGHT = 256;
+
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    recordLaneStats(pixel, gl_HelperInvocation);
+
+    float r = float(gl_SubgroupInvocationID) / float(gl_SubgroupSize - 1);
+    r = subgroupShuffle(r, shuffleSource(gl_SubgroupInvocationID, gl_SubgroupSize));
+    float g = frameGradient(vec2(pixel), vec2(RENDER_WIDTH, RENDER_HEIGHT));
+    float b = float(gl_SubgroupSize) / 64.0;
+
+    outColor = vec4(r, g, b, 1.0);
+}
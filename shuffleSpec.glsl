@@ -0,0 +1,113 @@
+// shuffleSpec.glsl
+// Shuffle patterns selected by specialization constants, for the
+// parameterized kernels (shaderComputeShufflePattern.comp,
+// shaderShufflePattern.frag). The host picks the pattern and its argument at
+// pipeline creation (shuffle_variants.h), so each variant is its own
+// pipeline and the driver folds the pattern branch and the index math.
+//
+//   SHUFFLE_PATTERN = 0  reverse    size - 1 - lane
+//   SHUFFLE_PATTERN = 1  rotate     lane + ARGUMENT, wrapping
+//   SHUFFLE_PATTERN = 2  xor        lane ^ ARGUMENT (butterfly)
+//   SHUFFLE_PATTERN = 3  broadcast  every lane reads lane ARGUMENT
+//   SHUFFLE_PATTERN = 4  random     SHUFFLE_TABLE[lane], a permutation the
+//                                   host draws from the seed in ARGUMENT
+//
+// Subgroup sizes are powers of two, so wrapping is a mask. The table covers
+// 64 lanes; larger subgroups apply it to each block of 64.
+// Constant ids 8, 9 and 16..79 keep clear of invocationMapping.glsl (0..2).
+
+layout(constant_id = 8) const uint SHUFFLE_PATTERN = 0;
+layout(constant_id = 9) const uint SHUFFLE_ARGUMENT = 1;
+
+layout(constant_id = 16) const uint SHUFFLE_TABLE_0 = 0u;
+layout(constant_id = 17) const uint SHUFFLE_TABLE_1 = 1u;
+layout(constant_id = 18) const uint SHUFFLE_TABLE_2 = 2u;
+layout(constant_id = 19) const uint SHUFFLE_TABLE_3 = 3u;
+layout(constant_id = 20) const uint SHUFFLE_TABLE_4 = 4u;
+layout(constant_id = 21) const uint SHUFFLE_TABLE_5 = 5u;
+layout(constant_id = 22) const uint SHUFFLE_TABLE_6 = 6u;
+layout(constant_id = 23) const uint SHUFFLE_TABLE_7 = 7u;
+layout(constant_id = 24) const uint SHUFFLE_TABLE_8 = 8u;
+layout(constant_id = 25) const uint SHUFFLE_TABLE_9 = 9u;
+layout(constant_id = 26) const uint SHUFFLE_TABLE_10 = 10u;
+layout(constant_id = 27) const uint SHUFFLE_TABLE_11 = 11u;
+layout(constant_id = 28) const uint SHUFFLE_TABLE_12 = 12u;
+layout(constant_id = 29) const uint SHUFFLE_TABLE_13 = 13u;
+layout(constant_id = 30) const uint SHUFFLE_TABLE_14 = 14u;
+layout(constant_id = 31) const uint SHUFFLE_TABLE_15 = 15u;
+layout(constant_id = 32) const uint SHUFFLE_TABLE_16 = 16u;
+layout(constant_id = 33) const uint SHUFFLE_TABLE_17 = 17u;
+layout(constant_id = 34) const uint SHUFFLE_TABLE_18 = 18u;
+layout(constant_id = 35) const uint SHUFFLE_TABLE_19 = 19u;
+layout(constant_id = 36) const uint SHUFFLE_TABLE_20 = 20u;
+layout(constant_id = 37) const uint SHUFFLE_TABLE_21 = 21u;
+layout(constant_id = 38) const uint SHUFFLE_TABLE_22 = 22u;
+layout(constant_id = 39) const uint SHUFFLE_TABLE_23 = 23u;
+layout(constant_id = 40) const uint SHUFFLE_TABLE_24 = 24u;
+layout(constant_id = 41) const uint SHUFFLE_TABLE_25 = 25u;
+layout(constant_id = 42) const uint SHUFFLE_TABLE_26 = 26u;
+layout(constant_id = 43) const uint SHUFFLE_TABLE_27 = 27u;
+layout(constant_id = 44) const uint SHUFFLE_TABLE_28 = 28u;
+layout(constant_id = 45) const uint SHUFFLE_TABLE_29 = 29u;
+layout(constant_id = 46) const uint SHUFFLE_TABLE_30 = 30u;
+layout(constant_id = 47) const uint SHUFFLE_TABLE_31 = 31u;
+layout(constant_id = 48) const uint SHUFFLE_TABLE_32 = 32u;
+layout(constant_id = 49) const uint SHUFFLE_TABLE_33 = 33u;
+layout(constant_id = 50) const uint SHUFFLE_TABLE_34 = 34u;
+layout(constant_id = 51) const uint SHUFFLE_TABLE_35 = 35u;
+layout(constant_id = 52) const uint SHUFFLE_TABLE_36 = 36u;
+layout(constant_id = 53) const uint SHUFFLE_TABLE_37 = 37u;
+layout(constant_id = 54) const uint SHUFFLE_TABLE_38 = 38u;
+layout(constant_id = 55) const uint SHUFFLE_TABLE_39 = 39u;
+layout(constant_id = 56) const uint SHUFFLE_TABLE_40 = 40u;
+layout(constant_id = 57) const uint SHUFFLE_TABLE_41 = 41u;
+layout(constant_id = 58) const uint SHUFFLE_TABLE_42 = 42u;
+layout(constant_id = 59) const uint SHUFFLE_TABLE_43 = 43u;
+layout(constant_id = 60) const uint SHUFFLE_TABLE_44 = 44u;
+layout(constant_id = 61) const uint SHUFFLE_TABLE_45 = 45u;
+layout(constant_id = 62) const uint SHUFFLE_TABLE_46 = 46u;
+layout(constant_id = 63) const uint SHUFFLE_TABLE_47 = 47u;
+layout(constant_id = 64) const uint SHUFFLE_TABLE_48 = 48u;
+layout(constant_id = 65) const uint SHUFFLE_TABLE_49 = 49u;
+layout(constant_id = 66) const uint SHUFFLE_TABLE_50 = 50u;
+layout(constant_id = 67) const uint SHUFFLE_TABLE_51 = 51u;
+layout(constant_id = 68) const uint SHUFFLE_TABLE_52 = 52u;
+layout(constant_id = 69) const uint SHUFFLE_TABLE_53 = 53u;
+layout(constant_id = 70) const uint SHUFFLE_TABLE_54 = 54u;
+layout(constant_id = 71) const uint SHUFFLE_TABLE_55 = 55u;
+layout(constant_id = 72) const uint SHUFFLE_TABLE_56 = 56u;
+layout(constant_id = 73) const uint SHUFFLE_TABLE_57 = 57u;
+layout(constant_id = 74) const uint SHUFFLE_TABLE_58 = 58u;
+layout(constant_id = 75) const uint SHUFFLE_TABLE_59 = 59u;
+layout(constant_id = 76) const uint SHUFFLE_TABLE_60 = 60u;
+layout(constant_id = 77) const uint SHUFFLE_TABLE_61 = 61u;
+layout(constant_id = 78) const uint SHUFFLE_TABLE_62 = 62u;
+layout(constant_id = 79) const uint SHUFFLE_TABLE_63 = 63u;
+
+const uint SHUFFLE_TABLE[64] = uint[64](
+    SHUFFLE_TABLE_0, SHUFFLE_TABLE_1, SHUFFLE_TABLE_2, SHUFFLE_TABLE_3, SHUFFLE_TABLE_4, SHUFFLE_TABLE_5, SHUFFLE_TABLE_6, SHUFFLE_TABLE_7,
+    SHUFFLE_TABLE_8, SHUFFLE_TABLE_9, SHUFFLE_TABLE_10, SHUFFLE_TABLE_11, SHUFFLE_TABLE_12, SHUFFLE_TABLE_13, SHUFFLE_TABLE_14, SHUFFLE_TABLE_15,
+    SHUFFLE_TABLE_16, SHUFFLE_TABLE_17, SHUFFLE_TABLE_18, SHUFFLE_TABLE_19, SHUFFLE_TABLE_20, SHUFFLE_TABLE_21, SHUFFLE_TABLE_22, SHUFFLE_TABLE_23,
+    SHUFFLE_TABLE_24, SHUFFLE_TABLE_25, SHUFFLE_TABLE_26, SHUFFLE_TABLE_27, SHUFFLE_TABLE_28, SHUFFLE_TABLE_29, SHUFFLE_TABLE_30, SHUFFLE_TABLE_31,
+    SHUFFLE_TABLE_32, SHUFFLE_TABLE_33, SHUFFLE_TABLE_34, SHUFFLE_TABLE_35, SHUFFLE_TABLE_36, SHUFFLE_TABLE_37, SHUFFLE_TABLE_38, SHUFFLE_TABLE_39,
+    SHUFFLE_TABLE_40, SHUFFLE_TABLE_41, SHUFFLE_TABLE_42, SHUFFLE_TABLE_43, SHUFFLE_TABLE_44, SHUFFLE_TABLE_45, SHUFFLE_TABLE_46, SHUFFLE_TABLE_47,
+    SHUFFLE_TABLE_48, SHUFFLE_TABLE_49, SHUFFLE_TABLE_50, SHUFFLE_TABLE_51, SHUFFLE_TABLE_52, SHUFFLE_TABLE_53, SHUFFLE_TABLE_54, SHUFFLE_TABLE_55,
+    SHUFFLE_TABLE_56, SHUFFLE_TABLE_57, SHUFFLE_TABLE_58, SHUFFLE_TABLE_59, SHUFFLE_TABLE_60, SHUFFLE_TABLE_61, SHUFFLE_TABLE_62, SHUFFLE_TABLE_63
+);
+
+// Source lane for subgroupShuffle under the specialized pattern.
+uint shuffleSpecSource(uint lane, uint size) {
+    if (SHUFFLE_PATTERN == 1u) {
+        return (lane + SHUFFLE_ARGUMENT) & (size - 1u);
+    }
+    if (SHUFFLE_PATTERN == 2u) {
+        return lane ^ (SHUFFLE_ARGUMENT & (size - 1u));
+    }
+    if (SHUFFLE_PATTERN == 3u) {
+        return SHUFFLE_ARGUMENT & (size - 1u);
+    }
+    if (SHUFFLE_PATTERN == 4u) {
+        return (lane & ~63u) | SHUFFLE_TABLE[lane & 63u];
+    }
+    return size - 1u - lane;
+}
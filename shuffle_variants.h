@@ -0,0 +1,191 @@
+// shuffle_variants.h
+// Shuffle patterns baked in at pipeline creation, for the kernels built on
+// shuffleSpec.glsl (shaderComputeShufflePattern.comp, shaderShufflePattern.frag).
+// A variant is a pattern plus its argument; shuffleVariantSpecialize() turns
+// it into the VkSpecializationInfo those shaders read, and
+// ShuffleVariantCache keeps one pipeline per variant so a sweep builds each
+// pipeline once and never recompiles GLSL. Include after vulkan_functions.h.
+
+#ifndef SHUFFLE_VARIANTS_H
+#define SHUFFLE_VARIANTS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "host_alloc.h"
+
+typedef enum {
+    SHUFFLE_SPEC_REVERSE,
+    SHUFFLE_SPEC_ROTATE,    // Argument: rotation in lanes.
+    SHUFFLE_SPEC_XOR,       // Argument: xor mask.
+    SHUFFLE_SPEC_BROADCAST, // Argument: source lane. Not a permutation.
+    SHUFFLE_SPEC_RANDOM,    // Argument: seed of the permutation table.
+    SHUFFLE_SPEC_COUNT,
+} ShuffleSpecPattern;
+
+static const char* const shuffleSpecNames[SHUFFLE_SPEC_COUNT] = {"reverse", "rotate", "xor", "broadcast", "random"};
+
+// Constant ids declared by shuffleSpec.glsl.
+#define SHUFFLE_SPEC_PATTERN_ID 8
+#define SHUFFLE_SPEC_ARGUMENT_ID 9
+#define SHUFFLE_SPEC_TABLE_ID 16
+#define SHUFFLE_SPEC_TABLE_SIZE 64
+
+// Leading constants the caller adds to every variant, e.g. the invocation
+// mapping of the compute kernels.
+#define SHUFFLE_SPEC_MAX_BASE 4
+
+typedef struct {
+    uint32_t pattern;
+    uint32_t argument;
+} ShuffleVariant;
+
+// Parses "name" or "name:argument", e.g. "rotate:3". Returns 0 if unknown.
+static int parseShuffleVariant(const char* text, ShuffleVariant* variant) {
+    const char* colon = strchr(text, ':');
+    size_t length = colon ? (size_t)(colon - text) : strlen(text);
+    for (uint32_t pattern = 0; pattern < SHUFFLE_SPEC_COUNT; pattern++) {
+        if (strlen(shuffleSpecNames[pattern]) == length && strncmp(text, shuffleSpecNames[pattern], length) == 0) {
+            variant->pattern = pattern;
+            variant->argument = colon ? (uint32_t)strtoul(colon + 1, NULL, 10) : 1;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void shuffleVariantName(ShuffleVariant variant, char* name, size_t size) {
+    if (variant.pattern == SHUFFLE_SPEC_REVERSE) {
+        snprintf(name, size, "%s", shuffleSpecNames[variant.pattern]);
+    } else {
+        snprintf(name, size, "%s:%u", shuffleSpecNames[variant.pattern], variant.argument);
+    }
+}
+
+// Fills `table` with a permutation of [0, min(subgroupSize, 64)) drawn from
+// `seed` (xorshift32, Fisher-Yates); entries past the subgroup stay identity.
+static void shuffleVariantTable(uint32_t seed, uint32_t subgroupSize, uint32_t table[SHUFFLE_SPEC_TABLE_SIZE]) {
+    uint32_t count = subgroupSize < SHUFFLE_SPEC_TABLE_SIZE ? subgroupSize : SHUFFLE_SPEC_TABLE_SIZE;
+    uint32_t state = seed * 0x9E3779B9u + 1u;
+    for (uint32_t i = 0; i < SHUFFLE_SPEC_TABLE_SIZE; i++) {
+        table[i] = i;
+    }
+    for (uint32_t i = count; i > 1; i--) {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+        uint32_t j = state % i;
+        uint32_t swap = table[i - 1];
+        table[i - 1] = table[j];
+        table[j] = swap;
+    }
+}
+
+// Storage for one variant's specialization info; `info` points into it, so
+// keep it alive until the pipeline is created.
+typedef struct {
+    uint32_t values[SHUFFLE_SPEC_MAX_BASE + 2 + SHUFFLE_SPEC_TABLE_SIZE];
+    VkSpecializationMapEntry entries[SHUFFLE_SPEC_MAX_BASE + 2 + SHUFFLE_SPEC_TABLE_SIZE];
+    VkSpecializationInfo info;
+} ShuffleVariantSpecialization;
+
+// `baseIds`/`baseValues` (up to SHUFFLE_SPEC_MAX_BASE) come first. The table
+// is only passed for the random pattern; the others keep the shader default.
+static void shuffleVariantSpecialize(ShuffleVariantSpecialization* spec, ShuffleVariant variant, uint32_t subgroupSize,
+                                     const uint32_t* baseIds, const uint32_t* baseValues, uint32_t baseCount) {
+    uint32_t count = 0;
+    for (uint32_t i = 0; i < baseCount && i < SHUFFLE_SPEC_MAX_BASE; i++, count++) {
+        spec->entries[count].constantID = baseIds[i];
+        spec->values[count] = baseValues[i];
+    }
+    spec->entries[count].constantID = SHUFFLE_SPEC_PATTERN_ID;
+    spec->values[count++] = variant.pattern;
+    spec->entries[count].constantID = SHUFFLE_SPEC_ARGUMENT_ID;
+    spec->values[count++] = variant.argument;
+    if (variant.pattern == SHUFFLE_SPEC_RANDOM) {
+        uint32_t table[SHUFFLE_SPEC_TABLE_SIZE];
+        shuffleVariantTable(variant.argument, subgroupSize, table);
+        for (uint32_t i = 0; i < SHUFFLE_SPEC_TABLE_SIZE; i++, count++) {
+            spec->entries[count].constantID = SHUFFLE_SPEC_TABLE_ID + i;
+            spec->values[count] = table[i];
+        }
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        spec->entries[i].offset = i * sizeof(uint32_t);
+        spec->entries[i].size = sizeof(uint32_t);
+    }
+    spec->info.mapEntryCount = count;
+    spec->info.pMapEntries = spec->entries;
+    spec->info.dataSize = count * sizeof(uint32_t);
+    spec->info.pData = spec->values;
+}
+
+// Builds the pipeline of one variant from its specialization info.
+typedef VkPipeline (*ShuffleVariantBuildFn)(const VkSpecializationInfo* specialization, void* user);
+
+#define SHUFFLE_VARIANT_CACHE_CAPACITY 64
+
+// One pipeline per variant, built on first use. Lookups are a linear scan;
+// a sweep holds a few dozen variants at most.
+typedef struct {
+    VkDevice device;
+    uint32_t subgroupSize;
+    uint32_t baseIds[SHUFFLE_SPEC_MAX_BASE];
+    uint32_t baseValues[SHUFFLE_SPEC_MAX_BASE];
+    uint32_t baseCount;
+    ShuffleVariantBuildFn build;
+    void* user;
+    uint32_t count;
+    ShuffleVariant variants[SHUFFLE_VARIANT_CACHE_CAPACITY];
+    VkPipeline pipelines[SHUFFLE_VARIANT_CACHE_CAPACITY];
+    uint32_t hits;
+    uint32_t misses;
+} ShuffleVariantCache;
+
+static void shuffleVariantCacheInit(ShuffleVariantCache* cache, VkDevice device, uint32_t subgroupSize, const uint32_t* baseIds,
+                                    const uint32_t* baseValues, uint32_t baseCount, ShuffleVariantBuildFn build, void* user) {
+    memset(cache, 0, sizeof(*cache));
+    cache->device = device;
+    cache->subgroupSize = subgroupSize;
+    cache->baseCount = baseCount < SHUFFLE_SPEC_MAX_BASE ? baseCount : SHUFFLE_SPEC_MAX_BASE;
+    memcpy(cache->baseIds, baseIds, cache->baseCount * sizeof(uint32_t));
+    memcpy(cache->baseValues, baseValues, cache->baseCount * sizeof(uint32_t));
+    cache->build = build;
+    cache->user = user;
+}
+
+// The pipeline of `variant`, built if it isn't cached yet. VK_NULL_HANDLE if
+// the build fails or the cache is full.
+static VkPipeline shuffleVariantCacheGet(ShuffleVariantCache* cache, ShuffleVariant variant) {
+    for (uint32_t i = 0; i < cache->count; i++) {
+        if (cache->variants[i].pattern == variant.pattern && cache->variants[i].argument == variant.argument) {
+            cache->hits++;
+            return cache->pipelines[i];
+        }
+    }
+    if (cache->count == SHUFFLE_VARIANT_CACHE_CAPACITY) {
+        return VK_NULL_HANDLE;
+    }
+    ShuffleVariantSpecialization spec;
+    shuffleVariantSpecialize(&spec, variant, cache->subgroupSize, cache->baseIds, cache->baseValues, cache->baseCount);
+    VkPipeline pipeline = cache->build(&spec.info, cache->user);
+    if (pipeline == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+    cache->misses++;
+    cache->variants[cache->count] = variant;
+    cache->pipelines[cache->count] = pipeline;
+    cache->count++;
+    return pipeline;
+}
+
+static void shuffleVariantCacheDestroy(ShuffleVariantCache* cache) {
+    for (uint32_t i = 0; i < cache->count; i++) {
+        vkDestroyPipeline(cache->device, cache->pipelines[i], hostCallbacks);
+    }
+    cache->count = 0;
+}
+
+#endif // SHUFFLE_VARIANTS_H
@@ -0,0 +1,33 @@
+// sparseTiles.glsl
+// Sparse tile workload of the indirect dispatch benchmark (compute
+// --indirect-bench), shared by shaderComputeClassify.comp and
+// shaderComputeSparse.comp. A 16x16 tile carries work when its hash falls
+// below DENSITY out of 256, so the active tiles are scattered over the image;
+// the host mirrors the test with sparseTileActive() in compute.c.
+
+layout(constant_id = 3) const uint DENSITY = 256;
+
+#define TILE_DIM 16u
+
+// Active tiles compacted by the classification pass. The first three words
+// are a VkDispatchIndirectCommand: groupCountX doubles as the list length,
+// so the classification's atomic counter sizes the second pass directly.
+layout(set = 0, binding = 1, std430) buffer TileList {
+    uint groupCountX;
+    uint groupCountY;
+    uint groupCountZ;
+    uint tiles[];
+} tileList;
+
+uint hashTile(uint tile) {
+    tile ^= tile >> 16;
+    tile *= 0x7feb352du;
+    tile ^= tile >> 15;
+    tile *= 0x846ca68bu;
+    tile ^= tile >> 16;
+    return tile;
+}
+
+bool tileActive(uint tile) {
+    return (hashTile(tile) & 255u) < DENSITY;
+}
@@ -0,0 +1,369 @@
+// spirv_bundle.h
+// A single file holding every SPIR-V module plus an index, mapped into memory
+// at startup instead of reading loose files from spv/ one by one. Modules are
+// handed to vkCreateShaderModule straight from the mapping. spvbundle.c
+// writes bundles; the render and compute programs read them with --bundle.
+//
+// Layout, native endian:
+//   SpirvBundleHeader
+//   SpirvBundleEntry[moduleCount]   name, stage, entry point, hash, location
+//   module code, each starting on a 16-byte boundary
+//
+// Each module's hash is FNV-1a 64 over its code. The bundle hash combines
+// them and names the pipeline cache file, so a cache is never reused after a
+// shader changes. Without <vulkan/vulkan.h> only the file format, the writer
+// and the mapping are declared.
+
+#ifndef SPIRV_BUNDLE_H
+#define SPIRV_BUNDLE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#define SPIRV_BUNDLE_MAGIC 0x42565053u // "SPVB"
+#define SPIRV_BUNDLE_VERSION 1
+#define SPIRV_BUNDLE_NAME_LENGTH 64
+#define SPIRV_BUNDLE_ENTRY_LENGTH 32
+#define SPIRV_BUNDLE_ALIGNMENT 16
+
+// Stages as VkShaderStageFlagBits values, so the writer needs no Vulkan headers.
+#define SPIRV_BUNDLE_STAGE_VERTEX 0x01u
+#define SPIRV_BUNDLE_STAGE_FRAGMENT 0x10u
+#define SPIRV_BUNDLE_STAGE_COMPUTE 0x20u
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t moduleCount;
+    uint32_t reserved;
+} SpirvBundleHeader;
+
+typedef struct {
+    char name[SPIRV_BUNDLE_NAME_LENGTH];        // File name the module was built to, e.g. "shader.vert.spv".
+    char entryPoint[SPIRV_BUNDLE_ENTRY_LENGTH]; // From the module's OpEntryPoint.
+    uint32_t stage;                             // SPIRV_BUNDLE_STAGE_*.
+    uint32_t reserved;
+    uint64_t hash;                              // FNV-1a 64 of the code.
+    uint64_t offset;                            // From the start of the file.
+    uint64_t size;                              // In bytes.
+} SpirvBundleEntry;
+
+// An open, mapped bundle. `data` is NULL when none is open.
+typedef struct {
+    const uint8_t* data;
+    size_t size;
+    const SpirvBundleEntry* entries;
+    uint32_t moduleCount;
+    uint64_t hash;
+#ifdef _WIN32
+    HANDLE file;
+    HANDLE mapping;
+#endif
+} SpirvBundle;
+
+static uint64_t spirvBundleHashBytes(const void* data, size_t size, uint64_t hash) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= bytes[i];
+        hash *= 0x100000001B3ull;
+    }
+    return hash;
+}
+
+#define SPIRV_BUNDLE_HASH_SEED 0xCBF29CE484222325ull
+
+// Reads the execution model and name of the first OpEntryPoint. Returns 0 if
+// `code` isn't SPIR-V or has no entry point.
+static int spirvBundleParseEntryPoint(const uint32_t* code, size_t words, uint32_t* stage, char* name, size_t nameSize) {
+    if (words < 5 || code[0] != 0x07230203u) {
+        return 0;
+    }
+    for (size_t i = 5; i < words;) {
+        uint32_t wordCount = code[i] >> 16;
+        uint32_t opcode = code[i] & 0xFFFFu;
+        if (wordCount == 0 || i + wordCount > words) {
+            return 0;
+        }
+        if (opcode == 15 && wordCount >= 4) { // OpEntryPoint model id "name" ...
+            switch (code[i + 1]) {
+                case 0: *stage = SPIRV_BUNDLE_STAGE_VERTEX; break;
+                case 4: *stage = SPIRV_BUNDLE_STAGE_FRAGMENT; break;
+                case 5: *stage = SPIRV_BUNDLE_STAGE_COMPUTE; break;
+                default: return 0;
+            }
+            size_t maxBytes = (wordCount - 3) * sizeof(uint32_t);
+            const char* literal = (const char*)&code[i + 3];
+            size_t length = 0;
+            while (length < maxBytes && literal[length] != '\0') length++;
+            if (length >= nameSize) length = nameSize - 1;
+            memcpy(name, literal, length);
+            name[length] = '\0';
+            return 1;
+        }
+        i += wordCount;
+    }
+    return 0;
+}
+
+static const char* spirvBundleBaseName(const char* path) {
+    const char* name = path;
+    for (const char* p = path; *p; p++) {
+        if (*p == '/' || *p == '\\') name = p + 1;
+    }
+    return name;
+}
+
+// Writes the modules at `paths` into one bundle at `outputPath`, indexed by
+// file name. Returns 0 and prints the reason on failure.
+static int spirvBundleWrite(const char* outputPath, const char* const* paths, uint32_t count) {
+    SpirvBundleEntry* entries = (SpirvBundleEntry*)calloc(count ? count : 1, sizeof(SpirvBundleEntry));
+    uint8_t** codes = (uint8_t**)calloc(count ? count : 1, sizeof(uint8_t*));
+    int ok = entries != NULL && codes != NULL;
+    uint64_t offset = sizeof(SpirvBundleHeader) + (uint64_t)count * sizeof(SpirvBundleEntry);
+    for (uint32_t i = 0; ok && i < count; i++) {
+        const char* name = spirvBundleBaseName(paths[i]);
+        FILE* file = fopen(paths[i], "rb");
+        if (!file) {
+            fprintf(stderr, "Failed to open %s\n", paths[i]);
+            ok = 0;
+            break;
+        }
+        fseek(file, 0, SEEK_END);
+        long size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        codes[i] = (uint8_t*)malloc(size > 0 ? (size_t)size : 1);
+        ok = codes[i] != NULL && size > 0 && size % 4 == 0 && fread(codes[i], 1, (size_t)size, file) == (size_t)size;
+        fclose(file);
+        if (!ok || strlen(name) >= SPIRV_BUNDLE_NAME_LENGTH ||
+            !spirvBundleParseEntryPoint((const uint32_t*)codes[i], (size_t)size / 4, &entries[i].stage, entries[i].entryPoint,
+                                        SPIRV_BUNDLE_ENTRY_LENGTH)) {
+            fprintf(stderr, "Not a SPIR-V module with a vertex, fragment or compute entry point: %s\n", paths[i]);
+            ok = 0;
+            break;
+        }
+        for (uint32_t j = 0; j < i; j++) {
+            if (strcmp(entries[j].name, name) == 0) {
+                fprintf(stderr, "Duplicate module name %s\n", name);
+                ok = 0;
+            }
+        }
+        strcpy(entries[i].name, name);
+        offset = (offset + SPIRV_BUNDLE_ALIGNMENT - 1) / SPIRV_BUNDLE_ALIGNMENT * SPIRV_BUNDLE_ALIGNMENT;
+        entries[i].offset = offset;
+        entries[i].size = (uint64_t)size;
+        entries[i].hash = spirvBundleHashBytes(codes[i], (size_t)size, SPIRV_BUNDLE_HASH_SEED);
+        offset += (uint64_t)size;
+    }
+
+    FILE* out = ok ? fopen(outputPath, "wb") : NULL;
+    if (ok && !out) {
+        fprintf(stderr, "Failed to open %s for writing\n", outputPath);
+        ok = 0;
+    }
+    if (ok) {
+        SpirvBundleHeader header = {SPIRV_BUNDLE_MAGIC, SPIRV_BUNDLE_VERSION, count, 0};
+        uint64_t written = sizeof(header) + (uint64_t)count * sizeof(SpirvBundleEntry);
+        ok = fwrite(&header, sizeof(header), 1, out) == 1 && (count == 0 || fwrite(entries, sizeof(SpirvBundleEntry), count, out) == count);
+        static const uint8_t padding[SPIRV_BUNDLE_ALIGNMENT] = {0};
+        for (uint32_t i = 0; ok && i < count; i++) {
+            ok = fwrite(padding, 1, (size_t)(entries[i].offset - written), out) == entries[i].offset - written &&
+                 fwrite(codes[i], 1, (size_t)entries[i].size, out) == entries[i].size;
+            written = entries[i].offset + entries[i].size;
+        }
+        if (fclose(out) != 0) ok = 0;
+        if (!ok) fprintf(stderr, "Failed to write %s\n", outputPath);
+    }
+    for (uint32_t i = 0; codes && i < count; i++) {
+        free(codes[i]);
+    }
+    free(codes);
+    free(entries);
+    return ok;
+}
+
+// Maps the bundle at `path` read-only and checks its index. Returns 0 and
+// prints the reason on failure.
+static int spirvBundleOpen(SpirvBundle* bundle, const char* path) {
+    memset(bundle, 0, sizeof(*bundle));
+    void* data = NULL;
+    size_t size = 0;
+#ifdef _WIN32
+    bundle->file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    LARGE_INTEGER fileSize;
+    if (bundle->file == INVALID_HANDLE_VALUE || !GetFileSizeEx(bundle->file, &fileSize)) {
+        fprintf(stderr, "Failed to open shader bundle %s\n", path);
+        return 0;
+    }
+    size = (size_t)fileSize.QuadPart;
+    bundle->mapping = CreateFileMappingA(bundle->file, NULL, PAGE_READONLY, 0, 0, NULL);
+    data = bundle->mapping ? MapViewOfFile(bundle->mapping, FILE_MAP_READ, 0, 0, 0) : NULL;
+#else
+    int fd = open(path, O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat(fd, &st) != 0) {
+        fprintf(stderr, "Failed to open shader bundle %s\n", path);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    size = (size_t)st.st_size;
+    data = size > 0 ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd); // The mapping keeps the file alive.
+    if (data == MAP_FAILED) data = NULL;
+#endif
+    if (!data) {
+        fprintf(stderr, "Failed to map shader bundle %s\n", path);
+        return 0;
+    }
+    bundle->data = (const uint8_t*)data;
+    bundle->size = size;
+
+    const SpirvBundleHeader* header = (const SpirvBundleHeader*)bundle->data;
+    int valid = size >= sizeof(*header) && header->magic == SPIRV_BUNDLE_MAGIC && header->version == SPIRV_BUNDLE_VERSION &&
+                (size - sizeof(*header)) / sizeof(SpirvBundleEntry) >= header->moduleCount;
+    if (valid) {
+        bundle->entries = (const SpirvBundleEntry*)(bundle->data + sizeof(*header));
+        bundle->moduleCount = header->moduleCount;
+        bundle->hash = SPIRV_BUNDLE_HASH_SEED;
+        for (uint32_t i = 0; valid && i < bundle->moduleCount; i++) {
+            const SpirvBundleEntry* entry = &bundle->entries[i];
+            valid = entry->offset % 4 == 0 && entry->offset <= size && entry->size <= size - entry->offset &&
+                    memchr(entry->name, '\0', SPIRV_BUNDLE_NAME_LENGTH) != NULL;
+            bundle->hash = spirvBundleHashBytes(&entry->hash, sizeof(entry->hash), bundle->hash);
+        }
+    }
+    if (!valid) {
+        fprintf(stderr, "Not a valid shader bundle: %s\n", path);
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+        CloseHandle(bundle->mapping);
+        CloseHandle(bundle->file);
+#else
+        munmap(data, size);
+#endif
+        memset(bundle, 0, sizeof(*bundle));
+        return 0;
+    }
+    return 1;
+}
+
+// Looks a module up by file name; a path is reduced to its last component,
+// so "spv/shader.vert.spv" finds "shader.vert.spv". NULL if absent.
+static const SpirvBundleEntry* spirvBundleFind(const SpirvBundle* bundle, const char* path) {
+    const char* name = spirvBundleBaseName(path);
+    for (uint32_t i = 0; i < bundle->moduleCount; i++) {
+        if (strcmp(bundle->entries[i].name, name) == 0) {
+            return &bundle->entries[i];
+        }
+    }
+    return NULL;
+}
+
+static const uint32_t* spirvBundleCode(const SpirvBundle* bundle, const SpirvBundleEntry* entry) {
+    return (const uint32_t*)(bundle->data + entry->offset);
+}
+
+static void spirvBundleClose(SpirvBundle* bundle) {
+    if (bundle->data == NULL) {
+        return;
+    }
+#ifdef _WIN32
+    UnmapViewOfFile(bundle->data);
+    CloseHandle(bundle->mapping);
+    CloseHandle(bundle->file);
+#else
+    munmap((void*)bundle->data, bundle->size);
+#endif
+    memset(bundle, 0, sizeof(*bundle));
+}
+
+#ifdef VK_VERSION_1_0
+#include "host_alloc.h"
+
+// Creates a module from the mapped code, no copy. VK_NULL_HANDLE if `path`
+// isn't in the bundle.
+static VkShaderModule spirvBundleCreateModule(VkDevice device, const SpirvBundle* bundle, const char* path) {
+    const SpirvBundleEntry* entry = spirvBundleFind(bundle, path);
+    if (entry == NULL) {
+        return VK_NULL_HANDLE;
+    }
+    VkShaderModuleCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = (size_t)entry->size;
+    createInfo.pCode = spirvBundleCode(bundle, entry);
+    VkShaderModule module;
+    if (vkCreateShaderModule(device, &createInfo, hostCallbacks, &module) != VK_SUCCESS) {
+        return VK_NULL_HANDLE;
+    }
+    return module;
+}
+
+// "<bundle path>.<bundle hash>.pcache": the pipeline cache of this exact set
+// of modules.
+static void spirvBundleCachePath(const SpirvBundle* bundle, const char* bundlePath, char* path, size_t size) {
+    snprintf(path, size, "%s.%016llx.pcache", bundlePath, (unsigned long long)bundle->hash);
+}
+
+// Creates a pipeline cache seeded from `path` when it exists. The driver
+// rejects data from another device or driver version by itself.
+static VkPipelineCache spirvBundleLoadPipelineCache(VkDevice device, const char* path) {
+    void* data = NULL;
+    size_t size = 0;
+    FILE* file = fopen(path, "rb");
+    if (file) {
+        fseek(file, 0, SEEK_END);
+        long length = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        data = length > 0 ? malloc((size_t)length) : NULL;
+        if (data && fread(data, 1, (size_t)length, file) == (size_t)length) {
+            size = (size_t)length;
+        }
+        fclose(file);
+    }
+    VkPipelineCacheCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    createInfo.initialDataSize = size;
+    createInfo.pInitialData = size ? data : NULL;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    if (vkCreatePipelineCache(device, &createInfo, hostCallbacks, &cache) != VK_SUCCESS && size) {
+        createInfo.initialDataSize = 0;
+        createInfo.pInitialData = NULL;
+        vkCreatePipelineCache(device, &createInfo, hostCallbacks, &cache);
+    }
+    free(data);
+    return cache;
+}
+
+// Writes the cache back to `path` and destroys it.
+static void spirvBundleSavePipelineCache(VkDevice device, VkPipelineCache cache, const char* path) {
+    if (cache == VK_NULL_HANDLE) {
+        return;
+    }
+    size_t size = 0;
+    void* data = NULL;
+    if (vkGetPipelineCacheData(device, cache, &size, NULL) == VK_SUCCESS && size > 0 && (data = malloc(size)) != NULL &&
+        vkGetPipelineCacheData(device, cache, &size, data) == VK_SUCCESS) {
+        FILE* file = fopen(path, "wb");
+        if (file) {
+            fwrite(data, 1, size, file);
+            fclose(file);
+        } else {
+            fprintf(stderr, "Failed to write pipeline cache %s\n", path);
+        }
+    }
+    free(data);
+    vkDestroyPipelineCache(device, cache, hostCallbacks);
+}
+#endif
+
+#endif // SPIRV_BUNDLE_H
@@ -0,0 +1,52 @@
+// spvbundle.c
+// Packs SPIR-V modules into one indexed bundle (spirv_bundle.h) for
+// `render --bundle` and `compute --bundle`, or lists a bundle's index.
+//
+//   spvbundle <output.spvb> <module.spv>...
+//   spvbundle --list <bundle.spvb>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "spirv_bundle.h"
+
+static const char* stageName(uint32_t stage) {
+    switch (stage) {
+        case SPIRV_BUNDLE_STAGE_VERTEX: return "vertex";
+        case SPIRV_BUNDLE_STAGE_FRAGMENT: return "fragment";
+        case SPIRV_BUNDLE_STAGE_COMPUTE: return "compute";
+        default: return "?";
+    }
+}
+
+static int listBundle(const char* path) {
+    SpirvBundle bundle;
+    if (!spirvBundleOpen(&bundle, path)) {
+        return EXIT_FAILURE;
+    }
+    printf("%s: %u modules, %zu bytes, hash %016llx\n", path, bundle.moduleCount, bundle.size, (unsigned long long)bundle.hash);
+    printf("%-48s %-9s %-8s %16s %10s\n", "name", "stage", "entry", "hash", "bytes");
+    for (uint32_t i = 0; i < bundle.moduleCount; i++) {
+        const SpirvBundleEntry* entry = &bundle.entries[i];
+        printf("%-48s %-9s %-8s %016llx %10llu\n", entry->name, stageName(entry->stage), entry->entryPoint,
+               (unsigned long long)entry->hash, (unsigned long long)entry->size);
+    }
+    spirvBundleClose(&bundle);
+    return EXIT_SUCCESS;
+}
+
+int main(int argc, char** argv) {
+    if (argc == 3 && strcmp(argv[1], "--list") == 0) {
+        return listBundle(argv[2]);
+    }
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <output.spvb> <module.spv>...\n       %s --list <bundle.spvb>\n", argv[0], argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (!spirvBundleWrite(argv[1], (const char* const*)&argv[2], (uint32_t)(argc - 2))) {
+        return EXIT_FAILURE;
+    }
+    printf("Wrote %d modules to %s\n", argc - 2, argv[1]);
+    return EXIT_SUCCESS;
+}
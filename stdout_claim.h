@@ -0,0 +1,40 @@
+// stdout_claim.h
+// Lets one machine-readable output (a frame stream, a JSON report, a CSV
+// timeline) own stdout while the status and benchmark text, which the
+// programs print with printf, moves to stderr.
+
+#ifndef STDOUT_CLAIM_H
+#define STDOUT_CLAIM_H
+
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+// Hands the original stdout descriptor to the caller and points stdout at
+// stderr, so status messages can't corrupt the output. Call it before
+// anything is printed; repeated calls return the same file.
+static FILE* stdoutClaim(void) {
+    static FILE* file = NULL;
+    if (file) {
+        return file;
+    }
+    fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+    _dup2(_fileno(stderr), _fileno(stdout));
+    _setmode(fd, _O_BINARY);
+    file = _fdopen(fd, "wb");
+#else
+    int fd = dup(STDOUT_FILENO);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    file = fdopen(fd, "wb");
+#endif
+    return file;
+}
+
+#endif // STDOUT_CLAIM_H
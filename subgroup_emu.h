@@ -0,0 +1,196 @@
+// subgroup_emu.h
+// Host-side emulation of the GL_KHR_shader_subgroup operations the shaders
+// use. A subgroup is an array of per-lane 32-bit values (floats travel as
+// their bit patterns, so shuffles are bit-exact) of a power-of-two size
+// between SUBGROUP_EMU_MIN_SIZE and SUBGROUP_EMU_MAX_SIZE. Lanes are
+// processed SUBGROUP_EMU_WIDTH at a time with AVX-512 or AVX2 when the
+// compiler targets them (-march=native, /arch:AVX2), one at a time otherwise.
+//
+// Where GLSL leaves a result undefined (a shuffle index >= the subgroup size,
+// shuffleUp/Down past the edge) the emulator picks a fixed answer: indices
+// wrap modulo the size and out-of-range up/down lanes keep their own value.
+
+#ifndef SUBGROUP_EMU_H
+#define SUBGROUP_EMU_H
+
+#include <stdint.h>
+
+#if defined(__AVX512F__) || defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#define SUBGROUP_EMU_MIN_SIZE 4
+#define SUBGROUP_EMU_MAX_SIZE 128
+
+#if defined(__AVX512F__)
+#define SUBGROUP_EMU_WIDTH 16
+#define SUBGROUP_EMU_ISA "avx512"
+#elif defined(__AVX2__)
+#define SUBGROUP_EMU_WIDTH 8
+#define SUBGROUP_EMU_ISA "avx2"
+#else
+#define SUBGROUP_EMU_WIDTH 1
+#define SUBGROUP_EMU_ISA "scalar"
+#endif
+
+static int subgroupEmuSizeSupported(uint32_t size) {
+    return size >= SUBGROUP_EMU_MIN_SIZE && size <= SUBGROUP_EMU_MAX_SIZE && (size & (size - 1)) == 0;
+}
+
+// out[lane] = values[ids[lane] % size]. `out` must not alias `values`.
+static void subgroupEmuShuffle(const uint32_t* values, const uint32_t* ids, uint32_t* out, uint32_t size) {
+    uint32_t lane = 0;
+#if defined(__AVX512F__)
+    __m512i mask512 = _mm512_set1_epi32((int)(size - 1));
+    for (; lane + 16 <= size; lane += 16) {
+        __m512i index = _mm512_and_si512(_mm512_loadu_si512(ids + lane), mask512);
+        _mm512_storeu_si512(out + lane, _mm512_i32gather_epi32(index, values, 4));
+    }
+#endif
+#if defined(__AVX2__)
+    __m256i mask256 = _mm256_set1_epi32((int)(size - 1));
+    for (; lane + 8 <= size; lane += 8) {
+        __m256i index = _mm256_and_si256(_mm256_loadu_si256((const __m256i*)(ids + lane)), mask256);
+        _mm256_storeu_si256((__m256i*)(out + lane), _mm256_i32gather_epi32((const int*)values, index, 4));
+    }
+#endif
+    for (; lane < size; lane++) {
+        out[lane] = values[ids[lane] & (size - 1)];
+    }
+}
+
+// subgroupShuffleXor: lane reads lane ^ mask.
+static void subgroupEmuShuffleXor(const uint32_t* values, uint32_t mask, uint32_t* out, uint32_t size) {
+    uint32_t ids[SUBGROUP_EMU_MAX_SIZE];
+    for (uint32_t lane = 0; lane < size; lane++) ids[lane] = lane ^ mask;
+    subgroupEmuShuffle(values, ids, out, size);
+}
+
+// subgroupShuffleUp: lane reads lane - delta.
+static void subgroupEmuShuffleUp(const uint32_t* values, uint32_t delta, uint32_t* out, uint32_t size) {
+    uint32_t ids[SUBGROUP_EMU_MAX_SIZE];
+    for (uint32_t lane = 0; lane < size; lane++) ids[lane] = lane >= delta ? lane - delta : lane;
+    subgroupEmuShuffle(values, ids, out, size);
+}
+
+// subgroupShuffleDown: lane reads lane + delta.
+static void subgroupEmuShuffleDown(const uint32_t* values, uint32_t delta, uint32_t* out, uint32_t size) {
+    uint32_t ids[SUBGROUP_EMU_MAX_SIZE];
+    for (uint32_t lane = 0; lane < size; lane++) ids[lane] = lane + delta < size ? lane + delta : lane;
+    subgroupEmuShuffle(values, ids, out, size);
+}
+
+// subgroupBallot: bit `lane` of the uvec4 is set when predicate[lane] != 0.
+static void subgroupEmuBallot(const uint32_t* predicate, uint32_t size, uint32_t ballot[4]) {
+    ballot[0] = ballot[1] = ballot[2] = ballot[3] = 0;
+    uint32_t lane = 0;
+#if defined(__AVX512F__)
+    for (; lane + 16 <= size; lane += 16) {
+        __m512i v = _mm512_loadu_si512(predicate + lane);
+        ballot[lane / 32] |= (uint32_t)_mm512_test_epi32_mask(v, v) << (lane % 32);
+    }
+#endif
+#if defined(__AVX2__)
+    for (; lane + 8 <= size; lane += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i*)(predicate + lane));
+        __m256i zero = _mm256_cmpeq_epi32(v, _mm256_setzero_si256());
+        uint32_t bits = ~(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(zero)) & 0xFFu;
+        ballot[lane / 32] |= bits << (lane % 32);
+    }
+#endif
+    for (; lane < size; lane++) {
+        if (predicate[lane]) ballot[lane / 32] |= 1u << (lane % 32);
+    }
+}
+
+static uint32_t subgroupEmuBallotBitCount(const uint32_t ballot[4]) {
+    uint32_t count = 0;
+    for (int i = 0; i < 4; i++) {
+        for (uint32_t bits = ballot[i]; bits; bits &= bits - 1) count++;
+    }
+    return count;
+}
+
+// subgroupAdd/Min/Max/And/Or/Xor over unsigned lanes. Vector lanes are
+// folded into one accumulator, then reduced in order on the host.
+#if defined(__AVX512F__)
+#define SUBGROUP_EMU_REDUCE_AVX512(op512)                                   \
+    if (size >= 16) {                                                        \
+        __m512i acc = _mm512_loadu_si512(values);                            \
+        for (lane = 16; lane + 16 <= size; lane += 16) {                     \
+            acc = op512(acc, _mm512_loadu_si512(values + lane));             \
+        }                                                                    \
+        uint32_t partial[16];                                                \
+        _mm512_storeu_si512(partial, acc);                                   \
+        for (int i = 0; i < 16; i++) result = SCALAR_OP(result, partial[i]); \
+    }
+#else
+#define SUBGROUP_EMU_REDUCE_AVX512(op512)
+#endif
+#if defined(__AVX2__)
+#define SUBGROUP_EMU_REDUCE_AVX2(op256)                                                 \
+    if (lane == 0 && size >= 8) {                                                       \
+        __m256i acc = _mm256_loadu_si256((const __m256i*)values);                       \
+        for (lane = 8; lane + 8 <= size; lane += 8) {                                   \
+            acc = op256(acc, _mm256_loadu_si256((const __m256i*)(values + lane)));      \
+        }                                                                               \
+        uint32_t partial[8];                                                            \
+        _mm256_storeu_si256((__m256i*)partial, acc);                                    \
+        for (int i = 0; i < 8; i++) result = SCALAR_OP(result, partial[i]);             \
+    }
+#else
+#define SUBGROUP_EMU_REDUCE_AVX2(op256)
+#endif
+
+#define SUBGROUP_EMU_REDUCTION(name, identity, op512, op256)            \
+    static uint32_t name(const uint32_t* values, uint32_t size) {       \
+        uint32_t result = identity;                                     \
+        uint32_t lane = 0;                                              \
+        SUBGROUP_EMU_REDUCE_AVX512(op512)                               \
+        SUBGROUP_EMU_REDUCE_AVX2(op256)                                 \
+        for (; lane < size; lane++) result = SCALAR_OP(result, values[lane]); \
+        return result;                                                  \
+    }
+
+#define SCALAR_OP(a, b) ((a) + (b))
+SUBGROUP_EMU_REDUCTION(subgroupEmuAdd, 0u, _mm512_add_epi32, _mm256_add_epi32)
+#undef SCALAR_OP
+#define SCALAR_OP(a, b) ((a) < (b) ? (a) : (b))
+SUBGROUP_EMU_REDUCTION(subgroupEmuMin, UINT32_MAX, _mm512_min_epu32, _mm256_min_epu32)
+#undef SCALAR_OP
+#define SCALAR_OP(a, b) ((a) > (b) ? (a) : (b))
+SUBGROUP_EMU_REDUCTION(subgroupEmuMax, 0u, _mm512_max_epu32, _mm256_max_epu32)
+#undef SCALAR_OP
+#define SCALAR_OP(a, b) ((a) & (b))
+SUBGROUP_EMU_REDUCTION(subgroupEmuAnd, UINT32_MAX, _mm512_and_si512, _mm256_and_si256)
+#undef SCALAR_OP
+#define SCALAR_OP(a, b) ((a) | (b))
+SUBGROUP_EMU_REDUCTION(subgroupEmuOr, 0u, _mm512_or_si512, _mm256_or_si256)
+#undef SCALAR_OP
+#define SCALAR_OP(a, b) ((a) ^ (b))
+SUBGROUP_EMU_REDUCTION(subgroupEmuXor, 0u, _mm512_xor_si512, _mm256_xor_si256)
+#undef SCALAR_OP
+
+#undef SUBGROUP_EMU_REDUCTION
+#undef SUBGROUP_EMU_REDUCE_AVX2
+#undef SUBGROUP_EMU_REDUCE_AVX512
+
+// subgroupInclusiveAdd / subgroupExclusiveAdd. Scans are a serial dependency
+// chain and stay scalar.
+static void subgroupEmuInclusiveAdd(const uint32_t* values, uint32_t* out, uint32_t size) {
+    uint32_t sum = 0;
+    for (uint32_t lane = 0; lane < size; lane++) {
+        sum += values[lane];
+        out[lane] = sum;
+    }
+}
+
+static void subgroupEmuExclusiveAdd(const uint32_t* values, uint32_t* out, uint32_t size) {
+    uint32_t sum = 0;
+    for (uint32_t lane = 0; lane < size; lane++) {
+        out[lane] = sum;
+        sum += values[lane];
+    }
+}
+
+#endif // SUBGROUP_EMU_H
@@ -0,0 +1,133 @@
+// submit_graph.h
+// A small submission scheduler on a Vulkan 1.2 timeline semaphore. Each node
+// is a recorded command buffer plus the earlier nodes it depends on; the whole
+// graph goes to the queue in one vkQueueSubmit and the host waits once, on
+// the value signalled by the last node. Include after vulkan_functions.h.
+
+#ifndef SUBMIT_GRAPH_H
+#define SUBMIT_GRAPH_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "host_alloc.h"
+#include "timing.h"
+
+#define SUBMIT_GRAPH_MAX_NODES 16
+
+typedef struct {
+    const char* name;
+    VkCommandBuffer commandBuffer;
+    VkPipelineStageFlags waitStage; // First stage of this node that needs its dependencies.
+    uint32_t dependencyMask;        // Bit i set: waits for node i (i must be an earlier node).
+} SubmitNode;
+
+typedef struct {
+    VkDevice device;
+    VkQueue queue;
+    VkSemaphore timeline;
+    uint64_t baseValue; // Timeline value reached by the previous run.
+    SubmitNode nodes[SUBMIT_GRAPH_MAX_NODES];
+    uint32_t nodeCount;
+    double hostWaitSeconds; // Time the host spent blocked in submitGraphWait.
+} SubmitGraph;
+
+// Creates the timeline semaphore. The device must have the timelineSemaphore
+// feature enabled and vkWaitSemaphores loaded. Returns 0 on failure.
+static int submitGraphInit(SubmitGraph* graph, VkDevice device, VkQueue queue) {
+    memset(graph, 0, sizeof(*graph));
+    graph->device = device;
+    graph->queue = queue;
+    if (vkWaitSemaphores == NULL) {
+        return 0;
+    }
+
+    VkSemaphoreTypeCreateInfo typeCreateInfo = {0};
+    typeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    typeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    typeCreateInfo.initialValue = 0;
+    VkSemaphoreCreateInfo createInfo = {0};
+    createInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    createInfo.pNext = &typeCreateInfo;
+    return vkCreateSemaphore(device, &createInfo, hostCallbacks, &graph->timeline) == VK_SUCCESS;
+}
+
+// Appends a node and returns its index, for use in later dependency masks.
+// Returns UINT32_MAX and leaves the graph unchanged once it holds
+// SUBMIT_GRAPH_MAX_NODES nodes.
+static uint32_t submitGraphAddNode(SubmitGraph* graph, const char* name, VkCommandBuffer commandBuffer,
+                                   VkPipelineStageFlags waitStage, uint32_t dependencyMask) {
+    if (graph->nodeCount >= SUBMIT_GRAPH_MAX_NODES) {
+        return UINT32_MAX;
+    }
+    uint32_t index = graph->nodeCount++;
+    graph->nodes[index].name = name;
+    graph->nodes[index].commandBuffer = commandBuffer;
+    graph->nodes[index].waitStage = waitStage;
+    graph->nodes[index].dependencyMask = dependencyMask & ((1u << index) - 1u);
+    return index;
+}
+
+// Submits every node in one call. Node i signals baseValue + i + 1. Values on
+// one timeline only increase, so waiting on the latest dependency's value
+// covers all earlier ones too.
+static VkResult submitGraphSubmit(SubmitGraph* graph) {
+    VkSubmitInfo submitInfos[SUBMIT_GRAPH_MAX_NODES];
+    VkTimelineSemaphoreSubmitInfo timelineInfos[SUBMIT_GRAPH_MAX_NODES];
+    uint64_t waitValues[SUBMIT_GRAPH_MAX_NODES];
+    uint64_t signalValues[SUBMIT_GRAPH_MAX_NODES];
+
+    for (uint32_t i = 0; i < graph->nodeCount; i++) {
+        const SubmitNode* node = &graph->nodes[i];
+        uint32_t waitCount = 0;
+        if (node->dependencyMask != 0) {
+            uint32_t latest = 31;
+            while (!(node->dependencyMask & (1u << latest))) latest--;
+            waitValues[i] = graph->baseValue + latest + 1;
+            waitCount = 1;
+        }
+        signalValues[i] = graph->baseValue + i + 1;
+
+        memset(&timelineInfos[i], 0, sizeof(timelineInfos[i]));
+        timelineInfos[i].sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        timelineInfos[i].waitSemaphoreValueCount = waitCount;
+        timelineInfos[i].pWaitSemaphoreValues = &waitValues[i];
+        timelineInfos[i].signalSemaphoreValueCount = 1;
+        timelineInfos[i].pSignalSemaphoreValues = &signalValues[i];
+
+        memset(&submitInfos[i], 0, sizeof(submitInfos[i]));
+        submitInfos[i].sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfos[i].pNext = &timelineInfos[i];
+        submitInfos[i].waitSemaphoreCount = waitCount;
+        submitInfos[i].pWaitSemaphores = &graph->timeline;
+        submitInfos[i].pWaitDstStageMask = &node->waitStage;
+        submitInfos[i].commandBufferCount = 1;
+        submitInfos[i].pCommandBuffers = &node->commandBuffer;
+        submitInfos[i].signalSemaphoreCount = 1;
+        submitInfos[i].pSignalSemaphores = &graph->timeline;
+    }
+    return vkQueueSubmit(graph->queue, graph->nodeCount, submitInfos, VK_NULL_HANDLE);
+}
+
+// Blocks until the last node has finished, then rebases the graph so it can
+// be submitted again.
+static VkResult submitGraphWait(SubmitGraph* graph) {
+    uint64_t finalValue = graph->baseValue + graph->nodeCount;
+    VkSemaphoreWaitInfo waitInfo = {0};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &graph->timeline;
+    waitInfo.pValues = &finalValue;
+
+    double start = getTimeSeconds();
+    VkResult result = vkWaitSemaphores(graph->device, &waitInfo, UINT64_MAX);
+    graph->hostWaitSeconds += getTimeSeconds() - start;
+    graph->baseValue = finalValue;
+    return result;
+}
+
+static void submitGraphDestroy(SubmitGraph* graph) {
+    vkDestroySemaphore(graph->device, graph->timeline, hostCallbacks);
+}
+
+#endif // SUBMIT_GRAPH_H
@@ -0,0 +1,93 @@
+// threading.h
+// Minimal portable thread, mutex and condition variable wrappers
+// (pthreads on Linux, Win32 primitives on Windows).
+
+#ifndef THREADING_H
+#define THREADING_H
+
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+
+typedef HANDLE Thread;
+typedef CRITICAL_SECTION Mutex;
+typedef CONDITION_VARIABLE CondVar;
+
+typedef struct {
+    void* (*function)(void*);
+    void* argument;
+} ThreadStart;
+
+static DWORD WINAPI threadTrampoline(LPVOID parameter) {
+    ThreadStart start = *(ThreadStart*)parameter;
+    free(parameter);
+    start.function(start.argument);
+    return 0;
+}
+
+static int threadCreate(Thread* thread, void* (*function)(void*), void* argument) {
+    ThreadStart* start = (ThreadStart*)malloc(sizeof(ThreadStart));
+    if (!start) return 0;
+    start->function = function;
+    start->argument = argument;
+    *thread = CreateThread(NULL, 0, threadTrampoline, start, 0, NULL);
+    if (*thread == NULL) {
+        free(start);
+        return 0;
+    }
+    return 1;
+}
+
+static void threadJoin(Thread thread) {
+    WaitForSingleObject(thread, INFINITE);
+    CloseHandle(thread);
+}
+
+static void mutexInit(Mutex* mutex) { InitializeCriticalSection(mutex); }
+static void mutexDestroy(Mutex* mutex) { DeleteCriticalSection(mutex); }
+static void mutexLock(Mutex* mutex) { EnterCriticalSection(mutex); }
+static void mutexUnlock(Mutex* mutex) { LeaveCriticalSection(mutex); }
+
+static void condInit(CondVar* cond) { InitializeConditionVariable(cond); }
+static void condDestroy(CondVar* cond) { (void)cond; }
+static void condWait(CondVar* cond, Mutex* mutex) { SleepConditionVariableCS(cond, mutex, INFINITE); }
+static void condBroadcast(CondVar* cond) { WakeAllConditionVariable(cond); }
+
+static unsigned int hardwareThreadCount(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors;
+}
+
+#else
+#include <pthread.h>
+#include <unistd.h>
+
+typedef pthread_t Thread;
+typedef pthread_mutex_t Mutex;
+typedef pthread_cond_t CondVar;
+
+static int threadCreate(Thread* thread, void* (*function)(void*), void* argument) {
+    return pthread_create(thread, NULL, function, argument) == 0;
+}
+
+static void threadJoin(Thread thread) { pthread_join(thread, NULL); }
+
+static void mutexInit(Mutex* mutex) { pthread_mutex_init(mutex, NULL); }
+static void mutexDestroy(Mutex* mutex) { pthread_mutex_destroy(mutex); }
+static void mutexLock(Mutex* mutex) { pthread_mutex_lock(mutex); }
+static void mutexUnlock(Mutex* mutex) { pthread_mutex_unlock(mutex); }
+
+static void condInit(CondVar* cond) { pthread_cond_init(cond, NULL); }
+static void condDestroy(CondVar* cond) { pthread_cond_destroy(cond); }
+static void condWait(CondVar* cond, Mutex* mutex) { pthread_cond_wait(cond, mutex); }
+static void condBroadcast(CondVar* cond) { pthread_cond_broadcast(cond); }
+
+static unsigned int hardwareThreadCount(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+    return count > 0 ? (unsigned int)count : 1;
+}
+#endif
+
+#endif // THREADING_H
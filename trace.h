@@ -0,0 +1,134 @@
+// trace.h
+// Minimal tracing in the Chrome trace-event format (open the JSON in
+// https://ui.perfetto.dev or chrome://tracing). CPU spans are taken on the
+// main thread:
+//     double span = traceBegin();
+//     ...
+//     traceEnd("vkCreateDevice", span);
+// GPU spans come from timestamp queries. With no calibrated clock they are
+// placed on their own track relative to a CPU anchor (the submit time), so
+// they can start a little later than drawn but never earlier. When tracing
+// is off, traceBegin/traceEnd cost one branch.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "timing.h"
+
+enum {
+    TRACE_TRACK_CPU = 1,
+    TRACE_TRACK_GPU = 2,
+};
+
+typedef struct {
+    const char* name; // String literal or otherwise outlives the log.
+    double start;     // Seconds since traceInit().
+    double duration;
+    uint32_t track;
+    uint32_t index;   // Appended to the name when non-zero (per-frame spans).
+} TraceEvent;
+
+typedef struct {
+    int enabled;
+    double origin;
+    TraceEvent* events;
+    uint32_t count;
+    uint32_t capacity;
+    char processName[256];
+} TraceLog;
+
+static TraceLog traceLog;
+
+static void traceInit(int enabled) {
+    memset(&traceLog, 0, sizeof(traceLog));
+    traceLog.enabled = enabled;
+    traceLog.origin = getTimeSeconds();
+    snprintf(traceLog.processName, sizeof(traceLog.processName), "vulkan");
+}
+
+// Names the process row in the viewer (program and device).
+static void traceSetProcessName(const char* name) {
+    snprintf(traceLog.processName, sizeof(traceLog.processName), "%s", name);
+}
+
+static void traceAdd(const char* name, uint32_t index, double start, double duration, uint32_t track) {
+    if (traceLog.count == traceLog.capacity) {
+        traceLog.capacity = traceLog.capacity ? traceLog.capacity * 2 : 128;
+        traceLog.events = (TraceEvent*)realloc(traceLog.events, traceLog.capacity * sizeof(TraceEvent));
+    }
+    traceLog.events[traceLog.count++] = (TraceEvent){ name, start, duration, track, index };
+}
+
+static double traceBegin(void) {
+    return traceLog.enabled ? getTimeSeconds() : 0.0;
+}
+
+// Records a CPU span from `begin` (a traceBegin() value) to now.
+static void traceEnd(const char* name, double begin) {
+    if (!traceLog.enabled) return;
+    traceAdd(name, 0, begin - traceLog.origin, getTimeSeconds() - begin, TRACE_TRACK_CPU);
+}
+
+// Records a GPU span from two timestamp query results. `baseTicks` is the
+// timestamp that lines up with `anchor` (a getTimeSeconds() value), and
+// `period` the device's timestampPeriod in nanoseconds per tick. A non-zero
+// `index` is shown after the name, e.g. "frame 3".
+static void traceGpu(const char* name, uint32_t index, double anchor, uint64_t baseTicks, uint64_t beginTicks,
+                     uint64_t endTicks, float period) {
+    if (!traceLog.enabled) return;
+    double start = anchor - traceLog.origin + (double)(beginTicks - baseTicks) * period * 1e-9;
+    traceAdd(name, index, start, (double)(endTicks - beginTicks) * period * 1e-9, TRACE_TRACK_GPU);
+}
+
+static void traceWriteString(FILE* file, const char* text) {
+    fputc('"', file);
+    for (; *text; text++) {
+        if (*text == '"' || *text == '\\') fputc('\\', file);
+        if ((unsigned char)*text >= 0x20) fputc(*text, file);
+    }
+    fputc('"', file);
+}
+
+// Writes the trace as JSON to `path`. Returns 0 on failure.
+static int traceWrite(const char* path) {
+    FILE* file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "Failed to open trace file: %s\n", path);
+        return 0;
+    }
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":");
+    traceWriteString(file, traceLog.processName);
+    fprintf(file, "}},\n");
+    fprintf(file, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"CPU\"}},\n", TRACE_TRACK_CPU);
+    fprintf(file, "{\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"name\":\"thread_name\",\"args\":{\"name\":\"GPU\"}}", TRACE_TRACK_GPU);
+    for (uint32_t i = 0; i < traceLog.count; i++) {
+        const TraceEvent* event = &traceLog.events[i];
+        fprintf(file, ",\n{\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"cat\":\"%s\",\"name\":", event->track,
+                event->track == TRACE_TRACK_GPU ? "gpu" : "cpu");
+        if (event->index != 0) {
+            char name[256];
+            snprintf(name, sizeof(name), "%s %u", event->name, event->index);
+            traceWriteString(file, name);
+        } else {
+            traceWriteString(file, event->name);
+        }
+        fprintf(file, ",\"ts\":%.3f,\"dur\":%.3f}", event->start * 1e6, event->duration * 1e6);
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    printf("Trace written to %s (%u spans)\n", path, traceLog.count);
+    return 1;
+}
+
+static void traceDestroy(void) {
+    free(traceLog.events);
+    memset(&traceLog, 0, sizeof(traceLog));
+}
+
+#endif // TRACE_H
@@ -14,10 +14,18 @@
 #define INSTANCE_LEVEL_VULKAN_FUNCTION( name )
 #endif
 
+#ifndef OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION
+#define OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( name )
+#endif
+
 #ifndef DEVICE_LEVEL_VULKAN_FUNCTION
 #define DEVICE_LEVEL_VULKAN_FUNCTION( name )
 #endif
 
+#ifndef OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION
+#define OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( name )
+#endif
+
 // Dynamically loaded from libvulkan.so
 EXPORTED_VULKAN_FUNCTION( vkGetInstanceProcAddr )
 EXPORTED_VULKAN_FUNCTION( vkCreateInstance )
@@ -31,10 +39,14 @@ INSTANCE_LEVEL_VULKAN_FUNCTION( vkDestroyInstance )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkEnumeratePhysicalDevices )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceProperties )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceProperties2 )
+INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceFeatures2 )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceQueueFamilyProperties )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkCreateDevice )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetDeviceProcAddr )
 INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceMemoryProperties )
+INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceMemoryProperties2 )
+INSTANCE_LEVEL_VULKAN_FUNCTION( vkEnumerateDeviceExtensionProperties )
+INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceFormatProperties )
 
 // Device-level functions
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyDevice )
@@ -75,6 +87,7 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyRenderPass )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyFramebuffer )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyImageView )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyImage )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkFreeCommandBuffers )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyCommandPool )
 
 DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateDescriptorSetLayout )
@@ -90,8 +103,56 @@ DEVICE_LEVEL_VULKAN_FUNCTION( vkWaitForFences )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyFence )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyDescriptorPool )
 DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyDescriptorSetLayout )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkResetFences )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdPushConstants )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdFillBuffer )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdClearColorImage )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdCopyBuffer )
+
+// Timestamp queries used by the benchmarks
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateQueryPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyQueryPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdResetQueryPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdWriteTimestamp )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetQueryPoolResults )
+
+// Timeline semaphores (Vulkan 1.2)
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateSemaphore )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroySemaphore )
+OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( vkWaitSemaphores )
+OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( vkGetSemaphoreCounterValue )
+
+// Parallel recording into secondary command buffers
+DEVICE_LEVEL_VULKAN_FUNCTION( vkResetCommandPool )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdExecuteCommands )
+OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdDispatchBase )
+
+// Output layouts: linear images and texel buffers
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetImageSubresourceLayout )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreateBufferView )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyBufferView )
+
+// Pipeline cache of a shader bundle (spirv_bundle.h)
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCreatePipelineCache )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkGetPipelineCacheData )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkDestroyPipelineCache )
+
+// GPU-driven dispatch sizes
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdDispatchIndirect )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdUpdateBuffer )
+
+// Pipeline statistics and performance counters (gpu_counters.h)
+OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( vkEnumeratePhysicalDeviceQueueFamilyPerformanceQueryCountersKHR )
+OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION( vkGetPhysicalDeviceQueueFamilyPerformanceQueryPassesKHR )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdBeginQuery )
+DEVICE_LEVEL_VULKAN_FUNCTION( vkCmdEndQuery )
+OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( vkResetQueryPool )
+OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( vkAcquireProfilingLockKHR )
+OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION( vkReleaseProfilingLockKHR )
 
 #undef EXPORTED_VULKAN_FUNCTION
 #undef GLOBAL_LEVEL_VULKAN_FUNCTION
 #undef INSTANCE_LEVEL_VULKAN_FUNCTION
+#undef OPTIONAL_INSTANCE_LEVEL_VULKAN_FUNCTION
 #undef DEVICE_LEVEL_VULKAN_FUNCTION
+#undef OPTIONAL_DEVICE_LEVEL_VULKAN_FUNCTION